@@ -38,6 +38,7 @@ PRIV_HEADERS = \
 	priv/host_generic_simd256.h	\
 	priv/main_globals.h		\
 	priv/main_util.h		\
+	priv/main_stats.h		\
 	priv/guest_generic_x87.h	\
 	priv/guest_generic_bb_to_IR.h	\
 	priv/guest_x86_defs.h		\
@@ -48,15 +49,19 @@ PRIV_HEADERS = \
 	priv/s390_disasm.h		\
 	priv/s390_defs.h		\
 	priv/ir_match.h			\
-	priv/ir_opt.h
+	priv/ir_opt.h			\
+	priv/ir_serialize.h
 
 NORMAL_OBJS = \
 	priv/ir_defs.o			\
 	priv/ir_match.o			\
 	priv/ir_opt.o			\
 	priv/ir_inject.o		\
+	priv/ir_serialize.o		\
 	priv/main_globals.o		\
 	priv/main_util.o		\
+	priv/main_liftcache.o		\
+	priv/main_stats.o		\
 	priv/s390_disasm.o		\
 	priv/host_x86_defs.o		\
 	priv/host_amd64_defs.o		\
@@ -78,6 +83,7 @@ NORMAL_OBJS = \
 	priv/host_generic_simd128.o	\
 	priv/host_generic_simd256.o	\
 	priv/host_generic_reg_alloc2.o	\
+	priv/host_generic_reg_alloc3.o	\
 	priv/guest_generic_x87.o	\
 	priv/guest_generic_bb_to_IR.o	\
 	priv/guest_x86_helpers.o	\
@@ -63,9 +63,23 @@ DisResult disInstr_AMD64 ( IRSB*        irbb,
                            VexEndness   host_endness,
                            Bool         sigill_diag );
 
+/* Decode one amd64 insn without generating IR.  See
+   LibVEX_DecodeInsn. */
+extern
+Bool decodeInsn_AMD64 ( const UChar* code, UInt n_bytes, Addr addr,
+                        const VexArchInfo* archinfo,
+                        /*OUT*/VexDecodedInsn* insn );
+
+/* Likewise for an x86 insn.  This lives with the amd64 one, since
+   the two encodings differ only in a few places. */
+extern
+Bool decodeInsn_X86 ( const UChar* code, UInt n_bytes, Addr addr,
+                      const VexArchInfo* archinfo,
+                      /*OUT*/VexDecodedInsn* insn );
+
 /* Used by the optimiser to specialise calls to helpers. */
 extern
-IRExpr* guest_amd64_spechelper ( const HChar* function_name,
+IRExpr* guest_amd64_spechelper ( const IRCallee* cee,
                                  IRExpr** args,
                                  IRStmt** precedingStmts,
                                  Int      n_precedingStmts );
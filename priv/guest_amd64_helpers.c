@@ -575,17 +575,32 @@ static UInt tab_cond[AMD64G_CC_OP_NUMBER][16];
 static UInt n_calc_all  = 0;
 static UInt n_calc_c    = 0;
 static UInt n_calc_cond = 0;
+/* how many of the calc_cond calls took the fast route */
+static UInt n_calc_cond_fast = 0;
 
 #define SHOW_COUNTS_NOW (0 == (0x3FFFFF & (n_calc_all+n_calc_c+n_calc_cond)))
 
+/* n as a percentage of total, or 0 if total is 0 */
+static UInt percent ( UInt n, UInt total )
+{
+   return total == 0 ? 0 : (UInt)((100ULL * n) / total);
+}
+
 
 static void showCounts ( void )
 {
    Int op, co;
    HChar ch;
+   UInt n_calc_c_fast = 0;
    vex_printf("\nTotal calls: calc_all=%u   calc_cond=%u   calc_c=%u\n",
               n_calc_all, n_calc_cond, n_calc_c);
 
+   for (op = 0; op < AMD64G_CC_OP_NUMBER; op++)
+      n_calc_c_fast += tabc_fast[op];
+   vex_printf("Fast route hits: calc_cond=%u (%u%%)   calc_c=%u (%u%%)\n",
+              n_calc_cond_fast, percent(n_calc_cond_fast, n_calc_cond),
+              n_calc_c_fast, percent(n_calc_c_fast, n_calc_c));
+
    vex_printf("      cSLOW  cFAST    O   NO    B   NB    Z   NZ   BE  NBE"
               "    S   NS    P   NP    L   NL   LE  NLE\n");
    vex_printf("     -----------------------------------------------------"
@@ -625,6 +640,7 @@ static void initCounts ( void )
 {
    Int op, co;
    initted = True;
+   n_calc_cond_fast = 0;
    for (op = 0; op < AMD64G_CC_OP_NUMBER; op++) {
       tabc_fast[op] = tabc_slow[op] = 0;
       for (co = 0; co < 16; co++)
@@ -635,6 +651,16 @@ static void initCounts ( void )
 #endif /* PROFILE_RFLAGS */
 
 
+/* For the cc_ops that come in B/W/L/Q groups (ADDB .. SMULQ), the
+   left shift that moves the top bit of an operand of that size up to
+   bit 63.  Once both operands of a thunk are shifted like that, plain
+   64-bit comparisons give the flag values for any size, without
+   masking or sign extension. */
+static const UChar cc_op_size_shift[4] = { 56, 48, 32, 0 };
+
+#define CC_OP_SIZE_SHIFT(_cc_op) (cc_op_size_shift[((_cc_op) - 1) & 3])
+
+
 /* CALLED FROM GENERATED CODE: CLEAN HELPER */
 /* Calculate all the 6 flags from the supplied thunk parameters.
    Worker function, not directly called from generated code. */
@@ -785,18 +811,21 @@ ULong amd64g_calculate_rflags_c ( ULong cc_op,
       case AMD64G_CC_OP_LOGICW: 
       case AMD64G_CC_OP_LOGICB:
          return 0;
-	 //      case AMD64G_CC_OP_SUBL:
-	 //         return ((UInt)cc_dep1) < ((UInt)cc_dep2)
-	 //                   ? AMD64G_CC_MASK_C : 0;
-	 //      case AMD64G_CC_OP_SUBW:
-	 //         return ((UInt)(cc_dep1 & 0xFFFF)) < ((UInt)(cc_dep2 & 0xFFFF))
-	 //                   ? AMD64G_CC_MASK_C : 0;
-	 //      case AMD64G_CC_OP_SUBB:
-	 //         return ((UInt)(cc_dep1 & 0xFF)) < ((UInt)(cc_dep2 & 0xFF))
-	 //                   ? AMD64G_CC_MASK_C : 0;
-	 //      case AMD64G_CC_OP_INCL:
-	 //      case AMD64G_CC_OP_DECL:
-	 //         return cc_ndep & AMD64G_CC_MASK_C;
+      case AMD64G_CC_OP_ADDQ:
+      case AMD64G_CC_OP_ADDL:
+      case AMD64G_CC_OP_ADDW:
+      case AMD64G_CC_OP_ADDB: {
+         /* carry out iff the result is below argL */
+         Int sh = CC_OP_SIZE_SHIFT(cc_op);
+         return ((cc_dep1 + cc_dep2) << sh) < (cc_dep1 << sh);
+      }
+      case AMD64G_CC_OP_SUBQ:
+      case AMD64G_CC_OP_SUBL:
+      case AMD64G_CC_OP_SUBW:
+      case AMD64G_CC_OP_SUBB: {
+         Int sh = CC_OP_SIZE_SHIFT(cc_op);
+         return (cc_dep1 << sh) < (cc_dep2 << sh);
+      }
       default: 
          break;
    }
@@ -811,6 +840,86 @@ ULong amd64g_calculate_rflags_c ( ULong cc_op,
 }
 
 
+/* Fast route for amd64g_calculate_condition.  Profiling (see
+   PROFILE_RFLAGS) shows that most calls which get this far are for a
+   SUB or LOGIC thunk: typically the second of two conditional jumps
+   on the same flags, as in "cmp ; je ; jl", since the second jump
+   starts a new block and so the spechelper cannot see which cc_op
+   it is.  Shifts come next, with Z/NZ.  For those pairs, compute the
+   condition directly from the thunk rather than building all of
+   %rflags first.  Returns False, leaving *res alone, for pairs not
+   handled here; P/NP is never handled, and O/NO only for LOGIC. */
+static inline
+Bool calculate_condition_fast ( ULong/*AMD64Condcode*/ cond,
+                                ULong cc_op,
+                                ULong cc_dep1,
+                                ULong cc_dep2,
+                                /*OUT*/ULong* res )
+{
+   ULong argL, argR, r, b;
+   Int   sh;
+
+   switch (cc_op) {
+      case AMD64G_CC_OP_SUBB:
+      case AMD64G_CC_OP_SUBW:
+      case AMD64G_CC_OP_SUBL:
+      case AMD64G_CC_OP_SUBQ:
+         sh   = CC_OP_SIZE_SHIFT(cc_op);
+         argL = cc_dep1 << sh;
+         argR = cc_dep2 << sh;
+         switch (cond & ~1ULL) {
+            case AMD64CondB:  b = argL < argR;                 break;
+            case AMD64CondZ:  b = argL == argR;                break;
+            case AMD64CondBE: b = argL <= argR;                break;
+            case AMD64CondS:  b = (Long)(argL - argR) < 0;     break;
+            case AMD64CondL:  b = (Long)argL < (Long)argR;     break;
+            case AMD64CondLE: b = (Long)argL <= (Long)argR;    break;
+            default:          return False;
+         }
+         break;
+
+      case AMD64G_CC_OP_LOGICB:
+      case AMD64G_CC_OP_LOGICW:
+      case AMD64G_CC_OP_LOGICL:
+      case AMD64G_CC_OP_LOGICQ:
+         /* OF = CF = 0 */
+         r = cc_dep1 << CC_OP_SIZE_SHIFT(cc_op);
+         switch (cond & ~1ULL) {
+            case AMD64CondO:
+            case AMD64CondB:  b = 0;                           break;
+            case AMD64CondZ:
+            case AMD64CondBE: b = r == 0;                      break;
+            case AMD64CondS:
+            case AMD64CondL:  b = (Long)r < 0;                 break;
+            case AMD64CondLE: b = (Long)r <= 0;                break;
+            default:          return False;
+         }
+         break;
+
+      case AMD64G_CC_OP_SHLB:
+      case AMD64G_CC_OP_SHLW:
+      case AMD64G_CC_OP_SHLL:
+      case AMD64G_CC_OP_SHLQ:
+      case AMD64G_CC_OP_SHRB:
+      case AMD64G_CC_OP_SHRW:
+      case AMD64G_CC_OP_SHRL:
+      case AMD64G_CC_OP_SHRQ:
+         r = cc_dep1 << CC_OP_SIZE_SHIFT(cc_op);
+         switch (cond & ~1ULL) {
+            case AMD64CondZ:  b = r == 0;                      break;
+            case AMD64CondS:  b = (Long)r < 0;                 break;
+            default:          return False;
+         }
+         break;
+
+      default:
+         return False;
+   }
+
+   *res = 1 & ((cond & 1) ^ b);
+   return True;
+}
+
 /* CALLED FROM GENERATED CODE: CLEAN HELPER */
 /* returns 1 or 0 */
 ULong amd64g_calculate_condition ( ULong/*AMD64Condcode*/ cond, 
@@ -819,10 +928,10 @@ ULong amd64g_calculate_condition ( ULong/*AMD64Condcode*/ cond,
                                    ULong cc_dep2,
                                    ULong cc_ndep )
 {
-   ULong rflags = amd64g_calculate_rflags_all_WRK(cc_op, cc_dep1, 
-                                                  cc_dep2, cc_ndep);
+   ULong rflags;
    ULong of,sf,zf,cf,pf;
    ULong inv = cond & 1;
+   ULong res;
 
 #  if PROFILE_RFLAGS
    if (!initted) initCounts();
@@ -831,6 +940,16 @@ ULong amd64g_calculate_condition ( ULong/*AMD64Condcode*/ cond,
    if (SHOW_COUNTS_NOW) showCounts();
 #  endif
 
+   if (calculate_condition_fast(cond, cc_op, cc_dep1, cc_dep2, &res)) {
+#     if PROFILE_RFLAGS
+      n_calc_cond_fast++;
+#     endif
+      return res;
+   }
+
+   rflags = amd64g_calculate_rflags_all_WRK(cc_op, cc_dep1, 
+                                            cc_dep2, cc_ndep);
+
    switch (cond) {
       case AMD64CondNO:
       case AMD64CondO: /* OF == 1 */
@@ -987,7 +1106,7 @@ static Bool isU64 ( IRExpr* e, ULong n )
                   && e->Iex.Const.con->Ico.U64 == n );
 }
 
-IRExpr* guest_amd64_spechelper ( const HChar* function_name,
+IRExpr* guest_amd64_spechelper ( const IRCallee* cee,
                                  IRExpr** args,
                                  IRStmt** precedingStmts,
                                  Int      n_precedingStmts )
@@ -1003,7 +1122,7 @@ IRExpr* guest_amd64_spechelper ( const HChar* function_name,
       arity++;
 #  if 0
    vex_printf("spec request:\n");
-   vex_printf("   %s  ", function_name);
+   vex_printf("   %s  ", cee->name);
    for (i = 0; i < arity; i++) {
       vex_printf("  ");
       ppIRExpr(args[i]);
@@ -1013,7 +1132,7 @@ IRExpr* guest_amd64_spechelper ( const HChar* function_name,
 
    /* --------- specialising "amd64g_calculate_condition" --------- */
 
-   if (vex_streq(function_name, "amd64g_calculate_condition")) {
+   if (cee->addr == &amd64g_calculate_condition) {
       /* specialise calls to above "calculate condition" function */
       IRExpr *cond, *cc_op, *cc_dep1, *cc_dep2;
       vassert(arity == 5);
@@ -1702,7 +1821,7 @@ IRExpr* guest_amd64_spechelper ( const HChar* function_name,
 
    /* --------- specialising "amd64g_calculate_rflags_c" --------- */
 
-   if (vex_streq(function_name, "amd64g_calculate_rflags_c")) {
+   if (cee->addr == &amd64g_calculate_rflags_c) {
       /* specialise calls to above "calculate_rflags_c" function */
       IRExpr *cc_op, *cc_dep1, *cc_dep2, *cc_ndep;
       vassert(arity == 4);
@@ -185,21 +185,21 @@
    that we don't have to pass them around endlessly. */
 
 /* We need to know this to do sub-register accesses correctly. */
-static VexEndness host_endness;
+static VEX_TLS VexEndness host_endness;
 
 /* Pointer to the guest code area (points to start of BB, not to the
    insn being processed). */
-static const UChar* guest_code;
+static VEX_TLS const UChar* guest_code;
 
 /* The guest address corresponding to guest_code[0]. */
-static Addr64 guest_RIP_bbstart;
+static VEX_TLS Addr64 guest_RIP_bbstart;
 
 /* The guest address for the instruction currently being
    translated. */
-static Addr64 guest_RIP_curr_instr;
+static VEX_TLS Addr64 guest_RIP_curr_instr;
 
 /* The IRSB* into which we're generating code. */
-static IRSB* irsb;
+static VEX_TLS IRSB* irsb;
 
 /* For ensuring that %rip-relative addressing is done right.  A read
    of %rip generates the address of the next instruction.  It may be
@@ -213,8 +213,8 @@ static IRSB* irsb;
    After the decode, if _mustcheck is now True, _assumed is
    checked. */
 
-static Addr64 guest_RIP_next_assumed;
-static Bool   guest_RIP_next_mustcheck;
+static VEX_TLS Addr64 guest_RIP_next_assumed;
+static VEX_TLS Bool   guest_RIP_next_mustcheck;
 
 
 /*------------------------------------------------------------*/
@@ -19840,6 +19840,233 @@ Long dis_ESC_0F3A__SSE4 ( Bool* decode_OK,
 }
 
 
+/*------------------------------------------------------------*/
+/*---                                                      ---*/
+/*--- Top-level post-escape decoders: SSE routing tables   ---*/
+/*---                                                      ---*/
+/*------------------------------------------------------------*/
+
+/* dis_ESC_0F, dis_ESC_0F38 and dis_ESC_0F3A pass anything their own
+   switches don't take to the SSE decoders above, one after another,
+   until one accepts it.  Almost every opcode is known to just one of
+   them, so rather than have the rest each run their switch and fail,
+   these tables say which decoders have a case for which opcode.  An
+   entry must name every decoder whose top-level switch has a case
+   for the opcode; a case added to one of them without a matching
+   entry here is never reached. */
+
+#define SSE_DEC_SSE2     (1<<0)  /* dis_ESC_0F__SSE2 */
+#define SSE_DEC_SSE3     (1<<1)  /* dis_ESC_0F__SSE3 */
+#define SSE_DEC_SSE4     (1<<2)  /* dis_ESC_0F{,38,3A}__SSE4 */
+#define SSE_DEC_SupSSE3  (1<<3)  /* dis_ESC_0F{38,3A}__SupSSE3 */
+
+#define NO   0
+#define S2   SSE_DEC_SSE2
+#define S3   SSE_DEC_SSE3
+#define S23  (SSE_DEC_SSE2 | SSE_DEC_SSE3)
+#define S4   SSE_DEC_SSE4
+#define SS   SSE_DEC_SupSSE3
+
+static const UChar sse_decoders_0F[256] = {
+   /* 00 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 08 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 10 */ S2,  S2,  S23, S2,  S2,  S2,  S23, S2,
+   /* 18 */ S2,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 20 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 28 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* 30 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 38 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 40 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 48 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 50 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* 58 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* 60 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* 68 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* 70 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  NO,
+   /* 78 */ NO,  NO,  NO,  NO,  S3,  S3,  S2,  S2,
+   /* 80 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 88 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 90 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* 98 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* A0 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* A8 */ NO,  NO,  NO,  NO,  NO,  NO,  S2,  NO,
+   /* B0 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* B8 */ S4,  NO,  NO,  NO,  S4,  S4,  NO,  NO,
+   /* C0 */ NO,  NO,  S2,  S2,  S2,  S2,  S2,  NO,
+   /* C8 */ NO,  NO,  NO,  NO,  NO,  NO,  NO,  NO,
+   /* D0 */ S3,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* D8 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* E0 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* E8 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* F0 */ S3,  S2,  S2,  S2,  S2,  S2,  S2,  S2,
+   /* F8 */ S2,  S2,  S2,  S2,  S2,  S2,  S2,  NO
+};
+
+static const UChar sse_decoders_0F38[256] = {
+   /* 00 */ SS, SS, SS, SS, SS, SS, SS, SS, SS, SS, SS, SS, NO, NO, NO, NO,
+   /* 10 */ S4, NO, NO, NO, S4, S4, NO, S4, NO, NO, NO, NO, SS, SS, SS, NO,
+   /* 20 */ S4, S4, S4, S4, S4, S4, NO, NO, S4, S4, S4, S4, NO, NO, NO, NO,
+   /* 30 */ S4, S4, S4, S4, S4, S4, NO, S4, S4, S4, S4, S4, S4, S4, S4, S4,
+   /* 40 */ S4, S4, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 50 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 60 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 70 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 80 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 90 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* A0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* B0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* C0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* D0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, S4, S4, S4, S4, S4,
+   /* E0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* F0 */ S4, S4, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO
+};
+
+static const UChar sse_decoders_0F3A[256] = {
+   /* 00 */ NO, NO, NO, NO, NO, NO, NO, NO, S4, S4, S4, S4, S4, S4, S4, SS,
+   /* 10 */ NO, NO, NO, NO, S4, S4, S4, S4, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 20 */ S4, S4, S4, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 30 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 40 */ S4, S4, S4, NO, S4, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 50 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 60 */ S4, S4, S4, S4, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 70 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 80 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* 90 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* A0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* B0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* C0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* D0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, S4,
+   /* E0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO,
+   /* F0 */ NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO, NO
+};
+
+#undef NO
+#undef S2
+#undef S3
+#undef S23
+#undef S4
+#undef SS
+
+/* Set to 1 to have the first amd64 translation on each thread check
+   the tables above against the decoders, and panic if an entry is
+   missing.  Worth doing after adding cases to any of the decoders. */
+#define CHECK_SSE_DECODERS 0
+
+#if CHECK_SSE_DECODERS
+/* Run the decoder dec for escape esc (0 for 0F, 1 for 0F38, 2 for
+   0F3A) on the insn at guest_code[0], and say whether it took it. */
+static Bool try_sse_decoder ( Int esc, UInt dec,
+                              const VexArchInfo* archinfo,
+                              const VexAbiInfo* vbi,
+                              Prefix pfx, Int sz, DisResult* dres )
+{
+   Bool decode_OK = False;
+   switch (esc * 16 + dec) {
+      case 0 * 16 + SSE_DEC_SSE2:
+         dis_ESC_0F__SSE2(&decode_OK, archinfo, vbi, pfx, sz, 0, dres);
+         break;
+      case 0 * 16 + SSE_DEC_SSE3:
+         dis_ESC_0F__SSE3(&decode_OK, vbi, pfx, sz, 0);
+         break;
+      case 0 * 16 + SSE_DEC_SSE4:
+         dis_ESC_0F__SSE4(&decode_OK, archinfo, vbi, pfx, sz, 0);
+         break;
+      case 1 * 16 + SSE_DEC_SupSSE3:
+         dis_ESC_0F38__SupSSE3(&decode_OK, vbi, pfx, sz, 0);
+         break;
+      case 1 * 16 + SSE_DEC_SSE4:
+         dis_ESC_0F38__SSE4(&decode_OK, vbi, pfx, sz, 0);
+         break;
+      case 2 * 16 + SSE_DEC_SupSSE3:
+         dis_ESC_0F3A__SupSSE3(&decode_OK, vbi, pfx, sz, 0);
+         break;
+      case 2 * 16 + SSE_DEC_SSE4:
+         dis_ESC_0F3A__SSE4(&decode_OK, vbi, pfx, sz, 0);
+         break;
+      default:
+         vpanic("try_sse_decoder");
+   }
+   return decode_OK;
+}
+
+/* Walk the opcode space of each escape.  For each opcode, every
+   decoder that the table leaves out must reject it, with each of a
+   set of mandatory prefix and operand size combinations, and each
+   modrm reg field in both register and memory forms.  The decoders
+   run on a scratch IRSB and code buffer, whose TEMP storage is given
+   back after each try; the globals are restored afterwards. */
+static void check_sse_decoder_tables ( const VexArchInfo* archinfo,
+                                       const VexAbiInfo*  vbi )
+{
+   static const Prefix pfxs[9]
+      = { 0, PFX_66, PFX_F2, PFX_F3, PFX_66 | PFX_F2,
+          PFX_REX | PFX_REXW, PFX_66 | PFX_REX | PFX_REXW,
+          PFX_F2 | PFX_REX | PFX_REXW, PFX_F3 | PFX_REX | PFX_REXW };
+   static const HChar* const escs[3] = { "0F", "0F 38", "0F 3A" };
+   const UChar* tabs[3] = { sse_decoders_0F, sse_decoders_0F38,
+                            sse_decoders_0F3A };
+   const UInt   decs[3]
+      = { SSE_DEC_SSE2 | SSE_DEC_SSE3 | SSE_DEC_SSE4,
+          SSE_DEC_SupSSE3 | SSE_DEC_SSE4,
+          SSE_DEC_SupSSE3 | SSE_DEC_SSE4 };
+   const UChar* saved_code     = guest_code;
+   IRSB*        saved_irsb     = irsb;
+   Addr64       saved_curr     = guest_RIP_curr_instr;
+   Addr64       saved_bbstart  = guest_RIP_bbstart;
+   Addr64       saved_assumed  = guest_RIP_next_assumed;
+   Bool         saved_mustchk  = guest_RIP_next_mustcheck;
+   UChar        code[32];
+   DisResult    dres;
+   VexTempMark  mark;
+   Int          esc, opc, p, m, n_bad = 0;
+   UInt         dec;
+
+   vexGetTempMark(&mark);
+   guest_code           = code;
+   guest_RIP_curr_instr = 0;
+   guest_RIP_bbstart    = 0;
+   for (esc = 0; esc < 3; esc++) {
+      for (opc = 0; opc < 256; opc++) {
+         for (dec = 1; dec <= decs[esc]; dec <<= 1) {
+            if (!(decs[esc] & dec) || (tabs[esc][opc] & dec))
+               continue;
+            for (p = 0; p < 9; p++) {
+               Prefix pfx = PFX_EMPTY | pfxs[p];
+               Int    sz  = (pfx & PFX_REXW) ? 8 : (pfx & PFX_66) ? 2 : 4;
+               /* mod 3 (register) or 0 (memory, at (%rcx)), rm 1 */
+               for (m = 0; m < 16; m++) {
+                  vex_bzero(code, sizeof code);
+                  code[0] = toUChar(opc);
+                  code[1] = toUChar(((m & 8) ? 0xC1 : 0x01) | ((m & 7) << 3));
+                  vexReleaseTempToMark(&mark);
+                  irsb = emptyIRSB();
+                  if (!try_sse_decoder(esc, dec, archinfo, vbi,
+                                       pfx, sz, &dres))
+                     continue;
+                  vex_printf("check_sse_decoder_tables: %s %02x, "
+                             "modrm %02x, pfx 0x%x: decoder 0x%x "
+                             "is missing from the table\n",
+                             escs[esc], (UInt)opc, (UInt)code[1],
+                             (UInt)pfxs[p], dec);
+                  n_bad++;
+               }
+            }
+         }
+      }
+   }
+   vexReleaseTempToMark(&mark);
+   guest_code               = saved_code;
+   irsb                     = saved_irsb;
+   guest_RIP_curr_instr     = saved_curr;
+   guest_RIP_bbstart        = saved_bbstart;
+   guest_RIP_next_assumed   = saved_assumed;
+   guest_RIP_next_mustcheck = saved_mustchk;
+   if (n_bad > 0)
+      vpanic("check_sse_decoder_tables: tables are incomplete");
+}
+#endif /* CHECK_SSE_DECODERS */
+
+
 /*------------------------------------------------------------*/
 /*---                                                      ---*/
 /*--- Top-level post-escape decoders: dis_ESC_NONE         ---*/
@@ -22511,7 +22738,7 @@ Long dis_ESC_0F (
    /* Perhaps it's an SSE or SSE2 instruction.  We can try this
       without checking the guest hwcaps because SSE2 is a baseline
       facility in 64 bit mode. */
-   {
+   if (sse_decoders_0F[opc] & SSE_DEC_SSE2) {
       Bool decode_OK = False;
       delta = dis_ESC_0F__SSE2 ( &decode_OK,
                                  archinfo, vbi, pfx, sz, deltaIN, dres );
@@ -22522,7 +22749,7 @@ Long dis_ESC_0F (
    /* =-=-=-=-=-=-=-=-= SSE3ery =-=-=-=-=-=-=-=-= */
    /* Perhaps it's a SSE3 instruction.  FIXME: check guest hwcaps
       first. */
-   {
+   if (sse_decoders_0F[opc] & SSE_DEC_SSE3) {
       Bool decode_OK = False;
       delta = dis_ESC_0F__SSE3 ( &decode_OK, vbi, pfx, sz, deltaIN );
       if (decode_OK)
@@ -22532,7 +22759,7 @@ Long dis_ESC_0F (
    /* =-=-=-=-=-=-=-=-= SSE4ery =-=-=-=-=-=-=-=-= */
    /* Perhaps it's a SSE4 instruction.  FIXME: check guest hwcaps
       first. */
-   {
+   if (sse_decoders_0F[opc] & SSE_DEC_SSE4) {
       Bool decode_OK = False;
       delta = dis_ESC_0F__SSE4 ( &decode_OK,
                                  archinfo, vbi, pfx, sz, deltaIN );
@@ -22608,7 +22835,7 @@ Long dis_ESC_0F38 (
    /* =-=-=-=-=-=-=-=-= SSSE3ery =-=-=-=-=-=-=-=-= */
    /* Perhaps it's an SSSE3 instruction.  FIXME: consult guest hwcaps
       rather than proceeding indiscriminately. */
-   {
+   if (sse_decoders_0F38[opc] & SSE_DEC_SupSSE3) {
       Bool decode_OK = False;
       delta = dis_ESC_0F38__SupSSE3 ( &decode_OK, vbi, pfx, sz, deltaIN );
       if (decode_OK)
@@ -22618,7 +22845,7 @@ Long dis_ESC_0F38 (
    /* =-=-=-=-=-=-=-=-= SSE4ery =-=-=-=-=-=-=-=-= */
    /* Perhaps it's an SSE4 instruction.  FIXME: consult guest hwcaps
       rather than proceeding indiscriminately. */
-   {
+   if (sse_decoders_0F38[opc] & SSE_DEC_SSE4) {
       Bool decode_OK = False;
       delta = dis_ESC_0F38__SSE4 ( &decode_OK, vbi, pfx, sz, deltaIN );
       if (decode_OK)
@@ -22661,7 +22888,7 @@ Long dis_ESC_0F3A (
    /* =-=-=-=-=-=-=-=-= SSSE3ery =-=-=-=-=-=-=-=-= */
    /* Perhaps it's an SSSE3 instruction.  FIXME: consult guest hwcaps
       rather than proceeding indiscriminately. */
-   {
+   if (sse_decoders_0F3A[opc] & SSE_DEC_SupSSE3) {
       Bool decode_OK = False;
       delta = dis_ESC_0F3A__SupSSE3 ( &decode_OK, vbi, pfx, sz, deltaIN );
       if (decode_OK)
@@ -22671,7 +22898,7 @@ Long dis_ESC_0F3A (
    /* =-=-=-=-=-=-=-=-= SSE4ery =-=-=-=-=-=-=-=-= */
    /* Perhaps it's an SSE4 instruction.  FIXME: consult guest hwcaps
       rather than proceeding indiscriminately. */
-   {
+   if (sse_decoders_0F3A[opc] & SSE_DEC_SSE4) {
       Bool decode_OK = False;
       delta = dis_ESC_0F3A__SSE4 ( &decode_OK, vbi, pfx, sz, deltaIN );
       if (decode_OK)
@@ -31941,6 +32168,169 @@ Long dis_ESC_0F3A__VEX (
 /*---                                                      ---*/
 /*------------------------------------------------------------*/
 
+/* Eat the prefixes of the insn at &code[*deltaMOD], summarising them
+   in *pfxOUT and *escOUT and leaving *deltaMOD at the opcode or,
+   without VEX, at any escape bytes.  Returns False for a combination
+   that is invalid, or for an %fs or %gs override when fs_ok or gs_ok
+   is False.  Shared by disInstr_AMD64_WRK and decode_insn_x86_family;
+   the latter also uses it for 32-bit code (!mode64), where 40..4F are
+   not prefixes and archinfo's hwcaps are not amd64 ones. */
+
+static Bool eat_prefixes ( /*OUT*/Prefix* pfxOUT, /*OUT*/Escape* escOUT,
+                           /*MOD*/Long* deltaMOD, const UChar* code,
+                           const VexArchInfo* archinfo,
+                           Bool fs_ok, Bool gs_ok, Bool mode64 )
+{
+   UChar  pre;
+   Int    n, n_prefixes;
+   Bool   ok     = False;
+   Prefix pfx    = PFX_EMPTY;
+   Escape esc    = ESC_NONE;
+   Long   delta  = *deltaMOD;
+
+   n_prefixes = 0;
+   while (True) {
+      if (n_prefixes > 7) goto bad;
+      pre = code[delta];
+      switch (pre) {
+         case 0x66: pfx |= PFX_66; break;
+         case 0x67: pfx |= PFX_ASO; break;
+         case 0xF2: pfx |= PFX_F2; break;
+         case 0xF3: pfx |= PFX_F3; break;
+         case 0xF0: pfx |= PFX_LOCK; break;
+         case 0x2E: pfx |= PFX_CS; break;
+         case 0x3E: pfx |= PFX_DS; break;
+         case 0x26: pfx |= PFX_ES; break;
+         case 0x64: pfx |= PFX_FS; break;
+         case 0x65: pfx |= PFX_GS; break;
+         case 0x36: pfx |= PFX_SS; break;
+
+         case 0x40: case 0x41: case 0x42: case 0x43:
+         case 0x44: case 0x45: case 0x46: case 0x47:
+         case 0x48: case 0x49: case 0x4a: case 0x4b:
+         case 0x4c: case 0x4d: case 0x4e: case 0x4f:
+            if (!mode64)
+               goto not_a_legacy_prefix; /* inc and dec */
+            pfx |= PFX_REX;
+            if (pre & (1<<3)) pfx |= PFX_REXW;
+            if (pre & (1<<2)) pfx |= PFX_REXR;
+            if (pre & (1<<1)) pfx |= PFX_REXX;
+            if (pre & (1<<0)) pfx |= PFX_REXB;
+            break;
+         default: 
+            goto not_a_legacy_prefix;
+      }
+      n_prefixes++;
+      delta++;
+   }
+
+   not_a_legacy_prefix:
+   /* We've used up all the non-VEX prefixes.  Parse and validate a
+      VEX prefix if that's appropriate.  In 32-bit code C4 and C5 are
+      LES and LDS unless a register-form modrm follows, which those
+      can't have. */
+   if (mode64 ? (archinfo->hwcaps & VEX_HWCAPS_AMD64_AVX) != 0
+              : (code[delta+1] & 0xC0) == 0xC0) {
+      /* Used temporarily for holding VEX prefixes. */
+      UChar vex0 = code[delta];
+      if (vex0 == 0xC4) {
+         /* 3-byte VEX */
+         UChar vex1 = code[delta+1];
+         UChar vex2 = code[delta+2];
+         delta += 3;
+         pfx |= PFX_VEX;
+         /* Snarf contents of byte 1 */
+         /* R */ pfx |= (vex1 & (1<<7)) ? 0 : PFX_REXR;
+         /* X */ pfx |= (vex1 & (1<<6)) ? 0 : PFX_REXX;
+         /* B */ pfx |= (vex1 & (1<<5)) ? 0 : PFX_REXB;
+         /* m-mmmm */
+         switch (vex1 & 0x1F) {
+            case 1: esc = ESC_0F;   break;
+            case 2: esc = ESC_0F38; break;
+            case 3: esc = ESC_0F3A; break;
+            /* Any other m-mmmm field will #UD */
+            default: goto bad;
+         }
+         /* Snarf contents of byte 2 */
+         /* W */    pfx |= (vex2 & (1<<7)) ? PFX_REXW : 0;
+         /* ~v3 */  pfx |= (vex2 & (1<<6)) ? 0 : PFX_VEXnV3;
+         /* ~v2 */  pfx |= (vex2 & (1<<5)) ? 0 : PFX_VEXnV2;
+         /* ~v1 */  pfx |= (vex2 & (1<<4)) ? 0 : PFX_VEXnV1;
+         /* ~v0 */  pfx |= (vex2 & (1<<3)) ? 0 : PFX_VEXnV0;
+         /* L */    pfx |= (vex2 & (1<<2)) ? PFX_VEXL : 0;
+         /* pp */
+         switch (vex2 & 3) {
+            case 0: break;
+            case 1: pfx |= PFX_66; break;
+            case 2: pfx |= PFX_F3; break;
+            case 3: pfx |= PFX_F2; break;
+            default: vassert(0);
+         }
+      }
+      else if (vex0 == 0xC5) {
+         /* 2-byte VEX */
+         UChar vex1 = code[delta+1];
+         delta += 2;
+         pfx |= PFX_VEX;
+         /* Snarf contents of byte 1 */
+         /* R */    pfx |= (vex1 & (1<<7)) ? 0 : PFX_REXR;
+         /* ~v3 */  pfx |= (vex1 & (1<<6)) ? 0 : PFX_VEXnV3;
+         /* ~v2 */  pfx |= (vex1 & (1<<5)) ? 0 : PFX_VEXnV2;
+         /* ~v1 */  pfx |= (vex1 & (1<<4)) ? 0 : PFX_VEXnV1;
+         /* ~v0 */  pfx |= (vex1 & (1<<3)) ? 0 : PFX_VEXnV0;
+         /* L */    pfx |= (vex1 & (1<<2)) ? PFX_VEXL : 0;
+         /* pp */
+         switch (vex1 & 3) {
+            case 0: break;
+            case 1: pfx |= PFX_66; break;
+            case 2: pfx |= PFX_F3; break;
+            case 3: pfx |= PFX_F2; break;
+            default: vassert(0);
+         }
+         /* implied: */
+         esc = ESC_0F;
+      }
+      /* Can't have both VEX and REX */
+      if ((pfx & PFX_VEX) && (pfx & PFX_REX))
+         goto bad; /* can't have both */
+   }
+
+   /* Dump invalid combinations */
+   n = 0;
+   if (pfx & PFX_F2) n++;
+   if (pfx & PFX_F3) n++;
+   if (n > 1) 
+      goto bad; /* can't have both */
+
+   n = 0;
+   if (pfx & PFX_CS) n++;
+   if (pfx & PFX_DS) n++;
+   if (pfx & PFX_ES) n++;
+   if (pfx & PFX_FS) n++;
+   if (pfx & PFX_GS) n++;
+   if (pfx & PFX_SS) n++;
+   if (n > 1) 
+      goto bad; /* multiple seg overrides == illegal */
+
+   /* We have a %fs prefix.  Reject it if there's no evidence that we
+      should accept it. */
+   if ((pfx & PFX_FS) && !fs_ok)
+      goto bad;
+
+   /* Ditto for %gs prefixes. */
+   if ((pfx & PFX_GS) && !gs_ok)
+      goto bad;
+
+
+   ok = True;
+  bad:
+   *pfxOUT   = pfx;
+   *escOUT   = esc;
+   *deltaMOD = delta;
+   return ok;
+}
+
+
 /* Disassemble a single instruction into IR.  The instruction is
    located in host memory at &guest_code[delta]. */
    
@@ -31958,7 +32348,6 @@ DisResult disInstr_AMD64_WRK (
 {
    IRTemp    t1, t2;
    UChar     pre;
-   Int       n, n_prefixes;
    DisResult dres;
 
    /* The running delta */
@@ -32074,133 +32463,12 @@ DisResult disInstr_AMD64_WRK (
 
    /* Eat prefixes, summarising the result in pfx and sz, and rejecting
       as many invalid combinations as possible. */
-   n_prefixes = 0;
-   while (True) {
-      if (n_prefixes > 7) goto decode_failure;
-      pre = getUChar(delta);
-      switch (pre) {
-         case 0x66: pfx |= PFX_66; break;
-         case 0x67: pfx |= PFX_ASO; break;
-         case 0xF2: pfx |= PFX_F2; break;
-         case 0xF3: pfx |= PFX_F3; break;
-         case 0xF0: pfx |= PFX_LOCK; *expect_CAS = True; break;
-         case 0x2E: pfx |= PFX_CS; break;
-         case 0x3E: pfx |= PFX_DS; break;
-         case 0x26: pfx |= PFX_ES; break;
-         case 0x64: pfx |= PFX_FS; break;
-         case 0x65: pfx |= PFX_GS; break;
-         case 0x36: pfx |= PFX_SS; break;
-
-         case 0x40: case 0x41: case 0x42: case 0x43:
-         case 0x44: case 0x45: case 0x46: case 0x47:
-         case 0x48: case 0x49: case 0x4a: case 0x4b:
-         case 0x4c: case 0x4d: case 0x4e: case 0x4f:
-            pfx |= PFX_REX;
-            if (pre & (1<<3)) pfx |= PFX_REXW;
-            if (pre & (1<<2)) pfx |= PFX_REXR;
-            if (pre & (1<<1)) pfx |= PFX_REXX;
-            if (pre & (1<<0)) pfx |= PFX_REXB;
-            break;
-         default: 
-            goto not_a_legacy_prefix;
-      }
-      n_prefixes++;
-      delta++;
-   }
-
-   not_a_legacy_prefix:
-   /* We've used up all the non-VEX prefixes.  Parse and validate a
-      VEX prefix if that's appropriate. */
-   if (archinfo->hwcaps & VEX_HWCAPS_AMD64_AVX) {
-      /* Used temporarily for holding VEX prefixes. */
-      UChar vex0 = getUChar(delta);
-      if (vex0 == 0xC4) {
-         /* 3-byte VEX */
-         UChar vex1 = getUChar(delta+1);
-         UChar vex2 = getUChar(delta+2);
-         delta += 3;
-         pfx |= PFX_VEX;
-         /* Snarf contents of byte 1 */
-         /* R */ pfx |= (vex1 & (1<<7)) ? 0 : PFX_REXR;
-         /* X */ pfx |= (vex1 & (1<<6)) ? 0 : PFX_REXX;
-         /* B */ pfx |= (vex1 & (1<<5)) ? 0 : PFX_REXB;
-         /* m-mmmm */
-         switch (vex1 & 0x1F) {
-            case 1: esc = ESC_0F;   break;
-            case 2: esc = ESC_0F38; break;
-            case 3: esc = ESC_0F3A; break;
-            /* Any other m-mmmm field will #UD */
-            default: goto decode_failure;
-         }
-         /* Snarf contents of byte 2 */
-         /* W */    pfx |= (vex2 & (1<<7)) ? PFX_REXW : 0;
-         /* ~v3 */  pfx |= (vex2 & (1<<6)) ? 0 : PFX_VEXnV3;
-         /* ~v2 */  pfx |= (vex2 & (1<<5)) ? 0 : PFX_VEXnV2;
-         /* ~v1 */  pfx |= (vex2 & (1<<4)) ? 0 : PFX_VEXnV1;
-         /* ~v0 */  pfx |= (vex2 & (1<<3)) ? 0 : PFX_VEXnV0;
-         /* L */    pfx |= (vex2 & (1<<2)) ? PFX_VEXL : 0;
-         /* pp */
-         switch (vex2 & 3) {
-            case 0: break;
-            case 1: pfx |= PFX_66; break;
-            case 2: pfx |= PFX_F3; break;
-            case 3: pfx |= PFX_F2; break;
-            default: vassert(0);
-         }
-      }
-      else if (vex0 == 0xC5) {
-         /* 2-byte VEX */
-         UChar vex1 = getUChar(delta+1);
-         delta += 2;
-         pfx |= PFX_VEX;
-         /* Snarf contents of byte 1 */
-         /* R */    pfx |= (vex1 & (1<<7)) ? 0 : PFX_REXR;
-         /* ~v3 */  pfx |= (vex1 & (1<<6)) ? 0 : PFX_VEXnV3;
-         /* ~v2 */  pfx |= (vex1 & (1<<5)) ? 0 : PFX_VEXnV2;
-         /* ~v1 */  pfx |= (vex1 & (1<<4)) ? 0 : PFX_VEXnV1;
-         /* ~v0 */  pfx |= (vex1 & (1<<3)) ? 0 : PFX_VEXnV0;
-         /* L */    pfx |= (vex1 & (1<<2)) ? PFX_VEXL : 0;
-         /* pp */
-         switch (vex1 & 3) {
-            case 0: break;
-            case 1: pfx |= PFX_66; break;
-            case 2: pfx |= PFX_F3; break;
-            case 3: pfx |= PFX_F2; break;
-            default: vassert(0);
-         }
-         /* implied: */
-         esc = ESC_0F;
-      }
-      /* Can't have both VEX and REX */
-      if ((pfx & PFX_VEX) && (pfx & PFX_REX))
-         goto decode_failure; /* can't have both */
-   }
-
-   /* Dump invalid combinations */
-   n = 0;
-   if (pfx & PFX_F2) n++;
-   if (pfx & PFX_F3) n++;
-   if (n > 1) 
-      goto decode_failure; /* can't have both */
-
-   n = 0;
-   if (pfx & PFX_CS) n++;
-   if (pfx & PFX_DS) n++;
-   if (pfx & PFX_ES) n++;
-   if (pfx & PFX_FS) n++;
-   if (pfx & PFX_GS) n++;
-   if (pfx & PFX_SS) n++;
-   if (n > 1) 
-      goto decode_failure; /* multiple seg overrides == illegal */
-
-   /* We have a %fs prefix.  Reject it if there's no evidence in 'vbi'
-      that we should accept it. */
-   if ((pfx & PFX_FS) && !vbi->guest_amd64_assume_fs_is_const)
-      goto decode_failure;
-
-   /* Ditto for %gs prefixes. */
-   if ((pfx & PFX_GS) && !vbi->guest_amd64_assume_gs_is_const)
+   if (!eat_prefixes(&pfx, &esc, &delta, guest_code, archinfo,
+                     vbi->guest_amd64_assume_fs_is_const,
+                     vbi->guest_amd64_assume_gs_is_const, True))
       goto decode_failure;
+   if (pfx & PFX_LOCK)
+      *expect_CAS = True;
 
    /* Set up sz. */
    sz = 4;
@@ -32429,6 +32697,16 @@ DisResult disInstr_AMD64 ( IRSB*        irsb_IN,
    guest_RIP_next_assumed   = 0;
    guest_RIP_next_mustcheck = False;
 
+#  if CHECK_SSE_DECODERS
+   {
+      static VEX_TLS Bool checked = False;
+      if (!checked) {
+         checked = True;
+         check_sse_decoder_tables(archinfo, abiinfo);
+      }
+   }
+#  endif
+
    x1 = irsb_IN->stmts_used;
    expect_CAS = False;
    dres = disInstr_AMD64_WRK ( &expect_CAS, resteerOkFn,
@@ -32482,6 +32760,334 @@ DisResult disInstr_AMD64 ( IRSB*        irsb_IN,
 }
 
 
+/*------------------------------------------------------------*/
+/*--- Decoding without IR                                  ---*/
+/*------------------------------------------------------------*/
+
+/* What follows the opcode byte, for decode_insn_x86_family. */
+#define OP_M   0x01  /* modrm, and any SIB and displacement */
+#define OP_I8  0x02  /* 8-bit immediate */
+#define OP_I16 0x04  /* 16-bit immediate */
+#define OP_IZ  0x08  /* 16- or 32-bit immediate, by operand size */
+#define OP_IV  0x10  /* 16-, 32- or 64-bit immediate, by operand size */
+#define OP_I32 0x20  /* 32-bit immediate or displacement, regardless */
+#define OP_MOF 0x40  /* 32- or 64-bit address, by address size */
+#define OP_BAD 0x80  /* invalid */
+
+#define M_    OP_M
+#define MI8   (OP_M|OP_I8)
+#define MIZ   (OP_M|OP_IZ)
+#define I8    OP_I8
+#define IZ    OP_IZ
+#define X_    OP_BAD
+
+/* One-byte opcodes in 64-bit code.  Prefixes and the 0F escape never
+   get here. */
+static const UChar amd64_operands_1[256] = {
+   /*       0    1    2    3    4    5    6    7
+            8    9    A    B    C    D    E    F */
+   /* 00 */ M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+            M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+   /* 10 */ M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+            M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+   /* 20 */ M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+            M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+   /* 30 */ M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+            M_,  M_,  M_,  M_,  I8,  IZ,  X_,  X_,
+   /* 40 */ 0,   0,   0,   0,   0,   0,   0,   0,
+            0,   0,   0,   0,   0,   0,   0,   0,
+   /* 50 */ 0,   0,   0,   0,   0,   0,   0,   0,
+            0,   0,   0,   0,   0,   0,   0,   0,
+   /* 60 */ X_,  X_,  X_,  M_,  0,   0,   0,   0,
+            IZ,  MIZ, I8,  MI8, 0,   0,   0,   0,
+   /* 70 */ I8,  I8,  I8,  I8,  I8,  I8,  I8,  I8,
+            I8,  I8,  I8,  I8,  I8,  I8,  I8,  I8,
+   /* 80 */ MI8, MIZ, X_,  MI8, M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* 90 */ 0,   0,   0,   0,   0,   0,   0,   0,
+            0,   0,   X_,  0,   0,   0,   0,   0,
+   /* A0 */ OP_MOF, OP_MOF, OP_MOF, OP_MOF, 0, 0, 0, 0,
+            I8,  IZ,  0,   0,   0,   0,   0,   0,
+   /* B0 */ I8,  I8,  I8,  I8,  I8,  I8,  I8,  I8,
+            OP_IV, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV,
+   /* C0 */ MI8, MI8, OP_I16, 0, X_, X_,  MI8, MIZ,
+            OP_I16|I8, 0, OP_I16, 0, 0, I8, X_,  0,
+   /* D0 */ M_,  M_,  M_,  M_,  X_,  X_,  X_,  0,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* E0 */ I8,  I8,  I8,  I8,  I8,  I8,  I8,  I8,
+            OP_I32, OP_I32, X_, I8, 0, 0, 0,   0,
+   /* F0 */ 0,   0,   0,   0,   0,   0,   M_,  M_,
+            0,   0,   0,   0,   0,   0,   M_,  M_
+};
+
+/* 0F xx.  0F 38 and 0F 3A never get here. */
+static const UChar amd64_operands_0F[256] = {
+   /*       0    1    2    3    4    5    6    7
+            8    9    A    B    C    D    E    F */
+   /* 00 */ M_,  M_,  M_,  M_,  X_,  0,   0,   0,
+            0,   0,   X_,  0,   X_,  M_,  0,   MI8,
+   /* 10 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* 20 */ M_,  M_,  M_,  M_,  X_,  X_,  X_,  X_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* 30 */ 0,   0,   0,   0,   0,   0,   X_,  0,
+            X_,  X_,  X_,  X_,  X_,  X_,  X_,  X_,
+   /* 40 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* 50 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* 60 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* 70 */ MI8, MI8, MI8, MI8, M_,  M_,  M_,  0,
+            M_,  M_,  X_,  X_,  M_,  M_,  M_,  M_,
+   /* 80 */ OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32,
+            OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32,
+   /* 90 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* A0 */ 0,   0,   0,   M_,  MI8, M_,  X_,  X_,
+            0,   0,   0,   M_,  MI8, M_,  M_,  M_,
+   /* B0 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  MI8, M_,  M_,  M_,  M_,  M_,
+   /* C0 */ M_,  M_,  MI8, M_,  MI8, MI8, MI8, M_,
+            0,   0,   0,   0,   0,   0,   0,   0,
+   /* D0 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* E0 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+   /* F0 */ M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_,
+            M_,  M_,  M_,  M_,  M_,  M_,  M_,  M_
+};
+
+#undef M_
+#undef MI8
+#undef MIZ
+#undef I8
+#undef IZ
+#undef X_
+
+/* One-byte opcodes in 32-bit code: as in 64-bit code, except for
+   those that 64-bit mode took away or gave to REX and VEX.  The 0F
+   table is the same for both. */
+static UChar x86_operands_1 ( UChar opc )
+{
+   switch (opc) {
+      case 0x06: case 0x07: case 0x0E: case 0x16:   /* push/pop sreg */
+      case 0x17: case 0x1E: case 0x1F:
+      case 0x27: case 0x2F: case 0x37: case 0x3F:   /* daa das aaa aas */
+      case 0x60: case 0x61:                         /* pusha popa */
+      case 0xCE:                                    /* into */
+      case 0xD6:                                    /* salc */
+         return 0;
+      case 0x62:                                    /* bound */
+      case 0xC4: case 0xC5:                         /* les lds */
+         return OP_M;
+      case 0x82:                                    /* as 80 */
+         return OP_M | OP_I8;
+      case 0xD4: case 0xD5:                         /* aam aad */
+         return OP_I8;
+      case 0x9A: case 0xEA:                         /* far call/jmp */
+         return OP_IZ | OP_I16;
+      default:
+         return amd64_operands_1[opc];
+   }
+}
+
+/* Decode the insn at code[0 .. n_bytes-1] without generating IR, as
+   64-bit code if mode64 and as 32-bit (x86) code otherwise.  Shares
+   eat_prefixes with disInstr_AMD64_WRK, but otherwise knows only how
+   long each opcode's operands are and which opcodes transfer control,
+   so it accepts some insns that disInstr_AMD64 and disInstr_X86 would
+   not. */
+
+static Bool decode_insn_x86_family ( const UChar* code, UInt n_bytes,
+                                     Addr addr,
+                                     const VexArchInfo* archinfo,
+                                     Bool mode64,
+                                     /*OUT*/VexDecodedInsn* insn )
+{
+   /* The longest insn is 15 bytes.  Don't let eat_prefixes and the
+      modrm parsing below run off the end of a short buffer. */
+   UChar  buf[32];
+   Prefix pfx;
+   Escape esc;
+   Long   delta = 0;
+   UChar  opc, ops, modrm;
+   UInt   len, i;
+   Long   disp = 0;
+   Addr   target;
+
+   insn->kind         = VexInsnInvalid;
+   insn->len          = 0;
+   insn->target       = 0;
+   insn->fall_through = addr;
+
+   if (n_bytes < sizeof(buf)) {
+      for (i = 0; i < sizeof(buf); i++)
+         buf[i] = i < n_bytes ? code[i] : 0;
+      code = buf;
+   }
+
+   /* Decoding doesn't depend on whether %fs and %gs are constant. */
+   if (!eat_prefixes(&pfx, &esc, &delta, code, archinfo, True, True,
+                     mode64))
+      return False;
+
+   if (!(pfx & PFX_VEX) && code[delta] == 0x0F) {
+      delta++;
+      switch (code[delta]) {
+         case 0x38: esc = ESC_0F38; delta++; break;
+         case 0x3A: esc = ESC_0F3A; delta++; break;
+         default:   esc = ESC_0F; break;
+      }
+   }
+
+   opc = code[delta++];
+   switch (esc) {
+      case ESC_NONE: ops = mode64 ? amd64_operands_1[opc]
+                                  : x86_operands_1(opc); break;
+      case ESC_0F:   ops = amd64_operands_0F[opc]; break;
+      case ESC_0F38: ops = OP_M;                   break;
+      case ESC_0F3A: ops = OP_M | OP_I8;           break;
+      default:       vassert(0);
+   }
+   if (ops & OP_BAD)
+      return False;
+
+   modrm = 0;
+   if (ops & OP_M) {
+      UChar mod = modrm = code[delta++];
+      UChar rm  = modrm & 7;
+      mod >>= 6;
+      if (mod != 3 && !mode64 && haveASO(pfx)) {
+         /* 16-bit addressing: no SIB, and 16-bit displacements */
+         if (mod == 0 && rm == 6) delta += 2;
+         if (mod == 1) delta += 1;
+         if (mod == 2) delta += 2;
+      } else if (mod != 3) {
+         if (rm == 4) {
+            UChar sib = code[delta++];
+            if (mod == 0 && (sib & 7) == 5)
+               delta += 4;
+         } else if (mod == 0 && rm == 5) {
+            delta += 4;
+         }
+         if (mod == 1) delta += 1;
+         if (mod == 2) delta += 4;
+      }
+      /* test Ib/Iz hides in groups 3. */
+      if (esc == ESC_NONE && (opc == 0xF6 || opc == 0xF7)
+          && gregLO3ofRM(modrm) < 2)
+         ops |= opc == 0xF6 ? OP_I8 : OP_IZ;
+   }
+
+   if (ops & OP_I8) {
+      disp = (Char)code[delta];
+      delta += 1;
+   }
+   if (ops & OP_I16)
+      delta += 2;
+   if (ops & OP_IZ)
+      delta += have66(pfx) ? 2 : 4;
+   if (ops & OP_IV)
+      delta += getRexW(pfx) ? 8 : have66(pfx) ? 2 : 4;
+   if ((ops & OP_I32) && !mode64 && have66(pfx)) {
+      /* rel16 */
+      disp = (Short)(code[delta] | (code[delta+1] << 8));
+      delta += 2;
+   } else if (ops & OP_I32) {
+      disp = (Int)(code[delta] | (code[delta+1] << 8)
+                   | (code[delta+2] << 16) | ((UInt)code[delta+3] << 24));
+      delta += 4;
+   }
+   if (ops & OP_MOF)
+      delta += mode64 ? (haveASO(pfx) ? 4 : 8) : (haveASO(pfx) ? 2 : 4);
+
+   len = (UInt)delta;
+   if (len > 15 || len > n_bytes)
+      return False;
+
+   /* For the direct branches.  In 32-bit code, a 66 prefix makes
+      these truncate EIP to 16 bits. */
+   target = addr + len + disp;
+   if (!mode64)
+      target &= have66(pfx) ? 0xFFFF : 0xFFFFFFFF;
+
+   insn->len          = len;
+   insn->fall_through = addr + len;
+   insn->kind         = VexInsnNormal;
+
+   if (esc == ESC_NONE) {
+      if ((opc >= 0x70 && opc <= 0x7F) || (opc >= 0xE0 && opc <= 0xE3)) {
+         insn->kind   = VexInsnCondJump;
+         insn->target = target;
+      }
+      else if (opc == 0xEB || opc == 0xE9) {
+         insn->kind   = VexInsnJump;
+         insn->target = target;
+      }
+      else if (opc == 0xE8) {
+         insn->kind   = VexInsnCall;
+         insn->target = target;
+      }
+      else if (opc == 0xC2 || opc == 0xC3 || opc == 0xCA || opc == 0xCB
+               || opc == 0xCF) {
+         insn->kind = VexInsnRet;
+      }
+      else if (opc == 0xCC || opc == 0xCD || opc == 0xF1 || opc == 0xF4
+               || opc == 0xCE) {
+         insn->kind = VexInsnSys;
+      }
+      else if (opc == 0x9A) {
+         insn->kind = VexInsnIndCall;  /* far, so not a target we know */
+      }
+      else if (opc == 0xEA) {
+         insn->kind = VexInsnIndJump;
+      }
+      else if (opc == 0xFF) {
+         switch (gregLO3ofRM(modrm)) {
+            case 2: case 3: insn->kind = VexInsnIndCall; break;
+            case 4: case 5: insn->kind = VexInsnIndJump; break;
+            default: break;
+         }
+      }
+   }
+   else if (esc == ESC_0F && !(pfx & PFX_VEX)) {
+      if (opc >= 0x80 && opc <= 0x8F) {
+         insn->kind   = VexInsnCondJump;
+         insn->target = target;
+      }
+      else if (opc == 0x05 || opc == 0x07 || opc == 0x0B
+               || opc == 0x34 || opc == 0x35) {
+         insn->kind = VexInsnSys;
+      }
+   }
+   return True;
+}
+
+Bool decodeInsn_AMD64 ( const UChar* code, UInt n_bytes, Addr addr,
+                        const VexArchInfo* archinfo,
+                        /*OUT*/VexDecodedInsn* insn )
+{
+   return decode_insn_x86_family(code, n_bytes, addr, archinfo, True, insn);
+}
+
+Bool decodeInsn_X86 ( const UChar* code, UInt n_bytes, Addr addr,
+                      const VexArchInfo* archinfo,
+                      /*OUT*/VexDecodedInsn* insn )
+{
+   return decode_insn_x86_family(code, n_bytes, addr, archinfo, False, insn);
+}
+
+#undef OP_M
+#undef OP_I8
+#undef OP_I16
+#undef OP_IZ
+#undef OP_IV
+#undef OP_I32
+#undef OP_MOF
+#undef OP_BAD
+
+
 /*------------------------------------------------------------*/
 /*--- Unused stuff                                         ---*/
 /*------------------------------------------------------------*/
@@ -53,9 +53,16 @@ DisResult disInstr_ARM64 ( IRSB*        irbb,
                            VexEndness   host_endness,
                            Bool         sigill_diag );
 
+/* Decode one ARM64 insn without generating IR.  See
+   LibVEX_DecodeInsn. */
+extern
+Bool decodeInsn_ARM64 ( const UChar* code, UInt n_bytes, Addr addr,
+                        const VexArchInfo* archinfo,
+                        /*OUT*/VexDecodedInsn* insn );
+
 /* Used by the optimiser to specialise calls to helpers. */
 extern
-IRExpr* guest_arm64_spechelper ( const HChar* function_name,
+IRExpr* guest_arm64_spechelper ( const IRCallee* cee,
                                  IRExpr** args,
                                  IRStmt** precedingStmts,
                                  Int      n_precedingStmts );
@@ -1294,7 +1294,7 @@ static Bool isU64 ( IRExpr* e, ULong n )
               && e->Iex.Const.con->Ico.U64 == n );
 }
 
-IRExpr* guest_arm64_spechelper ( const HChar* function_name,
+IRExpr* guest_arm64_spechelper ( const IRCallee* cee,
                                  IRExpr** args,
                                  IRStmt** precedingStmts,
                                  Int      n_precedingStmts )
@@ -1309,7 +1309,7 @@ IRExpr* guest_arm64_spechelper ( const HChar* function_name,
       arity++;
 //ZZ #  if 0
 //ZZ    vex_printf("spec request:\n");
-//ZZ    vex_printf("   %s  ", function_name);
+//ZZ    vex_printf("   %s  ", cee->name);
 //ZZ    for (i = 0; i < arity; i++) {
 //ZZ       vex_printf("  ");
 //ZZ       ppIRExpr(args[i]);
@@ -1319,7 +1319,7 @@ IRExpr* guest_arm64_spechelper ( const HChar* function_name,
 
    /* --------- specialising "arm64g_calculate_condition" --------- */
 
-   if (vex_streq(function_name, "arm64g_calculate_condition")) {
+   if (cee->addr == &arm64g_calculate_condition) {
 
       /* specialise calls to the "arm64g_calculate_condition" function.
          Not sure whether this is strictly necessary, but: the
@@ -1591,7 +1591,7 @@ IRExpr* guest_arm64_spechelper ( const HChar* function_name,
 //ZZ    /* --------- specialising "armg_calculate_flag_c" --------- */
 //ZZ 
 //ZZ    else
-//ZZ    if (vex_streq(function_name, "armg_calculate_flag_c")) {
+//ZZ    if (cee->addr == &armg_calculate_flag_c) {
 //ZZ 
 //ZZ       /* specialise calls to the "armg_calculate_flag_c" function.
 //ZZ          Note that the returned value must be either 0 or 1; nonzero
@@ -1641,7 +1641,7 @@ IRExpr* guest_arm64_spechelper ( const HChar* function_name,
 //ZZ    /* --------- specialising "armg_calculate_flag_v" --------- */
 //ZZ 
 //ZZ    else
-//ZZ    if (vex_streq(function_name, "armg_calculate_flag_v")) {
+//ZZ    if (cee->addr == &armg_calculate_flag_v) {
 //ZZ 
 //ZZ       /* specialise calls to the "armg_calculate_flag_v" function.
 //ZZ          Note that the returned value must be either 0 or 1; nonzero
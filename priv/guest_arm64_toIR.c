@@ -103,14 +103,14 @@
 /* CONST: what is the host's endianness?  We need to know this in
    order to do sub-register accesses to the SIMD/FP registers
    correctly. */
-static VexEndness host_endness;
+static VEX_TLS VexEndness host_endness;
 
 /* CONST: The guest address for the instruction currently being
    translated.  */
-static Addr64 guest_PC_curr_instr;
+static VEX_TLS Addr64 guest_PC_curr_instr;
 
 /* MOD: The IRSB* into which we're generating code. */
-static IRSB* irsb;
+static VEX_TLS IRSB* irsb;
 
 
 /*------------------------------------------------------------*/
@@ -14549,6 +14549,73 @@ DisResult disInstr_ARM64 ( IRSB*        irsb_IN,
 }
 
 
+/*------------------------------------------------------------*/
+/*--- Decoding without IR                                  ---*/
+/*------------------------------------------------------------*/
+
+/* Every insn is 4 bytes, so all decodeInsn_ARM64 has to do is spot
+   the branches that dis_ARM64_branch_etc handles. */
+
+Bool decodeInsn_ARM64 ( const UChar* code, UInt n_bytes, Addr addr,
+                        const VexArchInfo* archinfo,
+                        /*OUT*/VexDecodedInsn* insn_out )
+{
+#  define INSN(_bMax,_bMin)  SLICE_UInt(insn, (_bMax), (_bMin))
+   UInt insn;
+
+   insn_out->kind         = VexInsnInvalid;
+   insn_out->len          = 0;
+   insn_out->target       = 0;
+   insn_out->fall_through = addr;
+   if (n_bytes < 4)
+      return False;
+
+   insn = getUIntLittleEndianly(code);
+   insn_out->kind         = VexInsnNormal;
+   insn_out->len          = 4;
+   insn_out->fall_through = addr + 4;
+
+   if (INSN(31,24) == BITS8(0,1,0,1,0,1,0,0) && INSN(4,4) == 0) {
+      /* B.cond */
+      insn_out->kind   = VexInsnCondJump;
+      insn_out->target = addr + sx_to_64(INSN(23,5) << 2, 21);
+   }
+   else if (INSN(30,26) == BITS5(0,0,1,0,1)) {
+      /* B, BL */
+      insn_out->kind   = INSN(31,31) ? VexInsnCall : VexInsnJump;
+      insn_out->target = addr + sx_to_64(INSN(25,0) << 2, 28);
+   }
+   else if (INSN(31,23) == BITS9(1,1,0,1,0,1,1,0,0)
+            && INSN(20,16) == BITS5(1,1,1,1,1)
+            && INSN(15,10) == BITS6(0,0,0,0,0,0)
+            && INSN(4,0) == BITS5(0,0,0,0,0)) {
+      /* BR, BLR, RET */
+      switch (INSN(22,21)) {
+         case BITS2(0,0): insn_out->kind = VexInsnIndJump; break;
+         case BITS2(0,1): insn_out->kind = VexInsnIndCall; break;
+         case BITS2(1,0): insn_out->kind = VexInsnRet;     break;
+         default:         break;
+      }
+   }
+   else if (INSN(30,25) == BITS6(0,1,1,0,1,0)) {
+      /* CBZ, CBNZ */
+      insn_out->kind   = VexInsnCondJump;
+      insn_out->target = addr + sx_to_64(INSN(23,5) << 2, 21);
+   }
+   else if (INSN(30,25) == BITS6(0,1,1,0,1,1)) {
+      /* TBZ, TBNZ */
+      insn_out->kind   = VexInsnCondJump;
+      insn_out->target = addr + sx_to_64(INSN(18,5) << 2, 16);
+   }
+   else if (INSN(31,24) == BITS8(1,1,0,1,0,1,0,0)) {
+      /* SVC, HVC, SMC, BRK, HLT, DCPS */
+      insn_out->kind = VexInsnSys;
+   }
+   return True;
+#  undef INSN
+}
+
+
 /*--------------------------------------------------------------------*/
 /*--- end                                       guest_arm64_toIR.c ---*/
 /*--------------------------------------------------------------------*/
@@ -57,7 +57,7 @@ DisResult disInstr_ARM ( IRSB*        irbb,
 
 /* Used by the optimiser to specialise calls to helpers. */
 extern
-IRExpr* guest_arm_spechelper ( const HChar* function_name,
+IRExpr* guest_arm_spechelper ( const IRCallee* cee,
                                IRExpr** args,
                                IRStmt** precedingStmts,
                                Int      n_precedingStmts );
@@ -810,7 +810,7 @@ static Bool isU32 ( IRExpr* e, UInt n )
               && e->Iex.Const.con->Ico.U32 == n );
 }
 
-IRExpr* guest_arm_spechelper ( const HChar* function_name,
+IRExpr* guest_arm_spechelper ( const IRCallee* cee,
                                IRExpr** args,
                                IRStmt** precedingStmts,
                                Int      n_precedingStmts )
@@ -825,7 +825,7 @@ IRExpr* guest_arm_spechelper ( const HChar* function_name,
       arity++;
 #  if 0
    vex_printf("spec request:\n");
-   vex_printf("   %s  ", function_name);
+   vex_printf("   %s  ", cee->name);
    for (i = 0; i < arity; i++) {
       vex_printf("  ");
       ppIRExpr(args[i]);
@@ -835,7 +835,7 @@ IRExpr* guest_arm_spechelper ( const HChar* function_name,
 
    /* --------- specialising "armg_calculate_condition" --------- */
 
-   if (vex_streq(function_name, "armg_calculate_condition")) {
+   if (cee->addr == &armg_calculate_condition) {
 
       /* specialise calls to the "armg_calculate_condition" function.
          Not sure whether this is strictly necessary, but: the
@@ -1070,7 +1070,7 @@ IRExpr* guest_arm_spechelper ( const HChar* function_name,
    /* --------- specialising "armg_calculate_flag_c" --------- */
 
    else
-   if (vex_streq(function_name, "armg_calculate_flag_c")) {
+   if (cee->addr == &armg_calculate_flag_c) {
 
       /* specialise calls to the "armg_calculate_flag_c" function.
          Note that the returned value must be either 0 or 1; nonzero
@@ -1120,7 +1120,7 @@ IRExpr* guest_arm_spechelper ( const HChar* function_name,
    /* --------- specialising "armg_calculate_flag_v" --------- */
 
    else
-   if (vex_streq(function_name, "armg_calculate_flag_v")) {
+   if (cee->addr == &armg_calculate_flag_v) {
 
       /* specialise calls to the "armg_calculate_flag_v" function.
          Note that the returned value must be either 0 or 1; nonzero
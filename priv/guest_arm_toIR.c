@@ -126,20 +126,20 @@
 /* CONST: what is the guest's endianness?  This has to do with float vs
    double register accesses on VFP, but it's complex and not properly
    thought out. */
-static VexEndness guest_endness;
+static VEX_TLS VexEndness guest_endness;
 #define guest_memory_endness (guest_endness == VexEndnessBE ? Iend_BE : Iend_LE)
 
 /* CONST: The guest address for the instruction currently being
    translated.  This is the real, "decoded" address (not subject
    to the CPSR.T kludge). */
-static Addr32 guest_R15_curr_instr_notENC;
+static VEX_TLS Addr32 guest_R15_curr_instr_notENC;
 
 /* CONST, FOR ASSERTIONS ONLY.  Indicates whether currently processed
    insn is Thumb (True) or ARM (False). */
-static Bool __curr_is_Thumb;
+static VEX_TLS Bool __curr_is_Thumb;
 
 /* MOD: The IRSB* into which we're generating code. */
-static IRSB* irsb;
+static VEX_TLS IRSB* irsb;
 
 /* These are to do with handling writes to r15.  They are initially
    set at the start of disInstr_ARM_WRK to indicate no update,
@@ -152,17 +152,17 @@ static IRSB* irsb;
 
 /* MOD.  Initially False; set to True iff abovementioned handling is
    required. */
-static Bool r15written;
+static VEX_TLS Bool r15written;
 
 /* MOD.  Initially IRTemp_INVALID.  If the r15 branch to be generated
    is conditional, this holds the gating IRTemp :: Ity_I32.  If the
    branch to be generated is unconditional, this remains
    IRTemp_INVALID. */
-static IRTemp r15guard; /* :: Ity_I32, 0 or 1 */
+static VEX_TLS IRTemp r15guard; /* :: Ity_I32, 0 or 1 */
 
 /* MOD.  Initially Ijk_Boring.  If an r15 branch is to be generated,
    this holds the jump kind. */
-static IRTemp r15kind;
+static VEX_TLS IRTemp r15kind;
 
 
 /*------------------------------------------------------------*/
@@ -96,11 +96,65 @@ static ULong genericg_compute_checksum_8al_11 ( HWord first_w64 );
 VEX_REGPARM(1)
 static ULong genericg_compute_checksum_8al_12 ( HWord first_w64 );
 
+/* Vector versions of the generic checksum helpers, on x86. */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#  define VEX_CHECKSUM_SIMD 1
+#else
+#  define VEX_CHECKSUM_SIMD 0
+#endif
+
+#if VEX_CHECKSUM_SIMD
+__attribute__((target("sse2")))
+VEX_REGPARM(2)
+static UInt genericg_compute_checksum_4al_sse2 ( HWord first_w32,
+                                                 HWord n_w32s );
+__attribute__((target("avx2")))
+VEX_REGPARM(2)
+static ULong genericg_compute_checksum_8al_avx2 ( HWord first_w64,
+                                                  HWord n_w64s );
+#endif
+
 /* Small helpers */
 static Bool const_False ( void* callback_opaque, Addr a ) { 
    return False; 
 }
 
+/* The generic checksum helper bb_to_IR should use for a host, and its
+   name.  The vector versions are only picked for the host VEX itself
+   was built for, since bb_to_IR also calls the helper, to compute the
+   expected checksum. */
+typedef HWord VEX_REGPARM(2) (*ChecksumFn)(HWord, HWord);
+
+static ChecksumFn pick_checksum_generic ( VexArch arch_host,
+                                          UInt hwcaps_host,
+                                          /*OUT*/const HChar** nm )
+{
+   UInt host_word_szB = sizeof(HWord);
+#  if VEX_CHECKSUM_SIMD
+#  if defined(__x86_64__)
+   const VexArch arch_self = VexArchAMD64;
+#  else
+   const VexArch arch_self = VexArchX86;
+#  endif
+   if (arch_host == arch_self) {
+      if (host_word_szB == 8 && (hwcaps_host & VEX_HWCAPS_AMD64_AVX2)) {
+         *nm = "genericg_compute_checksum_8al_avx2";
+         return (ChecksumFn)genericg_compute_checksum_8al_avx2;
+      }
+      if (host_word_szB == 4 && (hwcaps_host & VEX_HWCAPS_X86_SSE2)) {
+         *nm = "genericg_compute_checksum_4al_sse2";
+         return (ChecksumFn)genericg_compute_checksum_4al_sse2;
+      }
+   }
+#  endif
+   if (host_word_szB == 8) {
+      *nm = "genericg_compute_checksum_8al";
+      return (ChecksumFn)genericg_compute_checksum_8al;
+   }
+   *nm = "genericg_compute_checksum_4al";
+   return (ChecksumFn)genericg_compute_checksum_4al;
+}
+
 /* Disassemble a complete basic block, starting at guest_IP_start, 
    returning a new IRSB.  The disassembler may chase across basic
    block boundaries if it wishes and if chase_into_ok allows it.
@@ -131,6 +185,9 @@ static Bool const_False ( void* callback_opaque, Addr a ) {
    not to disassemble any instructions into it; this is indicated
    by the callback returning True.
 
+   arch_host and hwcaps_host say which version of the self-check
+   checksum helper the host can use.
+
    offB_CMADDR and offB_CMLEN are the offsets of guest_CMADDR and
    guest_CMLEN.  Since this routine has to work for any guest state,
    without knowing what it is, those offsets have to passed in.
@@ -188,6 +245,8 @@ IRSB* bb_to_IR (
          /*IN*/ Addr             guest_IP_bbstart,
          /*IN*/ Bool             (*chase_into_ok)(void*,Addr),
          /*IN*/ VexEndness       host_endness,
+         /*IN*/ VexArch          arch_host,
+         /*IN*/ UInt             hwcaps_host,
          /*IN*/ Bool             sigill_diag,
          /*IN*/ VexArch          arch_guest,
          /*IN*/ const VexArchInfo* archinfo_guest,
@@ -209,7 +268,7 @@ IRSB* bb_to_IR (
    DisResult  dres;
    IRStmt*    imark;
    IRStmt*    nop;
-   static Int n_resteers = 0;
+   static VEX_TLS Int n_resteers = 0;
    Int        d_resteers = 0;
    Int        selfcheck_idx = 0;
    IRSB*      irsb;
@@ -528,7 +587,8 @@ IRSB* bb_to_IR (
       * there's a generic routine and 12 specialised cases, which
         handle the cases of 1 through 12-word lengths respectively.
         They seem to cover about 90% of the cases that occur in
-        practice.
+        practice.  Given SSE2 on x86 or AVX2 on amd64, the generic
+        routine is a vector version; see pick_checksum_generic.
 
       We ask the caller, via needs_self_check, which of the 3 vge
       extents needs a check, and only generate check code for those
@@ -539,7 +599,7 @@ IRSB* bb_to_IR (
       UInt     len2check;
       HWord    expectedhW;
       IRTemp   tistart_tmp, tilen_tmp;
-      HWord    VEX_REGPARM(2) (*fn_generic)(HWord, HWord);
+      ChecksumFn fn_generic;
       HWord    VEX_REGPARM(1) (*fn_spec)(HWord);
       const HChar* nm_generic;
       const HChar* nm_spec;
@@ -594,15 +654,8 @@ IRSB* bb_to_IR (
 
          /* vex_printf("%lx %lx  %ld\n", first_hW, last_hW, hWs_to_check); */
 
-         if (host_word_szB == 8) {
-            fn_generic =  (VEX_REGPARM(2) HWord(*)(HWord, HWord))
-                          genericg_compute_checksum_8al;
-            nm_generic = "genericg_compute_checksum_8al";
-         } else {
-            fn_generic =  (VEX_REGPARM(2) HWord(*)(HWord, HWord))
-                          genericg_compute_checksum_4al;
-            nm_generic = "genericg_compute_checksum_4al";
-         }
+         fn_generic = pick_checksum_generic(arch_host, hwcaps_host,
+                                            &nm_generic);
 
          fn_spec = NULL;
          nm_spec = NULL;
@@ -798,6 +851,120 @@ IRSB* bb_to_IR (
    arecalled once for every use of a self-checking translation, so
    they needs to be as fast as possible. */
 
+/* The checksum is defined word-at-a-time: for each word w,
+   sum1 = ROL(sum1 ^ w, 31 or 63) and sum2 += w, with sum1 ^= sum2
+   after every complete group of four words and after every word of
+   the tail.  Done literally, that is a chain of 4 dependent xor/rotate
+   pairs per group.  Since rotation distributes over xor, a group can
+   instead be folded in as
+
+      sum2 += (w0 + w1) + (w2 + w3)
+      sum1  = ROL(sum1,4r) ^ ROL(w0,4r) ^ ROL(w1,3r) ^ ROL(w2,2r)
+              ^ ROL(w3,r) ^ sum2
+
+   with r the per-word rotation (taken mod the word size), which
+   gives exactly the same value while letting the four words be
+   rotated in parallel.  That roughly halves the cost of the longer
+   checks.  Checksums already baked into existing translations stay
+   valid, since the value computed does not change. */
+
+/* On x86 hosts there are also vector versions of the generic
+   helpers, which bb_to_IR picks from the host's hwcaps.  Unrolling
+   the above over the first n words (n a multiple of 4), word i ends
+   up contributing ROR(w_i, n-i) to sum1, and the value of sum2 after
+   group g contributes ROR(sum2_g, n-4g).  So with words 4k .. 4k+3
+   in the lanes of vector k:
+
+   - lane l of an accumulator a picks up words l, l+4, l+8, .. as
+     a = ROR(a,4) ^ v for each vector in turn (done four vectors at a
+     time), and at the end is rotated right by a further 4-l;
+
+   - sixteen words at a time, the four group sums are added up across
+     the lanes, and the running sums folded into a second accumulator
+     b = ROR(b,16) ^ s, whose lane l is rotated right by 12-4l at the
+     end.
+
+   The result is exactly what the scalar loop computes, and whatever
+   words are left over are done by that.  The code uses GCC's generic
+   vector extensions rather than intrinsics.  There is an SSE2 version
+   for 32-bit words and an AVX2 one for 64-bit words.  64-bit words in
+   128-bit vectors turned out slower than the scalar loop, so amd64
+   hosts without AVX2 keep that. */
+
+#if VEX_CHECKSUM_SIMD
+
+typedef UInt   V4xU32 __attribute__((vector_size(16), aligned(4),
+                                     may_alias));
+typedef ULong  V4xU64 __attribute__((vector_size(32), aligned(8),
+                                     may_alias));
+typedef UShort V8xU16 __attribute__((vector_size(16)));
+typedef UChar  V32xU8 __attribute__((vector_size(32)));
+
+#define VROR(_v, _n, _bits) (((_v) >> (_n)) | ((_v) << ((_bits) - (_n))))
+
+/* Rotations by whole bytes are cheaper done as shuffles: for 32-bit
+   lanes, swap the halves; for 64-bit lanes, shuffle the bytes within
+   each lane. */
+#define VROR8_4xU32(_v)  VROR(_v, 8, 32)
+#define VROR16_4xU32(_v) \
+   ((V4xU32)__builtin_shuffle((V8xU16)(_v), \
+                              (V8xU16){1,0,3,2,5,4,7,6}))
+#define VROR8_4xU64(_v) \
+   ((V4xU64)__builtin_shuffle((V32xU8)(_v), \
+       (V32xU8){ 1, 2, 3, 4, 5, 6, 7, 0,  9,10,11,12,13,14,15, 8, \
+                17,18,19,20,21,22,23,16, 25,26,27,28,29,30,31,24}))
+#define VROR16_4xU64(_v) \
+   ((V4xU64)__builtin_shuffle((V32xU8)(_v), \
+       (V32xU8){ 2, 3, 4, 5, 6, 7, 0, 1, 10,11,12,13,14,15, 8, 9, \
+                18,19,20,21,22,23,16,17, 26,27,28,29,30,31,24,25}))
+
+/* Lane-wise sums of two shuffles of _a and _b. */
+#define VADDSHUF(_a, _b, _m1, _m2) (__builtin_shuffle((_a), (_b), (_m1)) \
+                                    + __builtin_shuffle((_a), (_b), (_m2)))
+
+/* Fold as many blocks of 16 _bits-bit words as there are at p into
+   sum1 and sum2, which must both be zero, advancing p and
+   decrementing _n past them.  _ROR8 and _ROR16 rotate each lane of a
+   vector right by 8 and 16 bits.  Under 32 words the scalar loop is as
+   fast, so leave it all to that.  The running sum is kept in all lanes of
+   c, so that neither it nor a and b have to wait on anything but
+   their own previous values. */
+#define CHECKSUM_VEC_BLOCKS(_V, _ROL, _ROR8, _ROR16, _bits, _n)         \
+   do {                                                                 \
+      const _V lo   = {0,1,4,5}, hi  = {2,3,6,7};                       \
+      const _V ilo  = {0,4,2,6}, ihi = {1,5,3,7};                       \
+      const _V up1  = {4,0,1,2}, up2 = {4,5,0,1}, last = {3,3,3,3};     \
+      const _V zero = {0,0,0,0};                                        \
+      _V a = zero, b = zero, c = zero;                                  \
+      if ((_n) < 32)                                                    \
+         break;                                                         \
+      do {                                                              \
+         _V v0 = ((const _V*)p)[0], v1 = ((const _V*)p)[1];             \
+         _V v2 = ((const _V*)p)[2], v3 = ((const _V*)p)[3];             \
+         _V s, t;                                                       \
+         a = _ROR16(a) ^ VROR(v0, 12, _bits)                            \
+             ^ _ROR8(v1) ^ VROR(v2, 4, _bits) ^ v3;                     \
+         /* the group sums, then the running sums */                    \
+         s = VADDSHUF(VADDSHUF(v0, v2, lo, hi),                         \
+                      VADDSHUF(v1, v3, lo, hi), ilo, ihi);              \
+         s += __builtin_shuffle(s, zero, up1);                          \
+         s += __builtin_shuffle(s, zero, up2);                          \
+         t = __builtin_shuffle(s, last);                                \
+         s += c;                                                        \
+         c += t;                                                        \
+         b = _ROR16(b) ^ s;                                             \
+         p += 16;                                                       \
+         (_n) -= 16;                                                    \
+      } while ((_n) >= 16);                                             \
+      sum1 = _ROL(a[0], (_bits)-4) ^ _ROL(a[1], (_bits)-3)              \
+             ^ _ROL(a[2], (_bits)-2) ^ _ROL(a[3], (_bits)-1)            \
+             ^ _ROL(b[0], (_bits)-12) ^ _ROL(b[1], (_bits)-8)           \
+             ^ _ROL(b[2], (_bits)-4) ^ b[3];                            \
+      sum2 = c[0];                                                      \
+   } while (0)
+
+#endif /* VEX_CHECKSUM_SIMD */
+
 /* --- 32-bit versions, used only on 32-bit hosts --- */
 
 static inline UInt ROL32 ( UInt w, Int n ) {
@@ -805,21 +972,21 @@ static inline UInt ROL32 ( UInt w, Int n ) {
    return w;
 }
 
-VEX_REGPARM(2)
-static UInt genericg_compute_checksum_4al ( HWord first_w32, HWord n_w32s )
+/* Fold the n_w32s words at p into sum1 and sum2, and return the
+   checksum.  sum1 and sum2 are as left by some whole number of groups
+   of four words; the vector versions below finish off here. */
+static inline UInt checksum_4al_from ( UInt sum1, UInt sum2,
+                                       const UInt* p, HWord n_w32s )
 {
-   UInt  sum1 = 0, sum2 = 0;
-   UInt* p = (UInt*)first_w32;
-   /* unrolled */
+   /* unrolled, one group of four words at a time */
    while (n_w32s >= 4) {
-      UInt  w;
-      w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-      w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-      w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-      w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
+      UInt  w0, w1, w2, w3;
+      w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+      sum2 += (w0 + w1) + (w2 + w3);
+      sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+              ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
       p += 4;
       n_w32s -= 4;
-      sum1 ^= sum2;
    }
    while (n_w32s >= 1) {
       UInt  w;
@@ -831,6 +998,26 @@ static UInt genericg_compute_checksum_4al ( HWord first_w32, HWord n_w32s )
    return sum1 + sum2;
 }
 
+VEX_REGPARM(2)
+static UInt genericg_compute_checksum_4al ( HWord first_w32, HWord n_w32s )
+{
+   return checksum_4al_from(0, 0, (const UInt*)first_w32, n_w32s);
+}
+
+#if VEX_CHECKSUM_SIMD
+__attribute__((target("sse2")))
+VEX_REGPARM(2)
+static UInt genericg_compute_checksum_4al_sse2 ( HWord first_w32,
+                                                 HWord n_w32s )
+{
+   UInt  sum1 = 0, sum2 = 0;
+   const UInt* p = (const UInt*)first_w32;
+   CHECKSUM_VEC_BLOCKS(V4xU32, ROL32, VROR8_4xU32, VROR16_4xU32, 32,
+                       n_w32s);
+   return checksum_4al_from(sum1, sum2, p, n_w32s);
+}
+#endif
+
 /* Specialised versions of the above function */
 
 VEX_REGPARM(1)
@@ -877,12 +1064,11 @@ static UInt genericg_compute_checksum_4al_4 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    return sum1 + sum2;
 }
 
@@ -891,12 +1077,11 @@ static UInt genericg_compute_checksum_4al_5 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
    sum1 ^= sum2;
    return sum1 + sum2;
@@ -907,12 +1092,11 @@ static UInt genericg_compute_checksum_4al_6 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
    sum1 ^= sum2;
    w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
@@ -925,12 +1109,11 @@ static UInt genericg_compute_checksum_4al_7 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
    sum1 ^= sum2;
    w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
@@ -945,17 +1128,15 @@ static UInt genericg_compute_checksum_4al_8 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[6];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[7];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    return sum1 + sum2;
 }
 
@@ -964,17 +1145,15 @@ static UInt genericg_compute_checksum_4al_9 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[6];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[7];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    w = p[8];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
    sum1 ^= sum2;
    return sum1 + sum2;
@@ -985,17 +1164,15 @@ static UInt genericg_compute_checksum_4al_10 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[6];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[7];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    w = p[8];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
    sum1 ^= sum2;
    w = p[9];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
@@ -1008,17 +1185,15 @@ static UInt genericg_compute_checksum_4al_11 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[6];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[7];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    w = p[8];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
    sum1 ^= sum2;
    w = p[9];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
@@ -1033,26 +1208,22 @@ static UInt genericg_compute_checksum_4al_12 ( HWord first_w32 )
 {
    UInt  sum1 = 0, sum2 = 0;
    UInt* p = (UInt*)first_w32;
-   UInt  w;
-   w = p[0];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[1];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[2];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[3];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[5];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[6];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[7];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[8];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[9];  sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[10]; sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   w = p[11]; sum1 = ROL32(sum1 ^ w, 31);  sum2 += w;
-   sum1 ^= sum2;
+   UInt  w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
+   w0 = p[8];  w1 = p[9];  w2 = p[10];  w3 = p[11];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL32(sum1, 28) ^ ROL32(w0, 28) ^ ROL32(w1, 29)
+           ^ ROL32(w2, 30) ^ ROL32(w3, 31) ^ sum2;
    return sum1 + sum2;
 }
 
-
 /* --- 64-bit versions, used only on 64-bit hosts --- */
 
 static inline ULong ROL64 ( ULong w, Int n ) {
@@ -1060,21 +1231,20 @@ static inline ULong ROL64 ( ULong w, Int n ) {
    return w;
 }
 
-VEX_REGPARM(2)
-static ULong genericg_compute_checksum_8al ( HWord first_w64, HWord n_w64s )
+/* Fold the n_w64s words at p into sum1 and sum2, and return the
+   checksum.  As checksum_4al_from. */
+static inline ULong checksum_8al_from ( ULong sum1, ULong sum2,
+                                        const ULong* p, HWord n_w64s )
 {
-   ULong  sum1 = 0, sum2 = 0;
-   ULong* p = (ULong*)first_w64;
-   /* unrolled */
+   /* unrolled, one group of four words at a time */
    while (n_w64s >= 4) {
-      ULong  w;
-      w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-      w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-      w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-      w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
+      ULong  w0, w1, w2, w3;
+      w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+      sum2 += (w0 + w1) + (w2 + w3);
+      sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+              ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
       p += 4;
       n_w64s -= 4;
-      sum1 ^= sum2;
    }
    while (n_w64s >= 1) {
       ULong  w;
@@ -1086,6 +1256,26 @@ static ULong genericg_compute_checksum_8al ( HWord first_w64, HWord n_w64s )
    return sum1 + sum2;
 }
 
+VEX_REGPARM(2)
+static ULong genericg_compute_checksum_8al ( HWord first_w64, HWord n_w64s )
+{
+   return checksum_8al_from(0, 0, (const ULong*)first_w64, n_w64s);
+}
+
+#if VEX_CHECKSUM_SIMD
+__attribute__((target("avx2")))
+VEX_REGPARM(2)
+static ULong genericg_compute_checksum_8al_avx2 ( HWord first_w64,
+                                                  HWord n_w64s )
+{
+   ULong  sum1 = 0, sum2 = 0;
+   const ULong* p = (const ULong*)first_w64;
+   CHECKSUM_VEC_BLOCKS(V4xU64, ROL64, VROR8_4xU64, VROR16_4xU64, 64,
+                       n_w64s);
+   return checksum_8al_from(sum1, sum2, p, n_w64s);
+}
+#endif
+
 /* Specialised versions of the above function */
 
 VEX_REGPARM(1)
@@ -1132,12 +1322,11 @@ static ULong genericg_compute_checksum_8al_4 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    return sum1 + sum2;
 }
 
@@ -1146,12 +1335,11 @@ static ULong genericg_compute_checksum_8al_5 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
    sum1 ^= sum2;
    return sum1 + sum2;
@@ -1162,12 +1350,11 @@ static ULong genericg_compute_checksum_8al_6 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
    sum1 ^= sum2;
    w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
@@ -1180,12 +1367,11 @@ static ULong genericg_compute_checksum_8al_7 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
    sum1 ^= sum2;
    w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
@@ -1200,17 +1386,15 @@ static ULong genericg_compute_checksum_8al_8 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[6];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[7];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    return sum1 + sum2;
 }
 
@@ -1219,17 +1403,15 @@ static ULong genericg_compute_checksum_8al_9 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[6];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[7];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    w = p[8];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
    sum1 ^= sum2;
    return sum1 + sum2;
@@ -1240,17 +1422,15 @@ static ULong genericg_compute_checksum_8al_10 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[6];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[7];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    w = p[8];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
    sum1 ^= sum2;
    w = p[9];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
@@ -1263,17 +1443,15 @@ static ULong genericg_compute_checksum_8al_11 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[6];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[7];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w, w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    w = p[8];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
    sum1 ^= sum2;
    w = p[9];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
@@ -1288,25 +1466,43 @@ static ULong genericg_compute_checksum_8al_12 ( HWord first_w64 )
 {
    ULong  sum1 = 0, sum2 = 0;
    ULong* p = (ULong*)first_w64;
-   ULong  w;
-   w = p[0];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[1];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[2];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[3];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[4];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[5];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[6];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[7];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
-   w = p[8];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[9];  sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[10]; sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   w = p[11]; sum1 = ROL64(sum1 ^ w, 63);  sum2 += w;
-   sum1 ^= sum2;
+   ULong  w0, w1, w2, w3;
+   w0 = p[0];  w1 = p[1];  w2 = p[2];  w3 = p[3];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
+   w0 = p[4];  w1 = p[5];  w2 = p[6];  w3 = p[7];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
+   w0 = p[8];  w1 = p[9];  w2 = p[10];  w3 = p[11];
+   sum2 += (w0 + w1) + (w2 + w3);
+   sum1 =  ROL64(sum1, 60) ^ ROL64(w0, 60) ^ ROL64(w1, 61)
+           ^ ROL64(w2, 62) ^ ROL64(w3, 63) ^ sum2;
    return sum1 + sum2;
 }
 
+#if defined(VEX_BENCH_SMCSUM)
+/* For useful/bench_smcsum.c only, which compiles this file itself
+   with VEX_BENCH_SMCSUM defined so as to time the helpers actually
+   used.  Returns the generic helper for szB-byte words: the scalar
+   version if impl is 0, the SSE2 one if 1 and the AVX2 one if 2, or
+   NULL if there is no such version. */
+void* genericg_checksum_for_bench ( UInt szB, UInt impl )
+{
+   if (impl == 0)
+      return szB == 8 ? (void*)genericg_compute_checksum_8al
+                      : (void*)genericg_compute_checksum_4al;
+#  if VEX_CHECKSUM_SIMD
+   if (impl == 1 && szB == 4)
+      return (void*)genericg_compute_checksum_4al_sse2;
+   if (impl == 2 && szB == 8)
+      return (void*)genericg_compute_checksum_8al_avx2;
+#  endif
+   return NULL;
+}
+#endif
+
 /*--------------------------------------------------------------------*/
 /*--- end                                 guest_generic_bb_to_IR.c ---*/
 /*--------------------------------------------------------------------*/
@@ -178,6 +178,8 @@ IRSB* bb_to_IR (
          /*IN*/ Addr             guest_IP_bbstart,
          /*IN*/ Bool             (*chase_into_ok)(void*,Addr),
          /*IN*/ VexEndness       host_endness,
+         /*IN*/ VexArch          arch_host,
+         /*IN*/ UInt             hwcaps_host,
          /*IN*/ Bool             sigill_diag,
          /*IN*/ VexArch          arch_guest,
          /*IN*/ const VexArchInfo* archinfo_guest,
@@ -193,6 +195,11 @@ IRSB* bb_to_IR (
          /*IN*/ Int              szB_GUEST_IP
       );
 
+#if defined(VEX_BENCH_SMCSUM)
+/* Test-only; see guest_generic_bb_to_IR.c. */
+extern void* genericg_checksum_for_bench ( UInt szB, UInt impl );
+#endif
+
 
 #endif /* ndef __VEX_GUEST_GENERIC_BB_TO_IR_H */
 
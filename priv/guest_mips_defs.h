@@ -56,12 +56,12 @@ extern DisResult disInstr_MIPS ( IRSB*        irbb,
                                  Bool         sigill_diag );
 
 /* Used by the optimiser to specialise calls to helpers. */
-extern IRExpr *guest_mips32_spechelper ( const HChar * function_name,
+extern IRExpr *guest_mips32_spechelper ( const IRCallee* cee,
                                          IRExpr ** args,
                                          IRStmt ** precedingStmts,
                                          Int n_precedingStmts );
 
-extern IRExpr *guest_mips64_spechelper ( const HChar * function_name,
+extern IRExpr *guest_mips64_spechelper ( const IRCallee* cee,
                                          IRExpr ** args,
                                          IRStmt ** precedingStmts,
                                          Int n_precedingStmts);
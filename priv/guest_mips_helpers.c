@@ -52,13 +52,13 @@
     { offsetof(VexGuestMIPS64State, field),            \
       (sizeof ((VexGuestMIPS64State*)0)->field) }
 
-IRExpr *guest_mips32_spechelper(const HChar * function_name, IRExpr ** args,
+IRExpr *guest_mips32_spechelper(const IRCallee* cee, IRExpr ** args,
                                 IRStmt ** precedingStmts, Int n_precedingStmts)
 {
    return NULL;
 }
 
-IRExpr *guest_mips64_spechelper ( const HChar * function_name, IRExpr ** args,
+IRExpr *guest_mips64_spechelper ( const IRCallee* cee, IRExpr ** args,
                                   IRStmt ** precedingStmts,
                                   Int n_precedingStmts )
 {
@@ -52,27 +52,27 @@
 /* CONST: what is the host's endianness?  This has to do with float vs
    double register accesses on VFP, but it's complex and not properly
    thought out. */
-static VexEndness host_endness;
+static VEX_TLS VexEndness host_endness;
 
 /* Whether code we're analyzing comes from a big or little endian machine */
-static IREndness guest_endness;
+static VEX_TLS IREndness guest_endness;
 
 /* Pointer to the guest code area. */
-static const UChar *guest_code;
+static VEX_TLS const UChar *guest_code;
 
 /* CONST: The guest address for the instruction currently being
    translated. */
-static Addr64 guest_PC_curr_instr;
+static VEX_TLS Addr64 guest_PC_curr_instr;
 
 /* MOD: The IRSB* into which we're generating code. */
-static IRSB *irsb;
+static VEX_TLS IRSB *irsb;
 
 /* Is our guest binary 32 or 64bit? Set at each call to
    disInstr_MIPS below. */
-static Bool mode64 = False;
+static VEX_TLS Bool mode64 = False;
 
 /* CPU has FPU and 32 dbl. prec. FP registers. */
-static Bool fp_mode64 = False;
+static VEX_TLS Bool fp_mode64 = False;
 
 #define OFFB_PC (mode64 ? offsetof(VexGuestMIPS64State, guest_PC) : offsetof(VexGuestMIPS32State, guest_PC))
 
@@ -12044,8 +12044,8 @@ static DisResult disInstr_MIPS_WRK ( Bool(*resteerOkFn) (/*opaque */void *,
 
    DisResult dres;
 
-   static IRExpr *lastn = NULL;  /* last jump addr */
-   static IRStmt *bstmt = NULL;  /* branch (Exit) stmt */
+   static VEX_TLS IRExpr *lastn = NULL;  /* last jump addr */
+   static VEX_TLS IRStmt *bstmt = NULL;  /* branch (Exit) stmt */
 
    /* The running delta */
    Int delta = (Int) delta64;
@@ -199,7 +199,7 @@ void ppc64g_dirtyhelper_LVS ( VexGuestPPC64State* gst,
 
 /* Helper-function specialiser. */
 
-IRExpr* guest_ppc32_spechelper ( const HChar* function_name,
+IRExpr* guest_ppc32_spechelper ( const IRCallee* cee,
                                  IRExpr** args,
                                  IRStmt** precedingStmts,
                                  Int      n_precedingStmts )
@@ -207,7 +207,7 @@ IRExpr* guest_ppc32_spechelper ( const HChar* function_name,
    return NULL;
 }
 
-IRExpr* guest_ppc64_spechelper ( const HChar* function_name,
+IRExpr* guest_ppc64_spechelper ( const IRCallee* cee,
                                  IRExpr** args,
                                  IRStmt** precedingStmts,
                                  Int      n_precedingStmts )
@@ -201,24 +201,24 @@
    given insn. */
 
 /* We need to know this to do sub-register accesses correctly. */
-static VexEndness guest_endness;
+static VEX_TLS VexEndness guest_endness;
 
 /* Pointer to the guest code area. */
-static const UChar* guest_code;
+static VEX_TLS const UChar* guest_code;
 
 /* The guest address corresponding to guest_code[0]. */
-static Addr64 guest_CIA_bbstart;
+static VEX_TLS Addr64 guest_CIA_bbstart;
 
 /* The guest address for the instruction currently being
    translated. */
-static Addr64 guest_CIA_curr_instr;
+static VEX_TLS Addr64 guest_CIA_curr_instr;
 
 /* The IRSB* into which we're generating code. */
-static IRSB* irsb;
+static VEX_TLS IRSB* irsb;
 
 /* Is our guest binary 32 or 64bit?  Set at each call to
    disInstr_PPC below. */
-static Bool mode64 = False;
+static VEX_TLS Bool mode64 = False;
 
 // Given a pointer to a function as obtained by "& functionname" in C,
 // produce a pointer to the actual entry point for the function.  For
@@ -27441,7 +27441,7 @@ DisResult disInstr_PPC_WRK (
                  getUIntPPCendianly(code+ 4) == 0x54006800 &&
                  getUIntPPCendianly(code+ 8) == 0x5400E800 &&
                  getUIntPPCendianly(code+12) == 0x54009800) {
-         static Bool reported = False;
+         static VEX_TLS Bool reported = False;
          if (!reported) {
             vex_printf("disInstr(ppc): old ppc32 instruction magic detected. Code might clobber r0.\n");
             vex_printf("disInstr(ppc): source needs to be recompiled against latest valgrind.h.\n");
@@ -54,7 +54,7 @@ DisResult disInstr_S390 ( IRSB*        irbb,
                           Bool         sigill_diag );
 
 /* Used by the optimiser to specialise calls to helpers. */
-IRExpr* guest_s390x_spechelper ( const HChar *function_name,
+IRExpr* guest_s390x_spechelper ( const IRCallee* cee,
                                  IRExpr **args,
                                  IRStmt **precedingStmts,
                                  Int n_precedingStmts);
@@ -1823,7 +1823,7 @@ isC64(const IRExpr *expr)
    case the helper function will be called. Otherwise, the expression has
    type Ity_I32 and a Boolean value. */
 IRExpr *
-guest_s390x_spechelper(const HChar *function_name, IRExpr **args,
+guest_s390x_spechelper(const IRCallee* cee, IRExpr **args,
                        IRStmt **precedingStmts, Int n_precedingStmts)
 {
    UInt i, arity = 0;
@@ -1833,7 +1833,7 @@ guest_s390x_spechelper(const HChar *function_name, IRExpr **args,
 
 #  if 0
    vex_printf("spec request:\n");
-   vex_printf("   %s  ", function_name);
+   vex_printf("   %s  ", cee->name);
    for (i = 0; i < arity; i++) {
       vex_printf("  ");
       ppIRExpr(args[i]);
@@ -1843,7 +1843,7 @@ guest_s390x_spechelper(const HChar *function_name, IRExpr **args,
 
    /* --------- Specialising "s390_calculate_cond" --------- */
 
-   if (vex_streq(function_name, "s390_calculate_cond")) {
+   if (cee->addr == &s390_calculate_cond) {
       IRExpr *cond_expr, *cc_op_expr, *cc_dep1, *cc_dep2;
       ULong cond, cc_op;
 
@@ -2380,7 +2380,7 @@ guest_s390x_spechelper(const HChar *function_name, IRExpr **args,
 
    /* --------- Specialising "s390_calculate_cc" --------- */
 
-   if (vex_streq(function_name, "s390_calculate_cc")) {
+   if (cee->addr == &s390_calculate_cc) {
       IRExpr *cc_op_expr, *cc_dep1;
       ULong cc_op;
 
@@ -58,24 +58,24 @@ static void s390_irgen_CLC_EX(IRTemp, IRTemp, IRTemp);
 /*------------------------------------------------------------*/
 
 /* The IRSB* into which we're generating code. */
-static IRSB *irsb;
+static VEX_TLS IRSB *irsb;
 
 /* The guest address for the instruction currently being
    translated. */
-static Addr64 guest_IA_curr_instr;
+static VEX_TLS Addr64 guest_IA_curr_instr;
 
 /* The guest address for the instruction following the current instruction. */
-static Addr64 guest_IA_next_instr;
+static VEX_TLS Addr64 guest_IA_next_instr;
 
 /* Result of disassembly step. */
-static DisResult *dis_res;
+static VEX_TLS DisResult *dis_res;
 
 /* Resteer function and callback data */
-static Bool (*resteer_fn)(void *, Addr);
-static void *resteer_data;
+static VEX_TLS Bool (*resteer_fn)(void *, Addr);
+static VEX_TLS void *resteer_data;
 
 /* Whether to print diagnostics for illegal instructions. */
-static Bool sigill_diag;
+static VEX_TLS Bool sigill_diag;
 
 /* The last seen execute target instruction */
 ULong last_execute_target;
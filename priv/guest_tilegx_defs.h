@@ -55,7 +55,7 @@ extern DisResult disInstr_TILEGX ( IRSB* irbb,
                                    Bool sigill_diag_IN );
 
 /* Used by the optimiser to specialise calls to helpers. */
-extern IRExpr *guest_tilegx_spechelper ( const HChar * function_name,
+extern IRExpr *guest_tilegx_spechelper ( const IRCallee* cee,
                                          IRExpr ** args,
                                          IRStmt ** precedingStmts,
                                          Int n_precedingStmts );
@@ -46,7 +46,7 @@
   { offsetof(VexGuestTILEGXState, field),               \
       (sizeof ((VexGuestTILEGXState*)0)->field) }
 
-IRExpr *guest_tilegx_spechelper ( const HChar * function_name, IRExpr ** args,
+IRExpr *guest_tilegx_spechelper ( const IRCallee* cee, IRExpr ** args,
                                   IRStmt ** precedingStmts, Int n_precedingStmts)
 {
   return NULL;
@@ -54,20 +54,20 @@
 /* CONST: is the host bigendian?  This has to do with float vs double
    register accesses on VFP, but it's complex and not properly thought
    out. */
-static VexEndness host_endness;
+static VEX_TLS VexEndness host_endness;
 
 /* Pointer to the guest code area. */
-static UChar *guest_code;
+static VEX_TLS UChar *guest_code;
 
 /* The guest address corresponding to guest_code[0]. */
-static Addr64 guest_PC_bbstart;
+static VEX_TLS Addr64 guest_PC_bbstart;
 
 /* CONST: The guest address for the instruction currently being
    translated. */
-static Addr64 guest_PC_curr_instr;
+static VEX_TLS Addr64 guest_PC_curr_instr;
 
 /* MOD: The IRSB* into which we're generating code. */
-static IRSB *irsb;
+static VEX_TLS IRSB *irsb;
 
 /*------------------------------------------------------------*/
 /*--- Debugging output                                     ---*/
@@ -429,17 +429,32 @@ static UInt tab_cond[X86G_CC_OP_NUMBER][16];
 static UInt n_calc_all  = 0;
 static UInt n_calc_c    = 0;
 static UInt n_calc_cond = 0;
+/* how many of the calc_cond calls took the fast route */
+static UInt n_calc_cond_fast = 0;
 
 #define SHOW_COUNTS_NOW (0 == (0x3FFFFF & (n_calc_all+n_calc_c+n_calc_cond)))
 
+/* n as a percentage of total, or 0 if total is 0 */
+static UInt percent ( UInt n, UInt total )
+{
+   return total == 0 ? 0 : (UInt)((100ULL * n) / total);
+}
+
 
 static void showCounts ( void )
 {
    Int op, co;
    HChar ch;
+   UInt n_calc_c_fast = 0;
    vex_printf("\nTotal calls: calc_all=%u   calc_cond=%u   calc_c=%u\n",
               n_calc_all, n_calc_cond, n_calc_c);
 
+   for (op = 0; op < X86G_CC_OP_NUMBER; op++)
+      n_calc_c_fast += tabc_fast[op];
+   vex_printf("Fast route hits: calc_cond=%u (%u%%)   calc_c=%u (%u%%)\n",
+              n_calc_cond_fast, percent(n_calc_cond_fast, n_calc_cond),
+              n_calc_c_fast, percent(n_calc_c_fast, n_calc_c));
+
    vex_printf("      cSLOW  cFAST    O   NO    B   NB    Z   NZ   BE  NBE"
               "    S   NS    P   NP    L   NL   LE  NLE\n");
    vex_printf("     -----------------------------------------------------"
@@ -477,6 +492,7 @@ static void initCounts ( void )
 {
    Int op, co;
    initted = True;
+   n_calc_cond_fast = 0;
    for (op = 0; op < X86G_CC_OP_NUMBER; op++) {
       tabc_fast[op] = tabc_slow[op] = 0;
       for (co = 0; co < 16; co++)
@@ -487,6 +503,16 @@ static void initCounts ( void )
 #endif /* PROFILE_EFLAGS */
 
 
+/* For the cc_ops that come in B/W/L groups (ADDB .. SMULL), the left
+   shift that moves the top bit of an operand of that size up to bit
+   31.  Once both operands of a thunk are shifted like that, plain
+   32-bit comparisons give the flag values for any size, without
+   masking or sign extension. */
+static const UChar cc_op_size_shift[3] = { 24, 16, 0 };
+
+#define CC_OP_SIZE_SHIFT(_cc_op) (cc_op_size_shift[((_cc_op) - 1) % 3])
+
+
 /* CALLED FROM GENERATED CODE: CLEAN HELPER */
 /* Calculate all the 6 flags from the supplied thunk parameters.
    Worker function, not directly called from generated code. */
@@ -608,6 +634,14 @@ UInt x86g_calculate_eflags_c ( UInt cc_op,
       case X86G_CC_OP_LOGICW: 
       case X86G_CC_OP_LOGICB:
          return 0;
+      case X86G_CC_OP_ADDL:
+      case X86G_CC_OP_ADDW:
+      case X86G_CC_OP_ADDB: {
+         /* carry out iff the result is below argL */
+         Int sh = CC_OP_SIZE_SHIFT(cc_op);
+         return ((cc_dep1 + cc_dep2) << sh) < (cc_dep1 << sh)
+                   ? X86G_CC_MASK_C : 0;
+      }
       case X86G_CC_OP_SUBL:
          return ((UInt)cc_dep1) < ((UInt)cc_dep2)
                    ? X86G_CC_MASK_C : 0;
@@ -634,6 +668,79 @@ UInt x86g_calculate_eflags_c ( UInt cc_op,
 }
 
 
+/* Fast route for x86g_calculate_condition, for the same pairs as
+   calculate_condition_fast in guest_amd64_helpers.c: SUB and LOGIC
+   thunks, which are what the second of two conditional jumps on the
+   same flags (eg "cmp ; je ; jl") sees, since the spechelper cannot
+   know the cc_op at the start of a block; and Z/S after shifts.
+   Returns False, leaving *res alone, for pairs not handled here. */
+static inline
+Bool calculate_condition_fast ( UInt/*X86Condcode*/ cond,
+                                UInt cc_op,
+                                UInt cc_dep1,
+                                UInt cc_dep2,
+                                /*OUT*/UInt* res )
+{
+   UInt argL, argR, r, b;
+   Int  sh;
+
+   switch (cc_op) {
+      case X86G_CC_OP_SUBB:
+      case X86G_CC_OP_SUBW:
+      case X86G_CC_OP_SUBL:
+         sh   = CC_OP_SIZE_SHIFT(cc_op);
+         argL = cc_dep1 << sh;
+         argR = cc_dep2 << sh;
+         switch (cond & ~1) {
+            case X86CondB:  b = argL < argR;                   break;
+            case X86CondZ:  b = argL == argR;                  break;
+            case X86CondBE: b = argL <= argR;                  break;
+            case X86CondS:  b = (Int)(argL - argR) < 0;        break;
+            case X86CondL:  b = (Int)argL < (Int)argR;         break;
+            case X86CondLE: b = (Int)argL <= (Int)argR;        break;
+            default:        return False;
+         }
+         break;
+
+      case X86G_CC_OP_LOGICB:
+      case X86G_CC_OP_LOGICW:
+      case X86G_CC_OP_LOGICL:
+         /* OF = CF = 0 */
+         r = cc_dep1 << CC_OP_SIZE_SHIFT(cc_op);
+         switch (cond & ~1) {
+            case X86CondO:
+            case X86CondB:  b = 0;                             break;
+            case X86CondZ:
+            case X86CondBE: b = r == 0;                        break;
+            case X86CondS:
+            case X86CondL:  b = (Int)r < 0;                    break;
+            case X86CondLE: b = (Int)r <= 0;                   break;
+            default:        return False;
+         }
+         break;
+
+      case X86G_CC_OP_SHLB:
+      case X86G_CC_OP_SHLW:
+      case X86G_CC_OP_SHLL:
+      case X86G_CC_OP_SHRB:
+      case X86G_CC_OP_SHRW:
+      case X86G_CC_OP_SHRL:
+         r = cc_dep1 << CC_OP_SIZE_SHIFT(cc_op);
+         switch (cond & ~1) {
+            case X86CondZ:  b = r == 0;                        break;
+            case X86CondS:  b = (Int)r < 0;                    break;
+            default:        return False;
+         }
+         break;
+
+      default:
+         return False;
+   }
+
+   *res = 1 & ((cond & 1) ^ b);
+   return True;
+}
+
 /* CALLED FROM GENERATED CODE: CLEAN HELPER */
 /* returns 1 or 0 */
 UInt x86g_calculate_condition ( UInt/*X86Condcode*/ cond, 
@@ -642,10 +749,10 @@ UInt x86g_calculate_condition ( UInt/*X86Condcode*/ cond,
                                 UInt cc_dep2,
                                 UInt cc_ndep )
 {
-   UInt eflags = x86g_calculate_eflags_all_WRK(cc_op, cc_dep1, 
-                                               cc_dep2, cc_ndep);
+   UInt eflags;
    UInt of,sf,zf,cf,pf;
    UInt inv = cond & 1;
+   UInt res;
 
 #  if PROFILE_EFLAGS
    if (!initted) initCounts();
@@ -654,6 +761,16 @@ UInt x86g_calculate_condition ( UInt/*X86Condcode*/ cond,
    if (SHOW_COUNTS_NOW) showCounts();
 #  endif
 
+   if (calculate_condition_fast(cond, cc_op, cc_dep1, cc_dep2, &res)) {
+#     if PROFILE_EFLAGS
+      n_calc_cond_fast++;
+#     endif
+      return res;
+   }
+
+   eflags = x86g_calculate_eflags_all_WRK(cc_op, cc_dep1, 
+                                          cc_dep2, cc_ndep);
+
    switch (cond) {
       case X86CondNO:
       case X86CondO: /* OF == 1 */
@@ -810,7 +927,7 @@ static inline Bool isU32 ( IRExpr* e, UInt n )
               && e->Iex.Const.con->Ico.U32 == n );
 }
 
-IRExpr* guest_x86_spechelper ( const HChar* function_name,
+IRExpr* guest_x86_spechelper ( const IRCallee* cee,
                                IRExpr** args,
                                IRStmt** precedingStmts,
                                Int      n_precedingStmts )
@@ -825,7 +942,7 @@ IRExpr* guest_x86_spechelper ( const HChar* function_name,
       arity++;
 #  if 0
    vex_printf("spec request:\n");
-   vex_printf("   %s  ", function_name);
+   vex_printf("   %s  ", cee->name);
    for (i = 0; i < arity; i++) {
       vex_printf("  ");
       ppIRExpr(args[i]);
@@ -835,7 +952,7 @@ IRExpr* guest_x86_spechelper ( const HChar* function_name,
 
    /* --------- specialising "x86g_calculate_condition" --------- */
 
-   if (vex_streq(function_name, "x86g_calculate_condition")) {
+   if (cee->addr == &x86g_calculate_condition) {
       /* specialise calls to above "calculate condition" function */
       IRExpr *cond, *cc_op, *cc_dep1, *cc_dep2;
       vassert(arity == 5);
@@ -1254,7 +1371,7 @@ IRExpr* guest_x86_spechelper ( const HChar* function_name,
 
    /* --------- specialising "x86g_calculate_eflags_c" --------- */
 
-   if (vex_streq(function_name, "x86g_calculate_eflags_c")) {
+   if (cee->addr == &x86g_calculate_eflags_c) {
       /* specialise calls to above "calculate_eflags_c" function */
       IRExpr *cc_op, *cc_dep1, *cc_dep2, *cc_ndep;
       vassert(arity == 4);
@@ -1328,7 +1445,7 @@ IRExpr* guest_x86_spechelper ( const HChar* function_name,
 
    /* --------- specialising "x86g_calculate_eflags_all" --------- */
 
-   if (vex_streq(function_name, "x86g_calculate_eflags_all")) {
+   if (cee->addr == &x86g_calculate_eflags_all) {
       /* specialise calls to above "calculate_eflags_all" function */
       IRExpr *cc_op, *cc_dep1; /*, *cc_dep2, *cc_ndep; */
       vassert(arity == 4);
@@ -195,36 +195,36 @@
    given insn. */
 
 /* We need to know this to do sub-register accesses correctly. */
-static VexEndness host_endness;
+static VEX_TLS VexEndness host_endness;
 
 /* Pointer to the guest code area (points to start of BB, not to the
    insn being processed). */
-static const UChar* guest_code;
+static VEX_TLS const UChar* guest_code;
 
 /* The guest address corresponding to guest_code[0]. */
-static Addr32 guest_EIP_bbstart;
+static VEX_TLS Addr32 guest_EIP_bbstart;
 
 /* The guest address for the instruction currently being
    translated. */
-static Addr32 guest_EIP_curr_instr;
+static VEX_TLS Addr32 guest_EIP_curr_instr;
 
 /* The IRSB* into which we're generating code. */
-static IRSB* irsb;
+static VEX_TLS IRSB* irsb;
 
 /* Whether are not we are in protected mode */
-static Bool protected_mode;
+static VEX_TLS Bool protected_mode;
 
 /* The addr-op size of the instruction
  * By default it is 4 for protected mode and 2 for real mode.
  * If there is the 0x67 prefix it is swapped
  */
-static Int current_sz_addr;
+static VEX_TLS Int current_sz_addr;
 
 /* The data-op size of the instruction
  * By default it is 4 for protected mode and 2 for real mode.
  * If there is the 0x66 prefix it is swapped
  */
-static Int current_sz_data;
+static VEX_TLS Int current_sz_data;
 
 
 /*------------------------------------------------------------*/
@@ -54,7 +54,8 @@ const RRegUniverse* getRRegUniverse_AMD64 ( void )
    /* Handy shorthand, nothing more */
    RRegUniverse* ru = &rRegUniverse_AMD64;
 
-   /* This isn't thread-safe.  Sigh. */
+   /* LibVEX_Init calls this, so after that it is read-only and may be
+      shared between threads. */
    if (LIKELY(rRegUniverse_AMD64_initted))
       return ru;
 
@@ -1996,6 +1997,417 @@ void genReload_AMD64 ( /*OUT*/HInstr** i1, /*OUT*/HInstr** i2,
 }
 
 
+/* --------- Peephole optimisation of allocated code. --------- */
+
+/* These run after register allocation, so every register mentioned
+   is a real one and liveness can be tracked with the rRead/rWritten
+   masks of HRegUsage alone. */
+
+/* Is real register |r| dead after code->arr[ix]?  That is, is it
+   written before being read, or not read at all before the block
+   ends?  Registers are never live out of a block, so an
+   unconditional exit ends the search. */
+static Bool rregDeadAfter_AMD64 ( const HInstrArray* code, Int ix, HReg r )
+{
+   HRegUsage u;
+   ULong     mask = 1ULL << hregIndex(r);
+   Int       j;
+   for (j = ix + 1; j < code->arr_used; j++) {
+      const AMD64Instr* i = code->arr[j];
+      getRegUsage_AMD64Instr(&u, i, True);
+      if (u.rRead & mask)
+         return False;
+      if (u.rWritten & mask)
+         return True;
+      if ((i->tag == Ain_XDirect && i->Ain.XDirect.cond == Acc_ALWAYS)
+          || (i->tag == Ain_XIndir && i->Ain.XIndir.cond == Acc_ALWAYS)
+          || (i->tag == Ain_XAssisted
+              && i->Ain.XAssisted.cond == Acc_ALWAYS))
+         return True;
+   }
+   return True;
+}
+
+/* How an instruction treats %rflags, as far as the peepholer needs
+   to know.  Anything not listed is assumed to read them. */
+typedef
+   enum { FlNone, FlWrite, FlRead, FlEnd }
+   FlagsEffect;
+
+static FlagsEffect flagsEffect_AMD64 ( const AMD64Instr* i )
+{
+   switch (i->tag) {
+      case Ain_Alu64R:
+      case Ain_Alu64M:
+      case Ain_Alu32R: {
+         AMD64AluOp op = i->tag == Ain_Alu64R ? i->Ain.Alu64R.op
+                         : i->tag == Ain_Alu64M ? i->Ain.Alu64M.op
+                         : i->Ain.Alu32R.op;
+         if (op == Aalu_MOV)
+            return FlNone;
+         if (op == Aalu_ADC || op == Aalu_SBB)
+            return FlRead;
+         return FlWrite;
+      }
+      case Ain_Test64:
+         return FlWrite;
+      case Ain_Unary64:
+         return i->Ain.Unary64.op == Aun_NOT ? FlNone : FlWrite;
+      case Ain_Imm64: case Ain_Lea64: case Ain_MovxLQ: case Ain_LoadEX:
+      case Ain_Store: case Ain_SseLdSt: case Ain_SseLdzLO:
+      case Ain_SseReRg: case Ain_Sse32Fx4: case Ain_Sse32FLo:
+      case Ain_Sse64Fx2: case Ain_Sse64FLo: case Ain_SseShuf:
+         return FlNone;
+      case Ain_Call:
+         return i->Ain.Call.cond == Acc_ALWAYS ? FlWrite : FlRead;
+      case Ain_XDirect:
+         return i->Ain.XDirect.cond == Acc_ALWAYS ? FlEnd : FlRead;
+      case Ain_XIndir:
+         return i->Ain.XIndir.cond == Acc_ALWAYS ? FlEnd : FlRead;
+      case Ain_XAssisted:
+         return i->Ain.XAssisted.cond == Acc_ALWAYS ? FlEnd : FlRead;
+      default:
+         return FlRead;
+   }
+}
+
+/* Are the flags dead after code->arr[ix]: overwritten, or the block
+   left, before anything reads them? */
+static Bool flagsDeadAfter_AMD64 ( const HInstrArray* code, Int ix )
+{
+   Int j;
+   for (j = ix + 1; j < code->arr_used; j++) {
+      switch (flagsEffect_AMD64(code->arr[j])) {
+         case FlNone:  break;
+         case FlRead:  return False;
+         default:      return True;
+      }
+   }
+   return True;
+}
+
+static AMD64CondCode* exitCond_AMD64 ( AMD64Instr* i )
+{
+   switch (i->tag) {
+      case Ain_XDirect:   return &i->Ain.XDirect.cond;
+      case Ain_XIndir:    return &i->Ain.XIndir.cond;
+      case Ain_XAssisted: return &i->Ain.XAssisted.cond;
+      default:            return NULL;
+   }
+}
+
+static Bool sameAMode_AMD64 ( const AMD64AMode* a, const AMD64AMode* b )
+{
+   if (a->tag != b->tag)
+      return False;
+   if (a->tag == Aam_IR)
+      return a->Aam.IR.imm == b->Aam.IR.imm
+             && sameHReg(a->Aam.IR.reg, b->Aam.IR.reg);
+   return a->Aam.IRRS.imm == b->Aam.IRRS.imm
+          && sameHReg(a->Aam.IRRS.base, b->Aam.IRRS.base)
+          && sameHReg(a->Aam.IRRS.index, b->Aam.IRRS.index)
+          && a->Aam.IRRS.shift == b->Aam.IRRS.shift;
+}
+
+/* Is |i| a 64-bit integer register-to-register move? */
+static Bool isMovRR_AMD64 ( const AMD64Instr* i, HReg* src, HReg* dst )
+{
+   if (i->tag != Ain_Alu64R || i->Ain.Alu64R.op != Aalu_MOV
+       || i->Ain.Alu64R.src->tag != Armi_Reg)
+      return False;
+   *src = i->Ain.Alu64R.src->Armi.Reg.reg;
+   *dst = i->Ain.Alu64R.dst;
+   return True;
+}
+
+static Bool amodeMentions_AMD64 ( AMD64AMode* am, HReg r )
+{
+   HRegUsage u;
+   initHRegUsage(&u);
+   addRegUsage_AMD64AMode(&u, am);
+   return HRegUsage__contains(&u, r);
+}
+
+/* If |i| reads |from| only as a plain source operand, return a copy
+   that reads |to| instead; otherwise NULL. */
+static AMD64Instr* substSrc_AMD64 ( const AMD64Instr* i, HReg from, HReg to )
+{
+   switch (i->tag) {
+      case Ain_Test64:
+         if (sameHReg(i->Ain.Test64.dst, from))
+            return AMD64Instr_Test64(i->Ain.Test64.imm32, to);
+         return NULL;
+      case Ain_Alu64M:
+         if (i->Ain.Alu64M.op == Aalu_MOV
+             && i->Ain.Alu64M.src->tag == Ari_Reg
+             && sameHReg(i->Ain.Alu64M.src->Ari.Reg.reg, from)
+             && !amodeMentions_AMD64(i->Ain.Alu64M.dst, from))
+            return AMD64Instr_Alu64M(Aalu_MOV, AMD64RI_Reg(to),
+                                     i->Ain.Alu64M.dst);
+         return NULL;
+      case Ain_Store:
+         if (sameHReg(i->Ain.Store.src, from)
+             && !amodeMentions_AMD64(i->Ain.Store.dst, from))
+            return AMD64Instr_Store(i->Ain.Store.sz, to, i->Ain.Store.dst);
+         return NULL;
+      case Ain_Alu64R:
+         /* op %from,%d, with %d not %from */
+         if (i->Ain.Alu64R.op != Aalu_MOV
+             && i->Ain.Alu64R.src->tag == Armi_Reg
+             && sameHReg(i->Ain.Alu64R.src->Armi.Reg.reg, from)
+             && !sameHReg(i->Ain.Alu64R.dst, from))
+            return AMD64Instr_Alu64R(i->Ain.Alu64R.op, AMD64RMI_Reg(to),
+                                     i->Ain.Alu64R.dst);
+         /* cmpq src,%from, with src not mentioning %from */
+         if (i->Ain.Alu64R.op == Aalu_CMP
+             && sameHReg(i->Ain.Alu64R.dst, from)
+             && (i->Ain.Alu64R.src->tag == Armi_Imm
+                 || (i->Ain.Alu64R.src->tag == Armi_Reg
+                     && !sameHReg(i->Ain.Alu64R.src->Armi.Reg.reg, from))))
+            return AMD64Instr_Alu64R(Aalu_CMP, i->Ain.Alu64R.src, to);
+         return NULL;
+      default:
+         return NULL;
+   }
+}
+
+/* If |i| writes |from| as its only effect on registers, and without
+   reading it, return a copy that writes |to| instead; otherwise
+   NULL. */
+static AMD64Instr* substDst_AMD64 ( const AMD64Instr* i, HReg from, HReg to )
+{
+   AMD64Instr* n;
+   HReg*       dst;
+   switch (i->tag) {
+      case Ain_Imm64: case Ain_Lea64: case Ain_MovxLQ: case Ain_LoadEX:
+      case Ain_Set64:
+         break;
+      case Ain_Alu64R:
+         if (i->Ain.Alu64R.op == Aalu_MOV
+             && i->Ain.Alu64R.src->tag != Armi_Reg)
+            break;
+         return NULL;
+      default:
+         return NULL;
+   }
+   n = LibVEX_Alloc_inline(sizeof(AMD64Instr));
+   *n = *i;
+   switch (n->tag) {
+      case Ain_Imm64:  dst = &n->Ain.Imm64.dst;  break;
+      case Ain_Lea64:  dst = &n->Ain.Lea64.dst;  break;
+      case Ain_MovxLQ: dst = &n->Ain.MovxLQ.dst; break;
+      case Ain_LoadEX: dst = &n->Ain.LoadEX.dst; break;
+      case Ain_Set64:  dst = &n->Ain.Set64.dst;  break;
+      default:         dst = &n->Ain.Alu64R.dst; break;
+   }
+   if (!sameHReg(*dst, from))
+      return NULL;
+   *dst = to;
+   return n;
+}
+
+/* Rules that need look only at the previous surviving instruction.
+   Returns the new instruction count. */
+static Int peepholePairs_AMD64 ( HInstrArray* code )
+{
+   Int i, n = 0;
+   for (i = 0; i < code->arr_used; i++) {
+      AMD64Instr* cur  = code->arr[i];
+      AMD64Instr* prev = n > 0 ? code->arr[n-1] : NULL;
+      HReg s1, d1, s2, d2;
+
+      /* mov %r,%r  ==>  (nothing) */
+      if (isMove_AMD64Instr(cur, &s2, &d2) && sameHReg(s2, d2))
+         continue;
+
+      if (prev != NULL) {
+         /* movq %r,am ; movq am,%r2  ==>  movq %r,am ; movq %r,%r2
+            and likewise for 16-byte SSE spills and reloads.  The
+            store cannot change the amode's registers. */
+         if (prev->tag == Ain_Alu64M && prev->Ain.Alu64M.op == Aalu_MOV
+             && prev->Ain.Alu64M.src->tag == Ari_Reg
+             && cur->tag == Ain_Alu64R && cur->Ain.Alu64R.op == Aalu_MOV
+             && cur->Ain.Alu64R.src->tag == Armi_Mem
+             && sameAMode_AMD64(prev->Ain.Alu64M.dst,
+                                cur->Ain.Alu64R.src->Armi.Mem.am)) {
+            s1 = prev->Ain.Alu64M.src->Ari.Reg.reg;
+            if (sameHReg(s1, cur->Ain.Alu64R.dst))
+               continue;
+            cur = AMD64Instr_Alu64R(Aalu_MOV, AMD64RMI_Reg(s1),
+                                    cur->Ain.Alu64R.dst);
+         }
+         else
+         if (prev->tag == Ain_SseLdSt && !prev->Ain.SseLdSt.isLoad
+             && cur->tag == Ain_SseLdSt && cur->Ain.SseLdSt.isLoad
+             && prev->Ain.SseLdSt.sz == 16 && cur->Ain.SseLdSt.sz == 16
+             && sameAMode_AMD64(prev->Ain.SseLdSt.addr,
+                                cur->Ain.SseLdSt.addr)) {
+            s1 = prev->Ain.SseLdSt.reg;
+            if (sameHReg(s1, cur->Ain.SseLdSt.reg))
+               continue;
+            cur = AMD64Instr_SseReRg(Asse_MOV, s1, cur->Ain.SseLdSt.reg);
+         }
+         /* movq am,%r ; movq %r,am  ==>  movq am,%r, provided the
+            load did not overwrite one of the amode's registers. */
+         else
+         if (prev->tag == Ain_Alu64R && prev->Ain.Alu64R.op == Aalu_MOV
+             && prev->Ain.Alu64R.src->tag == Armi_Mem
+             && cur->tag == Ain_Alu64M && cur->Ain.Alu64M.op == Aalu_MOV
+             && cur->Ain.Alu64M.src->tag == Ari_Reg
+             && sameHReg(prev->Ain.Alu64R.dst, cur->Ain.Alu64M.src->Ari.Reg.reg)
+             && sameAMode_AMD64(prev->Ain.Alu64R.src->Armi.Mem.am,
+                                cur->Ain.Alu64M.dst)) {
+            if (!amodeMentions_AMD64(cur->Ain.Alu64M.dst,
+                                     prev->Ain.Alu64R.dst))
+               continue;
+         }
+
+         /* mov %a,%b ; mov %b,%a  ==>  mov %a,%b
+            mov %a,%b ; mov %b,%c  ==>  mov %a,%c   if %b then dies */
+         /* <write %b> ; mov %b,%c  ==>  <write %c>   if %b then dies */
+         if (isMovRR_AMD64(cur, &s2, &d2)) {
+            AMD64Instr* sub = substDst_AMD64(prev, s2, d2);
+            if (sub != NULL && rregDeadAfter_AMD64(code, i, s2)) {
+               code->arr[n-1] = sub;
+               continue;
+            }
+         }
+
+         if (isMovRR_AMD64(prev, &s1, &d1) && isMovRR_AMD64(cur, &s2, &d2)
+             && sameHReg(d1, s2)) {
+            if (sameHReg(s1, d2))
+               continue;
+            if (rregDeadAfter_AMD64(code, i, d1)) {
+               n--;
+               cur = AMD64Instr_Alu64R(Aalu_MOV, AMD64RMI_Reg(s1), d2);
+            }
+         }
+         else
+         if (isMovRR_AMD64(prev, &s1, &d1)) {
+            AMD64Instr* sub;
+            /* mov %a,%b ; addq %c,%b  ==>  leaq (%a,%c),%b
+               mov %a,%b ; addq $k,%b  ==>  leaq k(%a),%b
+               if the flags the add sets are not used. */
+            if (cur->tag == Ain_Alu64R && cur->Ain.Alu64R.op == Aalu_ADD
+                && sameHReg(cur->Ain.Alu64R.dst, d1)
+                && flagsDeadAfter_AMD64(code, i)) {
+               const AMD64RMI* src = cur->Ain.Alu64R.src;
+               if (src->tag == Armi_Reg
+                   && !sameHReg(src->Armi.Reg.reg, d1)) {
+                  n--;
+                  cur = AMD64Instr_Lea64(
+                           AMD64AMode_IRRS(0, s1, src->Armi.Reg.reg, 0), d1);
+               }
+               else if (src->tag == Armi_Imm) {
+                  n--;
+                  cur = AMD64Instr_Lea64(
+                           AMD64AMode_IR(src->Armi.Imm.imm32, s1), d1);
+               }
+            }
+            /* mov %a,%b ; <read %b>  ==>  <read %a>   if %b then dies */
+            else
+            if ((sub = substSrc_AMD64(cur, d1, s1)) != NULL
+                && rregDeadAfter_AMD64(code, i, d1)) {
+               n--;
+               cur = sub;
+            }
+         }
+      }
+      code->arr[n++] = cur;
+   }
+   return n;
+}
+
+/* A conditional exit on a boolean that was itself made by setcc:
+
+      setq<cc> %a ; [movq %a,%b] ; andq $1,%b ; j<nz> exit
+      setq<cc> %a ; testq $1,%a ; j<nz> exit
+
+   The flags that set %a are still intact if nothing in between
+   touched them, so the exit can test <cc> directly.  The and/test
+   (and the move) can go if %b is dead afterwards and nothing
+   following the exit reads the flags the test would have set. */
+static void peepholeExits_AMD64 ( HInstrArray* code )
+{
+   Int i, j, n;
+   for (i = 2; i < code->arr_used; i++) {
+      AMD64Instr*    ex   = code->arr[i];
+      AMD64Instr*    tst  = code->arr[i-1];
+      AMD64CondCode* cond = exitCond_AMD64(ex);
+      AMD64Instr*    set;
+      Int            movIx = -1;
+      HReg           b, a, s, d;
+
+      if (cond == NULL || (*cond != Acc_NZ && *cond != Acc_Z))
+         continue;
+      if (tst->tag == Ain_Alu64R && tst->Ain.Alu64R.op == Aalu_AND
+          && tst->Ain.Alu64R.src->tag == Armi_Imm
+          && tst->Ain.Alu64R.src->Armi.Imm.imm32 == 1) {
+         b = tst->Ain.Alu64R.dst;
+         if (!rregDeadAfter_AMD64(code, i-1, b))
+            continue;
+      }
+      else if (tst->tag == Ain_Test64 && tst->Ain.Test64.imm32 == 1)
+         b = tst->Ain.Test64.dst;
+      else
+         continue;
+
+      /* Find the setq, looking back over a few instructions that
+         neither touch the flags nor write the register being
+         tested. */
+      a = b;
+      if (code->arr[i-2] != NULL && tst->tag == Ain_Alu64R
+          && isMovRR_AMD64(code->arr[i-2], &s, &d) && sameHReg(d, b)) {
+         movIx = i-2;
+         a = s;
+      }
+      set = NULL;
+      for (j = (movIx >= 0 ? movIx : i-1) - 1; j >= 0 && j >= i-8; j--) {
+         AMD64Instr* p = code->arr[j];
+         HRegUsage   u;
+         if (p == NULL)
+            continue;
+         if (p->tag == Ain_Set64) {
+            set = p;
+            break;
+         }
+         getRegUsage_AMD64Instr(&u, p, True);
+         if (flagsEffect_AMD64(p) != FlNone
+             || (u.rWritten & (1ULL << hregIndex(a))))
+            break;
+      }
+      if (set == NULL || !sameHReg(set->Ain.Set64.dst, a)
+          || set->Ain.Set64.cond >= Acc_ALWAYS)
+         continue;
+
+      if (!flagsDeadAfter_AMD64(code, i))
+         continue;
+
+      *cond = *cond == Acc_NZ ? set->Ain.Set64.cond
+                              : 1 ^ set->Ain.Set64.cond;
+      code->arr[i-1] = NULL;
+      if (movIx >= 0)
+         code->arr[movIx] = NULL;
+   }
+
+   for (i = n = 0; i < code->arr_used; i++)
+      if (code->arr[i] != NULL)
+         code->arr[n++] = code->arr[i];
+   code->arr_used = n;
+}
+
+/* Remove some obvious waste from register-allocated code: moves to
+   self, reloads of a just-spilled value, move chains the allocator
+   could not coalesce and redundant flag tests before conditional
+   exits.  The array is changed in place. */
+void peephole_AMD64Instrs ( HInstrArray* code, Bool mode64 )
+{
+   vassert(mode64 == True);
+   code->arr_used = peepholePairs_AMD64(code);
+   peepholeExits_AMD64(code);
+}
+
+
 /* --------- The amd64 assembler (bleh.) --------- */
 
 /* Produce the low three bits of an integer register number. */
@@ -3924,9 +4336,9 @@ VexInvalRange chainXDirect_AMD64 ( VexEndness endness_host,
    Long delta   = (Long)((const UChar *)place_to_jump_to - (const UChar*)p) - 5;
    Bool shortOK = delta >= -1000*1000*1000 && delta < 1000*1000*1000;
 
-   static UInt shortCTR = 0; /* DO NOT MAKE NON-STATIC */
+   static VEX_TLS UInt shortCTR = 0; /* DO NOT MAKE NON-STATIC */
    if (shortOK) {
-      shortCTR++; // thread safety bleh
+      shortCTR++;
       if (0 == (shortCTR & 0x3FF)) {
          shortOK = False;
          if (0)
@@ -55,7 +55,8 @@ const RRegUniverse* getRRegUniverse_ARM64 ( void )
    /* Handy shorthand, nothing more */
    RRegUniverse* ru = &rRegUniverse_ARM64;
 
-   /* This isn't thread-safe.  Sigh. */
+   /* LibVEX_Init calls this, so after that it is read-only and may be
+      shared between threads. */
    if (LIKELY(rRegUniverse_ARM64_initted))
       return ru;
 
@@ -2596,6 +2597,479 @@ void genReload_ARM64 ( /*OUT*/HInstr** i1, /*OUT*/HInstr** i2,
 }
 
 
+/* --------- Peephole optimisation of allocated code. --------- */
+
+/* These run after register allocation, so every register mentioned
+   is a real one and liveness can be tracked with the rRead/rWritten
+   masks of HRegUsage alone. */
+
+static Bool isUncondExit_ARM64 ( const ARM64Instr* i )
+{
+   return (i->tag == ARM64in_XDirect && i->ARM64in.XDirect.cond == ARM64cc_AL)
+          || (i->tag == ARM64in_XIndir && i->ARM64in.XIndir.cond == ARM64cc_AL)
+          || (i->tag == ARM64in_XAssisted
+              && i->ARM64in.XAssisted.cond == ARM64cc_AL);
+}
+
+/* Is real register |r| dead after code->arr[ix]?  Registers are
+   never live out of a block, so an unconditional exit ends the
+   search. */
+static Bool rregDeadAfter_ARM64 ( const HInstrArray* code, Int ix, HReg r )
+{
+   HRegUsage u;
+   ULong     mask = 1ULL << hregIndex(r);
+   Int       j;
+   for (j = ix + 1; j < code->arr_used; j++) {
+      getRegUsage_ARM64Instr(&u, code->arr[j], True);
+      if (u.rRead & mask)
+         return False;
+      if (u.rWritten & mask)
+         return True;
+      if (isUncondExit_ARM64(code->arr[j]))
+         return True;
+   }
+   return True;
+}
+
+/* How an instruction treats NZCV, as far as the peepholer needs to
+   know.  Anything not listed is assumed to read them. */
+typedef
+   enum { FlNone, FlWrite, FlRead, FlEnd }
+   FlagsEffect;
+
+static FlagsEffect flagsEffect_ARM64 ( const ARM64Instr* i )
+{
+   switch (i->tag) {
+      case ARM64in_Cmp: case ARM64in_Test:
+      case ARM64in_VCmpD: case ARM64in_VCmpS:
+         return FlWrite;
+      case ARM64in_Arith: case ARM64in_Logic: case ARM64in_Shift:
+      case ARM64in_Unary: case ARM64in_MovI: case ARM64in_Imm64:
+      case ARM64in_LdSt64: case ARM64in_LdSt32: case ARM64in_LdSt16:
+      case ARM64in_LdSt8: case ARM64in_VLdStH: case ARM64in_VLdStS:
+      case ARM64in_VLdStD: case ARM64in_VLdStQ: case ARM64in_VMov:
+      case ARM64in_VBinV: case ARM64in_VUnaryV: case ARM64in_VImmQ:
+      case ARM64in_VDfromX: case ARM64in_VQfromX: case ARM64in_VQfromXX:
+      case ARM64in_VXfromQ: case ARM64in_VXfromDorS:
+         return FlNone;
+      case ARM64in_Call:
+         return i->ARM64in.Call.cond == ARM64cc_AL ? FlWrite : FlRead;
+      case ARM64in_XDirect: case ARM64in_XIndir: case ARM64in_XAssisted:
+         return isUncondExit_ARM64(i) ? FlEnd : FlRead;
+      default:
+         return FlRead;
+   }
+}
+
+static ARM64CondCode* exitCond_ARM64 ( ARM64Instr* i )
+{
+   switch (i->tag) {
+      case ARM64in_XDirect:   return &i->ARM64in.XDirect.cond;
+      case ARM64in_XIndir:    return &i->ARM64in.XIndir.cond;
+      case ARM64in_XAssisted: return &i->ARM64in.XAssisted.cond;
+      default:                return NULL;
+   }
+}
+
+static Bool sameAMode_ARM64 ( const ARM64AMode* a, const ARM64AMode* b )
+{
+   if (a->tag != b->tag)
+      return False;
+   switch (a->tag) {
+      case ARM64am_RI9:
+         return sameHReg(a->ARM64am.RI9.reg, b->ARM64am.RI9.reg)
+                && a->ARM64am.RI9.simm9 == b->ARM64am.RI9.simm9;
+      case ARM64am_RI12:
+         return sameHReg(a->ARM64am.RI12.reg, b->ARM64am.RI12.reg)
+                && a->ARM64am.RI12.uimm12 == b->ARM64am.RI12.uimm12
+                && a->ARM64am.RI12.szB == b->ARM64am.RI12.szB;
+      case ARM64am_RR:
+         return sameHReg(a->ARM64am.RR.base, b->ARM64am.RR.base)
+                && sameHReg(a->ARM64am.RR.index, b->ARM64am.RR.index);
+      default:
+         return False;
+   }
+}
+
+/* Are |a| and |b| the same add/sub, with a destination that is not
+   also a source? */
+static Bool sameArith_ARM64 ( const ARM64Instr* a, const ARM64Instr* b )
+{
+   const ARM64RIA* ra = a->ARM64in.Arith.argR;
+   const ARM64RIA* rb = b->ARM64in.Arith.argR;
+   if (a->tag != ARM64in_Arith || b->tag != ARM64in_Arith
+       || a->ARM64in.Arith.isAdd != b->ARM64in.Arith.isAdd
+       || !sameHReg(a->ARM64in.Arith.dst, b->ARM64in.Arith.dst)
+       || !sameHReg(a->ARM64in.Arith.argL, b->ARM64in.Arith.argL)
+       || sameHReg(a->ARM64in.Arith.dst, a->ARM64in.Arith.argL)
+       || ra->tag != ARM64riA_I12 || rb->tag != ARM64riA_I12)
+      return False;
+   return ra->ARM64riA.I12.imm12 == rb->ARM64riA.I12.imm12
+          && ra->ARM64riA.I12.shift == rb->ARM64riA.I12.shift;
+}
+
+static ARM64Instr* dupInstr_ARM64 ( const ARM64Instr* i )
+{
+   ARM64Instr* n = LibVEX_Alloc_inline(sizeof(ARM64Instr));
+   *n = *i;
+   return n;
+}
+
+static Bool amodeMentions_ARM64 ( ARM64AMode* am, HReg r )
+{
+   HRegUsage u;
+   initHRegUsage(&u);
+   addRegUsage_ARM64AMode(&u, am);
+   return HRegUsage__contains(&u, r);
+}
+
+/* If |i| writes |from| as its only effect on registers, and without
+   reading it, return a copy that writes |to| instead; otherwise
+   NULL. */
+static ARM64Instr* substDst_ARM64 ( const ARM64Instr* i, HReg from, HReg to )
+{
+   ARM64Instr* n = dupInstr_ARM64(i);
+   HReg*       dst;
+   switch (n->tag) {
+      case ARM64in_Imm64:  dst = &n->ARM64in.Imm64.dst;  break;
+      case ARM64in_Arith:  dst = &n->ARM64in.Arith.dst;  break;
+      case ARM64in_Logic:  dst = &n->ARM64in.Logic.dst;  break;
+      case ARM64in_Shift:  dst = &n->ARM64in.Shift.dst;  break;
+      case ARM64in_Unary:  dst = &n->ARM64in.Unary.dst;  break;
+      case ARM64in_CSel:   dst = &n->ARM64in.CSel.dst;   break;
+      case ARM64in_LdSt64:
+         if (!n->ARM64in.LdSt64.isLoad) return NULL;
+         dst = &n->ARM64in.LdSt64.rD;
+         break;
+      case ARM64in_LdSt32:
+         if (!n->ARM64in.LdSt32.isLoad) return NULL;
+         dst = &n->ARM64in.LdSt32.rD;
+         break;
+      default:
+         return NULL;
+   }
+   if (!sameHReg(*dst, from))
+      return NULL;
+   *dst = to;
+   return n;
+}
+
+/* If |i| reads |from| only as a plain source operand, return a copy
+   that reads |to| instead; otherwise NULL. */
+static ARM64Instr* substSrc_ARM64 ( const ARM64Instr* i, HReg from, HReg to )
+{
+   ARM64Instr* n;
+   Bool        hit = False;
+   switch (i->tag) {
+      case ARM64in_Arith:
+         n = dupInstr_ARM64(i);
+         if (sameHReg(n->ARM64in.Arith.argL, from)) {
+            n->ARM64in.Arith.argL = to;
+            hit = True;
+         }
+         if (n->ARM64in.Arith.argR->tag == ARM64riA_R
+             && sameHReg(n->ARM64in.Arith.argR->ARM64riA.R.reg, from)) {
+            n->ARM64in.Arith.argR = ARM64RIA_R(to);
+            hit = True;
+         }
+         break;
+      case ARM64in_Cmp:
+         n = dupInstr_ARM64(i);
+         if (sameHReg(n->ARM64in.Cmp.argL, from)) {
+            n->ARM64in.Cmp.argL = to;
+            hit = True;
+         }
+         if (n->ARM64in.Cmp.argR->tag == ARM64riA_R
+             && sameHReg(n->ARM64in.Cmp.argR->ARM64riA.R.reg, from)) {
+            n->ARM64in.Cmp.argR = ARM64RIA_R(to);
+            hit = True;
+         }
+         break;
+      case ARM64in_Logic:
+         n = dupInstr_ARM64(i);
+         if (sameHReg(n->ARM64in.Logic.argL, from)) {
+            n->ARM64in.Logic.argL = to;
+            hit = True;
+         }
+         if (n->ARM64in.Logic.argR->tag == ARM64riL_R
+             && sameHReg(n->ARM64in.Logic.argR->ARM64riL.R.reg, from)) {
+            n->ARM64in.Logic.argR = ARM64RIL_R(to);
+            hit = True;
+         }
+         break;
+      case ARM64in_Test:
+         n = dupInstr_ARM64(i);
+         if (sameHReg(n->ARM64in.Test.argL, from)) {
+            n->ARM64in.Test.argL = to;
+            hit = True;
+         }
+         if (n->ARM64in.Test.argR->tag == ARM64riL_R
+             && sameHReg(n->ARM64in.Test.argR->ARM64riL.R.reg, from)) {
+            n->ARM64in.Test.argR = ARM64RIL_R(to);
+            hit = True;
+         }
+         break;
+      case ARM64in_Shift:
+         n = dupInstr_ARM64(i);
+         if (sameHReg(n->ARM64in.Shift.argL, from)) {
+            n->ARM64in.Shift.argL = to;
+            hit = True;
+         }
+         if (n->ARM64in.Shift.argR->tag == ARM64ri6_R
+             && sameHReg(n->ARM64in.Shift.argR->ARM64ri6.R.reg, from)) {
+            n->ARM64in.Shift.argR = ARM64RI6_R(to);
+            hit = True;
+         }
+         break;
+      case ARM64in_LdSt64:
+         if (i->ARM64in.LdSt64.isLoad
+             || !sameHReg(i->ARM64in.LdSt64.rD, from)
+             || amodeMentions_ARM64(i->ARM64in.LdSt64.amode, from))
+            return NULL;
+         return ARM64Instr_LdSt64(False, to, i->ARM64in.LdSt64.amode);
+      case ARM64in_LdSt32:
+         if (i->ARM64in.LdSt32.isLoad
+             || !sameHReg(i->ARM64in.LdSt32.rD, from)
+             || amodeMentions_ARM64(i->ARM64in.LdSt32.amode, from))
+            return NULL;
+         return ARM64Instr_LdSt32(False, to, i->ARM64in.LdSt32.amode);
+      default:
+         return NULL;
+   }
+   return hit ? n : NULL;
+}
+
+/* Rules that need look only at the last one or two surviving
+   instructions.  Returns the new instruction count. */
+static Int peepholePairs_ARM64 ( HInstrArray* code )
+{
+   Int i, n = 0;
+   for (i = 0; i < code->arr_used; i++) {
+      ARM64Instr* cur  = code->arr[i];
+      ARM64Instr* prev = n > 0 ? code->arr[n-1] : NULL;
+      HReg s1, d2;
+
+      /* mov x,x  ==>  (nothing).  64- and 32-bit vector moves zero
+         the rest of the register, so only the 128-bit ones go. */
+      if (cur->tag == ARM64in_MovI
+          && sameHReg(cur->ARM64in.MovI.dst, cur->ARM64in.MovI.src))
+         continue;
+      if (cur->tag == ARM64in_VMov && cur->ARM64in.VMov.szB == 16
+          && sameHReg(cur->ARM64in.VMov.dst, cur->ARM64in.VMov.src))
+         continue;
+
+      if (prev == NULL) {
+         code->arr[n++] = cur;
+         continue;
+      }
+
+      /* add x9,x21,#off ; st.. [x9] ; add x9,x21,#off  ==>
+         add x9,x21,#off ; st.. [x9]
+         which is how 128-bit spills and reloads address their slot. */
+      if (n >= 2 && sameArith_ARM64(code->arr[n-2], cur)) {
+         HRegUsage u;
+         getRegUsage_ARM64Instr(&u, prev, True);
+         if (!(u.rWritten & ((1ULL << hregIndex(cur->ARM64in.Arith.dst))
+                             | (1ULL << hregIndex(cur->ARM64in.Arith.argL)))))
+            continue;
+      }
+
+      /* str x,am ; ldr y,am  ==>  str x,am ; mov y,x
+         and likewise for 64- and 128-bit vector spills and reloads.
+         The store cannot change the amode's registers. */
+      if (prev->tag == ARM64in_LdSt64 && !prev->ARM64in.LdSt64.isLoad
+          && cur->tag == ARM64in_LdSt64 && cur->ARM64in.LdSt64.isLoad
+          && sameAMode_ARM64(prev->ARM64in.LdSt64.amode,
+                             cur->ARM64in.LdSt64.amode)) {
+         s1 = prev->ARM64in.LdSt64.rD;
+         d2 = cur->ARM64in.LdSt64.rD;
+         if (sameHReg(s1, d2))
+            continue;
+         cur = ARM64Instr_MovI(d2, s1);
+      }
+      else
+      if (prev->tag == ARM64in_VLdStD && !prev->ARM64in.VLdStD.isLoad
+          && cur->tag == ARM64in_VLdStD && cur->ARM64in.VLdStD.isLoad
+          && sameHReg(prev->ARM64in.VLdStD.rN, cur->ARM64in.VLdStD.rN)
+          && prev->ARM64in.VLdStD.uimm12 == cur->ARM64in.VLdStD.uimm12) {
+         s1 = prev->ARM64in.VLdStD.dD;
+         d2 = cur->ARM64in.VLdStD.dD;
+         if (sameHReg(s1, d2))
+            continue;
+         cur = ARM64Instr_VMov(8, d2, s1);
+      }
+      else
+      if (prev->tag == ARM64in_VLdStQ && !prev->ARM64in.VLdStQ.isLoad
+          && cur->tag == ARM64in_VLdStQ && cur->ARM64in.VLdStQ.isLoad
+          && sameHReg(prev->ARM64in.VLdStQ.rN, cur->ARM64in.VLdStQ.rN)) {
+         s1 = prev->ARM64in.VLdStQ.rQ;
+         d2 = cur->ARM64in.VLdStQ.rQ;
+         if (sameHReg(s1, d2))
+            continue;
+         cur = ARM64Instr_VMov(16, d2, s1);
+      }
+      /* ldr x,am ; str x,am  ==>  ldr x,am, provided the load did
+         not overwrite one of the amode's registers. */
+      else
+      if (prev->tag == ARM64in_LdSt64 && prev->ARM64in.LdSt64.isLoad
+          && cur->tag == ARM64in_LdSt64 && !cur->ARM64in.LdSt64.isLoad
+          && sameHReg(prev->ARM64in.LdSt64.rD, cur->ARM64in.LdSt64.rD)
+          && sameAMode_ARM64(prev->ARM64in.LdSt64.amode,
+                             cur->ARM64in.LdSt64.amode)) {
+         HRegUsage u;
+         initHRegUsage(&u);
+         addRegUsage_ARM64AMode(&u, cur->ARM64in.LdSt64.amode);
+         if (!HRegUsage__contains(&u, cur->ARM64in.LdSt64.rD))
+            continue;
+      }
+
+      /* mov a,b ; mov b,a  ==>  mov a,b
+         mov b,a ; mov c,b  ==>  mov c,a   if b then dies */
+      if (prev->tag == ARM64in_MovI && cur->tag == ARM64in_MovI
+          && sameHReg(prev->ARM64in.MovI.dst, cur->ARM64in.MovI.src)) {
+         s1 = prev->ARM64in.MovI.src;
+         d2 = cur->ARM64in.MovI.dst;
+         if (sameHReg(s1, d2))
+            continue;
+         if (rregDeadAfter_ARM64(code, i, prev->ARM64in.MovI.dst)) {
+            n--;
+            cur = ARM64Instr_MovI(d2, s1);
+         }
+      }
+      else
+      if (prev->tag == ARM64in_MovI || cur->tag == ARM64in_MovI) {
+         ARM64Instr* sub;
+         HRegUsage   u;
+         /* mov b,a ; <read b>  ==>  <read a>   if b then dies, or is
+            overwritten by the reader itself */
+         if (prev->tag == ARM64in_MovI
+             && (sub = substSrc_ARM64(cur, prev->ARM64in.MovI.dst,
+                                      prev->ARM64in.MovI.src)) != NULL) {
+            getRegUsage_ARM64Instr(&u, cur, True);
+            if ((u.rWritten & (1ULL << hregIndex(prev->ARM64in.MovI.dst)))
+                || rregDeadAfter_ARM64(code, i, prev->ARM64in.MovI.dst)) {
+               n--;
+               cur = sub;
+            }
+         }
+         /* <write b> ; mov c,b  ==>  <write c>   if b then dies */
+         else
+         if (cur->tag == ARM64in_MovI
+             && (sub = substDst_ARM64(prev, cur->ARM64in.MovI.src,
+                                      cur->ARM64in.MovI.dst)) != NULL
+             && rregDeadAfter_ARM64(code, i, cur->ARM64in.MovI.src)) {
+            code->arr[n-1] = sub;
+            continue;
+         }
+      }
+      code->arr[n++] = cur;
+   }
+   return n;
+}
+
+/* Find the instruction that last wrote |r| before code->arr[ix],
+   looking back at most |lim| instructions.  Returns -1 if there is
+   none in range. */
+static Int lastWriter_ARM64 ( const HInstrArray* code, Int ix, HReg r,
+                              Int lim )
+{
+   HRegUsage u;
+   Int       j;
+   for (j = ix - 1; j >= 0 && j >= ix - lim; j--) {
+      if (code->arr[j] == NULL)
+         continue;
+      getRegUsage_ARM64Instr(&u, code->arr[j], True);
+      if (u.rWritten & (1ULL << hregIndex(r)))
+         return j;
+   }
+   return -1;
+}
+
+static Bool isImm64_ARM64 ( const ARM64Instr* i, HReg r, ULong imm )
+{
+   return i->tag == ARM64in_Imm64 && sameHReg(i->ARM64in.Imm64.dst, r)
+          && i->ARM64in.Imm64.imm64 == imm;
+}
+
+/* A conditional exit on a boolean that was itself made by csel:
+
+      mov a,#1 ; mov z,#0 ; .. ; csel b,a,z,<cc> ; tst b,#1 ; b.ne exit
+
+   If nothing between the csel and the exit touched the flags, the
+   exit can test <cc> directly, provided nothing following it reads
+   the flags the tst would have set. */
+static void peepholeExits_ARM64 ( HInstrArray* code )
+{
+   Int i, j, k, n;
+   for (i = 2; i < code->arr_used; i++) {
+      ARM64Instr*    ex   = code->arr[i];
+      ARM64Instr*    tst  = code->arr[i-1];
+      ARM64CondCode* cond = exitCond_ARM64(ex);
+      ARM64Instr*    sel;
+      HReg           b;
+
+      if (cond == NULL || (*cond != ARM64cc_NE && *cond != ARM64cc_EQ))
+         continue;
+      if (tst->tag != ARM64in_Test
+          || tst->ARM64in.Test.argR->tag != ARM64riL_I13
+          || tst->ARM64in.Test.argR->ARM64riL.I13.bitN != 1
+          || tst->ARM64in.Test.argR->ARM64riL.I13.immR != 0
+          || tst->ARM64in.Test.argR->ARM64riL.I13.immS != 0)
+         continue;
+      b = tst->ARM64in.Test.argL;
+
+      j = lastWriter_ARM64(code, i-1, b, 16);
+      if (j < 0)
+         continue;
+      sel = code->arr[j];
+      if (sel->tag != ARM64in_CSel)
+         continue;
+      if (sel->ARM64in.CSel.cond >= ARM64cc_AL)
+         continue;
+      for (k = j+1; k < i-1; k++)
+         if (code->arr[k] != NULL
+             && flagsEffect_ARM64(code->arr[k]) != FlNone)
+            break;
+      if (k < i-1)
+         continue;
+      k = lastWriter_ARM64(code, j, sel->ARM64in.CSel.argL, 16);
+      if (k < 0 || !isImm64_ARM64(code->arr[k], sel->ARM64in.CSel.argL, 1))
+         continue;
+      k = lastWriter_ARM64(code, j, sel->ARM64in.CSel.argR, 16);
+      if (k < 0 || !isImm64_ARM64(code->arr[k], sel->ARM64in.CSel.argR, 0))
+         continue;
+
+      /* Check nothing after the exit reads the flags. */
+      for (k = i+1; k < code->arr_used; k++)
+         if (flagsEffect_ARM64(code->arr[k]) != FlNone)
+            break;
+      if (k < code->arr_used
+          && flagsEffect_ARM64(code->arr[k]) == FlRead)
+         continue;
+
+      *cond = *cond == ARM64cc_NE ? sel->ARM64in.CSel.cond
+                                  : 1 ^ sel->ARM64in.CSel.cond;
+      code->arr[i-1] = NULL;
+   }
+
+   for (i = n = 0; i < code->arr_used; i++)
+      if (code->arr[i] != NULL)
+         code->arr[n++] = code->arr[i];
+   code->arr_used = n;
+}
+
+/* Remove some obvious waste from register-allocated code: moves to
+   self, reloads of a just-spilled value, move chains the allocator
+   could not coalesce and redundant flag tests before conditional
+   exits.  The array is changed in place. */
+void peephole_ARM64Instrs ( HInstrArray* code, Bool mode64 )
+{
+   vassert(mode64 == True);
+   code->arr_used = peepholePairs_ARM64(code);
+   peepholeExits_ARM64(code);
+}
+
+
 /* Emit an instruction into buf and return the number of bytes used.
    Note that buf is not the insn's final place, and therefore it is
    imperative to emit position-independent code. */
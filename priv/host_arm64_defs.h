@@ -983,6 +983,8 @@ extern void genSpill_ARM64  ( /*OUT*/HInstr** i1, /*OUT*/HInstr** i2,
 extern void genReload_ARM64 ( /*OUT*/HInstr** i1, /*OUT*/HInstr** i2,
                               HReg rreg, Int offset, Bool );
 
+extern void peephole_ARM64Instrs ( HInstrArray*, Bool );
+
 extern const RRegUniverse* getRRegUniverse_ARM64 ( void );
 
 extern HInstrArray* iselSB_ARM64 ( const IRSB*, 
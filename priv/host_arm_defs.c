@@ -41,7 +41,7 @@
 #include "host_generic_regs.h"
 #include "host_arm_defs.h"
 
-UInt arm_hwcaps = 0;
+VEX_TLS UInt arm_hwcaps = 0;
 
 
 /* --------- Registers. --------- */
@@ -56,7 +56,8 @@ const RRegUniverse* getRRegUniverse_ARM ( void )
    /* Handy shorthand, nothing more */
    RRegUniverse* ru = &rRegUniverse_ARM;
 
-   /* This isn't thread-safe.  Sigh. */
+   /* LibVEX_Init calls this, so after that it is read-only and may be
+      shared between threads. */
    if (LIKELY(rRegUniverse_ARM_initted))
       return ru;
 
@@ -4946,9 +4947,9 @@ VexInvalRange chainXDirect_ARM ( VexEndness endness_host,
    Bool shortOK = delta >= -30*1000*1000 && delta < 30*1000*1000;
    vassert(0 == (delta & (Long)3));
 
-   static UInt shortCTR = 0; /* DO NOT MAKE NON-STATIC */
+   static VEX_TLS UInt shortCTR = 0; /* DO NOT MAKE NON-STATIC */
    if (shortOK) {
-      shortCTR++; // thread safety bleh
+      shortCTR++;
       if (0 == (shortCTR & 0x3FF)) {
          shortOK = False;
          if (0)
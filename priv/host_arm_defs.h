@@ -33,8 +33,9 @@
 #include "libvex_basictypes.h"
 #include "libvex.h"                      // VexArch
 #include "host_generic_regs.h"           // HReg
+#include "main_util.h"                   // VEX_TLS
 
-extern UInt arm_hwcaps;
+extern VEX_TLS UInt arm_hwcaps;
 
 
 /* --------- Registers. --------- */
@@ -37,6 +37,7 @@
 #include "libvex.h"
 
 #include "main_util.h"
+#include "main_stats.h"
 #include "host_generic_regs.h"
 
 /* Set to 1 for lots of debugging output. */
@@ -282,65 +283,6 @@ static void sortRRLRarray ( RRegLR* arr,
 }
 
 
-/* Compute the index of the highest and lowest 1 in a ULong,
-   respectively.  Results are undefined if the argument is zero.
-   Don't pass it zero :) */
-static inline UInt ULong__maxIndex ( ULong w64 ) {
-#ifdef _MSC_VER
-   /* This implementation should be correct with 32 or 64-bit msvc compiler.
-      Ref: https://chessprogramming.wikispaces.com/BitScan */
-   const int index64[64] = {
-        0, 47,  1, 56, 48, 27,  2, 60,
-       57, 49, 41, 37, 28, 16,  3, 61,
-       54, 58, 35, 52, 50, 42, 21, 44,
-       38, 32, 29, 23, 17, 11,  4, 62,
-       46, 55, 26, 59, 40, 36, 15, 53,
-       34, 51, 20, 43, 31, 22, 10, 45,
-       25, 39, 14, 33, 19, 30,  9, 24,
-       13, 18,  8, 12,  7,  6,  5, 63
-   };
-
-   const ULong debruijn64 = 0x03f79d71b4cb0a89;
-   ULong bb = w64;
-   bb |= bb >> 1;
-   bb |= bb >> 2;
-   bb |= bb >> 4;
-   bb |= bb >> 8;
-   bb |= bb >> 16;
-   bb |= bb >> 32;
-   return index64[(bb * debruijn64) >> 58];
-#else
-   return 63 - __builtin_clzll(w64);
-#endif
-}
-
-static inline UInt ULong__minIndex ( ULong w64 ) {
-#ifdef _MSC_VER
-   /* This implementation should be correct with 32 or 64-bit msvc compiler.
-      Ref: https://chessprogramming.wikispaces.com/BitScan */
-   const int lsb_64_table[64] =
-   {
-      63, 30,  3, 32, 59, 14, 11, 33,
-      60, 24, 50,  9, 55, 19, 21, 34,
-      61, 29,  2, 53, 51, 23, 41, 18,
-      56, 28,  1, 43, 46, 27,  0, 35,
-      62, 31, 58,  4,  5, 49, 54,  6,
-      15, 52, 12, 40,  7, 42, 45, 16,
-      25, 57, 48, 13, 10, 39,  8, 44,
-      20, 47, 38, 22, 17, 37, 36, 26
-   };
-
-   unsigned int folded;
-   ULong bb = w64;
-   bb ^= bb - 1;
-   folded = (int) bb ^ (bb >> 32);
-   return lsb_64_table[folded * 0x78291ACF >> 26];
-#else
-   return __builtin_ctzll(w64);
-#endif
-}
-
-
 /* Vectorised memset, copied from Valgrind's m_libcbase.c. */
 static void* local_memset ( void *destV, Int c, SizeT sz )
 {
@@ -494,6 +436,9 @@ HInstrArray* doRegisterAllocation (
       not at each insn processed. */
    Bool do_sanity_check;
 
+   /* For the pipeline statistics. */
+   UInt n_spills = 0, n_reloads = 0, n_moves_coalesced = 0;
+
    vassert(0 == (guest_sizeB % LibVEX_GUEST_STATE_ALIGN));
    vassert(0 == (LibVEX_N_SPILL_BYTES % LibVEX_GUEST_STATE_ALIGN));
    vassert(0 == (N_SPILL64S % 2));
@@ -1185,6 +1130,7 @@ HInstrArray* doRegisterAllocation (
          /* This rreg has become associated with a different vreg and
             hence with a different spill slot.  Play safe. */
          rreg_state[n].eq_spill_slot = False;
+         n_moves_coalesced++;
 
          /* Move on to the next insn.  We skip the post-insn stuff for
             fixed registers, since this move should not interact with
@@ -1278,6 +1224,7 @@ HInstrArray* doRegisterAllocation (
                      EMIT_INSTR(spill1);
                   if (spill2)
                      EMIT_INSTR(spill2);
+                  n_spills++;
                }
                rreg_state[k].eq_spill_slot = True;
             }
@@ -1453,6 +1400,7 @@ HInstrArray* doRegisterAllocation (
                   EMIT_INSTR(reload1);
                if (reload2)
                   EMIT_INSTR(reload2);
+               n_reloads++;
                /* This rreg is read or modified by the instruction.
                   If it's merely read we can claim it now equals the
                   spill slot, but not so if it is modified. */
@@ -1538,6 +1486,7 @@ HInstrArray* doRegisterAllocation (
                EMIT_INSTR(spill1);
             if (spill2)
                EMIT_INSTR(spill2);
+            n_spills++;
          }
 
          /* Update the rreg_state to reflect the new assignment for this
@@ -1564,6 +1513,7 @@ HInstrArray* doRegisterAllocation (
                EMIT_INSTR(reload1);
             if (reload2)
                EMIT_INSTR(reload2);
+            n_reloads++;
             /* This rreg is read or modified by the instruction.
                If it's merely read we can claim it now equals the
                spill slot, but not so if it is modified. */
@@ -1647,6 +1597,12 @@ HInstrArray* doRegisterAllocation (
    vassert(rreg_lrs_la_next == rreg_lrs_used);
    vassert(rreg_lrs_db_next == rreg_lrs_used);
 
+   if (vex_stats != NULL) {
+      vex_stats->n_spills          += n_spills;
+      vex_stats->n_reloads         += n_reloads;
+      vex_stats->n_moves_coalesced += n_moves_coalesced;
+   }
+
    return instrs_out;
 
 #  undef INVALID_INSTRNO
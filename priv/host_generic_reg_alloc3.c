@@ -0,0 +1,946 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*---------------------------------------------------------------*/
+/*--- begin                                 host_reg_alloc3.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "libvex_basictypes.h"
+#include "libvex.h"
+
+#include "main_util.h"
+#include "main_stats.h"
+#include "host_generic_regs.h"
+
+/* Set to 1 for lots of debugging output. */
+#define DEBUG_REGALLOC 0
+
+/* Set to 1 to keep a shadow record of which vreg each real register
+   and spill slot holds, and check every use of a vreg against it.
+   Slow; for testing changes to this file. */
+#define CHECK_REGALLOC 0
+
+
+/* A linear-scan register allocator.  It is an alternative to the one
+   in host_generic_reg_alloc2.c, chosen by VexControl.regalloc_version,
+   with the same interface and the same contract with the back ends.
+   Like that one it makes a single pass over the instructions, binding
+   vregs to real registers as they are needed and working around the
+   hard live ranges (HLRs) of real registers that the instructions
+   mention.  It differs in that:
+
+   * A vreg is not tied to one real register between spills.  When it
+     has to give up its register -- to make room for another vreg, or
+     because an HLR of the register begins -- it goes to its spill
+     slot, and at its next use is reloaded into whichever register
+     suits it best then.  So live ranges are split at uses.
+
+   * The vreg evicted is the one whose next use is furthest away.  No
+     spill store is needed if its slot is already up to date, or if
+     its next use overwrites it.  Next uses come from a per-vreg list
+     of the instructions mentioning it, not from scanning ahead.
+
+   * Spill slots are handed out when a vreg is first spilled and
+     taken back when it dies, so vregs which never leave registers
+     never get one, and the same slot serves many short lived vregs.
+
+   * Free registers are kept in a bitmask.  Of the free registers of
+     the right class, the one chosen is that whose next HLR starts
+     soonest after the vreg dies, so that registers without HLRs are
+     left for long lived vregs.
+
+   * isMove drives three kinds of move coalescing:
+        v -> v  the source dies at the move and the destination
+                starts there: the destination takes over the source's
+                register, or if it is spilled, its spill slot.
+        v -> r  the source dies at the move, which starts an HLR of
+                r, and the source is in r already.
+        r -> v  the move ends an HLR of r and starts the destination,
+                and r is free for the destination's whole live range.
+     The second kind also makes r the preferred register for the
+     source, so that it usually is in r already.
+
+   Live ranges and HLRs are computed as in host_generic_reg_alloc2.c,
+   and have the same meanings: a vreg is live from the insn
+   live_after which first writes it to the insn dead_before-1 which
+   last mentions it.
+*/
+
+#define INVALID_RREG_NO   (-1)
+#define INVALID_SLOT_NO   (-1)
+#define INVALID_INSTRNO   (-2)
+#define INFINITE_INSTRNO  0x7FFFFFFF
+
+#define N_SPILL64S  (LibVEX_N_SPILL_BYTES / 8)
+
+
+/* Information about a vreg, computed once, followed by its running
+   state. */
+typedef
+   struct {
+      Int       live_after;
+      Int       dead_before;
+      HRegClass reg_class;
+      /* The insns mentioning it, in order, are use_ii[uses_first ..
+         uses_first+n_uses-1], and use_write[] says which of those
+         only write it.  uses_next is a cursor into them, advanced
+         as allocation proceeds. */
+      Int       uses_first;
+      Int       n_uses;
+      Int       uses_next;
+      /* If it dies by being copied to another vreg which will be
+         coalesced with it, and so on, the dead_before of the last in
+         that chain; otherwise its own. */
+      Int       end_before;
+      /* The rreg that insn hint_ii copies it, or the end of its chain,
+         to as it dies, or INVALID_RREG_NO. */
+      Int       hint;
+      Int       hint_ii;
+      /* The rreg it is in, if any; its spill slot, if it has one; and
+         whether that slot holds its current value. */
+      Int       rreg;
+      Int       slot;
+      Bool      in_slot;
+      /* Next vreg in the list of those dying before the same insn. */
+      Int       next_dying;
+   }
+   VRegState;
+
+/* Information about an allocable rreg.  Its HLRs, in order, are
+   hlr_la/hlr_db[hlrs_first .. hlrs_first+n_hlrs-1].  hlrs_next is
+   the one it is in, or failing that the next one it will be in.
+   vreg is the vreg it holds, if any. */
+typedef
+   struct {
+      Int hlrs_first;
+      Int n_hlrs;
+      Int hlrs_next;
+      Int vreg;
+   }
+   RRegState;
+
+/* An HLR, while they are being collected. */
+typedef
+   struct {
+      Int rreg;
+      Int live_after;
+      Int dead_before;
+   }
+   HLR;
+
+typedef
+   struct {
+      /* As passed to doRegisterAllocation_v3. */
+      const RRegUniverse* univ;
+      void (*genSpill)  ( HInstr**, HInstr**, HReg, Int, Bool );
+      void (*genReload) ( HInstr**, HInstr**, HReg, Int, Bool );
+      void (*ppInstr) ( const HInstr*, Bool );
+      void (*ppReg) ( HReg );
+      Int  guest_sizeB;
+      Bool mode64;
+
+      Int        n_vregs;
+      VRegState* vregs;      /* [0 .. n_vregs-1] */
+      Int        n_rregs;
+      RRegState* rregs;      /* [0 .. n_rregs-1] */
+      Int*       use_ii;
+      UChar*     use_write;
+      Int*       hlr_la;
+      Int*       hlr_db;
+
+      /* The rregs which are free, and those holding a vreg.  Those in
+         neither set are in an HLR. */
+      ULong free;
+      ULong bound;
+      /* The allocable rregs of each class. */
+      ULong class_rregs[HRcVec128+1];
+
+      /* The spill slots in use, one bit per 8-byte slot. */
+      ULong slots_busy[N_SPILL64S / 64];
+
+      HInstrArray* instrs_out;
+
+      /* For the pipeline statistics. */
+      UInt n_spills;
+      UInt n_reloads;
+      UInt n_moves_coalesced;
+
+#     if CHECK_REGALLOC
+      /* The vreg whose value each rreg and spill slot holds, or -1. */
+      Int* rreg_holds;
+      Int  slot_holds[N_SPILL64S];
+#     endif
+   }
+   RAEnv;
+
+
+static void emit ( RAEnv* env, HInstr* instr )
+{
+   if (DEBUG_REGALLOC) {
+      vex_printf("**  ");
+      (*env->ppInstr)(instr, env->mode64);
+      vex_printf("\n");
+   }
+   addHInstr(env->instrs_out, instr);
+}
+
+static void emit2 ( RAEnv* env, HInstr* i1, HInstr* i2 )
+{
+   vassert(i1 || i2); /* can't both be NULL */
+   if (i1)
+      emit(env, i1);
+   if (i2)
+      emit(env, i2);
+}
+
+
+/* The index in use_ii[] of the first use of v at or after insn ii, or
+   -1 if there is none. */
+static inline Int next_use ( RAEnv* env, VRegState* v, Int ii )
+{
+   const Int* uses = &env->use_ii[v->uses_first];
+   while (v->uses_next < v->n_uses && uses[v->uses_next] < ii)
+      v->uses_next++;
+   return v->uses_next < v->n_uses ? v->uses_first + v->uses_next : -1;
+}
+
+/* The insn at which the next HLR of rreg k starts. */
+static inline Int free_until ( const RAEnv* env, Int k )
+{
+   const RRegState* r = &env->rregs[k];
+   return r->hlrs_next < r->n_hlrs ? env->hlr_la[r->hlrs_first + r->hlrs_next]
+                                   : INFINITE_INSTRNO;
+}
+
+
+/* Spill slots.  Flt64 and Vec128 values need a 16-aligned pair of
+   slots, so that aligned loads and stores can be used. */
+
+static inline Bool needs_slot_pair ( HRegClass rc )
+{
+   return rc == HRcVec128 || rc == HRcFlt64;
+}
+
+static Int alloc_slot ( RAEnv* env, HRegClass rc )
+{
+   Bool pair = needs_slot_pair(rc);
+   for (UInt w = 0; w < N_SPILL64S / 64; w++) {
+      ULong avail = ~env->slots_busy[w];
+      if (pair)
+         avail &= (avail >> 1) & 0x5555555555555555ULL;
+      if (avail == 0)
+         continue;
+      UInt b = ULong__minIndex(avail);
+      env->slots_busy[w] |= (pair ? 3ULL : 1ULL) << b;
+      return w * 64 + b;
+   }
+   vpanic("LibVEX_N_SPILL_BYTES is too low.  Increase and recompile.");
+}
+
+static void free_slot ( RAEnv* env, VRegState* v )
+{
+   if (v->slot == INVALID_SLOT_NO)
+      return;
+   ULong bits = needs_slot_pair(v->reg_class) ? 3ULL : 1ULL;
+   env->slots_busy[v->slot / 64] &= ~(bits << (v->slot % 64));
+   v->slot    = INVALID_SLOT_NO;
+   v->in_slot = False;
+}
+
+static inline Int slot_offset ( const RAEnv* env, Int slot )
+{
+   return env->guest_sizeB * 3 + slot * 8;
+}
+
+
+/* Bindings between vregs and rregs. */
+
+static inline void bind ( RAEnv* env, Int m, Int k )
+{
+   vassert(env->free & (1ULL << k));
+   env->free  &= ~(1ULL << k);
+   env->bound |= 1ULL << k;
+   env->rregs[k].vreg = m;
+   env->vregs[m].rreg = k;
+}
+
+/* Take the vreg out of rreg k at insn ii, leaving k neither free nor
+   bound.  If the vreg is still live, and its value is needed and not
+   already in its spill slot, store it there. */
+static void evict ( RAEnv* env, Int k, Int ii )
+{
+   Int        m = env->rregs[k].vreg;
+   VRegState* v = &env->vregs[m];
+   vassert(v->rreg == k);
+
+   Int u = next_use(env, v, ii);
+   if (u >= 0 && !v->in_slot && !env->use_write[u]) {
+      HInstr* spill1 = NULL;
+      HInstr* spill2 = NULL;
+      if (v->slot == INVALID_SLOT_NO)
+         v->slot = alloc_slot(env, v->reg_class);
+      (*env->genSpill)( &spill1, &spill2, env->univ->regs[k],
+                        slot_offset(env, v->slot), env->mode64 );
+      emit2(env, spill1, spill2);
+      env->n_spills++;
+      v->in_slot = True;
+#     if CHECK_REGALLOC
+      vassert(env->rreg_holds[k] == m);
+      env->slot_holds[v->slot] = m;
+#     endif
+   }
+#  if CHECK_REGALLOC
+   if (u >= 0 && !env->use_write[u])
+      vassert(v->in_slot && env->slot_holds[v->slot] == m);
+#  endif
+
+   env->bound &= ~(1ULL << k);
+   env->rregs[k].vreg = INVALID_RREG_NO;
+   v->rreg = INVALID_RREG_NO;
+}
+
+/* Find an rreg for vreg m, which insn ii mentions, evicting another
+   vreg if need be.  The rregs in |busy| hold the other vregs that ii
+   mentions and so are not candidates for eviction.  Leaves the rreg
+   free. */
+static Int find_rreg ( RAEnv* env, Int m, Int ii, ULong busy )
+{
+   VRegState* v     = &env->vregs[m];
+   ULong      cands = env->free & env->class_rregs[v->reg_class];
+
+   if (cands != 0) {
+      if (v->hint != INVALID_RREG_NO && (cands & (1ULL << v->hint))) {
+         Int fu = free_until(env, v->hint);
+         if (fu >= v->end_before
+             || (fu == v->hint_ii && v->end_before == v->hint_ii + 1))
+            return v->hint;
+      }
+      /* Prefer the tightest fit among rregs that are free for the
+         rest of v's live range, and those of the vregs it will be
+         coalesced with, or failing that the one free for longest. */
+      Int  best    = -1;
+      Int  best_fu = 0;
+      Bool fits    = False;
+      while (cands != 0) {
+         Int k  = ULong__minIndex(cands);
+         Int fu = free_until(env, k);
+         cands &= cands - 1;
+         if (fu >= v->end_before) {
+            if (!fits || fu < best_fu) {
+               best = k; best_fu = fu; fits = True;
+            }
+         } else if (!fits && (best == -1 || fu > best_fu)) {
+            best = k; best_fu = fu;
+         }
+      }
+      return best;
+   }
+
+   /* No free rreg of the right class.  Evict the vreg which is next
+      needed furthest in the future, treating one which is next
+      written as not needed at all, and among equals, one which
+      needs no spill store. */
+   cands = env->bound & env->class_rregs[v->reg_class] & ~busy;
+   if (cands == 0) {
+      vex_printf("reg_alloc: can't find a register in class: ");
+      ppHRegClass(v->reg_class);
+      vex_printf("\n");
+      vpanic("reg_alloc: can't create a free register.");
+   }
+   Int  victim       = -1;
+   Int  victim_next  = -1;
+   Bool victim_clean = False;
+   while (cands != 0) {
+      Int        k = ULong__minIndex(cands);
+      VRegState* w = &env->vregs[env->rregs[k].vreg];
+      cands &= cands - 1;
+      Int  u     = next_use(env, w, ii);
+      vassert(u >= 0 && env->use_ii[u] > ii);
+      Int  next  = env->use_write[u] ? INFINITE_INSTRNO : env->use_ii[u];
+      Bool clean = env->use_write[u] || w->in_slot;
+      if (next > victim_next
+          || (next == victim_next && clean && !victim_clean)) {
+         victim = k; victim_next = next; victim_clean = clean;
+      }
+   }
+   evict(env, victim, ii);
+   env->free |= 1ULL << victim;
+   return victim;
+}
+
+
+#if CHECK_REGALLOC
+static void check_state ( RAEnv* env, Int ii )
+{
+   vassert((env->free & env->bound) == 0);
+   for (Int k = 0; k < env->n_rregs; k++) {
+      RRegState* r    = &env->rregs[k];
+      ULong      mask = 1ULL << k;
+      Bool       in_hlr
+         = r->hlrs_next < r->n_hlrs
+           && env->hlr_la[r->hlrs_first + r->hlrs_next] < ii;
+      vassert(in_hlr == (((env->free | env->bound) & mask) == 0));
+      if (env->bound & mask) {
+         vassert(env->vregs[r->vreg].rreg == k);
+         vassert(env->vregs[r->vreg].dead_before >= ii);
+      }
+   }
+   for (Int m = 0; m < env->n_vregs; m++) {
+      VRegState* v = &env->vregs[m];
+      if (v->rreg != INVALID_RREG_NO)
+         vassert(env->rregs[v->rreg].vreg == m);
+   }
+}
+#endif
+
+
+/* A register allocator which, unlike doRegisterAllocation, splits
+   live ranges, coalesces spill slots and coalesces moves.  Arguments
+   are as for doRegisterAllocation. */
+HInstrArray* doRegisterAllocation_v3 (
+   HInstrArray* instrs_in,
+   const RRegUniverse* univ,
+   Bool (*isMove) ( const HInstr*, HReg*, HReg* ),
+   void (*getRegUsage) ( HRegUsage*, const HInstr*, Bool ),
+   void (*mapRegs) ( HRegRemap*, HInstr*, Bool ),
+   void    (*genSpill)  ( HInstr**, HInstr**, HReg, Int, Bool ),
+   void    (*genReload) ( HInstr**, HInstr**, HReg, Int, Bool ),
+   HInstr* (*directReload) ( HInstr*, HReg, Short ),
+   Int     guest_sizeB,
+   void (*ppInstr) ( const HInstr*, Bool ),
+   void (*ppReg) ( HReg ),
+   Bool mode64
+)
+{
+   RAEnv      env_s;
+   RAEnv*     env = &env_s;
+   HRegUsage* reg_usage_arr;
+   HRegRemap  remap;
+
+   const Int n_insns = instrs_in->arr_used;
+
+   vassert(0 == (guest_sizeB % LibVEX_GUEST_STATE_ALIGN));
+   vassert(0 == (LibVEX_N_SPILL_BYTES % LibVEX_GUEST_STATE_ALIGN));
+   vassert(0 == (N_SPILL64S % 64));
+   /* Spill offsets are passed to directReload as Shorts. */
+   vassert(guest_sizeB * 3 + LibVEX_N_SPILL_BYTES <= 32767);
+   vassert(N_RREGUNIVERSE_REGS == 64);
+
+   vex_bzero(env, sizeof(*env));
+   env->univ        = univ;
+   env->genSpill    = genSpill;
+   env->genReload   = genReload;
+   env->ppInstr     = ppInstr;
+   env->ppReg       = ppReg;
+   env->guest_sizeB = guest_sizeB;
+   env->mode64      = mode64;
+   env->n_vregs     = instrs_in->n_vregs;
+   env->n_rregs     = univ->allocable;
+   vassert(env->n_rregs > 0 && env->n_rregs <= N_RREGUNIVERSE_REGS);
+
+   const Int   n_vregs = env->n_vregs;
+   const Int   n_rregs = env->n_rregs;
+   const ULong allocable
+      = n_rregs == 64 ? ~0ULL : (1ULL << n_rregs) - 1;
+
+   env->instrs_out = newHInstrArray();
+
+   env->vregs = LibVEX_Alloc_inline((n_vregs + 1) * sizeof(VRegState));
+   for (Int m = 0; m < n_vregs; m++) {
+      VRegState* v = &env->vregs[m];
+      v->live_after  = INVALID_INSTRNO;
+      v->dead_before = INVALID_INSTRNO;
+      v->reg_class   = HRcINVALID;
+      v->uses_first  = 0;
+      v->n_uses      = 0;
+      v->uses_next   = 0;
+      v->hint        = INVALID_RREG_NO;
+      v->hint_ii     = INVALID_INSTRNO;
+      v->rreg        = INVALID_RREG_NO;
+      v->slot        = INVALID_SLOT_NO;
+      v->in_slot     = False;
+      v->next_dying  = -1;
+   }
+
+   env->rregs = LibVEX_Alloc_inline(n_rregs * sizeof(RRegState));
+   vex_bzero(env->rregs, n_rregs * sizeof(RRegState));
+   for (Int k = 0; k < n_rregs; k++) {
+      HRegClass rc = hregClass(univ->regs[k]);
+      vassert(rc >= HRcInt32 && rc <= HRcVec128);
+      env->class_rregs[rc] |= 1ULL << k;
+      env->rregs[k].vreg = INVALID_RREG_NO;
+   }
+   env->free = allocable;
+
+   /* --------- Stage 1: compute vreg live ranges --------- */
+
+   reg_usage_arr = LibVEX_Alloc_inline((n_insns + 1) * sizeof(HRegUsage));
+   Int n_uses = 0;
+
+   for (Int ii = 0; ii < n_insns; ii++) {
+      HRegUsage* ru = &reg_usage_arr[ii];
+      (*getRegUsage)( ru, instrs_in->arr[ii], mode64 );
+
+      for (Int j = 0; j < ru->n_vRegs; j++) {
+         HReg vreg = ru->vRegs[j];
+         vassert(hregIsVirtual(vreg));
+         Int m = hregIndex(vreg);
+         if (m < 0 || m >= n_vregs) {
+            vex_printf("\n");
+            (*ppInstr)(instrs_in->arr[ii], mode64);
+            vex_printf("\n");
+            vex_printf("vreg %d, n_vregs %d\n", m, n_vregs);
+            vpanic("doRegisterAllocation_v3: out-of-range vreg");
+         }
+         VRegState* v = &env->vregs[m];
+         if (v->reg_class == HRcINVALID)
+            v->reg_class = hregClass(vreg);
+         else
+            vassert(v->reg_class == hregClass(vreg));
+
+         if (v->live_after == INVALID_INSTRNO) {
+            if (ru->vMode[j] != HRmWrite) {
+               vex_printf("\n\nOFFENDING VREG = %d\n", m);
+               vpanic("doRegisterAllocation_v3: "
+                      "first event for vreg is Read or Modify");
+            }
+            v->live_after = ii;
+         }
+         v->dead_before = ii + 1;
+         v->n_uses++;
+         n_uses++;
+      }
+   }
+
+   /* Lay out the use lists, and note which vregs die before each
+      insn. */
+   env->use_ii    = LibVEX_Alloc_inline((n_uses + 1) * sizeof(Int));
+   env->use_write = LibVEX_Alloc_inline(n_uses + 1);
+   Int* dying     = LibVEX_Alloc_inline((n_insns + 1) * sizeof(Int));
+   for (Int ii = 0; ii <= n_insns; ii++)
+      dying[ii] = -1;
+   n_uses = 0;
+   for (Int m = 0; m < n_vregs; m++) {
+      VRegState* v = &env->vregs[m];
+      v->uses_first = n_uses;
+      n_uses += v->n_uses;
+      v->n_uses = 0;
+      if (v->live_after != INVALID_INSTRNO) {
+         v->next_dying      = dying[v->dead_before];
+         dying[v->dead_before] = m;
+      }
+   }
+
+   /* --------- Stage 2: compute rreg HLRs --------- */
+
+   /* Each allocable rreg's HLRs are found in order, but interleaved
+      with those of the others; collect them all and then sort them
+      by rreg.  hlr_start[ii] and hlr_end[ii] are the rregs whose HLRs
+      start at insn ii and end after it. */
+   Int*   rreg_live_after  = LibVEX_Alloc_inline(n_rregs * sizeof(Int));
+   Int*   rreg_dead_before = LibVEX_Alloc_inline(n_rregs * sizeof(Int));
+   ULong* hlr_start = LibVEX_Alloc_inline((n_insns + 1) * sizeof(ULong));
+   ULong* hlr_end   = LibVEX_Alloc_inline((n_insns + 1) * sizeof(ULong));
+   Int    hlrs_size = 16;
+   Int    hlrs_used = 0;
+   HLR*   hlrs      = LibVEX_Alloc_inline(hlrs_size * sizeof(HLR));
+
+   for (Int k = 0; k < n_rregs; k++)
+      rreg_live_after[k] = rreg_dead_before[k] = INVALID_INSTRNO;
+   vex_bzero(hlr_start, (n_insns + 1) * sizeof(ULong));
+   vex_bzero(hlr_end,   (n_insns + 1) * sizeof(ULong));
+
+   for (Int ii = 0; ii <= n_insns; ii++) {
+      ULong rRead, rWritten, rMentioned;
+      if (ii < n_insns) {
+         const HRegUsage* ru = &reg_usage_arr[ii];
+         for (Int j = 0; j < ru->n_vRegs; j++) {
+            VRegState* v = &env->vregs[hregIndex(ru->vRegs[j])];
+            Int        u = v->uses_first + v->n_uses++;
+            env->use_ii[u]    = ii;
+            env->use_write[u] = ru->vMode[j] == HRmWrite;
+         }
+         rRead      = ru->rRead & allocable;
+         rWritten   = ru->rWritten & allocable;
+         rMentioned = rRead | rWritten;
+      } else {
+         /* Flush whatever HLRs are left over. */
+         rRead      = 0;
+         rWritten   = allocable;
+         rMentioned = allocable;
+      }
+
+      while (rMentioned != 0) {
+         Int   k     = ULong__minIndex(rMentioned);
+         ULong kMask = 1ULL << k;
+         rMentioned &= rMentioned - 1;
+
+         if ((rWritten & kMask) && !(rRead & kMask)) {
+            if (rreg_live_after[k] != INVALID_INSTRNO) {
+               if (hlrs_used == hlrs_size) {
+                  HLR* hlrs2 = LibVEX_Alloc_inline(2 * hlrs_size
+                                                   * sizeof(HLR));
+                  vex_memcpy(hlrs2, hlrs, hlrs_used * sizeof(HLR));
+                  hlrs = hlrs2;
+                  hlrs_size *= 2;
+               }
+               hlrs[hlrs_used].rreg        = k;
+               hlrs[hlrs_used].live_after  = rreg_live_after[k];
+               hlrs[hlrs_used].dead_before = rreg_dead_before[k];
+               hlrs_used++;
+               env->rregs[k].n_hlrs++;
+               hlr_start[rreg_live_after[k]]      |= kMask;
+               hlr_end  [rreg_dead_before[k] - 1] |= kMask;
+            }
+            rreg_live_after[k]  = ii;
+            rreg_dead_before[k] = ii + 1;
+         } else {
+            if (rreg_live_after[k] == INVALID_INSTRNO) {
+               vex_printf("\nOFFENDING RREG = ");
+               (*ppReg)(univ->regs[k]);
+               vex_printf("\n");
+               vex_printf("\nOFFENDING instr = ");
+               (*ppInstr)(instrs_in->arr[ii], mode64);
+               vex_printf("\n");
+               vpanic("doRegisterAllocation_v3: "
+                      "first event for rreg is Read or Modify");
+            }
+            rreg_dead_before[k] = ii + 1;
+         }
+      }
+   }
+
+   env->hlr_la = LibVEX_Alloc_inline((hlrs_used + 1) * sizeof(Int));
+   env->hlr_db = LibVEX_Alloc_inline((hlrs_used + 1) * sizeof(Int));
+   {
+      Int n = 0;
+      for (Int k = 0; k < n_rregs; k++) {
+         env->rregs[k].hlrs_first = n;
+         n += env->rregs[k].n_hlrs;
+      }
+      for (Int j = 0; j < hlrs_used; j++) {
+         RRegState* r = &env->rregs[hlrs[j].rreg];
+         Int        h = r->hlrs_first + r->hlrs_next++;
+         env->hlr_la[h] = hlrs[j].live_after;
+         env->hlr_db[h] = hlrs[j].dead_before;
+      }
+      for (Int k = 0; k < n_rregs; k++)
+         env->rregs[k].hlrs_next = 0;
+   }
+
+   /* Now that live ranges are known, find the moves at which a vreg
+      dies by being copied to an allocable rreg, or to a vreg that
+      will take over its register.  Going backwards means that a
+      move's destination has been dealt with before its source. */
+   for (Int m = 0; m < n_vregs; m++)
+      env->vregs[m].end_before = env->vregs[m].dead_before;
+   for (Int ii = n_insns - 1; ii >= 0; ii--) {
+      HReg src, dst;
+      if (reg_usage_arr[ii].n_vRegs == 0
+          || !(*isMove)( instrs_in->arr[ii], &src, &dst )
+          || !hregIsVirtual(src))
+         continue;
+      VRegState* s = &env->vregs[hregIndex(src)];
+      if (s->dead_before != ii + 1)
+         continue;
+      if (!hregIsVirtual(dst)) {
+         if (hregIndex(dst) < n_rregs) {
+            s->hint    = hregIndex(dst);
+            s->hint_ii = ii;
+         }
+      } else {
+         VRegState* d = &env->vregs[hregIndex(dst)];
+         if (d->live_after == ii) {
+            s->end_before = d->end_before;
+            if (s->hint == INVALID_RREG_NO) {
+               s->hint    = d->hint;
+               s->hint_ii = d->hint_ii;
+            }
+         }
+      }
+   }
+
+#  if CHECK_REGALLOC
+   env->rreg_holds = LibVEX_Alloc_inline(n_rregs * sizeof(Int));
+   for (Int k = 0; k < n_rregs; k++)
+      env->rreg_holds[k] = -1;
+   for (Int s = 0; s < N_SPILL64S; s++)
+      env->slot_holds[s] = -1;
+#  endif
+
+   /* --------- Stage 3: process instructions --------- */
+
+   for (Int ii = 0; ii < n_insns; ii++) {
+
+      HRegUsage* ru = &reg_usage_arr[ii];
+
+      if (DEBUG_REGALLOC) {
+         vex_printf("\n====----====---- Insn %d ----====----====\n", ii);
+         vex_printf("---- ");
+         (*ppInstr)(instrs_in->arr[ii], mode64);
+         vex_printf("\n");
+      }
+
+#     if CHECK_REGALLOC
+      check_state(env, ii);
+#     endif
+
+      /* ------ Release vregs which died at the previous insn ------ */
+
+      for (Int m = dying[ii]; m != -1; m = env->vregs[m].next_dying) {
+         VRegState* v = &env->vregs[m];
+         if (v->rreg != INVALID_RREG_NO) {
+            env->bound &= ~(1ULL << v->rreg);
+            env->free  |= 1ULL << v->rreg;
+            env->rregs[v->rreg].vreg = INVALID_RREG_NO;
+            v->rreg = INVALID_RREG_NO;
+         }
+         free_slot(env, v);
+      }
+
+      HReg src = INVALID_HREG;
+      HReg dst = INVALID_HREG;
+      Bool is_move = (*isMove)( instrs_in->arr[ii], &src, &dst );
+
+      /* ------ v -> v move coalescing ------ */
+
+      if (is_move && hregIsVirtual(src) && hregIsVirtual(dst)) {
+         VRegState* s = &env->vregs[hregIndex(src)];
+         VRegState* d = &env->vregs[hregIndex(dst)];
+         vassert(s->reg_class == d->reg_class);
+         if (s->dead_before == ii + 1 && d->live_after == ii) {
+            Int sno = hregIndex(src);
+            Int dno = hregIndex(dst);
+            vassert(d->rreg == INVALID_RREG_NO
+                    && d->slot == INVALID_SLOT_NO);
+            if (s->rreg != INVALID_RREG_NO) {
+               Int k = s->rreg;
+               env->rregs[k].vreg = dno;
+               d->rreg = k;
+               s->rreg = INVALID_RREG_NO;
+#              if CHECK_REGALLOC
+               vassert(env->rreg_holds[k] == sno);
+               env->rreg_holds[k] = dno;
+#              endif
+            } else {
+               vassert(s->in_slot);
+            }
+#           if CHECK_REGALLOC
+            if (s->in_slot) {
+               vassert(env->slot_holds[s->slot] == sno);
+               env->slot_holds[s->slot] = dno;
+            }
+#           endif
+            /* The slot goes too, so that it is not freed when s
+               dies. */
+            d->slot    = s->slot;
+            d->in_slot = s->in_slot;
+            s->slot    = INVALID_SLOT_NO;
+            s->in_slot = False;
+            env->n_moves_coalesced++;
+            if (DEBUG_REGALLOC)
+               vex_printf("COALESCE v%d -> v%d\n", sno, dno);
+            /* A v -> v move mentions no rregs, so there are no HLR
+               boundaries to deal with. */
+            continue;
+         }
+      }
+
+      /* ------ Pre-instruction actions for fixed rreg uses ------ */
+
+      /* rregs starting an HLR here must be vacated. */
+      Bool drop = False;
+      for (ULong starts = hlr_start[ii]; starts != 0; starts &= starts - 1) {
+         Int k = ULong__minIndex(starts);
+         if (env->bound & (1ULL << k)) {
+            Int m = env->rregs[k].vreg;
+            if (is_move && hregIsVirtual(src) && hregIndex(src) == m
+                && !hregIsVirtual(dst) && hregIndex(dst) == k
+                && env->vregs[m].dead_before == ii + 1) {
+               /* v -> r, with v in r already and dying here. */
+#              if CHECK_REGALLOC
+               vassert(env->rreg_holds[k] == m);
+#              endif
+               env->bound &= ~(1ULL << k);
+               env->rregs[k].vreg = INVALID_RREG_NO;
+               env->vregs[m].rreg = INVALID_RREG_NO;
+               env->n_moves_coalesced++;
+               drop = True;
+            } else {
+               evict(env, k, ii);
+            }
+         } else {
+            vassert(env->free & (1ULL << k));
+            env->free &= ~(1ULL << k);
+         }
+#        if CHECK_REGALLOC
+         env->rreg_holds[k] = -1;
+#        endif
+      }
+
+      /* r -> v, ending r's HLR, when r is free for all of v's live
+         range: bind v to r after the HLR ends instead. */
+      Int bind_after = INVALID_RREG_NO;
+      if (is_move && !drop && !hregIsVirtual(src) && hregIsVirtual(dst)
+          && hregIndex(src) < n_rregs
+          && (hlr_end[ii] & (1ULL << hregIndex(src)))) {
+         Int        k = hregIndex(src);
+         RRegState* r = &env->rregs[k];
+         VRegState* d = &env->vregs[hregIndex(dst)];
+         vassert(d->reg_class == hregClass(src));
+         if (d->live_after == ii
+             && (r->hlrs_next + 1 == r->n_hlrs
+                 || env->hlr_la[r->hlrs_first + r->hlrs_next + 1]
+                    >= d->end_before)) {
+            bind_after = k;
+            env->n_moves_coalesced++;
+            drop = True;
+         }
+      }
+
+      if (!drop) {
+
+         /* ------ directReload optimisation ------ */
+
+         /* As in doRegisterAllocation: if the insn reads exactly one
+            vreg, which is spilled and dies here, try to have it read
+            the spill slot directly. */
+         if (directReload && ru->n_vRegs <= 2) {
+            HReg cand   = INVALID_HREG;
+            Int  nreads = 0;
+            for (Int j = 0; j < ru->n_vRegs; j++) {
+               if (ru->vMode[j] != HRmRead)
+                  continue;
+               nreads++;
+               VRegState* v = &env->vregs[hregIndex(ru->vRegs[j])];
+               if (v->rreg == INVALID_RREG_NO && v->dead_before == ii + 1)
+                  cand = ru->vRegs[j];
+            }
+            if (nreads == 1 && !hregIsInvalid(cand)) {
+               VRegState* v = &env->vregs[hregIndex(cand)];
+               vassert(v->in_slot);
+#              if CHECK_REGALLOC
+               vassert(env->slot_holds[v->slot] == hregIndex(cand));
+#              endif
+               HInstr* reloaded
+                  = directReload( instrs_in->arr[ii], cand,
+                                  toShort(slot_offset(env, v->slot)) );
+               if (reloaded) {
+                  instrs_in->arr[ii] = reloaded;
+                  (*getRegUsage)( ru, instrs_in->arr[ii], mode64 );
+               }
+            }
+         }
+
+         /* ------ Deal with the current instruction ------ */
+
+         ULong busy = 0;
+         for (Int j = 0; j < ru->n_vRegs; j++) {
+            Int k = env->vregs[hregIndex(ru->vRegs[j])].rreg;
+            if (k != INVALID_RREG_NO)
+               busy |= 1ULL << k;
+         }
+
+         initHRegRemap(&remap);
+         for (Int j = 0; j < ru->n_vRegs; j++) {
+            HReg       vreg = ru->vRegs[j];
+            Int        m    = hregIndex(vreg);
+            VRegState* v    = &env->vregs[m];
+            Int        k    = v->rreg;
+
+            if (k == INVALID_RREG_NO) {
+               k = find_rreg(env, m, ii, busy);
+               bind(env, m, k);
+               busy |= 1ULL << k;
+               if (ru->vMode[j] != HRmWrite) {
+                  HInstr* reload1 = NULL;
+                  HInstr* reload2 = NULL;
+                  vassert(v->in_slot);
+                  (*genReload)( &reload1, &reload2, univ->regs[k],
+                                slot_offset(env, v->slot), mode64 );
+                  emit2(env, reload1, reload2);
+                  env->n_reloads++;
+#                 if CHECK_REGALLOC
+                  vassert(env->slot_holds[v->slot] == m);
+                  env->rreg_holds[k] = m;
+#                 endif
+               }
+            }
+#           if CHECK_REGALLOC
+            if (ru->vMode[j] != HRmWrite)
+               vassert(env->rreg_holds[k] == m);
+#           endif
+            if (ru->vMode[j] != HRmRead)
+               v->in_slot = False;
+            addToHRegRemap(&remap, vreg, univ->regs[k]);
+         }
+
+         /* NOTE, DESTRUCTIVELY MODIFIES instrs_in->arr[ii]. */
+         (*mapRegs)( &remap, instrs_in->arr[ii], mode64 );
+         emit(env, instrs_in->arr[ii]);
+
+#        if CHECK_REGALLOC
+         for (ULong w = ru->rWritten & allocable; w != 0; w &= w - 1)
+            env->rreg_holds[ULong__minIndex(w)] = -1;
+         for (Int j = 0; j < ru->n_vRegs; j++) {
+            Int m = hregIndex(ru->vRegs[j]);
+            if (ru->vMode[j] != HRmRead)
+               env->rreg_holds[env->vregs[m].rreg] = m;
+         }
+#        endif
+      }
+
+      /* ------ Post-instruction actions for fixed rreg uses ------ */
+
+      for (ULong ends = hlr_end[ii]; ends != 0; ends &= ends - 1) {
+         Int k = ULong__minIndex(ends);
+         vassert(!((env->free | env->bound) & (1ULL << k)));
+         env->free |= 1ULL << k;
+         env->rregs[k].hlrs_next++;
+      }
+
+      if (bind_after != INVALID_RREG_NO) {
+         bind(env, hregIndex(dst), bind_after);
+#        if CHECK_REGALLOC
+         env->rreg_holds[bind_after] = hregIndex(dst);
+#        endif
+      }
+   }
+
+   for (Int k = 0; k < n_rregs; k++)
+      vassert(env->rregs[k].hlrs_next == env->rregs[k].n_hlrs);
+
+   if (vex_stats != NULL) {
+      vex_stats->n_spills          += env->n_spills;
+      vex_stats->n_reloads         += env->n_reloads;
+      vex_stats->n_moves_coalesced += env->n_moves_coalesced;
+   }
+
+   return env->instrs_out;
+}
+
+
+/*---------------------------------------------------------------*/
+/*---                                       host_reg_alloc3.c ---*/
+/*---------------------------------------------------------------*/
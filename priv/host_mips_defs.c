@@ -45,17 +45,17 @@
 const RRegUniverse* getRRegUniverse_MIPS ( Bool mode64 )
 {
    /* The real-register universe is a big constant, so we just want to
-      initialise it once.  rRegUniverse_MIPS_initted values: 0=not initted,
-      1=initted for 32-bit-mode, 2=initted for 64-bit-mode */
-   static RRegUniverse rRegUniverse_MIPS;
-   static UInt         rRegUniverse_MIPS_initted = 0;
+      initialise it once -- once for each mode, so that switching
+      between 32- and 64-bit hosts never rebuilds one in place.
+      LibVEX_Init builds both, so after that they are read-only and
+      may be shared between threads. */
+   static RRegUniverse rRegUniverse_MIPS[2];
+   static Bool         rRegUniverse_MIPS_initted[2] = { False, False };
 
    /* Handy shorthand, nothing more */
-   RRegUniverse* ru = &rRegUniverse_MIPS;
+   RRegUniverse* ru = &rRegUniverse_MIPS[mode64 ? 1 : 0];
 
-   /* This isn't thread-safe.  Sigh. */
-   UInt howNeeded = mode64 ? 2 : 1;
-   if (LIKELY(rRegUniverse_MIPS_initted == howNeeded))
+   if (LIKELY(rRegUniverse_MIPS_initted[mode64 ? 1 : 0]))
       return ru;
 
    RRegUniverse__init(ru);
@@ -119,7 +119,7 @@ const RRegUniverse* getRRegUniverse_MIPS ( Bool mode64 )
    ru->regs[ru->size++] = hregMIPS_GPR29(mode64);
    ru->regs[ru->size++] = hregMIPS_GPR31(mode64);
 
-   rRegUniverse_MIPS_initted = howNeeded;
+   rRegUniverse_MIPS_initted[mode64 ? 1 : 0] = True;
 
    RRegUniverse__check_is_sane(ru);
    return ru;
@@ -50,10 +50,10 @@
    SP          StackFramePointer
    RA          LinkRegister */
 
-static Bool mode64 = False;
+static VEX_TLS Bool mode64 = False;
 
 /* Host CPU has FPU and 32 dbl. prec. FP registers. */
-static Bool fp_mode64 = False;
+static VEX_TLS Bool fp_mode64 = False;
 
 /* GPR register class for mips32/64 */
 #define HRcGPR(_mode64) ((_mode64) ? HRcInt64 : HRcInt32)
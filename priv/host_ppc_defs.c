@@ -47,17 +47,17 @@
 const RRegUniverse* getRRegUniverse_PPC ( Bool mode64 )
 {
    /* The real-register universe is a big constant, so we just want to
-      initialise it once.  rRegUniverse_PPC_initted values: 0=not initted,
-      1=initted for 32-bit-mode, 2=initted for 64-bit-mode */
-   static RRegUniverse rRegUniverse_PPC;
-   static UInt         rRegUniverse_PPC_initted = 0;
+      initialise it once -- once for each mode, so that switching
+      between 32- and 64-bit hosts never rebuilds one in place.
+      LibVEX_Init builds both, so after that they are read-only and
+      may be shared between threads. */
+   static RRegUniverse rRegUniverse_PPC[2];
+   static Bool         rRegUniverse_PPC_initted[2] = { False, False };
 
    /* Handy shorthand, nothing more */
-   RRegUniverse* ru = &rRegUniverse_PPC;
+   RRegUniverse* ru = &rRegUniverse_PPC[mode64 ? 1 : 0];
 
-   /* This isn't thread-safe.  Sigh. */
-   UInt howNeeded = mode64 ? 2 : 1;
-   if (LIKELY(rRegUniverse_PPC_initted == howNeeded))
+   if (LIKELY(rRegUniverse_PPC_initted[mode64 ? 1 : 0]))
       return ru;
 
    RRegUniverse__init(ru);
@@ -139,7 +139,7 @@ const RRegUniverse* getRRegUniverse_PPC ( Bool mode64 )
    ru->regs[ru->size++] = hregPPC_GPR31(mode64);
    ru->regs[ru->size++] = hregPPC_VR29(mode64);
 
-   rRegUniverse_PPC_initted = howNeeded;
+   rRegUniverse_PPC_initted[mode64 ? 1 : 0] = True;
 
    RRegUniverse__check_is_sane(ru);
    return ru;
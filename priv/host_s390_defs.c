@@ -88,7 +88,7 @@ hregNumber(HReg reg)
 const HChar *
 s390_hreg_as_string(HReg reg)
 {
-   static HChar buf[10];
+   static VEX_TLS HChar buf[10];
 
    static const HChar ireg_names[16][5] = {
       "%r0",  "%r1",  "%r2",  "%r3",  "%r4",  "%r5",  "%r6",  "%r7",
@@ -250,7 +250,7 @@ s390_amode_for_guest_state(Int offset)
 const HChar *
 s390_amode_as_string(const s390_amode *am)
 {
-   static HChar buf[30];
+   static VEX_TLS HChar buf[30];
    HChar *p;
 
    buf[0] = '\0';
@@ -6515,7 +6515,7 @@ s390_sprintf(HChar *buf, const HChar *fmt, ...)
 const HChar *
 s390_insn_as_string(const s390_insn *insn)
 {
-   static HChar buf[300];  // large enough
+   static VEX_TLS HChar buf[300];  // large enough
    const HChar *op;
    HChar *p;
 
@@ -10097,9 +10097,9 @@ chainXDirect_S390(VexEndness endness_host,
       (Long)((const UChar *)place_to_jump_to - (const UChar *)place_to_chain) / 2;
    Bool shortOK = delta >= -1000*1000*1000 && delta < 1000*1000*1000;
 
-   static UInt shortCTR = 0; /* DO NOT MAKE NON-STATIC */
+   static VEX_TLS UInt shortCTR = 0; /* DO NOT MAKE NON-STATIC */
    if (shortOK) {
-      shortCTR++; // thread safety bleh
+      shortCTR++;
       if (0 == (shortCTR & 0x3FF)) {
          shortOK = False;
          if (0)
@@ -37,6 +37,7 @@
 #include "libvex.h"                       /* VexArchInfo */
 #include "host_generic_regs.h"            /* HReg */
 #include "s390_defs.h"                    /* s390_cc_t */
+#include "main_util.h"                    /* VEX_TLS */
 
 /* --------- Registers --------- */
 const HChar *s390_hreg_as_string(HReg);
@@ -773,7 +774,7 @@ VexInvalRange patchProfInc_S390(VexEndness endness_host,
                                 const ULong *location_of_counter);
 
 /* KLUDGE: See detailled comment in host_s390_defs.c. */
-extern UInt s390_host_hwcaps;
+extern VEX_TLS UInt s390_host_hwcaps;
 
 /* Convenience macros to test installed facilities */
 #define s390_host_has_ldisp \
@@ -1585,8 +1585,8 @@ s390_isel_int_expr_wrk(ISelEnv *env, IRExpr *expr)
 
       /* --------- UNARY OP --------- */
    case Iex_Unop: {
-      static s390_opnd_RMI mask  = { S390_OPND_IMMEDIATE };
-      static s390_opnd_RMI shift = { S390_OPND_IMMEDIATE };
+      s390_opnd_RMI mask  = { S390_OPND_IMMEDIATE };
+      s390_opnd_RMI shift = { S390_OPND_IMMEDIATE };
       s390_opnd_RMI opnd;
       s390_insn    *insn;
       IRExpr *arg;
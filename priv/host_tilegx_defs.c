@@ -404,6 +404,8 @@ const RRegUniverse* getRRegUniverse_TILEGX ( void )
   /* Get a pointer of the 'universe' */
   RRegUniverse* ru = &rRegUniverse_TILEGX;
 
+  /* LibVEX_Init calls this, so after that it is read-only and may be
+     shared between threads. */
   if (LIKELY(rRegUniverse_TILEGX_initted))
     return ru;
 
@@ -54,7 +54,8 @@ const RRegUniverse* getRRegUniverse_X86 ( void )
    /* Handy shorthand, nothing more */
    RRegUniverse* ru = &rRegUniverse_X86;
 
-   /* This isn't thread-safe.  Sigh. */
+   /* LibVEX_Init calls this, so after that it is read-only and may be
+      shared between threads. */
    if (LIKELY(rRegUniverse_X86_initted))
       return ru;
 
@@ -38,6 +38,7 @@
 #include "libvex.h"
 
 #include "main_util.h"
+#include "main_globals.h"
 
 
 /*---------------------------------------------------------------*/
@@ -1741,41 +1742,137 @@ void ppIRSB ( const IRSB* bb )
 /*---------------------------------------------------------------*/
 
 
+/* Interning of atoms.
+
+   When vex_control.ir_intern_atoms is set, the constructors for
+   integer constants, IRExpr_Const, IRExpr_RdTmp and IRExpr_Get hand
+   back a node they have already built in the current TEMP area, if
+   they can find one with the same contents, rather than allocating a
+   new one.  So with the knob on, these nodes are shared, both within
+   an IRSB and between IRSBs built in the same area, and must never be
+   modified in place.  deepCopyIRConst and deepCopyIRExpr always make
+   fresh nodes, so modifying a deep copy is still fine.
+
+   The tables are just caches: RdTmp nodes indexed by temp, the others
+   direct-mapped on a hash of their contents.  An entry only counts if
+   it was made in the current vex_temp_generation, so nothing needs
+   flushing when the area is cleared or swapped, and nothing is
+   interned in PERM mode. */
+
+#define N_INTERN_TMPS    1024  /* temps at or above this are not interned */
+#define N_INTERN_CONSTS  512   /* must be a power of 2 */
+#define N_INTERN_GETS    256   /* must be a power of 2 */
+
+typedef
+   struct {
+      IRExpr* e;
+      ULong   gen;
+   }
+   InternEnt;
+
+static VEX_TLS InternEnt intern_tmps[N_INTERN_TMPS];
+static VEX_TLS InternEnt intern_consts[N_INTERN_CONSTS];
+static VEX_TLS InternEnt intern_gets[N_INTERN_GETS];
+
+/* The generation to intern in, or 0 if we should not intern. */
+static inline ULong intern_gen ( void )
+{
+   if (LIKELY(!vex_control.ir_intern_atoms))
+      return 0;
+   return vex_temp_generation;
+}
+
+/* The value of an integer constant, and whether it is one. */
+static inline Bool intern_const_value ( const IRConst* c, /*OUT*/ULong* v )
+{
+   switch (c->tag) {
+      case Ico_U1:  *v = c->Ico.U1;  return True;
+      case Ico_U8:  *v = c->Ico.U8;  return True;
+      case Ico_U16: *v = c->Ico.U16; return True;
+      case Ico_U32: *v = c->Ico.U32; return True;
+      case Ico_U64: *v = c->Ico.U64; return True;
+      default:      return False;
+   }
+}
+
+static inline InternEnt* intern_const_slot ( IRConstTag tag, ULong v )
+{
+   ULong h = (v ^ ((ULong)tag << 48)) * 0x9E3779B97F4A7C15ULL;
+   return &intern_consts[(h >> 40) & (N_INTERN_CONSTS-1)];
+}
+
+/* The interned IRExpr_Const for integer constant v of type tag, or
+   NULL if there is none. */
+static IRExpr* find_const ( ULong gen, IRConstTag tag, ULong v )
+{
+   InternEnt* ent = intern_const_slot(tag, v);
+   ULong      v2;
+   if (ent->gen == gen
+       && ent->e->Iex.Const.con->tag == tag
+       && intern_const_value(ent->e->Iex.Const.con, &v2) && v2 == v)
+      return ent->e;
+   return NULL;
+}
+
+/* For the IRConst constructors: an interned constant to return in
+   place of a new one, or NULL. */
+static inline IRConst* find_IRConst ( IRConstTag tag, ULong v )
+{
+   ULong   gen = intern_gen();
+   IRExpr* e;
+   if (LIKELY(gen == 0))
+      return NULL;
+   e = find_const(gen, tag, v);
+   return e ? e->Iex.Const.con : NULL;
+}
+
+
 /* Constructors -- IRConst */
 
 IRConst* IRConst_U1 ( Bool bit )
 {
-   IRConst* c = LibVEX_Alloc_inline(sizeof(IRConst));
-   c->tag     = Ico_U1;
-   c->Ico.U1  = bit;
+   IRConst* c;
    /* call me paranoid; I don't care :-) */
    vassert(bit == False || bit == True);
+   c = find_IRConst(Ico_U1, bit);
+   if (c) return c;
+   c          = LibVEX_Alloc_inline(sizeof(IRConst));
+   c->tag     = Ico_U1;
+   c->Ico.U1  = bit;
    return c;
 }
 IRConst* IRConst_U8 ( UChar u8 )
 {
-   IRConst* c = LibVEX_Alloc_inline(sizeof(IRConst));
+   IRConst* c = find_IRConst(Ico_U8, u8);
+   if (c) return c;
+   c          = LibVEX_Alloc_inline(sizeof(IRConst));
    c->tag     = Ico_U8;
    c->Ico.U8  = u8;
    return c;
 }
 IRConst* IRConst_U16 ( UShort u16 )
 {
-   IRConst* c = LibVEX_Alloc_inline(sizeof(IRConst));
+   IRConst* c = find_IRConst(Ico_U16, u16);
+   if (c) return c;
+   c          = LibVEX_Alloc_inline(sizeof(IRConst));
    c->tag     = Ico_U16;
    c->Ico.U16 = u16;
    return c;
 }
 IRConst* IRConst_U32 ( UInt u32 )
 {
-   IRConst* c = LibVEX_Alloc_inline(sizeof(IRConst));
+   IRConst* c = find_IRConst(Ico_U32, u32);
+   if (c) return c;
+   c          = LibVEX_Alloc_inline(sizeof(IRConst));
    c->tag     = Ico_U32;
    c->Ico.U32 = u32;
    return c;
 }
 IRConst* IRConst_U64 ( ULong u64 )
 {
-   IRConst* c = LibVEX_Alloc_inline(sizeof(IRConst));
+   IRConst* c = find_IRConst(Ico_U64, u64);
+   if (c) return c;
+   c          = LibVEX_Alloc_inline(sizeof(IRConst));
    c->tag     = Ico_U64;
    c->Ico.U64 = u64;
    return c;
@@ -1862,13 +1959,26 @@ IRExpr* IRExpr_Binder ( Int binder ) {
    e->Iex.Binder.binder = binder;
    return e;
 }
-IRExpr* IRExpr_Get ( Int off, IRType ty ) {
+static inline IRExpr* mk_Get ( Int off, IRType ty ) {
    IRExpr* e         = LibVEX_Alloc_inline(sizeof(IRExpr));
    e->tag            = Iex_Get;
    e->Iex.Get.offset = off;
    e->Iex.Get.ty     = ty;
    return e;
 }
+IRExpr* IRExpr_Get ( Int off, IRType ty ) {
+   ULong      gen = intern_gen();
+   InternEnt* ent;
+   if (LIKELY(gen == 0))
+      return mk_Get(off, ty);
+   ent = &intern_gets[((UInt)off * 7 + (UInt)ty) & (N_INTERN_GETS-1)];
+   if (ent->gen != gen || ent->e->Iex.Get.offset != off
+       || ent->e->Iex.Get.ty != ty) {
+      ent->e   = mk_Get(off, ty);
+      ent->gen = gen;
+   }
+   return ent->e;
+}
 IRExpr* IRExpr_GetI ( IRRegArray* descr, IRExpr* ix, Int bias ) {
    IRExpr* e         = LibVEX_Alloc_inline(sizeof(IRExpr));
    e->tag            = Iex_GetI;
@@ -1877,12 +1987,24 @@ IRExpr* IRExpr_GetI ( IRRegArray* descr, IRExpr* ix, Int bias ) {
    e->Iex.GetI.bias  = bias;
    return e;
 }
-IRExpr* IRExpr_RdTmp ( IRTemp tmp ) {
+static inline IRExpr* mk_RdTmp ( IRTemp tmp ) {
    IRExpr* e        = LibVEX_Alloc_inline(sizeof(IRExpr));
    e->tag           = Iex_RdTmp;
    e->Iex.RdTmp.tmp = tmp;
    return e;
 }
+IRExpr* IRExpr_RdTmp ( IRTemp tmp ) {
+   ULong      gen = intern_gen();
+   InternEnt* ent;
+   if (LIKELY(gen == 0) || tmp >= N_INTERN_TMPS)
+      return mk_RdTmp(tmp);
+   ent = &intern_tmps[tmp];
+   if (ent->gen != gen) {
+      ent->e   = mk_RdTmp(tmp);
+      ent->gen = gen;
+   }
+   return ent->e;
+}
 IRExpr* IRExpr_Qop ( IROp op, IRExpr* arg1, IRExpr* arg2, 
                               IRExpr* arg3, IRExpr* arg4 ) {
    IRExpr* e       = LibVEX_Alloc_inline(sizeof(IRExpr));
@@ -1932,12 +2054,26 @@ IRExpr* IRExpr_Load ( IREndness end, IRType ty, IRExpr* addr ) {
    vassert(end == Iend_LE || end == Iend_BE);
    return e;
 }
-IRExpr* IRExpr_Const ( IRConst* con ) {
+static inline IRExpr* mk_Const ( IRConst* con ) {
    IRExpr* e        = LibVEX_Alloc_inline(sizeof(IRExpr));
    e->tag           = Iex_Const;
    e->Iex.Const.con = con;
    return e;
 }
+IRExpr* IRExpr_Const ( IRConst* con ) {
+   ULong      gen = intern_gen();
+   ULong      v;
+   IRExpr*    e;
+   InternEnt* ent;
+   if (LIKELY(gen == 0) || !intern_const_value(con, &v))
+      return mk_Const(con);
+   e = find_const(gen, con->tag, v);
+   if (e) return e;
+   ent      = intern_const_slot(con->tag, v);
+   ent->e   = mk_Const(con);
+   ent->gen = gen;
+   return ent->e;
+}
 IRExpr* IRExpr_CCall ( IRCallee* cee, IRType retty, IRExpr** args ) {
    IRExpr* e          = LibVEX_Alloc_inline(sizeof(IRExpr));
    e->tag             = Iex_CCall;
@@ -2178,9 +2314,9 @@ IRLoadG* mkIRLoadG ( IREndness end, IRLoadGOp cvt,
 
 IRStmt* IRStmt_NoOp ( void )
 {
-   /* Just use a single static closure. */
-   static IRStmt static_closure;
-   static_closure.tag = Ist_NoOp;
+   /* Just use a single static closure.  It is initialised statically
+      so that concurrent translations never write to it. */
+   static IRStmt static_closure = { .tag = Ist_NoOp };
    return &static_closure;
 }
 IRStmt* IRStmt_IMark ( Addr addr, UInt len, UChar delta ) {
@@ -2355,20 +2491,19 @@ IRExpr** deepCopyIRExprVec ( IRExpr *const * vec )
 
 IRConst* deepCopyIRConst ( const IRConst* c )
 {
+   IRConst* c2;
    switch (c->tag) {
-      case Ico_U1:   return IRConst_U1(c->Ico.U1);
-      case Ico_U8:   return IRConst_U8(c->Ico.U8);
-      case Ico_U16:  return IRConst_U16(c->Ico.U16);
-      case Ico_U32:  return IRConst_U32(c->Ico.U32);
-      case Ico_U64:  return IRConst_U64(c->Ico.U64);
-      case Ico_F32:  return IRConst_F32(c->Ico.F32);
-      case Ico_F32i: return IRConst_F32i(c->Ico.F32i);
-      case Ico_F64:  return IRConst_F64(c->Ico.F64);
-      case Ico_F64i: return IRConst_F64i(c->Ico.F64i);
-      case Ico_V128: return IRConst_V128(c->Ico.V128);
-      case Ico_V256: return IRConst_V256(c->Ico.V256);
+      case Ico_U1:   case Ico_U8:   case Ico_U16:  case Ico_U32:
+      case Ico_U64:  case Ico_F32:  case Ico_F32i: case Ico_F64:
+      case Ico_F64i: case Ico_V128: case Ico_V256:
+         break;
       default: vpanic("deepCopyIRConst");
    }
+   /* Not via the constructors, which might hand back a shared
+      constant; see "Interning of atoms". */
+   c2  = LibVEX_Alloc_inline(sizeof(IRConst));
+   *c2 = *c;
+   return c2;
 }
 
 IRCallee* deepCopyIRCallee ( const IRCallee* ce )
@@ -2387,13 +2522,13 @@ IRExpr* deepCopyIRExpr ( const IRExpr* e )
 {
    switch (e->tag) {
       case Iex_Get: 
-         return IRExpr_Get(e->Iex.Get.offset, e->Iex.Get.ty);
+         return mk_Get(e->Iex.Get.offset, e->Iex.Get.ty);
       case Iex_GetI: 
          return IRExpr_GetI(deepCopyIRRegArray(e->Iex.GetI.descr), 
                             deepCopyIRExpr(e->Iex.GetI.ix),
                             e->Iex.GetI.bias);
       case Iex_RdTmp: 
-         return IRExpr_RdTmp(e->Iex.RdTmp.tmp);
+         return mk_RdTmp(e->Iex.RdTmp.tmp);
       case Iex_Qop: {
          const IRQop* qop = e->Iex.Qop.details;
 
@@ -2423,7 +2558,7 @@ IRExpr* deepCopyIRExpr ( const IRExpr* e )
                             e->Iex.Load.ty,
                             deepCopyIRExpr(e->Iex.Load.addr));
       case Iex_Const: 
-         return IRExpr_Const(deepCopyIRConst(e->Iex.Const.con));
+         return mk_Const(deepCopyIRConst(e->Iex.Const.con));
       case Iex_CCall:
          return IRExpr_CCall(deepCopyIRCallee(e->Iex.CCall.cee),
                              e->Iex.CCall.retty,
@@ -2561,8 +2696,11 @@ IRSB* deepCopyIRSB ( const IRSB* bb )
    Int      i;
    IRStmt** sts2;
    IRSB* bb2 = deepCopyIRSBExceptStmts(bb);
-   bb2->stmts_used = bb2->stmts_size = bb->stmts_used;
-   sts2 = LibVEX_Alloc_inline(bb2->stmts_used * sizeof(IRStmt*));
+   bb2->stmts_used = bb->stmts_used;
+   /* No smaller than emptyIRSB makes it, which sanityCheckIRSB
+      insists on and addStmtToIRSB relies on to grow the array. */
+   bb2->stmts_size = bb->stmts_used < 8 ? 8 : bb->stmts_used;
+   sts2 = LibVEX_Alloc_inline(bb2->stmts_size * sizeof(IRStmt*));
    for (i = 0; i < bb2->stmts_used; i++)
       sts2[i] = deepCopyIRStmt(bb->stmts[i]);
    bb2->stmts = sts2;
@@ -2580,15 +2718,166 @@ IRSB* deepCopyIRSBExceptStmts ( const IRSB* bb )
 }
 
 
+/*---------------------------------------------------------------*/
+/*--- Renumbering temps                                       ---*/
+/*---------------------------------------------------------------*/
+
+/* These modify IR in place, so they must not meet the same node
+   twice.  The front end and iropt both share nodes freely, but
+   deepCopyIRSB makes a tree of everything. */
+
+static void renumberIRTemp ( IRTemp* tmp, IRTemp delta )
+{
+   if (*tmp != IRTemp_INVALID)
+      *tmp += delta;
+}
+
+static void renumberIRTemps_Expr ( IRExpr* e, IRTemp delta )
+{
+   Int i;
+   switch (e->tag) {
+      case Iex_GetI:
+         renumberIRTemps_Expr(e->Iex.GetI.ix, delta);
+         break;
+      case Iex_RdTmp:
+         renumberIRTemp(&e->Iex.RdTmp.tmp, delta);
+         break;
+      case Iex_Qop:
+         renumberIRTemps_Expr(e->Iex.Qop.details->arg1, delta);
+         renumberIRTemps_Expr(e->Iex.Qop.details->arg2, delta);
+         renumberIRTemps_Expr(e->Iex.Qop.details->arg3, delta);
+         renumberIRTemps_Expr(e->Iex.Qop.details->arg4, delta);
+         break;
+      case Iex_Triop:
+         renumberIRTemps_Expr(e->Iex.Triop.details->arg1, delta);
+         renumberIRTemps_Expr(e->Iex.Triop.details->arg2, delta);
+         renumberIRTemps_Expr(e->Iex.Triop.details->arg3, delta);
+         break;
+      case Iex_Binop:
+         renumberIRTemps_Expr(e->Iex.Binop.arg1, delta);
+         renumberIRTemps_Expr(e->Iex.Binop.arg2, delta);
+         break;
+      case Iex_Unop:
+         renumberIRTemps_Expr(e->Iex.Unop.arg, delta);
+         break;
+      case Iex_Load:
+         renumberIRTemps_Expr(e->Iex.Load.addr, delta);
+         break;
+      case Iex_CCall:
+         for (i = 0; e->Iex.CCall.args[i]; i++)
+            renumberIRTemps_Expr(e->Iex.CCall.args[i], delta);
+         break;
+      case Iex_ITE:
+         renumberIRTemps_Expr(e->Iex.ITE.cond, delta);
+         renumberIRTemps_Expr(e->Iex.ITE.iftrue, delta);
+         renumberIRTemps_Expr(e->Iex.ITE.iffalse, delta);
+         break;
+      case Iex_Get:
+      case Iex_Const:
+      case Iex_VECRET:
+      case Iex_GSPTR:
+      case Iex_Binder:
+         break;
+      default:
+         vpanic("renumberIRTemps_Expr");
+   }
+}
+
+static void renumberIRTemps_Stmt ( IRStmt* st, IRTemp delta )
+{
+   Int      i;
+   IRDirty* d;
+   IRCAS*   cas;
+   switch (st->tag) {
+      case Ist_NoOp:
+      case Ist_IMark:
+      case Ist_MBE:
+         break;
+      case Ist_AbiHint:
+         renumberIRTemps_Expr(st->Ist.AbiHint.base, delta);
+         renumberIRTemps_Expr(st->Ist.AbiHint.nia, delta);
+         break;
+      case Ist_Put:
+         renumberIRTemps_Expr(st->Ist.Put.data, delta);
+         break;
+      case Ist_PutI:
+         renumberIRTemps_Expr(st->Ist.PutI.details->ix, delta);
+         renumberIRTemps_Expr(st->Ist.PutI.details->data, delta);
+         break;
+      case Ist_WrTmp:
+         renumberIRTemp(&st->Ist.WrTmp.tmp, delta);
+         renumberIRTemps_Expr(st->Ist.WrTmp.data, delta);
+         break;
+      case Ist_Store:
+         renumberIRTemps_Expr(st->Ist.Store.addr, delta);
+         renumberIRTemps_Expr(st->Ist.Store.data, delta);
+         break;
+      case Ist_StoreG:
+         renumberIRTemps_Expr(st->Ist.StoreG.details->addr, delta);
+         renumberIRTemps_Expr(st->Ist.StoreG.details->data, delta);
+         renumberIRTemps_Expr(st->Ist.StoreG.details->guard, delta);
+         break;
+      case Ist_LoadG:
+         renumberIRTemp(&st->Ist.LoadG.details->dst, delta);
+         renumberIRTemps_Expr(st->Ist.LoadG.details->addr, delta);
+         renumberIRTemps_Expr(st->Ist.LoadG.details->alt, delta);
+         renumberIRTemps_Expr(st->Ist.LoadG.details->guard, delta);
+         break;
+      case Ist_CAS:
+         cas = st->Ist.CAS.details;
+         renumberIRTemp(&cas->oldHi, delta);
+         renumberIRTemp(&cas->oldLo, delta);
+         renumberIRTemps_Expr(cas->addr, delta);
+         if (cas->expdHi)
+            renumberIRTemps_Expr(cas->expdHi, delta);
+         renumberIRTemps_Expr(cas->expdLo, delta);
+         if (cas->dataHi)
+            renumberIRTemps_Expr(cas->dataHi, delta);
+         renumberIRTemps_Expr(cas->dataLo, delta);
+         break;
+      case Ist_LLSC:
+         renumberIRTemp(&st->Ist.LLSC.result, delta);
+         renumberIRTemps_Expr(st->Ist.LLSC.addr, delta);
+         if (st->Ist.LLSC.storedata)
+            renumberIRTemps_Expr(st->Ist.LLSC.storedata, delta);
+         break;
+      case Ist_Dirty:
+         d = st->Ist.Dirty.details;
+         renumberIRTemp(&d->tmp, delta);
+         renumberIRTemps_Expr(d->guard, delta);
+         for (i = 0; d->args[i]; i++)
+            renumberIRTemps_Expr(d->args[i], delta);
+         if (d->mAddr)
+            renumberIRTemps_Expr(d->mAddr, delta);
+         break;
+      case Ist_Exit:
+         renumberIRTemps_Expr(st->Ist.Exit.guard, delta);
+         break;
+      default:
+         vpanic("renumberIRTemps_Stmt");
+   }
+}
+
+void renumberIRTemps ( IRSB* bb, IRTemp delta )
+{
+   Int i;
+   for (i = 0; i < bb->stmts_used; i++)
+      renumberIRTemps_Stmt(bb->stmts[i], delta);
+   renumberIRTemps_Expr(bb->next, delta);
+}
+
+
 /*---------------------------------------------------------------*/
 /*--- Primop types                                            ---*/
 /*---------------------------------------------------------------*/
 
-void typeOfPrimop ( IROp op, 
-                    /*OUTs*/
-                    IRType* t_dst, 
-                    IRType* t_arg1, IRType* t_arg2, 
-                    IRType* t_arg3, IRType* t_arg4 )
+/* The types of every primop, as given by the switch below.  Returns
+   False for an op that it doesn't know. */
+static Bool typeOfPrimop_WRK ( IROp op, 
+                               /*OUTs*/
+                               IRType* t_dst, 
+                               IRType* t_arg1, IRType* t_arg2, 
+                               IRType* t_arg3, IRType* t_arg4 )
 {
 #  define UNARY(_ta1,_td)                                      \
       *t_dst = (_td); *t_arg1 = (_ta1); break
@@ -3576,9 +3865,9 @@ void typeOfPrimop ( IROp op,
          BINARY(Ity_V256,Ity_I8, Ity_V256);
 
       default:
-         ppIROp(op);
-         vpanic("typeOfPrimop");
+         return False;
    }
+   return True;
 #  undef UNARY
 #  undef BINARY
 #  undef TERNARY
@@ -3586,6 +3875,84 @@ void typeOfPrimop ( IROp op,
 #  undef UNARY_COMPARISON
 }
 
+/* typeOfPrimop_WRK's answers for every op, made by vexInitPrimopTypes
+   so that typeOfPrimop, and typeOfIRExpr, which the sanity checker and
+   the instruction selectors call for almost every expression, can
+   look them up rather than go through the switch.  The types are held
+   as offsets from Ity_INVALID; a .dst of zero means the switch doesn't
+   know the op. */
+typedef
+   struct {
+      UChar dst, arg1, arg2, arg3, arg4;
+   }
+   PrimopTypes;
+
+STATIC_ASSERT(Ity_V256 - Ity_INVALID < 256);
+
+static PrimopTypes primop_types[Iop_LAST - Iop_INVALID];
+static Bool        primop_types_ready = False;
+
+void vexInitPrimopTypes ( void )
+{
+   IRType t_dst, t_arg1, t_arg2, t_arg3, t_arg4;
+   UInt   i;
+   for (i = 0; i < Iop_LAST - Iop_INVALID; i++) {
+      PrimopTypes* pt = &primop_types[i];
+      if (!typeOfPrimop_WRK(Iop_INVALID + i,
+                            &t_dst, &t_arg1, &t_arg2, &t_arg3, &t_arg4))
+         t_dst = Ity_INVALID;
+      pt->dst  = toUChar(t_dst  - Ity_INVALID);
+      pt->arg1 = toUChar(t_arg1 - Ity_INVALID);
+      pt->arg2 = toUChar(t_arg2 - Ity_INVALID);
+      pt->arg3 = toUChar(t_arg3 - Ity_INVALID);
+      pt->arg4 = toUChar(t_arg4 - Ity_INVALID);
+   }
+   primop_types_ready = True;
+}
+
+/* The entry for |op|, or NULL if there is none yet or the op is
+   unknown. */
+static inline const PrimopTypes* lookupPrimopTypes ( IROp op )
+{
+   UInt i = op - Iop_INVALID;
+   if (LIKELY(primop_types_ready) && LIKELY(i < Iop_LAST - Iop_INVALID)
+       && LIKELY(primop_types[i].dst != 0))
+      return &primop_types[i];
+   return NULL;
+}
+
+void typeOfPrimop ( IROp op, 
+                    /*OUTs*/
+                    IRType* t_dst, 
+                    IRType* t_arg1, IRType* t_arg2, 
+                    IRType* t_arg3, IRType* t_arg4 )
+{
+   const PrimopTypes* pt = lookupPrimopTypes(op);
+   if (LIKELY(pt != NULL)) {
+      *t_dst  = Ity_INVALID + pt->dst;
+      *t_arg1 = Ity_INVALID + pt->arg1;
+      *t_arg2 = Ity_INVALID + pt->arg2;
+      *t_arg3 = Ity_INVALID + pt->arg3;
+      *t_arg4 = Ity_INVALID + pt->arg4;
+      return;
+   }
+   if (!typeOfPrimop_WRK(op, t_dst, t_arg1, t_arg2, t_arg3, t_arg4)) {
+      ppIROp(op);
+      vpanic("typeOfPrimop");
+   }
+}
+
+/* Just the result type of |op|. */
+static inline IRType typeOfPrimopResult ( IROp op )
+{
+   IRType t_dst, t_arg1, t_arg2, t_arg3, t_arg4;
+   const PrimopTypes* pt = lookupPrimopTypes(op);
+   if (LIKELY(pt != NULL))
+      return Ity_INVALID + pt->dst;
+   typeOfPrimop(op, &t_dst, &t_arg1, &t_arg2, &t_arg3, &t_arg4);
+   return t_dst;
+}
+
 
 /*---------------------------------------------------------------*/
 /*--- Helper functions for the IR -- IR Basic Blocks          ---*/
@@ -3687,7 +4054,6 @@ void typeOfIRLoadGOp ( IRLoadGOp cvt,
 
 IRType typeOfIRExpr ( const IRTypeEnv* tyenv, const IRExpr* e )
 {
-   IRType t_dst, t_arg1, t_arg2, t_arg3, t_arg4;
  start:
    switch (e->tag) {
       case Iex_Load:
@@ -3701,21 +4067,13 @@ IRType typeOfIRExpr ( const IRTypeEnv* tyenv, const IRExpr* e )
       case Iex_Const:
          return typeOfIRConst(e->Iex.Const.con);
       case Iex_Qop:
-         typeOfPrimop(e->Iex.Qop.details->op, 
-                      &t_dst, &t_arg1, &t_arg2, &t_arg3, &t_arg4);
-         return t_dst;
+         return typeOfPrimopResult(e->Iex.Qop.details->op);
       case Iex_Triop:
-         typeOfPrimop(e->Iex.Triop.details->op,
-                      &t_dst, &t_arg1, &t_arg2, &t_arg3, &t_arg4);
-         return t_dst;
+         return typeOfPrimopResult(e->Iex.Triop.details->op);
       case Iex_Binop:
-         typeOfPrimop(e->Iex.Binop.op, 
-                      &t_dst, &t_arg1, &t_arg2, &t_arg3, &t_arg4);
-         return t_dst;
+         return typeOfPrimopResult(e->Iex.Binop.op);
       case Iex_Unop:
-         typeOfPrimop(e->Iex.Unop.op, 
-                      &t_dst, &t_arg1, &t_arg2, &t_arg3, &t_arg4);
-         return t_dst;
+         return typeOfPrimopResult(e->Iex.Unop.op);
       case Iex_CCall:
          return e->Iex.CCall.retty;
       case Iex_ITE:
@@ -4848,6 +5206,8 @@ Bool eqIRAtom ( const IRExpr* a1, const IRExpr* a2 )
 {
    vassert(isIRAtom(a1));
    vassert(isIRAtom(a2));
+   if (a1 == a2)
+      return True;
    if (a1->tag == Iex_RdTmp && a2->tag == Iex_RdTmp)
       return toBool(a1->Iex.RdTmp.tmp == a2->Iex.RdTmp.tmp);
    if (a1->tag == Iex_Const && a2->tag == Iex_Const)
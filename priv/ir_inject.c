@@ -48,7 +48,7 @@
 
 /* The IR Injection Control Block. vex_inject_ir will query its contents
    to construct IR statements for testing purposes. */
-static IRICB iricb;
+static VEX_TLS IRICB iricb;
 
 
 void
@@ -40,13 +40,15 @@
 
 #include "main_util.h"
 #include "main_globals.h"
+#include "main_stats.h"
 #include "ir_opt.h"
 
 
 /* Set to 1 for lots of debugging output. */
 #define DEBUG_IROPT 0
 
-/* Set to 1 to gather some statistics. Currently only for sameIRExprs. */
+/* Set to 1 to gather some statistics.  Currently only for sameIRExprs
+   and do_cse_BB. */
 #define STATS_IROPT 0
 
 
@@ -99,7 +101,8 @@
    ~~~~~~~~~~~~~~~~~~~~
 
    There are three levels of optimisation, controlled by
-   vex_control.iropt_level.  Define first:
+   vex_control.iropt_level (or by the lift_mode a caller passes to
+   LibVEX_Lift).  Define first:
 
    "Cheap transformations" are the following sequence:
       * Redundant-Get removal
@@ -172,13 +175,31 @@
 /*--- Finite mappery, of a sort                               ---*/
 /*---------------------------------------------------------------*/
 
-/* General map from HWord-sized thing HWord-sized thing.  Could be by
-   hashing, but it's not clear whether or not this would really be any
-   faster. */
+/* General map from HWord-sized thing HWord-sized thing.  This is an
+   open-addressing hash table with linear probing, allocated in the
+   arena.  |size| is always a power of 2 and the table is kept at most
+   half full, so probe sequences stay short.
+
+   Each slot records the hash its key was placed by, so growing and
+   deleting never rehash a key.  lookupHHW and addToHHW hash the key
+   itself and compare keys as plain words.  A client whose keys are
+   pointers to structures to be compared by value (CSE's AvailExprs)
+   instead hashes them itself and goes through findSlotHHW and
+   addSlotHHW, passing its own equality function.
+
+   clearHHW drops every binding at once; that is all the GET/PUT
+   removal passes and most of CSE's invalidations need.  The one place
+   which drops bindings selectively is do_cse_BB's menv invalidation
+   at a Put or PutI, which removes just the GetIt bindings the write
+   overlaps.  It does so with removeSlotHHW, which uses backward-shift
+   deletion rather than tombstones, so lookups never have to step over
+   dead entries, and it re-examines the current slot whenever
+   removeSlotHHW says it has been refilled. */
 
 typedef
    struct {
       Bool*  inuse;
+      UInt*  hash;
       HWord* key;
       HWord* val;
       Int    size;
@@ -189,29 +210,105 @@ typedef
 static HashHW* newHHW ( void )
 {
    HashHW* h = LibVEX_Alloc_inline(sizeof(HashHW));
-   h->size   = 8;
+   h->size   = 16;
    h->used   = 0;
    h->inuse  = LibVEX_Alloc_inline(h->size * sizeof(Bool));
+   h->hash   = LibVEX_Alloc_inline(h->size * sizeof(UInt));
    h->key    = LibVEX_Alloc_inline(h->size * sizeof(HWord));
    h->val    = LibVEX_Alloc_inline(h->size * sizeof(HWord));
+   vex_bzero(h->inuse, h->size * sizeof(Bool));
    return h;
 }
 
 
+/* The hash of a plain key.  Keys are often small integers or aligned
+   pointers, so mix them (Fibonacci hashing); the table uses the low
+   bits as the home slot. */
+
+static inline UInt hashHHW ( HWord key )
+{
+   ULong k = 0x9E3779B97F4A7C15ULL * (ULong)key;
+   return (UInt)(k >> 32);
+}
+
+
+/* Look up key, whose hash is hash.  Returns the slot holding it, or
+   the (free) slot where it would go.  Keys are compared with eq, or
+   as plain words if eq is NULL. */
+
+static inline Int findSlotHHW ( const HashHW* h, HWord key, UInt hash,
+                                Bool (*eq)(HWord, HWord) )
+{
+   Int mask = h->size - 1;
+   Int i;
+   for (i = hash & mask; h->inuse[i]; i = (i + 1) & mask) {
+      if (h->hash[i] == hash
+          && (eq ? eq(key, h->key[i]) : h->key[i] == key))
+         break;
+   }
+   return i;
+}
+
+
+/* Bind key, whose hash is hash, to val.  key must not already be
+   bound, and slot must be what findSlotHHW returned for it. */
+
+static void addSlotHHW ( HashHW* h, Int slot, HWord key, UInt hash,
+                         HWord val )
+{
+   Int i, j;
+   vassert(!h->inuse[slot]);
+
+   /* Ensure the table stays at most half full. */
+   if (2 * (h->used + 1) > h->size) {
+      /* Rehash into arrays twice the size. */
+      Bool*  inuse1 = h->inuse;
+      UInt*  hash1  = h->hash;
+      HWord* key1   = h->key;
+      HWord* val1   = h->val;
+      Int    size1  = h->size;
+      h->size *= 2;
+      h->inuse = LibVEX_Alloc_inline(h->size * sizeof(Bool));
+      h->hash  = LibVEX_Alloc_inline(h->size * sizeof(UInt));
+      h->key   = LibVEX_Alloc_inline(h->size * sizeof(HWord));
+      h->val   = LibVEX_Alloc_inline(h->size * sizeof(HWord));
+      vex_bzero(h->inuse, h->size * sizeof(Bool));
+      for (j = 0; j < size1; j++) {
+         if (!inuse1[j]) continue;
+         for (i = hash1[j] & (h->size - 1); h->inuse[i];
+              i = (i + 1) & (h->size - 1))
+            ;
+         h->inuse[i] = True;
+         h->hash[i]  = hash1[j];
+         h->key[i]   = key1[j];
+         h->val[i]   = val1[j];
+      }
+      /* Find the free slot for key in the new arrays. */
+      for (slot = hash & (h->size - 1); h->inuse[slot];
+           slot = (slot + 1) & (h->size - 1))
+         ;
+   }
+
+   h->inuse[slot] = True;
+   h->hash[slot]  = hash;
+   h->key[slot]   = key;
+   h->val[slot]   = val;
+   h->used++;
+}
+
+
 /* Look up key in the map. */
 
 static Bool lookupHHW ( HashHW* h, /*OUT*/HWord* val, HWord key )
 {
    Int i;
    /* vex_printf("lookupHHW(%llx)\n", key ); */
-   for (i = 0; i < h->used; i++) {
-      if (h->inuse[i] && h->key[i] == key) {
-         if (val)
-            *val = h->val[i];
-         return True;
-      }
-   }
-   return False;
+   i = findSlotHHW(h, key, hashHHW(key), NULL);
+   if (!h->inuse[i])
+      return False;
+   if (val)
+      *val = h->val[i];
+   return True;
 }
 
 
@@ -219,43 +316,55 @@ static Bool lookupHHW ( HashHW* h, /*OUT*/HWord* val, HWord key )
 
 static void addToHHW ( HashHW* h, HWord key, HWord val )
 {
-   Int i, j;
+   UInt hash = hashHHW(key);
+   Int  i;
    /* vex_printf("addToHHW(%llx, %llx)\n", key, val); */
+   i = findSlotHHW(h, key, hash, NULL);
+   if (h->inuse[i])
+      h->val[i] = val;
+   else
+      addSlotHHW(h, i, key, hash, val);
+}
 
-   /* Find and replace existing binding, if any. */
-   for (i = 0; i < h->used; i++) {
-      if (h->inuse[i] && h->key[i] == key) {
-         h->val[i] = val;
-         return;
-      }
-   }
 
-   /* Ensure a space is available. */
-   if (h->used == h->size) {
-      /* Copy into arrays twice the size. */
-      Bool*  inuse2 = LibVEX_Alloc_inline(2 * h->size * sizeof(Bool));
-      HWord* key2   = LibVEX_Alloc_inline(2 * h->size * sizeof(HWord));
-      HWord* val2   = LibVEX_Alloc_inline(2 * h->size * sizeof(HWord));
-      for (i = j = 0; i < h->size; i++) {
-         if (!h->inuse[i]) continue;
-         inuse2[j] = True;
-         key2[j] = h->key[i];
-         val2[j] = h->val[i];
-         j++;
+/* Remove the binding in slot j, which must be in use, by shifting
+   later members of its probe run back into the gap.  Returns True if
+   slot j now holds a different binding, in which case a caller
+   walking the table must look at slot j again.  A binding may also be
+   moved from the start of the table to its end, so such a caller can
+   see it twice; that is harmless for the filters used here. */
+
+static Bool removeSlotHHW ( HashHW* h, Int j )
+{
+   Int  mask = h->size - 1;
+   Int  hole = j;
+   Int  i, home;
+   vassert(j >= 0 && j < h->size && h->inuse[j]);
+   for (i = (j + 1) & mask; h->inuse[i]; i = (i + 1) & mask) {
+      home = h->hash[i] & mask;
+      /* The binding at i can fill the hole only if its home slot is
+         not cyclically within (hole .. i]. */
+      if (((i - home) & mask) >= ((i - hole) & mask)) {
+         h->hash[hole] = h->hash[i];
+         h->key[hole]  = h->key[i];
+         h->val[hole]  = h->val[i];
+         hole = i;
       }
-      h->used = j;
-      h->size *= 2;
-      h->inuse = inuse2;
-      h->key = key2;
-      h->val = val2;
    }
+   h->inuse[hole] = False;
+   h->used--;
+   return toBool(hole != j);
+}
 
-   /* Finally, add it. */
-   vassert(h->used < h->size);
-   h->inuse[h->used] = True;
-   h->key[h->used] = key;
-   h->val[h->used] = val;
-   h->used++;
+
+/* Remove all bindings. */
+
+static void clearHHW ( HashHW* h )
+{
+   if (h->used == 0)
+      return;
+   vex_bzero(h->inuse, h->size * sizeof(Bool));
+   h->used = 0;
 }
 
 
@@ -583,43 +692,124 @@ static UInt mk_key_GetIPutI ( IRRegArray* descr )
    return (minoff << 16) | maxoff;
 }
 
-/* Supposing h has keys of the form generated by mk_key_GetPut and
-   mk_key_GetIPutI, invalidate any key which overlaps (k_lo
-   .. k_hi). 
-*/
-static void invalidateOverlaps ( HashHW* h, UInt k_lo, UInt k_hi )
+/* Both passes keep bindings keyed as above, and must forget every
+   binding overlapping a range of the guest state whenever that range
+   is written (for GET removal) or read (for PUT removal).  Rather than
+   search the bindings for overlaps each time, they number the
+   statements they look at and keep, in a GSMap, the number of the
+   last statement to write (read) each byte of the guest state.  A
+   binding remembers the number of the statement that made it, and is
+   dead if any of its bytes has been touched since.  So invalidating a
+   range and checking a binding both cost time proportional to the
+   size of the range, however many bindings there are.  Statements
+   which invalidate everything just clearHHW the bindings. */
+
+typedef
+   struct {
+      UInt* stamp;    /* per byte, the last statement to touch it */
+      UInt  szB;      /* number of bytes covered */
+      UInt  flushed;  /* bindings for ranges needing precise exns
+                         made before this are dead */
+   }
+   GSMap;
+
+/* One past the highest guest state offset mentioned in bb, which must
+   be flat. */
+static UInt guestExtent ( IRSB* bb )
 {
-   Int  j;
-   UInt e_lo, e_hi;
-   vassert(k_lo <= k_hi);
-   /* invalidate any env entries which in any way overlap (k_lo
-      .. k_hi) */
-   /* vex_printf("invalidate %d .. %d\n", k_lo, k_hi ); */
-
-   for (j = 0; j < h->used; j++) {
-      if (!h->inuse[j]) 
-         continue;
-      e_lo = (((UInt)h->key[j]) >> 16) & 0xFFFF;
-      e_hi = ((UInt)h->key[j]) & 0xFFFF;
-      vassert(e_lo <= e_hi);
-      if (e_hi < k_lo || k_hi < e_lo)
-         continue; /* no overlap possible */
-      else
-         /* overlap; invalidate */
-         h->inuse[j] = False;
+   Int     i;
+   UInt    key, szB;
+   IRStmt* st;
+
+   key = mk_key_GetPut(bb->offsIP, typeOfIRExpr(bb->tyenv, bb->next));
+   szB = (key & 0xFFFF) + 1;
+   for (i = 0; i < bb->stmts_used; i++) {
+      st = bb->stmts[i];
+      switch (st->tag) {
+         case Ist_WrTmp:
+            if (st->Ist.WrTmp.data->tag == Iex_Get)
+               key = mk_key_GetPut(st->Ist.WrTmp.data->Iex.Get.offset,
+                                   st->Ist.WrTmp.data->Iex.Get.ty);
+            else if (st->Ist.WrTmp.data->tag == Iex_GetI)
+               key = mk_key_GetIPutI(st->Ist.WrTmp.data->Iex.GetI.descr);
+            else
+               continue;
+            break;
+         case Ist_Put:
+            key = mk_key_GetPut(st->Ist.Put.offset,
+                                typeOfIRExpr(bb->tyenv, st->Ist.Put.data));
+            break;
+         case Ist_PutI:
+            key = mk_key_GetIPutI(st->Ist.PutI.details->descr);
+            break;
+         default:
+            continue;
+      }
+      if ((key & 0xFFFF) + 1 > szB)
+         szB = (key & 0xFFFF) + 1;
    }
+   return szB;
+}
+
+static GSMap* newGSMap ( UInt szB )
+{
+   GSMap* m   = LibVEX_Alloc_inline(sizeof(GSMap));
+   m->stamp   = LibVEX_Alloc_inline(szB * sizeof(UInt));
+   m->szB     = szB;
+   m->flushed = 0;
+   vex_bzero(m->stamp, szB * sizeof(UInt));
+   return m;
+}
+
+/* Statement n touches the range denoted by key. */
+static inline void touchGSMap ( GSMap* m, UInt key, UInt n )
+{
+   UInt lo = (key >> 16) & 0xFFFF;
+   UInt hi = key & 0xFFFF;
+   vassert(lo <= hi && hi < m->szB);
+   for (; lo <= hi; lo++)
+      m->stamp[lo] = n;
+}
+
+/* Is a binding for the range denoted by key, made by statement made,
+   still alive?  precise says whether the range needs precise memory
+   exceptions. */
+static inline Bool liveInGSMap ( const GSMap* m, UInt key, UInt made,
+                                 Bool precise )
+{
+   UInt lo = (key >> 16) & 0xFFFF;
+   UInt hi = key & 0xFFFF;
+   vassert(lo <= hi && hi < m->szB);
+   if (precise && made < m->flushed)
+      return False;
+   for (; lo <= hi; lo++)
+      if (m->stamp[lo] > made)
+         return False;
+   return True;
 }
 
 
+/* A binding made by redundant_get_removal_BB. */
+typedef
+   struct {
+      IRExpr* val;
+      UInt    made;
+   }
+   GetBinding;
+
 static void redundant_get_removal_BB ( IRSB* bb )
 {
-   HashHW* env = newHHW();
-   UInt    key = 0; /* keep gcc -O happy */
-   Int     i, j;
-   HWord   val;
+   HashHW*     env = newHHW();
+   GSMap*      map = newGSMap(guestExtent(bb));
+   UInt        key = 0; /* keep gcc -O happy */
+   UInt        n;
+   Int         i, j;
+   HWord       val;
+   GetBinding* b;
 
    for (i = 0; i < bb->stmts_used; i++) {
       IRStmt* st = bb->stmts[i];
+      n = i + 1;
 
       if (st->tag == Ist_NoOp)
          continue;
@@ -632,14 +822,15 @@ static void redundant_get_removal_BB ( IRSB* bb )
          IRExpr* get = st->Ist.WrTmp.data;
          key = (HWord)mk_key_GetPut( get->Iex.Get.offset, 
                                      get->Iex.Get.ty );
-         if (lookupHHW(env, &val, (HWord)key)) {
+         b = lookupHHW(env, &val, (HWord)key) ? (GetBinding*)val : NULL;
+         if (b && liveInGSMap(map, key, b->made, False)) {
             /* found it */
             /* Note, we could do better here.  If the types are
                different we don't do the substitution, since doing so
                could lead to invalidly-typed IR.  An improvement would
                be to stick in a reinterpret-style cast, although that
                would make maintaining flatness more difficult. */
-            IRExpr* valE    = (IRExpr*)val;
+            IRExpr* valE    = b->val;
             Bool    typesOK = toBool( typeOfIRExpr(bb->tyenv,valE) 
                                       == st->Ist.WrTmp.data->Iex.Get.ty );
             if (typesOK && DEBUG_IROPT) {
@@ -653,15 +844,18 @@ static void redundant_get_removal_BB ( IRSB* bb )
             /* Not found, but at least we know that t and the Get(...)
                are now associated.  So add a binding to reflect that
                fact. */
-            addToHHW( env, (HWord)key, 
-                           (HWord)(void*)(IRExpr_RdTmp(st->Ist.WrTmp.tmp)) );
+            if (!b) {
+               b = LibVEX_Alloc_inline(sizeof(GetBinding));
+               addToHHW( env, (HWord)key, (HWord)b );
+            }
+            b->val  = IRExpr_RdTmp(st->Ist.WrTmp.tmp);
+            b->made = n;
          }
       }
 
       /* Deal with Puts: invalidate any env entries overlapped by this
          Put */
       if (st->tag == Ist_Put || st->tag == Ist_PutI) {
-         UInt k_lo, k_hi;
          if (st->tag == Ist_Put) {
             key = mk_key_GetPut( st->Ist.Put.offset, 
                                  typeOfIRExpr(bb->tyenv,st->Ist.Put.data) );
@@ -669,10 +863,7 @@ static void redundant_get_removal_BB ( IRSB* bb )
             vassert(st->tag == Ist_PutI);
             key = mk_key_GetIPutI( st->Ist.PutI.details->descr );
          }
-
-         k_lo = (key >> 16) & 0xFFFF;
-         k_hi = key & 0xFFFF;
-         invalidateOverlaps(env, k_lo, k_hi);
+         touchGSMap(map, key, n);
       }
       else
       if (st->tag == Ist_Dirty) {
@@ -688,8 +879,7 @@ static void redundant_get_removal_BB ( IRSB* bb )
          }
          if (writes) {
             /* dump the entire env (not clever, but correct ...) */
-            for (j = 0; j < env->used; j++)
-               env->inuse[j] = False;
+            clearHHW(env);
             if (0) vex_printf("rGET: trash env due to dirty helper\n");
          }
       }
@@ -697,7 +887,14 @@ static void redundant_get_removal_BB ( IRSB* bb )
       /* add this one to the env, if appropriate */
       if (st->tag == Ist_Put) {
          vassert(isIRAtom(st->Ist.Put.data));
-         addToHHW( env, (HWord)key, (HWord)(st->Ist.Put.data));
+         if (lookupHHW(env, &val, (HWord)key)) {
+            b = (GetBinding*)val;
+         } else {
+            b = LibVEX_Alloc_inline(sizeof(GetBinding));
+            addToHHW( env, (HWord)key, (HWord)b );
+         }
+         b->val  = st->Ist.Put.data;
+         b->made = n;
       }
 
    } /* for (i = 0; i < bb->stmts_used; i++) */
@@ -709,18 +906,19 @@ static void redundant_get_removal_BB ( IRSB* bb )
 /*--- In-place removal of redundant PUTs                      ---*/
 /*---------------------------------------------------------------*/
 
-/* Find any Get uses in st and invalidate any partially or fully
-   overlapping ranges listed in env.  Due to the flattening phase, the
-   only stmt kind we expect to find a Get on is IRStmt_WrTmp. */
+/* Find any Get uses in st, which is statement n, and invalidate any
+   partially or fully overlapping ranges bound in env, by way of map.
+   Due to the flattening phase, the only stmt kind we expect to find a
+   Get on is IRStmt_WrTmp. */
 
 static void handle_gets_Stmt ( 
-               HashHW* env, 
+               HashHW* env,
+               GSMap*  map,
                IRStmt* st,
-               Bool (*preciseMemExnsFn)(Int,Int,VexRegisterUpdates),
+               UInt    n,
                VexRegisterUpdates pxControl
             )
 {
-   Int     j;
    UInt    key = 0; /* keep gcc -O happy */
    Bool    isGet;
    Bool    memRW = False;
@@ -748,12 +946,8 @@ static void handle_gets_Stmt (
             default: 
                isGet = False;
          }
-         if (isGet) {
-            UInt k_lo, k_hi;
-            k_lo = (key >> 16) & 0xFFFF;
-            k_hi = key & 0xFFFF;
-            invalidateOverlaps(env, k_lo, k_hi);
-         }
+         if (isGet)
+            touchGSMap(map, key, n);
          break;
 
       /* Be very conservative for dirty helper calls; dump the entire
@@ -774,8 +968,7 @@ static void handle_gets_Stmt (
       case Ist_Dirty:
       case Ist_CAS:
       case Ist_LLSC:
-         for (j = 0; j < env->used; j++)
-            env->inuse[j] = False;
+         clearHHW(env);
          break;
 
       /* all other cases are boring. */
@@ -833,8 +1026,7 @@ static void handle_gets_Stmt (
          case VexRegUpdAllregsAtMemAccess:
             /* Precise exceptions required at mem access.
                Flush all guest state. */
-            for (j = 0; j < env->used; j++)
-               env->inuse[j] = False;
+            clearHHW(env);
             break;
          case VexRegUpdSpAtMemAccess:
             /* We need to dump the stack pointer
@@ -843,16 +1035,9 @@ static void handle_gets_Stmt (
                to verify only the sp is to be checked. */
             /* fallthrough */
          case VexRegUpdUnwindregsAtMemAccess:
-            for (j = 0; j < env->used; j++) {
-               if (!env->inuse[j])
-                  continue;
-               /* Just flush the minimal amount required, as computed by
-                  preciseMemExnsFn. */
-               HWord k_lo = (env->key[j] >> 16) & 0xFFFF;
-               HWord k_hi = env->key[j] & 0xFFFF;
-               if (preciseMemExnsFn( k_lo, k_hi, pxControl ))
-                  env->inuse[j] = False;
-            }
+            /* Just flush the minimal amount required, as computed by
+               preciseMemExnsFn when each binding was made. */
+            map->flushed = n;
             break;
          case VexRegUpdAllregsAtEachInsn:
             // VexRegUpdAllregsAtEachInsn cannot happen here.
@@ -880,32 +1065,52 @@ static void handle_gets_Stmt (
    overlapping (minoff,maxoff).  The same has to happen for any events
    which implicitly read parts of the guest state: dirty helper calls
    and loads/stores.
+
+   Each member of the set is bound to the number of the statement
+   that added it, times two, plus one if preciseMemExnsFn says its
+   range needs precise memory exceptions.  Statements are numbered
+   from 2 upwards in the order they are scanned; 1 is for the final
+   exit.
 */
 
+static HWord put_binding ( UInt key, UInt n,
+                          Bool (*preciseMemExnsFn)(Int,Int,VexRegisterUpdates),
+                          VexRegisterUpdates pxControl )
+{
+   Bool precise = preciseMemExnsFn( (key >> 16) & 0xFFFF, key & 0xFFFF,
+                                    pxControl );
+   return ((HWord)n << 1) | (precise ? 1 : 0);
+}
+
 static void redundant_put_removal_BB ( 
                IRSB* bb,
                Bool (*preciseMemExnsFn)(Int,Int,VexRegisterUpdates),
                VexRegisterUpdates pxControl
             )
 {
-   Int     i, j;
+   Int     i;
    Bool    isPut;
    IRStmt* st;
    UInt    key = 0; /* keep gcc -O happy */
+   UInt    n;
+   HWord   val;
 
    vassert(pxControl < VexRegUpdAllregsAtEachInsn);
 
    HashHW* env = newHHW();
+   GSMap*  map = newGSMap(guestExtent(bb));
 
    /* Initialise the running env with the fact that the final exit
       writes the IP (or, whatever it claims to write.  We don't
       care.) */
    key = mk_key_GetPut(bb->offsIP, typeOfIRExpr(bb->tyenv, bb->next));
-   addToHHW(env, (HWord)key, 0);
+   addToHHW(env, (HWord)key, put_binding(key, 1, preciseMemExnsFn,
+                                         pxControl));
 
    /* And now scan backwards through the statements. */
    for (i = bb->stmts_used-1; i >= 0; i--) {
       st = bb->stmts[i];
+      n  = bb->stmts_used - i + 1;
 
       if (st->tag == Ist_NoOp)
          continue;
@@ -933,8 +1138,7 @@ static void redundant_put_removal_BB (
          //                    typeOfIRConst(st->Ist.Exit.dst));
          //re_add = lookupHHW(env, NULL, key);
          /* (2) */
-         for (j = 0; j < env->used; j++)
-            env->inuse[j] = False;
+         clearHHW(env);
          /* (3) */
          //if (0 && re_add) 
          //   addToHHW(env, (HWord)key, 0);
@@ -964,7 +1168,8 @@ static void redundant_put_removal_BB (
             or more entries in the env overlap this Put, but the use of
             lookupHHW will only find a single entry which exactly
             overlaps this Put.  This is suboptimal but safe. */
-         if (lookupHHW(env, NULL, (HWord)key)) {
+         if (lookupHHW(env, &val, (HWord)key)
+             && liveInGSMap(map, key, (UInt)(val >> 1), toBool(val & 1))) {
             /* This Put is redundant because a later one will overwrite
                it.  So NULL (nop) it out. */
             if (DEBUG_IROPT) {
@@ -975,7 +1180,8 @@ static void redundant_put_removal_BB (
          } else {
             /* We can't demonstrate that this Put is redundant, so add it
                to the running collection. */
-            addToHHW(env, (HWord)key, 0);
+            addToHHW(env, (HWord)key, put_binding(key, n, preciseMemExnsFn,
+                                                  pxControl));
          }
          continue;
       }
@@ -985,7 +1191,7 @@ static void redundant_put_removal_BB (
          of the guest state is no longer a write, but a read.  Also
          deals with implicit reads of guest state needed to maintain
          precise exceptions. */
-      handle_gets_Stmt( env, st, preciseMemExnsFn, pxControl );
+      handle_gets_Stmt( env, map, st, n, pxControl );
    }
 }
 
@@ -996,26 +1202,26 @@ static void redundant_put_removal_BB (
 
 #if STATS_IROPT
 /* How often sameIRExprs was invoked */
-static UInt invocation_count;
+static VEX_TLS UInt invocation_count;
 /* How often sameIRExprs recursed through IRTemp assignments */
-static UInt recursion_count;
+static VEX_TLS UInt recursion_count;
 /* How often sameIRExprs found identical IRExprs */
-static UInt success_count;
+static VEX_TLS UInt success_count;
 /* How often recursing through assignments to IRTemps helped
    establishing equality. */
-static UInt recursion_success_count;
+static VEX_TLS UInt recursion_success_count;
 /* Whether or not recursing through an IRTemp assignment helped 
    establishing IRExpr equality for a given sameIRExprs invocation. */
-static Bool recursion_helped;
+static VEX_TLS Bool recursion_helped;
 /* Whether or not a given sameIRExprs invocation recursed through an
    IRTemp assignment */
-static Bool recursed;
+static VEX_TLS Bool recursed;
 /* Maximum number of nodes ever visited when comparing two IRExprs. */
-static UInt max_nodes_visited;
+static VEX_TLS UInt max_nodes_visited;
 #endif /* STATS_IROPT */
 
 /* Count the number of nodes visited for a given sameIRExprs invocation. */
-static UInt num_nodes_visited;
+static VEX_TLS UInt num_nodes_visited;
 
 /* Do not visit more than NODE_LIMIT nodes when comparing two IRExprs.
    This is to guard against performance degradation by visiting large
@@ -1048,6 +1254,10 @@ static Bool sameIRExprs_aux2 ( IRExpr** env, IRExpr* e1, IRExpr* e2 );
 inline
 static Bool sameIRExprs_aux ( IRExpr** env, IRExpr* e1, IRExpr* e2 )
 {
+   /* Interned atoms (see ir_defs.c) are often the very same node.  Not
+      so for Gets, which may read different values at different
+      places. */
+   if (e1 == e2 && isIRAtom(e1)) return True;
    if (e1->tag != e2->tag) return False;
    return sameIRExprs_aux2(env, e1, e2);
 }
@@ -3169,10 +3379,14 @@ static Bool isOneU1 ( IRExpr* e )
 /*--- collaboration with the front end                        ---*/
 /*---------------------------------------------------------------*/
 
-static 
+/* The front end is handed the whole callee so that it can identify
+   the helper by its address rather than by comparing names, which
+   would cost a string comparison per helper per CCall. */
+
+static
 IRSB* spec_helpers_BB(
          IRSB* bb,
-         IRExpr* (*specHelper) (const HChar*, IRExpr**, IRStmt**, Int)
+         IRExpr* (*specHelper) (const IRCallee*, IRExpr**, IRStmt**, Int)
       )
 {
    Int     i;
@@ -3187,7 +3401,7 @@ IRSB* spec_helpers_BB(
           || st->Ist.WrTmp.data->tag != Iex_CCall)
          continue;
 
-      ex = (*specHelper)( st->Ist.WrTmp.data->Iex.CCall.cee->name,
+      ex = (*specHelper)( st->Ist.WrTmp.data->Iex.CCall.cee,
                           st->Ist.WrTmp.data->Iex.CCall.args,
                           &bb->stmts[0], i );
       if (!ex)
@@ -3574,6 +3788,135 @@ static Bool eq_AvailExpr ( AvailExpr* a1, AvailExpr* a2 )
    }
 }
 
+/* Structural hashing of AvailExprs, consistent with eq_AvailExpr:
+   any two AvailExprs which eq_AvailExpr considers equal must hash
+   the same. */
+
+static inline UInt hash_mix ( UInt h, ULong w )
+{
+   h ^= (UInt)w + 0x9E3779B9 + (h << 6) + (h >> 2);
+   h ^= (UInt)(w >> 32) + 0x9E3779B9 + (h << 6) + (h >> 2);
+   return h;
+}
+
+static UInt hash_IRConst ( const IRConst* c )
+{
+   UInt h = (UInt)c->tag;
+   switch (c->tag) {
+      case Ico_U1:   return hash_mix(h, 1 & c->Ico.U1);
+      case Ico_U8:   return hash_mix(h, c->Ico.U8);
+      case Ico_U16:  return hash_mix(h, c->Ico.U16);
+      case Ico_U32:  return hash_mix(h, c->Ico.U32);
+      case Ico_U64:  return hash_mix(h, c->Ico.U64);
+      case Ico_F32i: return hash_mix(h, c->Ico.F32i);
+      case Ico_F64i: return hash_mix(h, c->Ico.F64i);
+      case Ico_V128: return hash_mix(h, c->Ico.V128);
+      case Ico_V256: return hash_mix(h, c->Ico.V256);
+      /* eqIRConst compares these as floating point values, so 0.0
+         and -0.0 are equal even though their bits differ.  They are
+         rare enough that hashing just the tag is fine. */
+      case Ico_F32:  return h;
+      case Ico_F64:  return h;
+      default: vpanic("hash_IRConst");
+   }
+}
+
+static UInt hash_TmpOrConst ( UInt h, const TmpOrConst* tc )
+{
+   switch (tc->tag) {
+      case TCc: return hash_mix(h, hash_IRConst(tc->u.con));
+      case TCt: return hash_mix(h ^ 0x80000000, tc->u.tmp);
+      default:  vpanic("hash_TmpOrConst");
+   }
+}
+
+static UInt hash_AvailExpr ( const AvailExpr* ae )
+{
+   UInt h = hash_mix(0, ae->tag);
+   Int  i;
+   switch (ae->tag) {
+      case Ut:
+         h = hash_mix(h, ae->u.Ut.op);
+         h = hash_mix(h, ae->u.Ut.arg);
+         break;
+      case Btt:
+         h = hash_mix(h, ae->u.Btt.op);
+         h = hash_mix(h, ae->u.Btt.arg1);
+         h = hash_mix(h, ae->u.Btt.arg2);
+         break;
+      case Btc:
+         h = hash_mix(h, ae->u.Btc.op);
+         h = hash_mix(h, ae->u.Btc.arg1);
+         h = hash_mix(h, hash_IRConst(&ae->u.Btc.con2));
+         break;
+      case Bct:
+         h = hash_mix(h, ae->u.Bct.op);
+         h = hash_mix(h, hash_IRConst(&ae->u.Bct.con1));
+         h = hash_mix(h, ae->u.Bct.arg2);
+         break;
+      case Cf64i:
+         h = hash_mix(h, ae->u.Cf64i.f64i);
+         break;
+      case Ittt:
+         h = hash_mix(h, ae->u.Ittt.co);
+         h = hash_mix(h, ae->u.Ittt.e1);
+         h = hash_mix(h, ae->u.Ittt.e0);
+         break;
+      case Ittc:
+         h = hash_mix(h, ae->u.Ittc.co);
+         h = hash_mix(h, ae->u.Ittc.e1);
+         h = hash_mix(h, hash_IRConst(&ae->u.Ittc.con0));
+         break;
+      case Itct:
+         h = hash_mix(h, ae->u.Itct.co);
+         h = hash_mix(h, hash_IRConst(&ae->u.Itct.con1));
+         h = hash_mix(h, ae->u.Itct.e0);
+         break;
+      case Itcc:
+         h = hash_mix(h, ae->u.Itcc.co);
+         h = hash_mix(h, hash_IRConst(&ae->u.Itcc.con1));
+         h = hash_mix(h, hash_IRConst(&ae->u.Itcc.con0));
+         break;
+      case GetIt:
+         h = hash_mix(h, ae->u.GetIt.descr->base);
+         h = hash_mix(h, ae->u.GetIt.descr->elemTy);
+         h = hash_mix(h, ae->u.GetIt.descr->nElems);
+         h = hash_mix(h, ae->u.GetIt.ix);
+         h = hash_mix(h, (UInt)ae->u.GetIt.bias);
+         break;
+      case CCall:
+         h = hash_mix(h, (HWord)ae->u.CCall.cee->addr);
+         h = hash_mix(h, ae->u.CCall.nArgs);
+         for (i = 0; i < ae->u.CCall.nArgs; i++)
+            h = hash_TmpOrConst(h, &ae->u.CCall.args[i]);
+         break;
+      case Load:
+         h = hash_mix(h, ae->u.Load.end);
+         h = hash_mix(h, ae->u.Load.ty);
+         h = hash_TmpOrConst(h, &ae->u.Load.addr);
+         break;
+      default:
+         vpanic("hash_AvailExpr");
+   }
+   /* Final avalanche (murmur3 fmix32), since the table uses the low
+      bits as the home slot. */
+   h ^= h >> 16;
+   h *= 0x85EBCA6B;
+   h ^= h >> 13;
+   h *= 0xC2B2AE35;
+   h ^= h >> 16;
+   return h;
+}
+
+
+/* CSE's maps from AvailExpr to IRTemp are HashHWs keyed by
+   AvailExpr*, hashed with hash_AvailExpr and compared with this. */
+
+static Bool eq_AvailExpr_HW ( HWord a1, HWord a2 )
+{
+   return eq_AvailExpr( (AvailExpr*)a1, (AvailExpr*)a2 );
+}
+
 static IRExpr* availExpr_to_IRExpr ( AvailExpr* ae ) 
 {
    IRConst *con, *con0, *con1;
@@ -3870,6 +4213,13 @@ static AvailExpr* irExpr_to_AvailExpr ( IRExpr* e, Bool allowLoadsToBeCSEd )
    is something of a dodgy proposition if the guest program is doing
    some screwy stuff to do with races and spinloops. */
 
+#if STATS_IROPT
+/* How many CSE lookups found an existing binding, and how many added
+   a new one, over all blocks so far. */
+static VEX_TLS ULong cse_hits_total;
+static VEX_TLS ULong cse_misses_total;
+#endif /* STATS_IROPT */
+
 static Bool do_cse_BB ( IRSB* bb, Bool allowLoadsToBeCSEd )
 {
    Int        i, j, paranoia;
@@ -3877,11 +4227,19 @@ static Bool do_cse_BB ( IRSB* bb, Bool allowLoadsToBeCSEd )
    IRStmt*    st;
    AvailExpr* eprime;
    AvailExpr* ae;
+   HashHW*    env;
+   UInt       h;
    Bool       invalidate;
    Bool       anyDone = False;
+   UInt       cse_hits = 0, cse_misses = 0;
 
    HashHW* tenv = newHHW(); /* :: IRTemp -> IRTemp */
-   HashHW* aenv = newHHW(); /* :: AvailExpr* -> IRTemp */
+   HashHW* aenv = newHHW(); /* :: AvailExpr -> IRTemp, pure forms */
+   HashHW* menv = newHHW(); /* :: AvailExpr -> IRTemp, GetIt/Load */
+
+#  if STATS_IROPT
+   UInt cse_invalidations = 0;
+#  endif
 
    vassert(sizeof(IRTemp) <= sizeof(HWord));
 
@@ -3890,23 +4248,26 @@ static Bool do_cse_BB ( IRSB* bb, Bool allowLoadsToBeCSEd )
    /* Iterate forwards over the stmts.  
       On seeing "t = E", where E is one of the AvailExpr forms:
          let E' = apply tenv substitution to E
-         search aenv for E'
+         search aenv (or menv, for GetIt/Load) for E'
             if a mapping E' -> q is found, 
                replace this stmt by "t = q"
                and add binding t -> q to tenv
             else
-               add binding E' -> t to aenv
+               add binding E' -> t to aenv (or menv)
                replace this stmt by "t = E'"
 
       Other statements are only interesting to the extent that they
-      might invalidate some of the expressions in aenv.  So there is
-      an invalidate-bindings check for each statement seen.
+      might invalidate some of the expressions in menv.  So there is
+      an invalidate-bindings check for each statement seen.  Keeping
+      the vulnerable GetIt and Load bindings in their own table means
+      that check never has to look at the (usually far more numerous)
+      pure ones.
    */
    for (i = 0; i < bb->stmts_used; i++) {
       st = bb->stmts[i];
 
-      /* ------ BEGIN invalidate aenv bindings ------ */
-      /* This is critical: remove from aenv any E' -> .. bindings
+      /* ------ BEGIN invalidate menv bindings ------ */
+      /* This is critical: remove from menv any E' -> .. bindings
          which might be invalidated by this statement.  The only
          vulnerable kind of bindings are the GetI and Load kinds.
             Dirty call - dump (paranoia level -> 2) 
@@ -3929,60 +4290,65 @@ static Bool do_cse_BB ( IRSB* bb, Bool allowLoadsToBeCSEd )
             vpanic("do_cse_BB(1)");
       }
 
-      if (paranoia > 0) {
-         for (j = 0; j < aenv->used; j++) {
-            if (!aenv->inuse[j])
-               continue;
-            ae = (AvailExpr*)aenv->key[j];
-            if (ae->tag != GetIt && ae->tag != Load) 
+      if (paranoia >= 2) {
+#        if STATS_IROPT
+         cse_invalidations += menv->used;
+#        endif
+         clearHHW(menv);
+      }
+      else
+      if (paranoia == 1) {
+         for (j = 0; j < menv->size; ) {
+            if (!menv->inuse[j]) {
+               j++;
                continue;
+            }
+            ae = (AvailExpr*)menv->key[j];
+            vassert(ae->tag == GetIt || ae->tag == Load);
             invalidate = False;
-            if (paranoia >= 2) {
-               invalidate = True;
-            } else {
-               vassert(paranoia == 1);
-               if (ae->tag == Load) {
-                  /* Loads can be invalidated by anything that could
-                     possibly touch memory.  But in that case we
-                     should have |paranoia| == 2 and we won't get
-                     here.  So there's nothing to do; we don't have to
-                     invalidate the load. */
-               }
-               else
-               if (st->tag == Ist_Put) {
-                  if (getAliasingRelation_IC(
-                         ae->u.GetIt.descr, 
-                         IRExpr_RdTmp(ae->u.GetIt.ix), 
-                         st->Ist.Put.offset, 
-                         typeOfIRExpr(bb->tyenv,st->Ist.Put.data) 
-                      ) != NoAlias) 
-                     invalidate = True;
-               }
-               else 
-               if (st->tag == Ist_PutI) {
-                  IRPutI *puti = st->Ist.PutI.details;
-                  if (getAliasingRelation_II(
-                         ae->u.GetIt.descr, 
-                         IRExpr_RdTmp(ae->u.GetIt.ix), 
-                         ae->u.GetIt.bias,
-                         puti->descr,
-                         puti->ix,
-                         puti->bias
-                      ) != NoAlias)
-                     invalidate = True;
-               }
-               else 
-                  vpanic("do_cse_BB(2)");
+            if (ae->tag == Load) {
+               /* Loads can be invalidated by anything that could
+                  possibly touch memory.  But in that case we
+                  should have |paranoia| == 2 and we won't get
+                  here.  So there's nothing to do; we don't have to
+                  invalidate the load. */
             }
-
-            if (invalidate) {
-               aenv->inuse[j] = False;
-               aenv->key[j]   = (HWord)NULL;  /* be sure */
+            else
+            if (st->tag == Ist_Put) {
+               if (getAliasingRelation_IC(
+                      ae->u.GetIt.descr, 
+                      IRExpr_RdTmp(ae->u.GetIt.ix), 
+                      st->Ist.Put.offset, 
+                      typeOfIRExpr(bb->tyenv,st->Ist.Put.data) 
+                   ) != NoAlias) 
+                  invalidate = True;
             }
+            else 
+            if (st->tag == Ist_PutI) {
+               IRPutI *puti = st->Ist.PutI.details;
+               if (getAliasingRelation_II(
+                      ae->u.GetIt.descr, 
+                      IRExpr_RdTmp(ae->u.GetIt.ix), 
+                      ae->u.GetIt.bias,
+                      puti->descr,
+                      puti->ix,
+                      puti->bias
+                   ) != NoAlias)
+                  invalidate = True;
+            }
+            else 
+               vpanic("do_cse_BB(2)");
+
+#           if STATS_IROPT
+            if (invalidate)
+               cse_invalidations++;
+#           endif
+            if (!invalidate || !removeSlotHHW(menv, j))
+               j++;
          } /* for j */
-      } /* paranoia > 0 */
+      } /* paranoia == 1 */
 
-      /* ------ ENV invalidate aenv bindings ------ */
+      /* ------ ENV invalidate menv bindings ------ */
 
       /* ignore not-interestings */
       if (st->tag != Ist_WrTmp)
@@ -3999,28 +4365,45 @@ static Bool do_cse_BB ( IRSB* bb, Bool allowLoadsToBeCSEd )
       /* apply tenv */
       subst_AvailExpr( tenv, eprime );
 
-      /* search aenv for eprime, unfortunately the hard way */
-      for (j = 0; j < aenv->used; j++)
-         if (aenv->inuse[j] && eq_AvailExpr(eprime, (AvailExpr*)aenv->key[j]))
-            break;
+      /* search aenv/menv for eprime */
+      env = (eprime->tag == GetIt || eprime->tag == Load) ? menv : aenv;
+      h   = hash_AvailExpr(eprime);
+      j   = findSlotHHW(env, (HWord)eprime, h, eq_AvailExpr_HW);
 
-      if (j < aenv->used) {
+      if (env->inuse[j]) {
          /* A binding E' -> q was found.  Replace stmt by "t = q" and
             note the t->q binding in tenv. */
          /* (this is the core of the CSE action) */
-         q = (IRTemp)aenv->val[j];
+         q = (IRTemp)env->val[j];
          bb->stmts[i] = IRStmt_WrTmp( t, IRExpr_RdTmp(q) );
          addToHHW( tenv, (HWord)t, (HWord)q );
          anyDone = True;
+         cse_hits++;
       } else {
          /* No binding was found, so instead we add E' -> t to our
             collection of available expressions, replace this stmt
             with "t = E'", and move on. */
          bb->stmts[i] = IRStmt_WrTmp( t, availExpr_to_IRExpr(eprime) );
-         addToHHW( aenv, (HWord)eprime, (HWord)t );
+         addSlotHHW( env, j, (HWord)eprime, h, (HWord)t );
+         cse_misses++;
       }
    }
 
+   if (vex_stats != NULL) {
+      vex_stats->n_cse_hits   += cse_hits;
+      vex_stats->n_cse_misses += cse_misses;
+   }
+
+#  if STATS_IROPT
+   vex_printf("do_cse_BB: %d stmts  hits = %u (total %llu)  "
+              "misses = %u (total %llu)  invalidated = %u\n",
+              bb->stmts_used, cse_hits, cse_hits_total + cse_hits,
+              cse_misses, cse_misses_total + cse_misses,
+              cse_invalidations);
+   cse_hits_total   += cse_hits;
+   cse_misses_total += cse_misses;
+#  endif
+
    /*
    ppIRSB(bb);
    sanityCheckIRSB(bb, Ity_I32);
@@ -4923,12 +5306,14 @@ static IRSB* maybe_loop_unroll_BB ( IRSB* bb0, Addr my_addr )
 
 /* --- The 'tmp' environment is the central data structure here --- */
 
-/* The number of outstanding bindings we're prepared to track.
-   The number of times the env becomes full and we have to dump
-   the oldest binding (hence reducing code quality) falls very
-   rapidly as the env size increases.  8 gives reasonable performance 
-   under most circumstances. */
-#define A_NENV 10
+/* The maximum number of outstanding bindings we're prepared to
+   track.  The env is sized for the block, so it only becomes full,
+   forcing the oldest binding to be dumped (hence reducing code
+   quality), in blocks with more than this many single-use temps
+   pending at once.  Lookups are indexed by temp and invalidation
+   checks are skipped when no binding can be affected, so a wide
+   window costs little. */
+#define A_NENV 1000
 
 /* An interval. Used to record the bytes in the guest state accessed
    by a Put[I] statement or by (one or more) Get[I] expression(s). In 
@@ -4981,14 +5366,34 @@ typedef
    }
    ATmpInfo;
 
+/* The env proper.  Bindings are held oldest first in info[0 .. used-1].
+   Slots whose binding has been used or dumped are holes (bindee ==
+   NULL) until the env is next compacted.  slot[] maps each temp to
+   the index of its binding, or -1 if it has none.  nLoads and gets
+   summarise the live bindings, so that a statement which cannot
+   invalidate any of them need not look at them individually: nLoads
+   is the number which do loads, and gets covers (conservatively)
+   every live binding's getInterval. */
+typedef
+   struct {
+      ATmpInfo* info;
+      Int       used;
+      Int       size;
+      Int       live;
+      Int       nLoads;
+      Interval  gets;
+      Int*      slot;
+   }
+   AEnv;
+
 __attribute__((unused))
-static void ppAEnv ( ATmpInfo* env )
+static void ppAEnv ( AEnv* env )
 {
    Int i;
-   for (i = 0; i < A_NENV; i++) {
-      vex_printf("%d  tmp %d  val ", i, (Int)env[i].binder);
-      if (env[i].bindee) 
-         ppIRExpr(env[i].bindee);
+   for (i = 0; i < env->used; i++) {
+      vex_printf("%d  tmp %d  val ", i, (Int)env->info[i].binder);
+      if (env->info[i].bindee) 
+         ppIRExpr(env->info[i].bindee);
       else 
          vex_printf("(null)");
       vex_printf("\n");
@@ -5061,20 +5466,59 @@ static void setHints_Expr (Bool* doesLoad, Interval* getInterval, IRExpr* e )
 }
 
 
-/* Add a binding to the front of the env and slide all the rest
-   backwards.  It should be the case that the last slot is free. */
-static void addToEnvFront ( ATmpInfo* env, IRTemp binder, IRExpr* bindee )
+/* Slide in-use entries in env up to the front, closing the holes. */
+static void compactEnv ( AEnv* env )
 {
-   Int i;
-   vassert(env[A_NENV-1].bindee == NULL);
-   for (i = A_NENV-1; i >= 1; i--)
-      env[i] = env[i-1];
-   env[0].binder   = binder;
-   env[0].bindee   = bindee;
-   env[0].doesLoad = False; /* filled in later */
-   env[0].getInterval.present  = False; /* filled in later */
-   env[0].getInterval.low  = -1; /* filled in later */
-   env[0].getInterval.high = -1; /* filled in later */
+   Int k, m = 0;
+   for (k = 0; k < env->used; k++) {
+      if (env->info[k].bindee != NULL) {
+         env->info[m] = env->info[k];
+         env->slot[env->info[m].binder] = m;
+         m++;
+      }
+   }
+   vassert(m == env->live);
+   env->used = m;
+}
+
+/* Remove the binding in slot k, leaving a hole, and return the bound
+   expression. */
+static IRExpr* removeFromEnv ( AEnv* env, Int k )
+{
+   ATmpInfo* ti     = &env->info[k];
+   IRExpr*   bindee = ti->bindee;
+   vassert(bindee != NULL);
+   env->slot[ti->binder] = -1;
+   env->live--;
+   if (ti->doesLoad)
+      env->nLoads--;
+   ti->bindee = NULL;
+   return bindee;
+}
+
+/* Add a binding to the back of the env, as its youngest, and fill
+   in its hints.  It should be the case that there is a free slot. */
+static void addToEnvBack ( AEnv* env, IRTemp binder, IRExpr* bindee )
+{
+   ATmpInfo* ti;
+   if (env->used == env->size)
+      compactEnv(env);
+   vassert(env->used < env->size);
+   ti = &env->info[env->used];
+   ti->binder   = binder;
+   ti->bindee   = bindee;
+   ti->doesLoad = False;
+   ti->getInterval.present = False;
+   ti->getInterval.low  = -1;
+   ti->getInterval.high = -1;
+   setHints_Expr(&ti->doesLoad, &ti->getInterval, bindee);
+   env->slot[binder] = env->used;
+   env->used++;
+   env->live++;
+   if (ti->doesLoad)
+      env->nLoads++;
+   if (ti->getInterval.present)
+      update_interval(&env->gets, ti->getInterval.low, ti->getInterval.high);
 }
 
 /* Given uses :: array of UShort, indexed by IRTemp
@@ -5228,17 +5672,10 @@ static void aoccCount_Stmt ( UShort* uses, IRStmt* st )
    expression, and set the env's binding to NULL so it is marked as
    used.  If not found, return NULL. */
 
-static IRExpr* atbSubst_Temp ( ATmpInfo* env, IRTemp tmp )
+static IRExpr* atbSubst_Temp ( AEnv* env, IRTemp tmp )
 {
-   Int i;
-   for (i = 0; i < A_NENV; i++) {
-      if (env[i].binder == tmp && env[i].bindee != NULL) {
-         IRExpr* bindee = env[i].bindee;
-         env[i].bindee = NULL;
-         return bindee;
-      }
-   }
-   return NULL;
+   Int k = env->slot[tmp];
+   return k == -1 ? NULL : removeFromEnv(env, k);
 }
 
 /* Traverse e, looking for temps.  For each observed temp, see if env
@@ -5428,7 +5865,7 @@ static IRExpr* fold_IRExpr_Unop ( IROp op, IRExpr* aa )
    return IRExpr_Unop( op, aa );
 }
 
-static IRExpr* atbSubst_Expr ( ATmpInfo* env, IRExpr* e )
+static IRExpr* atbSubst_Expr ( AEnv* env, IRExpr* e )
 {
    IRExpr*  e2;
    IRExpr** args2;
@@ -5503,7 +5940,7 @@ static IRExpr* atbSubst_Expr ( ATmpInfo* env, IRExpr* e )
 
 /* Same deal as atbSubst_Expr, except for stmts. */
 
-static IRStmt* atbSubst_Stmt ( ATmpInfo* env, IRStmt* st )
+static IRStmt* atbSubst_Stmt ( AEnv* env, IRStmt* st )
 {
    Int     i;
    IRDirty *d, *d2;
@@ -5727,12 +6164,14 @@ static Interval stmt_modifies_guest_state (
                         VexRegisterUpdates pxControl
                      )
 {
-   Int      i, j, k, m;
-   Bool     stmtStores, invalidateMe;
+   Int      i, j, k;
+   Bool     stmtStores, invalidateMe, invalidateAny;
    Interval putInterval;
    IRStmt*  st;
    IRStmt*  st2;
-   ATmpInfo env[A_NENV];
+   AEnv     envV;
+   AEnv*    env = &envV;
+   Int      n_wrtmps = 0;
 
    Bool   max_ga_known = False;
    Addr   max_ga       = 0;
@@ -5762,6 +6201,9 @@ static Interval stmt_modifies_guest_state (
                max_ga = mga;
             break;
          }
+         case Ist_WrTmp:
+            n_wrtmps++;
+            break;
          default:
             break;
       }
@@ -5780,13 +6222,13 @@ static Interval stmt_modifies_guest_state (
 
    /* Phase 2.  Scan forwards in bb.  For each statement in turn:
 
-         If the env is full, emit the end element.  This guarantees
+         If the env is full, emit the oldest element.  This guarantees
          there is at least one free slot in the following.
 
          On seeing 't = E', occ(t)==1,  
             let E'=env(E)
             delete this stmt
-            add t -> E' to the front of the env
+            add t -> E' to the back of the env
             Examine E' and set the hints for E' appropriately
               (doesLoad? doesGet?)
 
@@ -5795,16 +6237,21 @@ static Interval stmt_modifies_guest_state (
             remove from env any 't=E' binds invalidated by stmt
                 emit the invalidated stmts
             emit stmt'
-            compact any holes in env 
-              by sliding entries towards the front
 
       Finally, apply env to bb->next.  
    */
 
-   for (i = 0; i < A_NENV; i++) {
-      env[i].bindee = NULL;
-      env[i].binder = IRTemp_INVALID;
-   }
+   env->size   = n_wrtmps < A_NENV ? (n_wrtmps > 0 ? n_wrtmps : 1) : A_NENV;
+   env->info   = LibVEX_Alloc_inline(env->size * sizeof(ATmpInfo));
+   env->used   = 0;
+   env->live   = 0;
+   env->nLoads = 0;
+   env->gets.present = False;
+   env->gets.low  = -1;
+   env->gets.high = -1;
+   env->slot   = LibVEX_Alloc_inline(n_tmps * sizeof(Int));
+   for (i = 0; i < n_tmps; i++)
+      env->slot[i] = -1;
 
    /* The stmts in bb are being reordered, and we are guaranteed to
       end up with no more than the number we started with.  Use i to
@@ -5820,12 +6267,13 @@ static Interval stmt_modifies_guest_state (
      
       /* Ensure there's at least one space in the env, by emitting
          the oldest binding if necessary. */
-      if (env[A_NENV-1].bindee != NULL) {
-         bb->stmts[j] = IRStmt_WrTmp( env[A_NENV-1].binder, 
-                                      env[A_NENV-1].bindee );
+      if (env->live == env->size) {
+         for (k = 0; env->info[k].bindee == NULL; k++)
+            ;
+         bb->stmts[j] = IRStmt_WrTmp( env->info[k].binder,
+                                      removeFromEnv(env, k) );
          j++;
          vassert(j <= i);
-         env[A_NENV-1].bindee = NULL;
       }
 
       /* Consider current stmt. */
@@ -5844,8 +6292,7 @@ static Interval stmt_modifies_guest_state (
             actions. */
          e  = st->Ist.WrTmp.data;
          e2 = atbSubst_Expr(env, e);
-         addToEnvFront(env, st->Ist.WrTmp.tmp, e2);
-         setHints_Expr(&env[0].doesLoad, &env[0].getInterval, e2);
+         addToEnvBack(env, st->Ist.WrTmp.tmp, e2);
          /* don't advance j, as we are deleting this stmt and instead
             holding it temporarily in the env. */
          continue; /* for (i = 0; i < bb->stmts_used; i++) loop */
@@ -5881,55 +6328,70 @@ static Interval stmt_modifies_guest_state (
                    || st->tag == Ist_LLSC
                    || st->tag == Ist_CAS );
 
-      for (k = A_NENV-1; k >= 0; k--) {
-         if (env[k].bindee == NULL)
-            continue;
-         /* Compare the actions of this stmt with the actions of
-            binding 'k', to see if they invalidate the binding. */
-         invalidateMe
-            = toBool(
-              /* a store invalidates loaded data */
-              (env[k].doesLoad && stmtStores)
-              /* a put invalidates get'd data, if they overlap */
-              || ((env[k].getInterval.present && putInterval.present) &&
-                  intervals_overlap(env[k].getInterval, putInterval))
-              /* a put invalidates loaded data. That means, in essense, that
-                 a load expression cannot be substituted into a statement
-                 that follows the put. But there is nothing wrong doing so
-                 except when the put statement requries precise exceptions.
-                 Think of a load that is moved past a put where the put
-                 updates the IP in the guest state. If the load generates
-                 a segfault, the wrong address (line number) would be
-                 reported. */
-              || (env[k].doesLoad && putInterval.present &&
-                  putRequiresPreciseMemExns)
-              /* probably overly conservative: a memory bus event
-                 invalidates absolutely everything, so that all
-                 computation prior to it is forced to complete before
-                 proceeding with the event (fence,lock,unlock). */
-              || st->tag == Ist_MBE
-              /* also be (probably overly) paranoid re AbiHints */
-              || st->tag == Ist_AbiHint
-              );
-         if (invalidateMe) {
-            bb->stmts[j] = IRStmt_WrTmp( env[k].binder, env[k].bindee );
-            j++;
-            vassert(j <= i);
-            env[k].bindee = NULL;
+      /* Most statements can invalidate no binding at all, which the
+         summary in env shows without looking at the bindings. */
+      invalidateAny
+         = toBool(
+           env->live > 0
+           && ((env->nLoads > 0 && stmtStores)
+               || (env->gets.present && putInterval.present &&
+                   intervals_overlap(env->gets, putInterval))
+               || (env->nLoads > 0 && putInterval.present &&
+                   putRequiresPreciseMemExns)
+               || st->tag == Ist_MBE
+               || st->tag == Ist_AbiHint)
+           );
+
+      if (invalidateAny) {
+         /* Oldest first.  Rebuild env->gets from the survivors as we
+            go, since it only ever grows otherwise. */
+         env->gets.present = False;
+         for (k = 0; k < env->used; k++) {
+            ATmpInfo* ti = &env->info[k];
+            if (ti->bindee == NULL)
+               continue;
+            /* Compare the actions of this stmt with the actions of
+               binding 'k', to see if they invalidate the binding. */
+            invalidateMe
+               = toBool(
+                 /* a store invalidates loaded data */
+                 (ti->doesLoad && stmtStores)
+                 /* a put invalidates get'd data, if they overlap */
+                 || ((ti->getInterval.present && putInterval.present) &&
+                     intervals_overlap(ti->getInterval, putInterval))
+                 /* a put invalidates loaded data. That means, in essense,
+                    that a load expression cannot be substituted into a
+                    statement that follows the put. But there is nothing
+                    wrong doing so except when the put statement requries
+                    precise exceptions.  Think of a load that is moved
+                    past a put where the put updates the IP in the guest
+                    state. If the load generates a segfault, the wrong
+                    address (line number) would be reported. */
+                 || (ti->doesLoad && putInterval.present &&
+                     putRequiresPreciseMemExns)
+                 /* probably overly conservative: a memory bus event
+                    invalidates absolutely everything, so that all
+                    computation prior to it is forced to complete before
+                    proceeding with the event (fence,lock,unlock). */
+                 || st->tag == Ist_MBE
+                 /* also be (probably overly) paranoid re AbiHints */
+                 || st->tag == Ist_AbiHint
+                 );
+            if (invalidateMe) {
+               bb->stmts[j] = IRStmt_WrTmp( ti->binder,
+                                            removeFromEnv(env, k) );
+               j++;
+               vassert(j <= i);
+            } else if (ti->getInterval.present) {
+               update_interval(&env->gets, ti->getInterval.low,
+                                           ti->getInterval.high);
+            }
          }
       }
 
-      /* Slide in-use entries in env up to the front */
-      m = 0;
-      for (k = 0; k < A_NENV; k++) {
-         if (env[k].bindee != NULL) {
-            env[m] = env[k];
-            m++;
-	 }
-      }
-      for (m = m; m < A_NENV; m++) {
-         env[m].bindee = NULL;
-      }
+      /* Compact any holes in env, once they make up half of it. */
+      if (2 * env->live < env->used)
+         compactEnv(env);
 
       /* finally, emit the substituted statement */
       bb->stmts[j] = st2;
@@ -6393,7 +6855,7 @@ static Bool iropt_verbose = False; /* True; */
 static 
 IRSB* cheap_transformations ( 
          IRSB* bb,
-         IRExpr* (*specHelper) (const HChar*, IRExpr**, IRStmt**, Int),
+         IRExpr* (*specHelper) (const IRCallee*, IRExpr**, IRStmt**, Int),
          Bool (*preciseMemExnsFn)(Int,Int,VexRegisterUpdates),
          VexRegisterUpdates pxControl
       )
@@ -6572,25 +7034,29 @@ static void considerExpensives ( /*OUT*/Bool* hasGetIorPutI,
 
 IRSB* do_iropt_BB(
          IRSB* bb0,
-         IRExpr* (*specHelper) (const HChar*, IRExpr**, IRStmt**, Int),
+         Int   level,
+         IRExpr* (*specHelper) (const IRCallee*, IRExpr**, IRStmt**, Int),
          Bool (*preciseMemExnsFn)(Int,Int,VexRegisterUpdates),
          VexRegisterUpdates pxControl,
          Addr    guest_addr,
          VexArch guest_arch
       )
 {
-   static Int n_total     = 0;
-   static Int n_expensive = 0;
+   static VEX_TLS Int n_total     = 0;
+   static VEX_TLS Int n_expensive = 0;
 
    Bool hasGetIorPutI, hasVorFtemps;
    IRSB *bb, *bb2;
+   VexStageMark m;
 
    n_total++;
 
    /* First flatten the block out, since all other
       phases assume flat code. */
 
+   vexStatsBegin(&m);
    bb = flatten_BB ( bb0 );
+   vexStatsEnd(VexStageIROptFlatten, &m);
 
    if (iropt_verbose) {
       vex_printf("\n========= FLAT\n\n" );
@@ -6598,7 +7064,7 @@ IRSB* do_iropt_BB(
    }
 
    /* If at level 0, stop now. */
-   if (vex_control.iropt_level <= 0) return bb;
+   if (level <= 0) return bb;
 
    /* Now do a preliminary cleanup pass, and figure out if we also
       need to do 'expensive' optimisations.  Expensive optimisations
@@ -6606,6 +7072,7 @@ IRSB* do_iropt_BB(
       If needed, do expensive transformations and then another cheap
       cleanup pass. */
 
+   vexStatsBegin(&m);
    bb = cheap_transformations( bb, specHelper, preciseMemExnsFn, pxControl );
 
    if (guest_arch == VexArchARM) {
@@ -6619,8 +7086,9 @@ IRSB* do_iropt_BB(
       do_cse_BB( bb, False/*!allowLoadsToBeCSEd*/ );
       do_deadcode_BB( bb );
    }
+   vexStatsEnd(VexStageIROptCheap, &m);
 
-   if (vex_control.iropt_level > 1) {
+   if (level > 1) {
 
       /* Peer at what we have, to decide how much more effort to throw
          at it. */
@@ -6632,8 +7100,10 @@ IRSB* do_iropt_BB(
             rounding modes.  Don't bother if hasGetIorPutI since that
             case leads into the expensive transformations, which do
             CSE anyway. */
+         vexStatsBegin(&m);
          (void)do_cse_BB( bb, False/*!allowLoadsToBeCSEd*/ );
          do_deadcode_BB( bb );
+         vexStatsEnd(VexStageIROptCSE, &m);
       }
 
       if (hasGetIorPutI) {
@@ -6641,14 +7111,23 @@ IRSB* do_iropt_BB(
          n_expensive++;
          if (DEBUG_IROPT)
             vex_printf("***** EXPENSIVE %d %d\n", n_total, n_expensive);
+         vexStatsBegin(&m);
          bb = expensive_transformations( bb, pxControl );
+         vexStatsEnd(VexStageIROptExpensive, &m);
+         vexStatsBegin(&m);
          bb = cheap_transformations( bb, specHelper,
                                      preciseMemExnsFn, pxControl );
+         vexStatsEnd(VexStageIROptCheap, &m);
          /* Potentially common up GetIs */
+         vexStatsBegin(&m);
          cses = do_cse_BB( bb, False/*!allowLoadsToBeCSEd*/ );
-         if (cses)
+         vexStatsEnd(VexStageIROptCSE, &m);
+         if (cses) {
+            vexStatsBegin(&m);
             bb = cheap_transformations( bb, specHelper,
                                         preciseMemExnsFn, pxControl );
+            vexStatsEnd(VexStageIROptCheap, &m);
+         }
       }
 
       ///////////////////////////////////////////////////////////
@@ -6661,6 +7140,9 @@ IRSB* do_iropt_BB(
       /* Now have a go at unrolling simple (single-BB) loops.  If
          successful, clean up the results as much as possible. */
 
+      /* The cleanup after a successful unroll is charged to the
+         unroller, since it would not be needed otherwise. */
+      vexStatsBegin(&m);
       bb2 = maybe_loop_unroll_BB( bb, guest_addr );
       if (bb2) {
          bb = cheap_transformations( bb2, specHelper,
@@ -6676,6 +7158,7 @@ IRSB* do_iropt_BB(
          }
          if (0) vex_printf("vex iropt: unrolled a loop\n");
       }
+      vexStatsEnd(VexStageIROptUnroll, &m);
 
    }
 
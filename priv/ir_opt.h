@@ -42,11 +42,13 @@
 
 /* Top level optimiser entry point.  Returns a new BB.  Operates
    under the control of the global "vex_control" struct and of the
-   supplied |pxControl| argument. */
+   supplied |pxControl| argument, at optimisation level |level|, which
+   is normally vex_control.iropt_level. */
 extern 
 IRSB* do_iropt_BB (
          IRSB* bb,
-         IRExpr* (*specHelper) (const HChar*, IRExpr**, IRStmt**, Int),
+         Int   level,
+         IRExpr* (*specHelper) (const IRCallee*, IRExpr**, IRStmt**, Int),
          Bool (*preciseMemExnsFn)(Int,Int,VexRegisterUpdates),
          VexRegisterUpdates pxControl,
          Addr    guest_addr,
@@ -0,0 +1,963 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*---------------------------------------------------------------*/
+/*--- begin                                    ir_serialize.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* Conversion of an IRSB to and from the flat, pointer-free format
+   described in pub/libvex.h. */
+
+#include "libvex_basictypes.h"
+#include "libvex_ir.h"
+#include "libvex.h"
+#include "main_util.h"
+#include "ir_serialize.h"
+
+
+/*---------------------------------------------------------------*/
+/*--- Writing                                                 ---*/
+/*---------------------------------------------------------------*/
+
+/* The writer walks the block twice.  The first pass has buf == NULL
+   and merely advances the cursors, so as to find out how big each
+   section is; the second pass lays the sections out using those sizes
+   and fills them in. */
+
+typedef
+   struct {
+      UChar* buf;
+      /* Byte offsets of the sections in buf. */
+      UInt   off_stmt_tab, off_stmt_pool, off_expr_pool;
+      UInt   off_const_pool, off_str_pool;
+      /* Cursors, in units of the respective section. */
+      UInt   n_stmts;      /* stmt table entries */
+      UInt   stmt_words;   /* words of stmt pool */
+      UInt   expr_words;   /* words of expr pool */
+      UInt   n_consts;     /* const pool entries */
+      UInt   str_bytes;    /* bytes of string pool */
+   }
+   SerState;
+
+static inline void put32 ( UChar* p, UInt w )
+{
+   p[0] = toUChar(w);
+   p[1] = toUChar(w >> 8);
+   p[2] = toUChar(w >> 16);
+   p[3] = toUChar(w >> 24);
+}
+
+static inline UInt get32 ( const UChar* p )
+{
+   return ((UInt)p[0]) | (((UInt)p[1]) << 8)
+          | (((UInt)p[2]) << 16) | (((UInt)p[3]) << 24);
+}
+
+/* Reserve n words in the stmt or expr pool and return the index of
+   the first. */
+static UInt ser_new_stmt ( SerState* s, UInt n )
+{
+   UInt w = s->stmt_words;
+   s->stmt_words += n;
+   return w;
+}
+
+static UInt ser_new_expr ( SerState* s, UInt n )
+{
+   UInt w = s->expr_words;
+   s->expr_words += n;
+   return w;
+}
+
+static inline void ser_set_stmt ( SerState* s, UInt w, UInt val )
+{
+   if (s->buf)
+      put32(s->buf + s->off_stmt_pool + 4 * w, val);
+}
+
+static inline void ser_set_expr ( SerState* s, UInt w, UInt val )
+{
+   if (s->buf)
+      put32(s->buf + s->off_expr_pool + 4 * w, val);
+}
+
+static UInt ser_const ( SerState* s, const IRConst* con )
+{
+   ULong  bits = 0;
+   UInt   ix   = s->n_consts++;
+   UChar* p;
+   if (s->buf == NULL)
+      return ix;
+   switch (con->tag) {
+      case Ico_U1:   bits = con->Ico.U1 ? 1 : 0; break;
+      case Ico_U8:   bits = con->Ico.U8;   break;
+      case Ico_U16:  bits = con->Ico.U16;  break;
+      case Ico_U32:  bits = con->Ico.U32;  break;
+      case Ico_U64:  bits = con->Ico.U64;  break;
+      case Ico_F32: {
+         union { Float f; UInt i; } u;
+         vassert(sizeof(Float) == sizeof(UInt));
+         u.f  = con->Ico.F32;
+         bits = u.i;
+         break;
+      }
+      case Ico_F32i: bits = con->Ico.F32i; break;
+      case Ico_F64: {
+         union { Double f; ULong i; } u;
+         vassert(sizeof(Double) == sizeof(ULong));
+         u.f  = con->Ico.F64;
+         bits = u.i;
+         break;
+      }
+      case Ico_F64i: bits = con->Ico.F64i; break;
+      case Ico_V128: bits = con->Ico.V128; break;
+      case Ico_V256: bits = con->Ico.V256; break;
+      default: vpanic("LibVEX_SerializeIRSB: unknown IRConst tag");
+   }
+   p = s->buf + s->off_const_pool + 4 * VEX_IRSER_CONST_WORDS * ix;
+   put32(p + 0, con->tag);
+   put32(p + 4, (UInt)bits);
+   put32(p + 8, (UInt)(bits >> 32));
+   return ix;
+}
+
+static UInt ser_string ( SerState* s, const HChar* str )
+{
+   UInt off = s->str_bytes;
+   UInt n   = 0;
+   while (str[n] != 0)
+      n++;
+   n++;
+   if (s->buf)
+      vex_memcpy(s->buf + s->off_str_pool + off, str, n);
+   s->str_bytes += n;
+   return off;
+}
+
+/* Write the 5 words describing cee at word w of the stmt or expr
+   pool. */
+static void ser_callee ( SerState* s, Bool in_stmt, UInt w,
+                         const IRCallee* cee )
+{
+   ULong addr = (ULong)(HWord)cee->addr;
+   UInt  name = ser_string(s, cee->name);
+   void (*set)(SerState*, UInt, UInt)
+      = in_stmt ? ser_set_stmt : ser_set_expr;
+   set(s, w + 0, (UInt)cee->regparms);
+   set(s, w + 1, cee->mcx_mask);
+   set(s, w + 2, (UInt)addr);
+   set(s, w + 3, (UInt)(addr >> 32));
+   set(s, w + 4, name);
+}
+
+static UInt n_args ( IRExpr* const* args )
+{
+   UInt n = 0;
+   while (args[n] != NULL)
+      n++;
+   return n;
+}
+
+static UInt ser_expr ( SerState* s, const IRExpr* e )
+{
+   UInt w, i, n;
+
+   if (e == NULL)
+      return VEX_IRSER_NONE;
+
+   switch (e->tag) {
+      case Iex_Binder:
+         w = ser_new_expr(s, 2);
+         ser_set_expr(s, w + 1, (UInt)e->Iex.Binder.binder);
+         break;
+      case Iex_Get:
+         w = ser_new_expr(s, 3);
+         ser_set_expr(s, w + 1, (UInt)e->Iex.Get.offset);
+         ser_set_expr(s, w + 2, e->Iex.Get.ty);
+         break;
+      case Iex_GetI:
+         w = ser_new_expr(s, 6);
+         ser_set_expr(s, w + 1, (UInt)e->Iex.GetI.descr->base);
+         ser_set_expr(s, w + 2, e->Iex.GetI.descr->elemTy);
+         ser_set_expr(s, w + 3, (UInt)e->Iex.GetI.descr->nElems);
+         ser_set_expr(s, w + 4, ser_expr(s, e->Iex.GetI.ix));
+         ser_set_expr(s, w + 5, (UInt)e->Iex.GetI.bias);
+         break;
+      case Iex_RdTmp:
+         w = ser_new_expr(s, 2);
+         ser_set_expr(s, w + 1, e->Iex.RdTmp.tmp);
+         break;
+      case Iex_Qop: {
+         const IRQop* qop = e->Iex.Qop.details;
+         w = ser_new_expr(s, 6);
+         ser_set_expr(s, w + 1, qop->op);
+         ser_set_expr(s, w + 2, ser_expr(s, qop->arg1));
+         ser_set_expr(s, w + 3, ser_expr(s, qop->arg2));
+         ser_set_expr(s, w + 4, ser_expr(s, qop->arg3));
+         ser_set_expr(s, w + 5, ser_expr(s, qop->arg4));
+         break;
+      }
+      case Iex_Triop: {
+         const IRTriop* triop = e->Iex.Triop.details;
+         w = ser_new_expr(s, 5);
+         ser_set_expr(s, w + 1, triop->op);
+         ser_set_expr(s, w + 2, ser_expr(s, triop->arg1));
+         ser_set_expr(s, w + 3, ser_expr(s, triop->arg2));
+         ser_set_expr(s, w + 4, ser_expr(s, triop->arg3));
+         break;
+      }
+      case Iex_Binop:
+         w = ser_new_expr(s, 4);
+         ser_set_expr(s, w + 1, e->Iex.Binop.op);
+         ser_set_expr(s, w + 2, ser_expr(s, e->Iex.Binop.arg1));
+         ser_set_expr(s, w + 3, ser_expr(s, e->Iex.Binop.arg2));
+         break;
+      case Iex_Unop:
+         w = ser_new_expr(s, 3);
+         ser_set_expr(s, w + 1, e->Iex.Unop.op);
+         ser_set_expr(s, w + 2, ser_expr(s, e->Iex.Unop.arg));
+         break;
+      case Iex_Load:
+         w = ser_new_expr(s, 4);
+         ser_set_expr(s, w + 1, e->Iex.Load.end);
+         ser_set_expr(s, w + 2, e->Iex.Load.ty);
+         ser_set_expr(s, w + 3, ser_expr(s, e->Iex.Load.addr));
+         break;
+      case Iex_Const:
+         w = ser_new_expr(s, 2);
+         ser_set_expr(s, w + 1, ser_const(s, e->Iex.Const.con));
+         break;
+      case Iex_ITE:
+         w = ser_new_expr(s, 4);
+         ser_set_expr(s, w + 1, ser_expr(s, e->Iex.ITE.cond));
+         ser_set_expr(s, w + 2, ser_expr(s, e->Iex.ITE.iftrue));
+         ser_set_expr(s, w + 3, ser_expr(s, e->Iex.ITE.iffalse));
+         break;
+      case Iex_CCall:
+         n = n_args(e->Iex.CCall.args);
+         w = ser_new_expr(s, 8 + n);
+         ser_callee(s, False, w + 1, e->Iex.CCall.cee);
+         ser_set_expr(s, w + 6, e->Iex.CCall.retty);
+         ser_set_expr(s, w + 7, n);
+         for (i = 0; i < n; i++)
+            ser_set_expr(s, w + 8 + i, ser_expr(s, e->Iex.CCall.args[i]));
+         break;
+      case Iex_VECRET:
+      case Iex_GSPTR:
+         w = ser_new_expr(s, 1);
+         break;
+      default:
+         vpanic("LibVEX_SerializeIRSB: unknown IRExpr tag");
+   }
+   ser_set_expr(s, w, e->tag);
+   return w;
+}
+
+static void ser_stmt ( SerState* s, const IRStmt* st )
+{
+   UInt w, i, n;
+
+   switch (st->tag) {
+      case Ist_NoOp:
+         w = ser_new_stmt(s, 1);
+         break;
+      case Ist_IMark:
+         w = ser_new_stmt(s, 5);
+         ser_set_stmt(s, w + 1, (UInt)st->Ist.IMark.addr);
+         ser_set_stmt(s, w + 2, (UInt)(((ULong)st->Ist.IMark.addr) >> 32));
+         ser_set_stmt(s, w + 3, st->Ist.IMark.len);
+         ser_set_stmt(s, w + 4, st->Ist.IMark.delta);
+         break;
+      case Ist_AbiHint:
+         w = ser_new_stmt(s, 4);
+         ser_set_stmt(s, w + 1, ser_expr(s, st->Ist.AbiHint.base));
+         ser_set_stmt(s, w + 2, (UInt)st->Ist.AbiHint.len);
+         ser_set_stmt(s, w + 3, ser_expr(s, st->Ist.AbiHint.nia));
+         break;
+      case Ist_Put:
+         w = ser_new_stmt(s, 3);
+         ser_set_stmt(s, w + 1, (UInt)st->Ist.Put.offset);
+         ser_set_stmt(s, w + 2, ser_expr(s, st->Ist.Put.data));
+         break;
+      case Ist_PutI: {
+         const IRPutI* puti = st->Ist.PutI.details;
+         w = ser_new_stmt(s, 7);
+         ser_set_stmt(s, w + 1, (UInt)puti->descr->base);
+         ser_set_stmt(s, w + 2, puti->descr->elemTy);
+         ser_set_stmt(s, w + 3, (UInt)puti->descr->nElems);
+         ser_set_stmt(s, w + 4, ser_expr(s, puti->ix));
+         ser_set_stmt(s, w + 5, (UInt)puti->bias);
+         ser_set_stmt(s, w + 6, ser_expr(s, puti->data));
+         break;
+      }
+      case Ist_WrTmp:
+         w = ser_new_stmt(s, 3);
+         ser_set_stmt(s, w + 1, st->Ist.WrTmp.tmp);
+         ser_set_stmt(s, w + 2, ser_expr(s, st->Ist.WrTmp.data));
+         break;
+      case Ist_Store:
+         w = ser_new_stmt(s, 4);
+         ser_set_stmt(s, w + 1, st->Ist.Store.end);
+         ser_set_stmt(s, w + 2, ser_expr(s, st->Ist.Store.addr));
+         ser_set_stmt(s, w + 3, ser_expr(s, st->Ist.Store.data));
+         break;
+      case Ist_StoreG: {
+         const IRStoreG* sg = st->Ist.StoreG.details;
+         w = ser_new_stmt(s, 5);
+         ser_set_stmt(s, w + 1, sg->end);
+         ser_set_stmt(s, w + 2, ser_expr(s, sg->addr));
+         ser_set_stmt(s, w + 3, ser_expr(s, sg->data));
+         ser_set_stmt(s, w + 4, ser_expr(s, sg->guard));
+         break;
+      }
+      case Ist_LoadG: {
+         const IRLoadG* lg = st->Ist.LoadG.details;
+         w = ser_new_stmt(s, 7);
+         ser_set_stmt(s, w + 1, lg->end);
+         ser_set_stmt(s, w + 2, lg->cvt);
+         ser_set_stmt(s, w + 3, lg->dst);
+         ser_set_stmt(s, w + 4, ser_expr(s, lg->addr));
+         ser_set_stmt(s, w + 5, ser_expr(s, lg->alt));
+         ser_set_stmt(s, w + 6, ser_expr(s, lg->guard));
+         break;
+      }
+      case Ist_CAS: {
+         const IRCAS* cas = st->Ist.CAS.details;
+         w = ser_new_stmt(s, 9);
+         ser_set_stmt(s, w + 1, cas->oldHi);
+         ser_set_stmt(s, w + 2, cas->oldLo);
+         ser_set_stmt(s, w + 3, cas->end);
+         ser_set_stmt(s, w + 4, ser_expr(s, cas->addr));
+         ser_set_stmt(s, w + 5, ser_expr(s, cas->expdHi));
+         ser_set_stmt(s, w + 6, ser_expr(s, cas->expdLo));
+         ser_set_stmt(s, w + 7, ser_expr(s, cas->dataHi));
+         ser_set_stmt(s, w + 8, ser_expr(s, cas->dataLo));
+         break;
+      }
+      case Ist_LLSC:
+         w = ser_new_stmt(s, 5);
+         ser_set_stmt(s, w + 1, st->Ist.LLSC.end);
+         ser_set_stmt(s, w + 2, st->Ist.LLSC.result);
+         ser_set_stmt(s, w + 3, ser_expr(s, st->Ist.LLSC.addr));
+         ser_set_stmt(s, w + 4, ser_expr(s, st->Ist.LLSC.storedata));
+         break;
+      case Ist_Dirty: {
+         const IRDirty* d = st->Ist.Dirty.details;
+         UInt fx;
+         n = n_args(d->args);
+         w = ser_new_stmt(s, 13 + 3 * d->nFxState + n);
+         ser_callee(s, True, w + 1, d->cee);
+         ser_set_stmt(s, w + 6, ser_expr(s, d->guard));
+         ser_set_stmt(s, w + 7, d->tmp);
+         ser_set_stmt(s, w + 8, d->mFx);
+         ser_set_stmt(s, w + 9, ser_expr(s, d->mAddr));
+         ser_set_stmt(s, w + 10, (UInt)d->mSize);
+         ser_set_stmt(s, w + 11, (UInt)d->nFxState);
+         fx = w + 12;
+         for (i = 0; i < (UInt)d->nFxState; i++, fx += 3) {
+            ser_set_stmt(s, fx + 0, d->fxState[i].fx);
+            ser_set_stmt(s, fx + 1, d->fxState[i].offset
+                                    | (((UInt)d->fxState[i].size) << 16));
+            ser_set_stmt(s, fx + 2, d->fxState[i].nRepeats
+                                    | (((UInt)d->fxState[i].repeatLen) << 8));
+         }
+         ser_set_stmt(s, fx, n);
+         for (i = 0; i < n; i++)
+            ser_set_stmt(s, fx + 1 + i, ser_expr(s, d->args[i]));
+         break;
+      }
+      case Ist_MBE:
+         w = ser_new_stmt(s, 2);
+         ser_set_stmt(s, w + 1, st->Ist.MBE.event);
+         break;
+      case Ist_Exit:
+         w = ser_new_stmt(s, 5);
+         ser_set_stmt(s, w + 1, ser_expr(s, st->Ist.Exit.guard));
+         ser_set_stmt(s, w + 2, ser_const(s, st->Ist.Exit.dst));
+         ser_set_stmt(s, w + 3, st->Ist.Exit.jk);
+         ser_set_stmt(s, w + 4, (UInt)st->Ist.Exit.offsIP);
+         break;
+      default:
+         vpanic("LibVEX_SerializeIRSB: unknown IRStmt tag");
+   }
+   ser_set_stmt(s, w, st->tag);
+   if (s->buf)
+      put32(s->buf + s->off_stmt_tab + 4 * s->n_stmts, w);
+   s->n_stmts++;
+}
+
+static UInt ser_irsb ( SerState* s, const IRSB* bb )
+{
+   Int  i;
+   UInt next;
+   for (i = 0; i < bb->stmts_used; i++)
+      ser_stmt(s, bb->stmts[i]);
+   next = ser_expr(s, bb->next);
+   return next;
+}
+
+static inline UInt round4 ( UInt n )
+{
+   return (n + 3) & ~3;
+}
+
+/* Exported to library client. */
+
+UInt LibVEX_SerializeIRSB ( const IRSB* bb, /*OUT*/UChar* buf, UInt buf_szB )
+{
+   SerState s;
+   UInt     off_types, size, next, i;
+   UInt     stmt_words, expr_words, n_consts, str_bytes;
+
+   vassert(bb != NULL);
+
+   /* Pass 1: find the section sizes. */
+   vex_bzero(&s, sizeof(s));
+   ser_irsb(&s, bb);
+   stmt_words = s.stmt_words;
+   expr_words = s.expr_words;
+   n_consts   = s.n_consts;
+   str_bytes  = s.str_bytes;
+
+   off_types        = 4 * VEX_IRSER_HDR_WORDS;
+   s.off_stmt_tab   = off_types + 4 * (UInt)bb->tyenv->types_used;
+   s.off_stmt_pool  = s.off_stmt_tab + 4 * (UInt)bb->stmts_used;
+   s.off_expr_pool  = s.off_stmt_pool + 4 * stmt_words;
+   s.off_const_pool = s.off_expr_pool + 4 * expr_words;
+   s.off_str_pool   = s.off_const_pool + 4 * VEX_IRSER_CONST_WORDS * n_consts;
+   size             = round4(s.off_str_pool + str_bytes);
+
+   if (buf == NULL || buf_szB < size)
+      return size;
+
+   /* Pass 2: fill them in. */
+   vex_bzero(buf, size);
+   s.buf        = buf;
+   s.n_stmts    = 0;
+   s.stmt_words = 0;
+   s.expr_words = 0;
+   s.n_consts   = 0;
+   s.str_bytes  = 0;
+   next = ser_irsb(&s, bb);
+   vassert(s.stmt_words == stmt_words && s.expr_words == expr_words
+           && s.n_consts == n_consts && s.str_bytes == str_bytes);
+
+   for (i = 0; i < (UInt)bb->tyenv->types_used; i++)
+      put32(buf + off_types + 4 * i, bb->tyenv->types[i]);
+
+   put32(buf + 4 * 0,  VEX_IRSER_MAGIC);
+   put32(buf + 4 * 1,  VEX_IRSER_VERSION);
+   put32(buf + 4 * 2,  size);
+   put32(buf + 4 * 3,  (UInt)bb->tyenv->types_used);
+   put32(buf + 4 * 4,  off_types);
+   put32(buf + 4 * 5,  (UInt)bb->stmts_used);
+   put32(buf + 4 * 6,  s.off_stmt_tab);
+   put32(buf + 4 * 7,  stmt_words);
+   put32(buf + 4 * 8,  s.off_stmt_pool);
+   put32(buf + 4 * 9,  expr_words);
+   put32(buf + 4 * 10, s.off_expr_pool);
+   put32(buf + 4 * 11, n_consts);
+   put32(buf + 4 * 12, s.off_const_pool);
+   put32(buf + 4 * 13, str_bytes);
+   put32(buf + 4 * 14, s.off_str_pool);
+   put32(buf + 4 * 15, next);
+   put32(buf + 4 * 16, bb->jumpkind);
+   put32(buf + 4 * 17, (UInt)bb->offsIP);
+   return size;
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Reading                                                 ---*/
+/*---------------------------------------------------------------*/
+
+/* The reader does not trust its input: anything out of range makes
+   it give up and return NULL rather than assert.  Child expressions
+   are always written after their parents, so insisting that every
+   reference points strictly forwards is enough to rule out cycles. */
+
+typedef
+   struct {
+      const UChar* buf;
+      Bool   ok;
+      UInt   n_exprs;   /* expressions decoded so far */
+      UInt   n_types;
+      UInt   off_stmt_pool, stmt_words;
+      UInt   off_expr_pool, expr_words;
+      UInt   off_const_pool, n_consts;
+      UInt   off_str_pool, str_bytes;
+      ULong  callee_delta;  /* added to every callee address */
+   }
+   DesState;
+
+static UInt des_stmt_word ( DesState* d, UInt w )
+{
+   if (w >= d->stmt_words) {
+      d->ok = False;
+      return 0;
+   }
+   return get32(d->buf + d->off_stmt_pool + 4 * w);
+}
+
+static UInt des_expr_word ( DesState* d, UInt w )
+{
+   if (w >= d->expr_words) {
+      d->ok = False;
+      return 0;
+   }
+   return get32(d->buf + d->off_expr_pool + 4 * w);
+}
+
+static Bool des_type_ok ( UInt ty )
+{
+   return isPlausibleIRType((IRType)ty);
+}
+
+static IREndness des_end ( DesState* d, UInt end )
+{
+   if (end != Iend_LE && end != Iend_BE) {
+      d->ok = False;
+      return Iend_LE;
+   }
+   return end;
+}
+
+static IRTemp des_tmp ( DesState* d, UInt tmp )
+{
+   if (tmp >= d->n_types)
+      d->ok = False;
+   return tmp;
+}
+
+static IRConst* des_const ( DesState* d, UInt ix )
+{
+   const UChar* p;
+   ULong bits;
+   if (ix >= d->n_consts) {
+      d->ok = False;
+      return NULL;
+   }
+   p    = d->buf + d->off_const_pool + 4 * VEX_IRSER_CONST_WORDS * ix;
+   bits = ((ULong)get32(p + 4)) | (((ULong)get32(p + 8)) << 32);
+   switch (get32(p)) {
+      case Ico_U1:   return IRConst_U1(toBool(bits & 1));
+      case Ico_U8:   return IRConst_U8(toUChar(bits));
+      case Ico_U16:  return IRConst_U16(toUShort(bits));
+      case Ico_U32:  return IRConst_U32((UInt)bits);
+      case Ico_U64:  return IRConst_U64(bits);
+      case Ico_F32: {
+         union { Float f; UInt i; } u;
+         u.i = (UInt)bits;
+         return IRConst_F32(u.f);
+      }
+      case Ico_F32i: return IRConst_F32i((UInt)bits);
+      case Ico_F64: {
+         union { Double f; ULong i; } u;
+         u.i = bits;
+         return IRConst_F64(u.f);
+      }
+      case Ico_F64i: return IRConst_F64i(bits);
+      case Ico_V128: return IRConst_V128(toUShort(bits));
+      case Ico_V256: return IRConst_V256((UInt)bits);
+      default:
+         d->ok = False;
+         return NULL;
+   }
+}
+
+/* Read the 5 callee words at w.  The name is copied into the storage
+   area, since the buffer may not outlive the IRSB. */
+static IRCallee* des_callee ( DesState* d, Bool in_stmt, UInt w )
+{
+   UInt (*get)(DesState*, UInt)
+      = in_stmt ? des_stmt_word : des_expr_word;
+   UInt   regparms = get(d, w + 0);
+   UInt   mcx_mask = get(d, w + 1);
+   ULong  addr     = ((ULong)get(d, w + 2)) | (((ULong)get(d, w + 3)) << 32);
+   UInt   name     = get(d, w + 4);
+   UInt   len;
+   HChar* str;
+   IRCallee* cee;
+
+   addr += d->callee_delta;
+   if (!d->ok || regparms > 3 || addr == 0 || name >= d->str_bytes) {
+      d->ok = False;
+      return NULL;
+   }
+   for (len = 0; name + len < d->str_bytes; len++)
+      if (d->buf[d->off_str_pool + name + len] == 0)
+         break;
+   if (name + len >= d->str_bytes) {
+      d->ok = False;
+      return NULL;
+   }
+   str = LibVEX_Alloc_inline(len + 1);
+   vex_memcpy(str, d->buf + d->off_str_pool + name, len + 1);
+
+   cee = mkIRCallee((Int)regparms, str, (void*)(HWord)addr);
+   cee->mcx_mask = mcx_mask;
+   return cee;
+}
+
+static IRRegArray* des_regarray ( DesState* d, UInt base, UInt elemTy,
+                                  UInt nElems )
+{
+   if (base > 10000 || !des_type_ok(elemTy) || elemTy == Ity_I1
+       || nElems == 0 || nElems > 500) {
+      d->ok = False;
+      return NULL;
+   }
+   return mkIRRegArray((Int)base, (IRType)elemTy, (Int)nElems);
+}
+
+static IRExpr* des_expr ( DesState* d, UInt w, UInt parent );
+
+/* Read the reference at word i of the expr at w. */
+static IRExpr* des_expr_ref ( DesState* d, UInt w, UInt i )
+{
+   IRExpr* e = des_expr(d, des_expr_word(d, w + i), w);
+   if (e == NULL)
+      d->ok = False;
+   return e;
+}
+
+static IRExpr** des_args ( DesState* d, Bool in_stmt, UInt w, UInt n,
+                           UInt parent )
+{
+   IRExpr** args;
+   UInt     i;
+   if (n > 64) {
+      d->ok = False;
+      return NULL;
+   }
+   args = LibVEX_Alloc_inline((n + 1) * sizeof(IRExpr*));
+   for (i = 0; i < n; i++) {
+      UInt ref = in_stmt ? des_stmt_word(d, w + i) : des_expr_word(d, w + i);
+      args[i] = des_expr(d, ref, parent);
+      if (args[i] == NULL)
+         d->ok = False;
+   }
+   args[n] = NULL;
+   return args;
+}
+
+/* Decode the expression at w.  parent is the word index of the
+   referring expression, or VEX_IRSER_NONE if it is referred to from
+   a statement or the header. */
+static IRExpr* des_expr ( DesState* d, UInt w, UInt parent )
+{
+   IRExpr* e = NULL;
+
+   if (!d->ok || w == VEX_IRSER_NONE)
+      return NULL;
+   /* A well-formed buffer is a forest, so nothing is decoded twice;
+      don't let a malformed one make us do exponential work. */
+   if ((parent != VEX_IRSER_NONE && w <= parent)
+       || ++d->n_exprs > d->expr_words) {
+      d->ok = False;
+      return NULL;
+   }
+
+   switch (des_expr_word(d, w)) {
+      case Iex_Binder:
+         e = IRExpr_Binder((Int)des_expr_word(d, w + 1));
+         break;
+      case Iex_Get: {
+         UInt ty = des_expr_word(d, w + 2);
+         if (!des_type_ok(ty))
+            d->ok = False;
+         e = IRExpr_Get((Int)des_expr_word(d, w + 1), (IRType)ty);
+         break;
+      }
+      case Iex_GetI: {
+         IRRegArray* descr = des_regarray(d, des_expr_word(d, w + 1),
+                                             des_expr_word(d, w + 2),
+                                             des_expr_word(d, w + 3));
+         IRExpr* ix = des_expr_ref(d, w, 4);
+         if (!d->ok)
+            return NULL;
+         e = IRExpr_GetI(descr, ix, (Int)des_expr_word(d, w + 5));
+         break;
+      }
+      case Iex_RdTmp:
+         e = IRExpr_RdTmp(des_tmp(d, des_expr_word(d, w + 1)));
+         break;
+      case Iex_Qop:
+         e = IRExpr_Qop(des_expr_word(d, w + 1),
+                        des_expr_ref(d, w, 2), des_expr_ref(d, w, 3),
+                        des_expr_ref(d, w, 4), des_expr_ref(d, w, 5));
+         break;
+      case Iex_Triop:
+         e = IRExpr_Triop(des_expr_word(d, w + 1),
+                          des_expr_ref(d, w, 2), des_expr_ref(d, w, 3),
+                          des_expr_ref(d, w, 4));
+         break;
+      case Iex_Binop:
+         e = IRExpr_Binop(des_expr_word(d, w + 1),
+                          des_expr_ref(d, w, 2), des_expr_ref(d, w, 3));
+         break;
+      case Iex_Unop:
+         e = IRExpr_Unop(des_expr_word(d, w + 1),
+                         des_expr_ref(d, w, 2));
+         break;
+      case Iex_Load: {
+         UInt ty = des_expr_word(d, w + 2);
+         if (!des_type_ok(ty))
+            d->ok = False;
+         e = IRExpr_Load(des_end(d, des_expr_word(d, w + 1)), (IRType)ty,
+                         des_expr_ref(d, w, 3));
+         break;
+      }
+      case Iex_Const:
+         e = IRExpr_Const(des_const(d, des_expr_word(d, w + 1)));
+         break;
+      case Iex_ITE:
+         e = IRExpr_ITE(des_expr_ref(d, w, 1), des_expr_ref(d, w, 2),
+                        des_expr_ref(d, w, 3));
+         break;
+      case Iex_CCall: {
+         IRCallee* cee   = des_callee(d, False, w + 1);
+         UInt      retty = des_expr_word(d, w + 6);
+         IRExpr**  args  = des_args(d, False, w + 8,
+                                    des_expr_word(d, w + 7), w);
+         if (!d->ok || !des_type_ok(retty))
+            return NULL;
+         e = IRExpr_CCall(cee, (IRType)retty, args);
+         break;
+      }
+      case Iex_VECRET:
+         e = IRExpr_VECRET();
+         break;
+      case Iex_GSPTR:
+         e = IRExpr_GSPTR();
+         break;
+      default:
+         d->ok = False;
+         break;
+   }
+   return d->ok ? e : NULL;
+}
+
+/* Decode an expression referred to from a statement.  Only a few
+   fields are allowed to be NULL. */
+static IRExpr* des_stmt_expr ( DesState* d, UInt ref, Bool mandatory )
+{
+   IRExpr* e = des_expr(d, ref, VEX_IRSER_NONE);
+   if (e == NULL && (mandatory || ref != VEX_IRSER_NONE))
+      d->ok = False;
+   return e;
+}
+
+static IRStmt* des_stmt ( DesState* d, UInt w )
+{
+   IRStmt* st = NULL;
+   UInt    i;
+
+#  define SW(_i)  des_stmt_word(d, w + (_i))
+#  define SE(_i)  des_stmt_expr(d, SW(_i), True)
+#  define SO(_i)  des_stmt_expr(d, SW(_i), False)
+
+   switch (SW(0)) {
+      case Ist_NoOp:
+         st = IRStmt_NoOp();
+         break;
+      case Ist_IMark: {
+         ULong addr = ((ULong)SW(1)) | (((ULong)SW(2)) << 32);
+         st = IRStmt_IMark((Addr)addr, SW(3), toUChar(SW(4)));
+         break;
+      }
+      case Ist_AbiHint:
+         st = IRStmt_AbiHint(SE(1), (Int)SW(2), SE(3));
+         break;
+      case Ist_Put:
+         st = IRStmt_Put((Int)SW(1), SE(2));
+         break;
+      case Ist_PutI: {
+         IRRegArray* descr = des_regarray(d, SW(1), SW(2), SW(3));
+         IRExpr*     ix    = SE(4);
+         IRExpr*     data  = SE(6);
+         if (!d->ok)
+            return NULL;
+         st = IRStmt_PutI(mkIRPutI(descr, ix, (Int)SW(5), data));
+         break;
+      }
+      case Ist_WrTmp:
+         st = IRStmt_WrTmp(des_tmp(d, SW(1)), SE(2));
+         break;
+      case Ist_Store:
+         st = IRStmt_Store(des_end(d, SW(1)), SE(2), SE(3));
+         break;
+      case Ist_StoreG:
+         st = IRStmt_StoreG(des_end(d, SW(1)), SE(2), SE(3), SE(4));
+         break;
+      case Ist_LoadG:
+         st = IRStmt_LoadG(des_end(d, SW(1)), SW(2),
+                           des_tmp(d, SW(3)), SE(4), SE(5), SE(6));
+         break;
+      case Ist_CAS: {
+         UInt oldHi = SW(1);
+         if (oldHi != IRTemp_INVALID)
+            des_tmp(d, oldHi);
+         st = IRStmt_CAS(mkIRCAS(oldHi, des_tmp(d, SW(2)),
+                                 des_end(d, SW(3)), SE(4),
+                                 SO(5), SE(6), SO(7), SE(8)));
+         break;
+      }
+      case Ist_LLSC:
+         st = IRStmt_LLSC(des_end(d, SW(1)), des_tmp(d, SW(2)),
+                          SE(3), SO(4));
+         break;
+      case Ist_Dirty: {
+         IRDirty* dirty = emptyIRDirty();
+         UInt     fx, nFx;
+         dirty->cee   = des_callee(d, True, w + 1);
+         dirty->guard = SE(6);
+         dirty->tmp   = SW(7);
+         if (dirty->tmp != IRTemp_INVALID)
+            des_tmp(d, dirty->tmp);
+         dirty->mFx   = SW(8);
+         dirty->mAddr = SO(9);
+         dirty->mSize = (Int)SW(10);
+         nFx          = SW(11);
+         if (nFx > VEX_N_FXSTATE) {
+            d->ok = False;
+            return NULL;
+         }
+         dirty->nFxState = (Int)nFx;
+         fx = 12;
+         for (i = 0; i < nFx; i++, fx += 3) {
+            dirty->fxState[i].fx        = SW(fx);
+            dirty->fxState[i].offset    = toUShort(SW(fx + 1));
+            dirty->fxState[i].size      = toUShort(SW(fx + 1) >> 16);
+            dirty->fxState[i].nRepeats  = toUChar(SW(fx + 2));
+            dirty->fxState[i].repeatLen = toUChar(SW(fx + 2) >> 8);
+         }
+         dirty->args = des_args(d, True, w + fx + 1, SW(fx),
+                                VEX_IRSER_NONE);
+         st = IRStmt_Dirty(dirty);
+         break;
+      }
+      case Ist_MBE:
+         st = IRStmt_MBE(SW(1));
+         break;
+      case Ist_Exit: {
+         IRExpr*  guard = SE(1);
+         IRConst* dst   = des_const(d, SW(2));
+         if (!d->ok)
+            return NULL;
+         st = IRStmt_Exit(guard, SW(3), dst, (Int)SW(4));
+         break;
+      }
+      default:
+         d->ok = False;
+         break;
+   }
+
+#  undef SW
+#  undef SE
+#  undef SO
+
+   return d->ok ? st : NULL;
+}
+
+/* Check that the section [off, +n*unit) lies within the first size
+   bytes of the buffer. */
+static Bool section_ok ( UInt off, UInt n, UInt unit, UInt size )
+{
+   return off <= size && n <= (size - off) / unit && (off & 3) == 0;
+}
+
+IRSB* vexDeserializeIRSB ( const UChar* buf, UInt buf_szB,
+                           ULong callee_delta )
+{
+   DesState d;
+   IRSB*    bb;
+   UInt     size, n_stmts, off_types, off_stmt_tab, i;
+
+   if (buf == NULL || buf_szB < 4 * VEX_IRSER_HDR_WORDS
+       || get32(buf + 4 * 0) != VEX_IRSER_MAGIC
+       || get32(buf + 4 * 1) != VEX_IRSER_VERSION)
+      return NULL;
+
+   size = get32(buf + 4 * 2);
+   if (size > buf_szB)
+      return NULL;
+
+   vex_bzero(&d, sizeof(d));
+   d.buf            = buf;
+   d.ok             = True;
+   d.callee_delta   = callee_delta;
+   d.n_types        = get32(buf + 4 * 3);
+   off_types        = get32(buf + 4 * 4);
+   n_stmts          = get32(buf + 4 * 5);
+   off_stmt_tab     = get32(buf + 4 * 6);
+   d.stmt_words     = get32(buf + 4 * 7);
+   d.off_stmt_pool  = get32(buf + 4 * 8);
+   d.expr_words     = get32(buf + 4 * 9);
+   d.off_expr_pool  = get32(buf + 4 * 10);
+   d.n_consts       = get32(buf + 4 * 11);
+   d.off_const_pool = get32(buf + 4 * 12);
+   d.str_bytes      = get32(buf + 4 * 13);
+   d.off_str_pool   = get32(buf + 4 * 14);
+
+   if (!section_ok(off_types, d.n_types, 4, size)
+       || !section_ok(off_stmt_tab, n_stmts, 4, size)
+       || !section_ok(d.off_stmt_pool, d.stmt_words, 4, size)
+       || !section_ok(d.off_expr_pool, d.expr_words, 4, size)
+       || !section_ok(d.off_const_pool, d.n_consts,
+                      4 * VEX_IRSER_CONST_WORDS, size)
+       || !section_ok(d.off_str_pool, d.str_bytes, 1, size))
+      return NULL;
+
+   bb = emptyIRSB();
+   for (i = 0; i < d.n_types; i++) {
+      UInt ty = get32(buf + off_types + 4 * i);
+      if (!des_type_ok(ty))
+         return NULL;
+      newIRTemp(bb->tyenv, (IRType)ty);
+   }
+   for (i = 0; i < n_stmts; i++) {
+      IRStmt* st = des_stmt(&d, get32(buf + off_stmt_tab + 4 * i));
+      if (st == NULL)
+         return NULL;
+      addStmtToIRSB(bb, st);
+   }
+   bb->next     = des_stmt_expr(&d, get32(buf + 4 * 15), True);
+   bb->jumpkind = get32(buf + 4 * 16);
+   bb->offsIP   = (Int)get32(buf + 4 * 17);
+
+   return d.ok ? bb : NULL;
+}
+
+/* Exported to library client. */
+
+IRSB* LibVEX_DeserializeIRSB ( const UChar* buf, UInt buf_szB )
+{
+   return vexDeserializeIRSB(buf, buf_szB, 0);
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- end                                      ir_serialize.c ---*/
+/*---------------------------------------------------------------*/
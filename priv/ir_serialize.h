@@ -0,0 +1,45 @@
+
+/*---------------------------------------------------------------*/
+/*--- begin                                    ir_serialize.h ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __VEX_IR_SERIALIZE_H
+#define __VEX_IR_SERIALIZE_H
+
+#include "libvex_basictypes.h"
+#include "libvex_ir.h"
+
+/* As LibVEX_DeserializeIRSB, but add callee_delta to the address of
+   every helper.  Used to load IR that was written by a copy of the
+   library mapped at a different address. */
+extern
+IRSB* vexDeserializeIRSB ( const UChar* buf, UInt buf_szB,
+                           ULong callee_delta );
+
+#endif /* ndef __VEX_IR_SERIALIZE_H */
+
+/*---------------------------------------------------------------*/
+/*--- end                                      ir_serialize.h ---*/
+/*---------------------------------------------------------------*/
@@ -56,10 +56,11 @@ void (*vex_log_bytes) ( const HChar*, SizeT nbytes ) = NULL;
 Int vex_debuglevel = 0;
 
 /* trace flags */
-Int vex_traceflags = 0;
+VEX_TLS Int vex_traceflags = 0;
 
 /* Max # guest insns per bb */
-VexControl vex_control = { 0,0,False,0,0,0 };
+VexControl vex_control_default = { 0,0,False,0,0,0 };
+VEX_TLS VexControl vex_control = { 0,0,False,0,0,0 };
 
 
 
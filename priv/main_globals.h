@@ -58,10 +58,20 @@ extern void (*vex_log_bytes) ( const HChar*, SizeT nbytes );
 extern Int vex_debuglevel;
 
 /* trace flags */
-extern Int vex_traceflags;
+extern VEX_TLS Int vex_traceflags;
 
-/* Optimiser/front-end control */
-extern VexControl vex_control;
+/* Optimiser/front-end control, as set by LibVEX_Init and
+   LibVEX_Update_Control. */
+extern VexControl vex_control_default;
+
+/* Optimiser/front-end control in force for the translation in
+   progress on this thread.  Loaded from vex_control_default by the
+   plain entry points, or from the VexContext by the _ctx ones. */
+extern VEX_TLS VexControl vex_control;
+
+/* Load vex_control as appropriate for the calling thread.  In
+   main_main.c. */
+extern void vexLoadControl ( void );
 
 
 /* vex_traceflags values */
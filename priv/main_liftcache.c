@@ -0,0 +1,590 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*---------------------------------------------------------------*/
+/*--- begin                                   main_liftcache.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* The lift cache described in pub/libvex.h. */
+
+#include "libvex_basictypes.h"
+#include "libvex_ir.h"
+#include "libvex.h"
+
+#include "main_globals.h"
+#include "main_util.h"
+#include "ir_serialize.h"
+
+
+/*---------------------------------------------------------------*/
+/*--- Entries                                                 ---*/
+/*---------------------------------------------------------------*/
+
+/* An entry is a header of little-endian words followed by the flat
+   IRSB image.  The same bytes are kept in memory and handed to the
+   persistent store, so an entry that comes back from the store is
+   checked as carefully as any other untrusted input.
+
+   Header (word offsets):
+      0 LC_MAGIC           1 LC_VERSION
+      2 key, low           3 key, high
+      4 bytes hash, low    5 bytes hash, high
+      6 anchor, low        7 anchor, high
+      8 extents.n_used     9..14 extents.base[0..2], low/high pairs
+     15..17 extents.len[0..2]
+     18 needs_self_check result
+     19 n_sc_extents      20 n_guest_instrs
+     21 pxControl         22 image size in bytes
+     23 unused
+
+   The anchor is the address of LibVEX_Lift in the library that made
+   the entry; the difference from ours is applied to the helper
+   addresses in the image. */
+
+#define LC_MAGIC      0x434C5856  /* "VXLC" */
+#define LC_VERSION    1
+#define LC_HDR_WORDS  24
+#define LC_HDR_BYTES  (4 * LC_HDR_WORDS)
+
+typedef
+   struct _LCEntry {
+      struct _LCEntry* chain;   /* next in hash bucket */
+      struct _LCEntry* older;   /* LRU list */
+      struct _LCEntry* newer;
+      ULong  key;
+      UInt   szB;               /* of blob */
+      UChar* blob;
+   }
+   LCEntry;
+
+struct _VexLiftCache {
+   VexLiftCacheConfig config;
+   LCEntry**          buckets;
+   UInt               n_buckets;   /* power of 2 */
+   LCEntry*           newest;
+   LCEntry*           oldest;
+   const LCEntry*     last;        /* for LibVEX_LiftCacheImage */
+   VexLiftCacheStats  stats;
+};
+
+static inline void put32 ( UChar* p, UInt w )
+{
+   p[0] = toUChar(w);
+   p[1] = toUChar(w >> 8);
+   p[2] = toUChar(w >> 16);
+   p[3] = toUChar(w >> 24);
+}
+
+static inline UInt get32 ( const UChar* p )
+{
+   return ((UInt)p[0]) | (((UInt)p[1]) << 8)
+          | (((UInt)p[2]) << 16) | (((UInt)p[3]) << 24);
+}
+
+static inline void put64 ( UChar* p, ULong w )
+{
+   put32(p, (UInt)w);
+   put32(p + 4, (UInt)(w >> 32));
+}
+
+static inline ULong get64 ( const UChar* p )
+{
+   return ((ULong)get32(p)) | (((ULong)get32(p + 4)) << 32);
+}
+
+static inline UInt hdr ( const UChar* blob, UInt w )
+{
+   return get32(blob + 4 * w);
+}
+
+static inline ULong hdr64 ( const UChar* blob, UInt w )
+{
+   return get64(blob + 4 * w);
+}
+
+static ULong anchor ( void )
+{
+   return (ULong)(HWord)&LibVEX_Lift;
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Hashing                                                 ---*/
+/*---------------------------------------------------------------*/
+
+static inline ULong mix64 ( ULong h )
+{
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDULL;
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+static inline ULong hash_word ( ULong h, ULong w )
+{
+   return mix64(h ^ (w + 0x9E3779B97F4A7C15ULL));
+}
+
+static ULong hash_bytes ( ULong h, const UChar* p, UInt n )
+{
+   UInt i;
+   h = hash_word(h, n);
+   for (i = 0; i + 8 <= n; i += 8)
+      h = hash_word(h, get64(p + i));
+   if (i < n) {
+      ULong w = 0;
+      UInt  sh = 0;
+      for (; i < n; i++, sh += 8)
+         w |= ((ULong)p[i]) << sh;
+      h = hash_word(h, w);
+   }
+   return h;
+}
+
+static ULong hash_archinfo ( ULong h, const VexArchInfo* ai )
+{
+   h = hash_word(h, ai->hwcaps);
+   h = hash_word(h, ai->endness);
+   h = hash_word(h, ai->hwcache_info.num_levels);
+   h = hash_word(h, ai->hwcache_info.num_caches);
+   h = hash_word(h, ai->hwcache_info.icaches_maintain_coherence);
+   h = hash_word(h, (UInt)ai->ppc_icache_line_szB);
+   h = hash_word(h, ai->ppc_dcbz_szB);
+   h = hash_word(h, ai->ppc_dcbzl_szB);
+   h = hash_word(h, ai->arm64_dMinLine_lg2_szB);
+   h = hash_word(h, ai->arm64_iMinLine_lg2_szB);
+   h = hash_word(h, ai->x86_cr0);
+   return h;
+}
+
+static ULong hash_abiinfo ( ULong h, const VexAbiInfo* abi )
+{
+   h = hash_word(h, (UInt)abi->guest_stack_redzone_size);
+   h = hash_word(h, abi->guest_amd64_assume_fs_is_const);
+   h = hash_word(h, abi->guest_amd64_assume_gs_is_const);
+   h = hash_word(h, abi->guest_ppc_zap_RZ_at_blr);
+   h = hash_word(h, abi->guest_ppc_zap_RZ_at_bl != NULL);
+   h = hash_word(h, abi->host_ppc_calls_use_fndescrs);
+   h = hash_word(h, abi->guest_mips_fp_mode64);
+   return h;
+}
+
+/* Everything in VexControl that the front end and iropt look at.
+   Keep in step with the struct. */
+static ULong hash_control ( ULong h, const VexControl* vcon )
+{
+   h = hash_word(h, (UInt)vcon->iropt_level);
+   h = hash_word(h, vcon->iropt_register_updates_default);
+   h = hash_word(h, (UInt)vcon->iropt_unroll_thresh);
+   h = hash_word(h, (UInt)vcon->guest_max_insns);
+   h = hash_word(h, (UInt)vcon->guest_max_bytes);
+   h = hash_word(h, (UInt)vcon->guest_chase_thresh);
+   h = hash_word(h, vcon->guest_chase_cond);
+   h = hash_word(h, vcon->arm_allow_optimizing_lookback);
+   h = hash_word(h, vcon->arm64_allow_reordered_writeback);
+   h = hash_word(h, vcon->x86_optimize_callpop_idiom);
+   return h;
+}
+
+static ULong cache_key ( const VexLiftCache* cache,
+                         const VexTranslateArgs* vta )
+{
+   ULong h = cache->config.salt;
+   h = hash_word(h, LC_VERSION);
+   h = hash_word(h, VEX_IRSER_VERSION);
+   h = hash_word(h, vta->guest_bytes_addr);
+   h = hash_word(h, vta->arch_guest);
+   h = hash_archinfo(h, &vta->archinfo_guest);
+   h = hash_word(h, vta->arch_host);
+   h = hash_archinfo(h, &vta->archinfo_host);
+   h = hash_abiinfo(h, &vta->abiinfo_both);
+   h = hash_control(h, &vex_control);
+   h = hash_word(h, vta->sigill_diag);
+   h = hash_word(h, vta->lift_mode);
+   h = hash_word(h, vta->preamble_function != NULL);
+   h = hash_word(h, vta->instrument1 != NULL);
+   h = hash_word(h, vta->instrument2 != NULL);
+   return h;
+}
+
+/* Hash the guest bytes covered by vge, as they are now. */
+static ULong hash_extents ( const VexTranslateArgs* vta,
+                            const VexGuestExtents* vge )
+{
+   ULong h = vge->n_used;
+   UInt  i;
+   for (i = 0; i < vge->n_used; i++) {
+      const UChar* p = vta->guest_bytes
+                       + (vge->base[i] - vta->guest_bytes_addr);
+      h = hash_word(h, vge->base[i]);
+      h = hash_bytes(h, p, vge->len[i]);
+   }
+   return h;
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Matching                                                ---*/
+/*---------------------------------------------------------------*/
+
+/* Check the header of a blob of szB bytes that claims to be for key,
+   and pull out its extents.
+
+   hash_extents is about to read the guest bytes the extents cover, so
+   they must be ones the front end could have made from vta: the first
+   starting at guest_bytes_addr, no more than guest_max_bytes in all,
+   and each of the others either carrying straight on from the one
+   before or starting somewhere chase_into_ok allows.  Those are the
+   only guest bytes lifting vta would read. */
+static Bool blob_ok ( const UChar* blob, UInt szB, ULong key,
+                      const VexTranslateArgs* vta,
+                      /*OUT*/VexGuestExtents* vge )
+{
+   UInt i, total = 0;
+   if (szB < LC_HDR_BYTES
+       || hdr(blob, 0) != LC_MAGIC || hdr(blob, 1) != LC_VERSION
+       || hdr64(blob, 2) != key
+       || hdr(blob, 22) != szB - LC_HDR_BYTES)
+      return False;
+   vge->n_used = toUShort(hdr(blob, 8));
+   if (vge->n_used < 1 || vge->n_used > 3)
+      return False;
+   for (i = 0; i < 3; i++) {
+      vge->base[i] = (Addr)hdr64(blob, 9 + 2 * i);
+      vge->len[i]  = toUShort(hdr(blob, 15 + i));
+      if (hdr(blob, 15 + i) >= 10000)
+         return False;
+   }
+   if (vge->base[0] != vta->guest_bytes_addr)
+      return False;
+   for (i = 0; i < vge->n_used; i++) {
+      if (vge->base[i] + vge->len[i] < vge->base[i])
+         return False;
+      if (i > 0
+          && vge->base[i] != vge->base[i-1] + vge->len[i-1]
+          && !vta->chase_into_ok(vta->callback_opaque, vge->base[i]))
+         return False;
+      total += vge->len[i];
+   }
+   return total <= (UInt)vex_control.guest_max_bytes;
+}
+
+/* Does the blob describe what lifting vta would produce now? */
+static Bool blob_matches ( const UChar* blob, const VexTranslateArgs* vta,
+                           const VexGuestExtents* vge )
+{
+   VexRegisterUpdates px;
+   UInt               sc;
+
+   if (hash_extents(vta, vge) != hdr64(blob, 4))
+      return False;
+
+   px = vex_control.iropt_register_updates_default;
+   sc = vta->needs_self_check(vta->callback_opaque, &px, vge);
+   return sc == hdr(blob, 18) && px == hdr(blob, 21);
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- The in-memory table                                     ---*/
+/*---------------------------------------------------------------*/
+
+static void lru_unlink ( VexLiftCache* cache, LCEntry* e )
+{
+   if (e->older) e->older->newer = e->newer; else cache->oldest = e->newer;
+   if (e->newer) e->newer->older = e->older; else cache->newest = e->older;
+   e->older = e->newer = NULL;
+}
+
+static void lru_push ( VexLiftCache* cache, LCEntry* e )
+{
+   e->older = cache->newest;
+   e->newer = NULL;
+   if (cache->newest) cache->newest->newer = e; else cache->oldest = e;
+   cache->newest = e;
+}
+
+static void remove_entry ( VexLiftCache* cache, LCEntry* e )
+{
+   LCEntry** pp = &cache->buckets[e->key & (cache->n_buckets - 1)];
+   while (*pp != e) {
+      vassert(*pp != NULL);
+      pp = &(*pp)->chain;
+   }
+   *pp = e->chain;
+   lru_unlink(cache, e);
+   if (cache->last == e)
+      cache->last = NULL;
+   cache->stats.n_entries--;
+   cache->stats.n_bytes -= e->szB;
+   cache->config.free(e);
+}
+
+/* Make an entry for a blob of szB bytes, evicting as necessary.
+   Returns NULL if it can't be had. */
+static LCEntry* new_entry ( VexLiftCache* cache, ULong key, UInt szB )
+{
+   LCEntry* e;
+
+   if (szB > cache->config.max_bytes)
+      return NULL;
+   while (cache->oldest != NULL
+          && (cache->stats.n_entries >= cache->config.max_entries
+              || cache->stats.n_bytes + szB > cache->config.max_bytes)) {
+      remove_entry(cache, cache->oldest);
+      cache->stats.evictions++;
+   }
+
+   e = cache->config.alloc(sizeof(LCEntry) + szB);
+   if (e == NULL)
+      return NULL;
+   e->key  = key;
+   e->szB  = szB;
+   e->blob = (UChar*)(e + 1);
+   e->chain = cache->buckets[key & (cache->n_buckets - 1)];
+   cache->buckets[key & (cache->n_buckets - 1)] = e;
+   lru_push(cache, e);
+   cache->stats.n_entries++;
+   cache->stats.n_bytes += szB;
+   return e;
+}
+
+/* Drop the entries for key, which are no longer any good. */
+static void remove_key ( VexLiftCache* cache, ULong key )
+{
+   LCEntry* e = cache->buckets[key & (cache->n_buckets - 1)];
+   while (e != NULL) {
+      LCEntry* next = e->chain;
+      if (e->key == key)
+         remove_entry(cache, e);
+      e = next;
+   }
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Lifting                                                 ---*/
+/*---------------------------------------------------------------*/
+
+/* Rebuild the IRSB from a blob that has passed blob_matches. */
+static IRSB* lift_from_blob ( const UChar* blob, const VexTranslateArgs* vta,
+                              const VexGuestExtents* vge,
+                              /*OUT*/ VexTranslateResult* res,
+                              /*OUT*/ VexRegisterUpdates* pxControl )
+{
+   IRSB* irsb;
+
+   vexSetAllocModeTEMP_and_clear();
+   irsb = vexDeserializeIRSB(blob + LC_HDR_BYTES, hdr(blob, 22),
+                             anchor() - hdr64(blob, 6));
+   if (irsb == NULL)
+      return NULL;
+
+   *vta->guest_extents = *vge;
+   res->status         = VexTransOK;
+   res->error_code     = VexTransErrNone;
+   res->error_msg      = NULL;
+   res->n_sc_extents   = hdr(blob, 19);
+   res->offs_profInc   = -1;
+   res->n_guest_instrs = hdr(blob, 20);
+   *pxControl          = hdr(blob, 21);
+   return irsb;
+}
+
+/* Fill in a blob of szB bytes for irsb, just lifted from vta. */
+static void make_blob ( /*OUT*/UChar* blob, UInt szB, ULong key,
+                        const VexTranslateArgs* vta, const IRSB* irsb,
+                        const VexTranslateResult* res,
+                        VexRegisterUpdates pxControl )
+{
+   const VexGuestExtents* vge = vta->guest_extents;
+   VexRegisterUpdates px;
+   UInt               i, sc;
+
+   px = vex_control.iropt_register_updates_default;
+   sc = vta->needs_self_check(vta->callback_opaque, &px, vge);
+
+   vex_bzero(blob, LC_HDR_BYTES);
+   put32(blob + 4 * 0, LC_MAGIC);
+   put32(blob + 4 * 1, LC_VERSION);
+   put64(blob + 4 * 2, key);
+   put64(blob + 4 * 4, hash_extents(vta, vge));
+   put64(blob + 4 * 6, anchor());
+   put32(blob + 4 * 8, vge->n_used);
+   for (i = 0; i < 3; i++) {
+      put64(blob + 4 * (9 + 2 * i), i < vge->n_used ? vge->base[i] : 0);
+      put32(blob + 4 * (15 + i), i < vge->n_used ? vge->len[i] : 0);
+   }
+   put32(blob + 4 * 18, sc);
+   put32(blob + 4 * 19, res->n_sc_extents);
+   put32(blob + 4 * 20, res->n_guest_instrs);
+   put32(blob + 4 * 21, pxControl);
+   put32(blob + 4 * 22, szB - LC_HDR_BYTES);
+   LibVEX_SerializeIRSB(irsb, blob + LC_HDR_BYTES, szB - LC_HDR_BYTES);
+}
+
+
+/* Exported to library client. */
+
+VexLiftCache* LibVEX_NewLiftCache ( const VexLiftCacheConfig* config )
+{
+   VexLiftCache* cache;
+   UInt          i;
+
+   vassert(vex_initdone);
+   vassert(config->alloc != NULL && config->free != NULL);
+   vassert(config->max_bytes > 0 && config->max_entries > 0);
+   vassert((config->load == NULL) == (config->store == NULL));
+
+   cache = config->alloc(sizeof(VexLiftCache));
+   vassert(cache != NULL);
+   vex_bzero(cache, sizeof(*cache));
+   cache->config = *config;
+
+   cache->n_buckets = 16;
+   while (cache->n_buckets < config->max_entries
+          && cache->n_buckets < (1U << 30))
+      cache->n_buckets *= 2;
+   cache->buckets = config->alloc(cache->n_buckets * sizeof(LCEntry*));
+   vassert(cache->buckets != NULL);
+   for (i = 0; i < cache->n_buckets; i++)
+      cache->buckets[i] = NULL;
+   return cache;
+}
+
+void LibVEX_DeleteLiftCache ( VexLiftCache* cache )
+{
+   while (cache->oldest != NULL)
+      remove_entry(cache, cache->oldest);
+   cache->config.free(cache->buckets);
+   cache->config.free(cache);
+}
+
+IRSB* LibVEX_Lift_cached ( VexLiftCache* cache,
+                           VexTranslateArgs* vta,
+                           /*OUT*/ VexTranslateResult* res,
+                           /*OUT*/ VexRegisterUpdates* pxControl )
+{
+   VexGuestExtents vge;
+   LCEntry*        e;
+   IRSB*           irsb;
+   ULong           key;
+   UInt            szB;
+
+   vassert(vex_initdone);
+   cache->last = NULL;
+
+   if (vta->traceflags != 0) {
+      cache->stats.bypassed++;
+      return LibVEX_Lift(vta, res, pxControl);
+   }
+
+   vexLoadControl();
+   vex_traceflags = 0;
+   key = cache_key(cache, vta);
+
+   /* In memory? */
+   for (e = cache->buckets[key & (cache->n_buckets - 1)];
+        e != NULL; e = e->chain) {
+      if (e->key == key && blob_ok(e->blob, e->szB, key, vta, &vge)
+          && blob_matches(e->blob, vta, &vge))
+         break;
+   }
+
+   /* In the persistent store? */
+   if (e == NULL && cache->config.load != NULL) {
+      const UChar* blob = cache->config.load(cache->config.store_opaque,
+                                             key, &szB);
+      if (blob != NULL && blob_ok(blob, szB, key, vta, &vge)
+          && blob_matches(blob, vta, &vge)) {
+         remove_key(cache, key);
+         e = new_entry(cache, key, szB);
+         if (e != NULL) {
+            vex_memcpy(e->blob, blob, szB);
+            cache->stats.disk_hits++;
+         } else {
+            /* Too big to keep in memory; use it from where it is. */
+            irsb = lift_from_blob(blob, vta, &vge, res, pxControl);
+            if (irsb != NULL) {
+               cache->stats.hits++;
+               cache->stats.disk_hits++;
+               return irsb;
+            }
+         }
+      }
+   }
+
+   if (e != NULL) {
+      irsb = lift_from_blob(e->blob, vta, &vge, res, pxControl);
+      if (irsb != NULL) {
+         lru_unlink(cache, e);
+         lru_push(cache, e);
+         cache->last = e;
+         cache->stats.hits++;
+         return irsb;
+      }
+      /* The image is corrupt.  Forget it and lift afresh. */
+      remove_entry(cache, e);
+   }
+
+   cache->stats.misses++;
+   irsb = LibVEX_Lift(vta, res, pxControl);
+   if (irsb == NULL)
+      return NULL;
+
+   remove_key(cache, key);
+   szB = LC_HDR_BYTES + LibVEX_SerializeIRSB(irsb, NULL, 0);
+   e = new_entry(cache, key, szB);
+   if (e != NULL) {
+      make_blob(e->blob, szB, key, vta, irsb, res, *pxControl);
+      cache->last = e;
+      if (cache->config.store != NULL)
+         cache->config.store(cache->config.store_opaque, key, e->blob, szB);
+   }
+   return irsb;
+}
+
+const UChar* LibVEX_LiftCacheImage ( const VexLiftCache* cache,
+                                     /*OUT*/UInt* szB )
+{
+   if (cache->last == NULL) {
+      *szB = 0;
+      return NULL;
+   }
+   *szB = cache->last->szB - LC_HDR_BYTES;
+   return cache->last->blob + LC_HDR_BYTES;
+}
+
+void LibVEX_GetLiftCacheStats ( const VexLiftCache* cache,
+                                /*OUT*/VexLiftCacheStats* stats )
+{
+   *stats = cache->stats;
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- end                                     main_liftcache.c ---*/
+/*---------------------------------------------------------------*/
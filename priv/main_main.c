@@ -49,6 +49,7 @@
 
 #include "main_globals.h"
 #include "main_util.h"
+#include "main_stats.h"
 #include "host_generic_regs.h"
 #include "ir_opt.h"
 
@@ -201,11 +202,33 @@ void LibVEX_default_VexControl ( /*OUT*/ VexControl* vcon )
    vcon->arm_allow_optimizing_lookback   = True;
    vcon->arm64_allow_reordered_writeback = True;
    vcon->x86_optimize_callpop_idiom      = True;
+   vcon->ir_intern_atoms                 = False;
+   vcon->regalloc_version                = 2;
+   vcon->host_peephole                   = False;
+   vcon->sanity_level                    = VexSanityAlways;
+   vcon->sanity_sample_interval          = 64;
 }
 
 
 /* Exported to library client. */
 
+/* Each host's real-register universe is built on first use.  Build
+   them all now, while there is only one thread about, so that
+   translations on several threads at once only ever read them. */
+static void init_rreg_universes ( void )
+{
+   (void)X86FN(getRRegUniverse_X86());
+   (void)AMD64FN(getRRegUniverse_AMD64());
+   (void)PPC32FN(getRRegUniverse_PPC(False));
+   (void)PPC64FN(getRRegUniverse_PPC(True));
+   (void)S390FN(getRRegUniverse_S390());
+   (void)ARMFN(getRRegUniverse_ARM());
+   (void)ARM64FN(getRRegUniverse_ARM64());
+   (void)MIPS32FN(getRRegUniverse_MIPS(False));
+   (void)MIPS64FN(getRRegUniverse_MIPS(True));
+   (void)TILEGXFN(getRRegUniverse_TILEGX());
+}
+
 void LibVEX_Init (
    /* failure exit function */
    __attribute__ ((noreturn))
@@ -289,13 +312,15 @@ void LibVEX_Init (
    vassert(sdiv32(-100, -7) == 14); /* not sure what this proves */
 
    /* Really start up .. */
+   vexInitPrimopTypes();
+   init_rreg_universes();
    LibVEX_Update_Control ( vcon );
    vexSetAllocMode ( VexAllocModeTEMP );
    vex_debuglevel         = debuglevel;
    vex_initdone           = True;
 }
 
-void LibVEX_Update_Control(const VexControl *vcon)
+static void check_control ( const VexControl* vcon )
 {
    vassert(vcon->iropt_verbosity >= 0);
    vassert(vcon->iropt_level >= 0);
@@ -308,7 +333,19 @@ void LibVEX_Update_Control(const VexControl *vcon)
    vassert(vcon->guest_chase_thresh < vcon->guest_max_insns);
    vassert(vcon->guest_chase_cond == True
            || vcon->guest_chase_cond == False);
+   vassert(vcon->ir_intern_atoms == True
+           || vcon->ir_intern_atoms == False);
+   vassert(vcon->regalloc_version == 2 || vcon->regalloc_version == 3);
+   vassert(vcon->host_peephole == True || vcon->host_peephole == False);
+   vassert(vcon->sanity_level >= VexSanityAlways
+           && vcon->sanity_level <= VexSanityNever);
+   vassert(vcon->sanity_sample_interval >= 1);
+}
 
+void LibVEX_Update_Control(const VexControl *vcon)
+{
+   check_control(vcon);
+   vex_control_default    = *vcon;
    vex_control            = *vcon;
 }
 
@@ -320,7 +357,18 @@ void LibVEX_Update_Control(const VexControl *vcon)
    effect of LibVEX_Translate. The variable is defined here rather than
    in host_s390_defs.c to avoid having main_main.c dragging S390
    object files in non VEXMULTIARCH. */
-UInt s390_host_hwcaps;
+VEX_TLS UInt s390_host_hwcaps;
+
+/* The VexContext this thread is currently translating in, or NULL if
+   it is using the library's static storage and vex_control_default. */
+static VEX_TLS VexContext* curr_context = NULL;
+
+/* Load vex_control for a translation about to start on this thread. */
+void vexLoadControl ( void )
+{
+   if (curr_context == NULL)
+      vex_control = vex_control_default;
+}
 
 
 /* Exported to library client. */
@@ -329,33 +377,66 @@ VexTranslateResult LibVEX_Translate ( VexTranslateArgs* vta )
 {
    VexTranslateResult res;
    VexRegisterUpdates pxControl;
+   IRSB*              irsb;
 
-   IRSB *irsb = LibVEX_Lift(vta, &res, &pxControl);
+   irsb = LibVEX_Lift(vta, &res, &pxControl);
+   if (res.status == VexTransError)
+      return res;
    LibVEX_Codegen(vta, &res, irsb, pxControl);
    return res;
 }
 
-IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
-                     /*OUT*/ VexTranslateResult *res,
-                     /*OUT*/ VexRegisterUpdates *pxControl)
+
+/* A failure has jumped back to *rp (see VexRecoverPoint).  Say so in
+   *res, and put the storage area straight: cleared if clear, else
+   just back in TEMP mode. */
+static void recovered ( const VexRecoverPoint* rp,
+                        /*OUT*/ VexTranslateResult* res, Bool clear )
 {
-   IRExpr*      (*specHelper)   ( const HChar*, IRExpr**, IRStmt**, Int );
+   if (clear)
+      vexSetAllocModeTEMP_and_clear();
+   else if (vexGetAllocMode() != VexAllocModeTEMP)
+      vexSetAllocMode(VexAllocModeTEMP);
+
+   res->status         = VexTransError;
+   res->error_code     = rp->code;
+   res->error_msg      = vexErrorMsg();
+   res->n_sc_extents   = 0;
+   res->offs_profInc   = -1;
+   res->n_guest_instrs = 0;
+}
+
+
+/* What the front end needs to know about the guest architecture.
+   This depends only on vta->arch_guest and vta->archinfo_guest, so
+   LibVEX_LiftBatch works it out once per batch rather than once per
+   block. */
+typedef
+   struct {
+      IRExpr* (*specHelper) ( const IRCallee*, IRExpr**, IRStmt**, Int );
+      Bool    (*preciseMemExnsFn) ( Int, Int, VexRegisterUpdates );
+      DisOneInstrFn   disInstrFn;
+      VexGuestLayout* guest_layout;
+      Int             offB_CMSTART, offB_CMLEN, offB_GUEST_IP, szB_GUEST_IP;
+      IRType          guest_word_type;
+      IRType          host_word_type;
+   }
+   LiftSetup;
+
+static void lift_setup ( const VexTranslateArgs* vta,
+                         /*OUT*/LiftSetup* ls )
+{
+   IRExpr*      (*specHelper)   ( const IRCallee*, IRExpr**, IRStmt**, Int );
    Bool (*preciseMemExnsFn) ( Int, Int, VexRegisterUpdates );
    DisOneInstrFn disInstrFn;
 
    VexGuestLayout* guest_layout;
-   IRSB*           irsb;
-   Int             i;
    Int             offB_CMSTART, offB_CMLEN, offB_GUEST_IP, szB_GUEST_IP;
-   IRType          guest_word_type;
-   IRType          host_word_type;
 
    guest_layout            = NULL;
    specHelper              = NULL;
    disInstrFn              = NULL;
    preciseMemExnsFn        = NULL;
-   guest_word_type         = arch_word_size(vta->arch_guest);
-   host_word_type          = arch_word_size(vta->arch_host);
    offB_CMSTART            = 0;
    offB_CMLEN              = 0;
    offB_GUEST_IP           = 0;
@@ -363,11 +444,12 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
 
    vassert(vex_initdone);
    vassert(vta->needs_self_check  != NULL);
+   vassert(vta->lift_mode >= VexLiftFull && vta->lift_mode <= VexLiftCheap);
+   /* Instrumenters expect flat IR. */
+   if (vta->lift_mode == VexLiftRaw)
+      vassert(vta->instrument1 == NULL && vta->instrument2 == NULL);
 
-   vexSetAllocModeTEMP_and_clear();
-   vexAllocSanityCheck();
-
-   vex_traceflags = vta->traceflags;
+   vexStatsSelect(vta->arch_guest, vta->arch_host);
 
    /* First off, check that the guest and host insn sets
       are supported. */
@@ -557,11 +639,6 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
    // FIXME: how can we know the guest's hardware capabilities?
    check_hwcaps(vta->arch_guest, vta->archinfo_guest.hwcaps);
 
-   res->status         = VexTransOK;
-   res->n_sc_extents   = 0;
-   res->offs_profInc   = -1;
-   res->n_guest_instrs = 0;
-
 #ifndef VEXMULTIARCH
    /* yet more sanity checks ... */
    if (vta->arch_guest == vta->arch_host) {
@@ -574,6 +651,234 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
    }
 #endif
 
+   ls->specHelper       = specHelper;
+   ls->preciseMemExnsFn = preciseMemExnsFn;
+   ls->disInstrFn       = disInstrFn;
+   ls->guest_layout     = guest_layout;
+   ls->offB_CMSTART     = offB_CMSTART;
+   ls->offB_CMLEN       = offB_CMLEN;
+   ls->offB_GUEST_IP    = offB_GUEST_IP;
+   ls->szB_GUEST_IP     = szB_GUEST_IP;
+   ls->guest_word_type  = arch_word_size(vta->arch_guest);
+   ls->host_word_type   = arch_word_size(vta->arch_host);
+}
+
+
+/* --------- Deciding what to sanity check. --------- */
+
+/* For VexSanitySampled, the number of blocks since the last one
+   checked, at each of the two points. */
+static VEX_TLS Int n_unchecked_initial      = 0;
+static VEX_TLS Int n_unchecked_instrumented = 0;
+
+/* For VexSanityNewOps, the IROps and the kinds of expression and
+   statement used by the blocks that have passed the check so far, as
+   bitmaps indexed from the first enumerator of each. */
+#define N_SEEN_OPS   (Iop_LAST - Iop_INVALID)
+#define N_SEEN_EXPRS (Iex_GSPTR - Iex_Binder + 1)
+#define N_SEEN_STMTS (Ist_Exit - Ist_NoOp + 1)
+
+static VEX_TLS UChar seen_ops[(N_SEEN_OPS + 7) / 8];
+static VEX_TLS UChar seen_exprs[(N_SEEN_EXPRS + 7) / 8];
+static VEX_TLS UChar seen_stmts[(N_SEEN_STMTS + 7) / 8];
+
+/* Say whether bit |ix| of |map| is clear, and set it if |mark|. */
+static inline Bool unseen ( UChar* map, UInt ix, Bool mark )
+{
+   UChar bit   = toUChar(1 << (ix & 7));
+   Bool  fresh = toBool((map[ix >> 3] & bit) == 0);
+   if (mark)
+      map[ix >> 3] |= bit;
+   return fresh;
+}
+
+static Bool unseen_Expr ( const IRExpr* e, Bool mark )
+{
+   Bool fresh = unseen(seen_exprs, e->tag - Iex_Binder, mark);
+   Int  i;
+   switch (e->tag) {
+      case Iex_GetI:
+         fresh |= unseen_Expr(e->Iex.GetI.ix, mark);
+         break;
+      case Iex_Qop: {
+         const IRQop* qop = e->Iex.Qop.details;
+         fresh |= unseen(seen_ops, qop->op - Iop_INVALID, mark);
+         fresh |= unseen_Expr(qop->arg1, mark);
+         fresh |= unseen_Expr(qop->arg2, mark);
+         fresh |= unseen_Expr(qop->arg3, mark);
+         fresh |= unseen_Expr(qop->arg4, mark);
+         break;
+      }
+      case Iex_Triop: {
+         const IRTriop* triop = e->Iex.Triop.details;
+         fresh |= unseen(seen_ops, triop->op - Iop_INVALID, mark);
+         fresh |= unseen_Expr(triop->arg1, mark);
+         fresh |= unseen_Expr(triop->arg2, mark);
+         fresh |= unseen_Expr(triop->arg3, mark);
+         break;
+      }
+      case Iex_Binop:
+         fresh |= unseen(seen_ops, e->Iex.Binop.op - Iop_INVALID, mark);
+         fresh |= unseen_Expr(e->Iex.Binop.arg1, mark);
+         fresh |= unseen_Expr(e->Iex.Binop.arg2, mark);
+         break;
+      case Iex_Unop:
+         fresh |= unseen(seen_ops, e->Iex.Unop.op - Iop_INVALID, mark);
+         fresh |= unseen_Expr(e->Iex.Unop.arg, mark);
+         break;
+      case Iex_Load:
+         fresh |= unseen_Expr(e->Iex.Load.addr, mark);
+         break;
+      case Iex_CCall:
+         for (i = 0; e->Iex.CCall.args[i]; i++)
+            fresh |= unseen_Expr(e->Iex.CCall.args[i], mark);
+         break;
+      case Iex_ITE:
+         fresh |= unseen_Expr(e->Iex.ITE.cond, mark);
+         fresh |= unseen_Expr(e->Iex.ITE.iftrue, mark);
+         fresh |= unseen_Expr(e->Iex.ITE.iffalse, mark);
+         break;
+      default:
+         /* Get, RdTmp, Const, Binder, VECRET, GSPTR: no subparts */
+         break;
+   }
+   return fresh;
+}
+
+static Bool unseen_Stmt ( const IRStmt* st, Bool mark )
+{
+   Bool fresh = unseen(seen_stmts, st->tag - Ist_NoOp, mark);
+   Int  i;
+   switch (st->tag) {
+      case Ist_AbiHint:
+         fresh |= unseen_Expr(st->Ist.AbiHint.base, mark);
+         fresh |= unseen_Expr(st->Ist.AbiHint.nia, mark);
+         break;
+      case Ist_Put:
+         fresh |= unseen_Expr(st->Ist.Put.data, mark);
+         break;
+      case Ist_PutI:
+         fresh |= unseen_Expr(st->Ist.PutI.details->ix, mark);
+         fresh |= unseen_Expr(st->Ist.PutI.details->data, mark);
+         break;
+      case Ist_WrTmp:
+         fresh |= unseen_Expr(st->Ist.WrTmp.data, mark);
+         break;
+      case Ist_Store:
+         fresh |= unseen_Expr(st->Ist.Store.addr, mark);
+         fresh |= unseen_Expr(st->Ist.Store.data, mark);
+         break;
+      case Ist_StoreG:
+         fresh |= unseen_Expr(st->Ist.StoreG.details->addr, mark);
+         fresh |= unseen_Expr(st->Ist.StoreG.details->data, mark);
+         fresh |= unseen_Expr(st->Ist.StoreG.details->guard, mark);
+         break;
+      case Ist_LoadG:
+         fresh |= unseen_Expr(st->Ist.LoadG.details->addr, mark);
+         fresh |= unseen_Expr(st->Ist.LoadG.details->alt, mark);
+         fresh |= unseen_Expr(st->Ist.LoadG.details->guard, mark);
+         break;
+      case Ist_CAS: {
+         const IRCAS* cas = st->Ist.CAS.details;
+         fresh |= unseen_Expr(cas->addr, mark);
+         if (cas->expdHi)
+            fresh |= unseen_Expr(cas->expdHi, mark);
+         fresh |= unseen_Expr(cas->expdLo, mark);
+         if (cas->dataHi)
+            fresh |= unseen_Expr(cas->dataHi, mark);
+         fresh |= unseen_Expr(cas->dataLo, mark);
+         break;
+      }
+      case Ist_LLSC:
+         fresh |= unseen_Expr(st->Ist.LLSC.addr, mark);
+         if (st->Ist.LLSC.storedata)
+            fresh |= unseen_Expr(st->Ist.LLSC.storedata, mark);
+         break;
+      case Ist_Dirty: {
+         const IRDirty* d = st->Ist.Dirty.details;
+         fresh |= unseen_Expr(d->guard, mark);
+         for (i = 0; d->args[i]; i++)
+            fresh |= unseen_Expr(d->args[i], mark);
+         if (d->mFx != Ifx_None)
+            fresh |= unseen_Expr(d->mAddr, mark);
+         break;
+      }
+      case Ist_Exit:
+         fresh |= unseen_Expr(st->Ist.Exit.guard, mark);
+         break;
+      default:
+         /* NoOp, IMark, MBE: no subparts */
+         break;
+   }
+   return fresh;
+}
+
+/* Does |bb| use anything that no block which passed the check has
+   used?  If |mark|, note that it has all now been used. */
+static Bool unseen_IRSB ( const IRSB* bb, Bool mark )
+{
+   Bool fresh = unseen_Expr(bb->next, mark);
+   Int  i;
+   for (i = 0; i < bb->stmts_used && (mark || !fresh); i++)
+      fresh |= unseen_Stmt(bb->stmts[i], mark);
+   return fresh;
+}
+
+/* Give |bb| to sanityCheckIRSB, if vex_control.sanity_level says it
+   should be checked at the point whose count of unchecked blocks is
+   |n_unchecked|. */
+static void maybe_sanityCheckIRSB ( const IRSB* bb, const HChar* caller,
+                                    Bool require_flatness,
+                                    IRType guest_word_size,
+                                    Int* n_unchecked )
+{
+   switch (vex_control.sanity_level) {
+      case VexSanityAlways:
+         break;
+      case VexSanitySampled: {
+         Bool check = toBool(*n_unchecked == 0);
+         if (++*n_unchecked == vex_control.sanity_sample_interval)
+            *n_unchecked = 0;
+         if (!check)
+            return;
+         break;
+      }
+      case VexSanityNewOps:
+         if (!unseen_IRSB(bb, False))
+            return;
+         break;
+      case VexSanityNever:
+         return;
+      default:
+         vpanic("maybe_sanityCheckIRSB");
+   }
+
+   sanityCheckIRSB(bb, caller, require_flatness, guest_word_size);
+
+   /* Only now that it has passed is what it uses taken as checked. */
+   if (vex_control.sanity_level == VexSanityNewOps)
+      (void)unseen_IRSB(bb, True);
+}
+
+
+/* The first half of lift_block: run the front end, and check its
+   output.  Returns NULL on access failure. */
+static IRSB* lift_front ( VexTranslateArgs* vta, const LiftSetup* ls,
+                          /*OUT*/ VexTranslateResult *res,
+                          /*OUT*/ VexRegisterUpdates *pxControl )
+{
+   IRSB*        irsb;
+   Int          i;
+   IRType       guest_word_type = ls->guest_word_type;
+   VexStageMark m;
+
+   res->status         = VexTransOK;
+   res->error_code     = VexTransErrNone;
+   res->error_msg      = NULL;
+   res->n_sc_extents   = 0;
+   res->offs_profInc   = -1;
+   res->n_guest_instrs = 0;
+
    vexAllocSanityCheck();
 
    if (vex_traceflags & VEX_TRACE_FE)
@@ -585,16 +890,19 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
    vassert(*pxControl >= VexRegUpdSpAtMemAccess
            && *pxControl <= VexRegUpdAllregsAtEachInsn);
 
+   vexStatsBegin(&m);
    irsb = bb_to_IR ( vta->guest_extents,
                      &res->n_sc_extents,
                      &res->n_guest_instrs,
                      pxControl,
                      vta->callback_opaque,
-                     disInstrFn,
+                     ls->disInstrFn,
                      vta->guest_bytes, 
                      vta->guest_bytes_addr,
                      vta->chase_into_ok,
                      vta->archinfo_host.endness,
+                     vta->arch_host,
+                     vta->archinfo_host.hwcaps,
                      vta->sigill_diag,
                      vta->arch_guest,
                      &vta->archinfo_guest,
@@ -602,16 +910,16 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
                      guest_word_type,
                      vta->needs_self_check,
                      vta->preamble_function,
-                     offB_CMSTART,
-                     offB_CMLEN,
-                     offB_GUEST_IP,
-                     szB_GUEST_IP );
+                     ls->offB_CMSTART,
+                     ls->offB_CMLEN,
+                     ls->offB_GUEST_IP,
+                     ls->szB_GUEST_IP );
+   vexStatsEnd(VexStageFrontEnd, &m);
 
    vexAllocSanityCheck();
 
    if (irsb == NULL) {
       /* Access failure. */
-      vexSetAllocModeTEMP_and_clear();
       return NULL;
    }
 
@@ -645,16 +953,45 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
       }
    }
 
-   /* Sanity check the initial IR. */
-   sanityCheckIRSB( irsb, "initial IR", 
-                    False/*can be non-flat*/, guest_word_type );
+   /* Sanity check the initial IR, unless the caller trusts it or
+      vex_control.sanity_level says not to. */
+   if (!vta->skip_initial_sanity) {
+      vexStatsBegin(&m);
+      maybe_sanityCheckIRSB( irsb, "initial IR",
+                             False/*can be non-flat*/, guest_word_type,
+                             &n_unchecked_initial );
+      vexStatsEnd(VexStageSanity, &m);
+   }
+
+   return irsb;
+}
+
+
+/* The second half: optimise and instrument the front end's output,
+   as vta->lift_mode says. */
+static IRSB* lift_finish ( VexTranslateArgs* vta, const LiftSetup* ls,
+                           IRSB* irsb,
+                           const VexTranslateResult *res,
+                           VexRegisterUpdates pxControl )
+{
+   IRType       guest_word_type = ls->guest_word_type;
+   IRType       host_word_type  = ls->host_word_type;
+   VexStageMark m;
 
    vexAllocSanityCheck();
 
-   /* Clean it up, hopefully a lot. */
-   irsb = do_iropt_BB ( irsb, specHelper, preciseMemExnsFn, *pxControl,
-                              vta->guest_bytes_addr,
-                              vta->arch_guest );
+   /* Clean it up, hopefully a lot, unless the caller only wants some
+      or none of that. */
+   if (vta->lift_mode != VexLiftRaw) {
+      Int level = vex_control.iropt_level;
+      if (vta->lift_mode == VexLiftFlat)
+         level = 0;
+      else if (vta->lift_mode == VexLiftCheap && level > 1)
+         level = 1;
+      irsb = do_iropt_BB ( irsb, level, ls->specHelper, ls->preciseMemExnsFn,
+                           pxControl, vta->guest_bytes_addr,
+                           vta->arch_guest );
+   }
 
    // JRS 2016 Aug 03: Sanity checking is expensive, we already checked
    // the output of the front end, and iropt never screws up the IR by
@@ -673,10 +1010,12 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
 
    vexAllocSanityCheck();
 
-   /* Get the thing instrumented. */
+   /* Get the thing instrumented.  The time is only charged if there
+      is an instrumenter, below. */
+   vexStatsBegin(&m);
    if (vta->instrument1)
       irsb = vta->instrument1(vta->callback_opaque,
-                              irsb, guest_layout, 
+                              irsb, ls->guest_layout, 
                               vta->guest_extents,
                               &vta->archinfo_host,
                               guest_word_type, host_word_type);
@@ -684,7 +1023,7 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
 
    if (vta->instrument2)
       irsb = vta->instrument2(vta->callback_opaque,
-                              irsb, guest_layout,
+                              irsb, ls->guest_layout,
                               vta->guest_extents,
                               &vta->archinfo_host,
                               guest_word_type, host_word_type);
@@ -709,8 +1048,12 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
       do_deadcode_BB( irsb );
       irsb = cprop_BB( irsb );
       do_deadcode_BB( irsb );
-      sanityCheckIRSB( irsb, "after post-instrumentation cleanup",
-                       True/*must be flat*/, guest_word_type );
+      vexStatsEnd(VexStageInstrument, &m);
+      vexStatsBegin(&m);
+      maybe_sanityCheckIRSB( irsb, "after post-instrumentation cleanup",
+                             True/*must be flat*/, guest_word_type,
+                             &n_unchecked_instrumented );
+      vexStatsEnd(VexStageSanity, &m);
    }
 
    vexAllocSanityCheck();
@@ -723,14 +1066,851 @@ IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
       vex_printf("\n");
    }
 
+   if (vex_stats != NULL) {
+      vex_stats->n_blocks_lifted++;
+      vex_stats->n_guest_instrs += res->n_guest_instrs;
+      vex_stats->n_ir_stmts     += irsb->stmts_used;
+   }
+
    return irsb;
 }
 
 
-void LibVEX_Codegen (   VexTranslateArgs *vta,
-                        VexTranslateResult *res,
-                        IRSB *irsb,
-                        VexRegisterUpdates pxControl)
+static IRSB* lift_block ( VexTranslateArgs* vta, const LiftSetup* ls,
+                          /*OUT*/ VexTranslateResult *res,
+                          /*OUT*/ VexRegisterUpdates *pxControl )
+{
+   IRSB* irsb = lift_front(vta, ls, res, pxControl);
+   if (irsb == NULL)
+      return NULL;
+   return lift_finish(vta, ls, irsb, res, *pxControl);
+}
+
+
+/* lift_block for LibVEX_LiftBatch, where a failure costs only the
+   block that caused it.  Earlier blocks may still be in the TEMP area,
+   so it is not cleared. */
+static IRSB* lift_block_recovering ( VexTranslateArgs* vta,
+                                     const LiftSetup* ls,
+                                     /*OUT*/ VexTranslateResult *res,
+                                     /*OUT*/ VexRegisterUpdates *pxControl )
+{
+   VexRecoverPoint rp;
+   IRSB*           irsb;
+
+   if (!vta->recover_errors)
+      return lift_block(vta, ls, res, pxControl);
+
+   if (vexRecoverSet(&rp)) {
+      recovered(&rp, res, False);
+      return NULL;
+   }
+   vex_recover = &rp;
+   irsb = lift_block(vta, ls, res, pxControl);
+   vex_recover = NULL;
+   return irsb;
+}
+
+
+IRSB *LibVEX_Lift (  VexTranslateArgs *vta,
+                     /*OUT*/ VexTranslateResult *res,
+                     /*OUT*/ VexRegisterUpdates *pxControl)
+{
+   LiftSetup       ls;
+   IRSB*           irsb;
+   VexRecoverPoint rp;
+
+   vexLoadControl();
+
+   vexSetAllocModeTEMP_and_clear();
+   vexAllocSanityCheck();
+
+   vex_traceflags = vta->traceflags;
+
+   vex_recover = NULL;
+   if (vta->recover_errors) {
+      if (vexRecoverSet(&rp)) {
+         recovered(&rp, res, True);
+         return NULL;
+      }
+      vex_recover = &rp;
+   }
+
+   lift_setup(vta, &ls);
+   irsb = lift_block(vta, &ls, res, pxControl);
+   vex_recover = NULL;
+
+   if (irsb == NULL) {
+      /* Access failure. */
+      vexSetAllocModeTEMP_and_clear();
+   }
+   return irsb;
+}
+
+
+UInt LibVEX_LiftBatch ( VexTranslateArgs* vta,
+                        /*MOD*/VexLiftRequest* reqs, UInt n_reqs,
+                        void (*deliver)( void* callback_opaque,
+                                         VexLiftRequest* req ) )
+{
+   LiftSetup        ls;
+   VexTranslateArgs one;
+   UInt             i, n_ok;
+   VexRecoverPoint  rp;
+
+   vexLoadControl();
+
+   vexSetAllocModeTEMP_and_clear();
+   vexAllocSanityCheck();
+
+   vex_traceflags = vta->traceflags;
+
+   vex_recover = NULL;
+   if (vta->recover_errors) {
+      if (vexRecoverSet(&rp)) {
+         /* None of the batch can be lifted. */
+         for (i = 0; i < n_reqs; i++) {
+            reqs[i].irsb = NULL;
+            recovered(&rp, &reqs[i].res, True);
+            if (deliver)
+               deliver(vta->callback_opaque, &reqs[i]);
+         }
+         return 0;
+      }
+      vex_recover = &rp;
+   }
+
+   lift_setup(vta, &ls);
+   vex_recover = NULL;
+
+   /* Work on a copy, so that the caller's guest_bytes etc are left
+      alone. */
+   one  = *vta;
+   n_ok = 0;
+   for (i = 0; i < n_reqs; i++) {
+      VexLiftRequest* req = &reqs[i];
+      one.guest_bytes      = req->guest_bytes;
+      one.guest_bytes_addr = req->guest_bytes_addr;
+      one.guest_extents    = &req->guest_extents;
+      req->irsb = lift_block_recovering(&one, &ls,
+                                        &req->res, &req->pxControl);
+      if (req->irsb != NULL)
+         n_ok++;
+      if (deliver) {
+         deliver(vta->callback_opaque, req);
+         req->irsb = NULL;
+         vexSetAllocModeTEMP_and_clear();
+      }
+   }
+
+   return n_ok;
+}
+
+
+/* --------- Decoding without lifting. --------- */
+
+typedef
+   Bool (*DecodeInsnFn) ( const UChar*, UInt, Addr, const VexArchInfo*,
+                          /*OUT*/VexDecodedInsn* );
+
+static Bool chase_into_nothing ( void* opaque, Addr addr )
+{
+   return False;
+}
+
+static UInt needs_no_self_check ( void* opaque,
+                                  /*MAYBE_MOD*/VexRegisterUpdates* pxControl,
+                                  const VexGuestExtents* vge )
+{
+   return 0;
+}
+
+static VexEndness host_endness ( void )
+{
+   UInt one = 1;
+   return *(UChar*)&one == 1 ? VexEndnessLE : VexEndnessBE;
+}
+
+static Addr const_to_Addr ( const IRConst* con )
+{
+   switch (con->tag) {
+      case Ico_U32: return (Addr)con->Ico.U32;
+      case Ico_U64: return (Addr)con->Ico.U64;
+      default:      vpanic("const_to_Addr");
+   }
+}
+
+/* For guests without a decoder of their own: run the front end over
+   the insn and look at the IR it makes.  The last Boring exit and
+   the last write to the guest IP say where control goes.  The IR is
+   left in TEMP, for the caller to release. */
+static Bool decode_by_lifting ( const LiftSetup* ls, VexArch arch,
+                                const VexArchInfo* archinfo,
+                                const VexAbiInfo*  abiinfo,
+                                const UChar* bytes, UInt n_bytes, Addr addr,
+                                /*OUT*/VexDecodedInsn* insn )
+{
+   /* Front ends may look a little past the insn they decode, and ARM
+      Thumb up to 18 bytes before it.  So always decode from a copy
+      with zeroes around it, rather than from the caller's buffer.  No
+      insn is longer than 32 bytes. */
+   UChar     buf[32 + 32 + 32];
+   Long      delta = 0;
+   IRSB*     irsb;
+   DisResult dres;
+   Int       i;
+   IRStmt*   exit = NULL;
+   IRExpr*   nia  = NULL;
+   Addr      fall;
+   VexRecoverPoint rp;
+
+   insn->kind         = VexInsnInvalid;
+   insn->len          = 0;
+   insn->target       = 0;
+   insn->fall_through = addr;
+
+   vex_bzero(buf, sizeof(buf));
+   vex_memcpy(&buf[32], bytes, n_bytes < 32 ? n_bytes : 32);
+   bytes = buf;
+   delta = 32;
+
+   /* Some front ends panic on junk, which a disassembler will often
+      hand us.  Call that undecodable. */
+   if (vexRecoverSet(&rp))
+      return False;
+   vex_recover = &rp;
+
+   irsb = emptyIRSB();
+   dres = ls->disInstrFn(irsb, chase_into_nothing, False, NULL,
+                         bytes, delta, addr, arch, archinfo, abiinfo,
+                         host_endness(), False);
+   vex_recover = NULL;
+   vassert(dres.whatNext == Dis_StopHere || dres.whatNext == Dis_Continue);
+
+   if (dres.len == 0 || dres.len > n_bytes)
+      return False;
+   if (dres.whatNext == Dis_StopHere && dres.jk_StopHere == Ijk_NoDecode)
+      return False;
+
+   for (i = 0; i < irsb->stmts_used; i++) {
+      IRStmt* st = irsb->stmts[i];
+      if (st->tag == Ist_Exit && st->Ist.Exit.jk == Ijk_Boring)
+         exit = st;
+      if (st->tag == Ist_Put && st->Ist.Put.offset == ls->offB_GUEST_IP)
+         nia = st->Ist.Put.data;
+   }
+
+   fall = addr + dres.len;
+   insn->len          = dres.len;
+   insn->fall_through = fall;
+   insn->kind         = VexInsnNormal;
+
+   if (dres.whatNext == Dis_Continue) {
+      if (exit && const_to_Addr(exit->Ist.Exit.dst) != fall) {
+         insn->kind   = VexInsnCondJump;
+         insn->target = const_to_Addr(exit->Ist.Exit.dst);
+      }
+      return True;
+   }
+
+   switch (dres.jk_StopHere) {
+      case Ijk_Boring:
+         if (nia == NULL || nia->tag != Iex_Const) {
+            insn->kind = VexInsnIndJump;
+         } else if (exit) {
+            /* One of the two goes to fall. */
+            Addr t = const_to_Addr(nia->Iex.Const.con);
+            insn->kind   = VexInsnCondJump;
+            insn->target = t != fall ? t
+                                     : const_to_Addr(exit->Ist.Exit.dst);
+         } else if (const_to_Addr(nia->Iex.Const.con) != fall) {
+            insn->kind   = VexInsnJump;
+            insn->target = const_to_Addr(nia->Iex.Const.con);
+         }
+         break;
+      case Ijk_Call:
+         if (nia != NULL && nia->tag == Iex_Const) {
+            insn->kind   = VexInsnCall;
+            insn->target = const_to_Addr(nia->Iex.Const.con);
+         } else {
+            insn->kind = VexInsnIndCall;
+         }
+         break;
+      case Ijk_Ret:
+         insn->kind = VexInsnRet;
+         break;
+      default:
+         insn->kind = VexInsnSys;
+         break;
+   }
+   return True;
+}
+
+
+/* Exported to library client. */
+
+UInt LibVEX_DecodeRange ( VexArch arch,
+                          const VexArchInfo* archinfo,
+                          const VexAbiInfo*  abiinfo,
+                          const UChar* bytes, UInt n_bytes, Addr addr,
+                          /*OUT*/VexDecodedInsn* insns, UInt max_insns,
+                          Bool stop_at_branch )
+{
+   DecodeInsnFn     decodeFn = NULL;
+   LiftSetup        ls;
+   VexTranslateArgs vta;
+   VexTempMark      mark;
+   UInt             n, off;
+   Bool             ok;
+
+   vassert(vex_initdone);
+
+   /* The other guests go through decode_by_lifting, which is much
+      slower. */
+   switch (arch) {
+      case VexArchX86:   decodeFn = X86FN(decodeInsn_X86);     break;
+      case VexArchAMD64: decodeFn = AMD64FN(decodeInsn_AMD64); break;
+      case VexArchARM64: decodeFn = ARM64FN(decodeInsn_ARM64); break;
+      default:           break;
+   }
+
+   if (decodeFn == NULL) {
+      vex_bzero(&vta, sizeof(vta));
+      vta.arch_guest       = arch;
+      vta.archinfo_guest   = *archinfo;
+      vta.arch_host        = arch;
+      vta.archinfo_host    = *archinfo;
+      vta.needs_self_check = needs_no_self_check;
+      vexLoadControl();
+      vex_traceflags = 0;
+      lift_setup(&vta, &ls);
+      /* Each insn's IR is thrown away once looked at, and nothing
+         the client made earlier in TEMP is disturbed. */
+      vexGetTempMark(&mark);
+   }
+
+   off = 0;
+   for (n = 0; n < max_insns; n++) {
+      VexDecodedInsn* insn = &insns[n];
+      if (decodeFn)
+         ok = decodeFn(bytes + off, n_bytes - off, addr + off,
+                       archinfo, insn);
+      else {
+         ok = decode_by_lifting(&ls, arch, archinfo, abiinfo,
+                                bytes + off, n_bytes - off, addr + off,
+                                insn);
+         vexReleaseTempToMark(&mark);
+      }
+      if (!ok)
+         break;
+      off += insn->len;
+      if (stop_at_branch && insn->kind != VexInsnNormal) {
+         n++;
+         break;
+      }
+   }
+   return n;
+}
+
+Bool LibVEX_DecodeInsn ( VexArch arch,
+                         const VexArchInfo* archinfo,
+                         const VexAbiInfo*  abiinfo,
+                         const UChar* bytes, UInt n_bytes, Addr addr,
+                         /*OUT*/VexDecodedInsn* insn )
+{
+   return LibVEX_DecodeRange(arch, archinfo, abiinfo, bytes, n_bytes, addr,
+                             insn, 1, False) == 1;
+}
+
+
+/* --------- Region lifting. --------- */
+
+/* Which block each insn lifted so far is in, keyed by the insn's
+   address (encoded, for Thumb: the address a jump to it would use).
+   Open addressing, so an insn that leaves its block is marked
+   RM_NONE rather than removed. */
+
+#define RM_EMPTY  (-2)
+#define RM_NONE   (-1)
+
+typedef
+   struct {
+      Addr* addrs;
+      Int*  blocks;
+      UInt  size;    /* a power of 2 */
+      UInt  used;
+   }
+   RegionMap;
+
+static UInt rm_hash ( const RegionMap* rm, Addr a )
+{
+   return (UInt)(((ULong)a * 0x9E3779B97F4A7C15ULL) >> 32) & (rm->size-1);
+}
+
+static void rm_init ( /*OUT*/RegionMap* rm, UInt size )
+{
+   UInt i;
+   rm->addrs  = LibVEX_Alloc_inline(size * sizeof(Addr));
+   rm->blocks = LibVEX_Alloc_inline(size * sizeof(Int));
+   rm->size   = size;
+   rm->used   = 0;
+   for (i = 0; i < size; i++)
+      rm->blocks[i] = RM_EMPTY;
+}
+
+static Int rm_get ( const RegionMap* rm, Addr a )
+{
+   UInt i = rm_hash(rm, a);
+   while (rm->blocks[i] != RM_EMPTY) {
+      if (rm->addrs[i] == a)
+         return rm->blocks[i];
+      i = (i + 1) & (rm->size-1);
+   }
+   return RM_NONE;
+}
+
+static void rm_set ( RegionMap* rm, Addr a, Int b )
+{
+   UInt i;
+   if (2 * (rm->used + 1) > rm->size) {
+      RegionMap old = *rm;
+      rm_init(rm, 2 * old.size);
+      for (i = 0; i < old.size; i++)
+         if (old.blocks[i] >= 0)
+            rm_set(rm, old.addrs[i], old.blocks[i]);
+   }
+   i = rm_hash(rm, a);
+   while (rm->blocks[i] != RM_EMPTY) {
+      if (rm->addrs[i] == a) {
+         rm->blocks[i] = b;
+         return;
+      }
+      i = (i + 1) & (rm->size-1);
+   }
+   rm->addrs[i]  = a;
+   rm->blocks[i] = b;
+   rm->used++;
+}
+
+static void* grow_array ( void* arr, /*MOD*/UInt* n_elems, SizeT elemSzB )
+{
+   void* arr2 = LibVEX_Alloc_inline(2 * *n_elems * elemSzB);
+   vex_memcpy(arr2, arr, *n_elems * elemSzB);
+   *n_elems *= 2;
+   return arr2;
+}
+
+typedef
+   struct {
+      VexTranslateArgs* vta;
+      const LiftSetup*  ls;
+      UInt              code_szB;
+      Int               max_bytes;  /* the caller's guest_max_bytes */
+      Bool              follow_calls;
+      VexRegion*        rg;
+      UInt              blocks_size;
+      UInt              edges_size;
+      RegionMap         map;
+      Addr*             work;
+      UInt              n_work;
+      UInt              work_size;
+   }
+   RegionBuilder;
+
+static Addr imark_addr ( const IRStmt* st )
+{
+   return st->Ist.IMark.addr + st->Ist.IMark.delta;
+}
+
+static Bool in_code ( const RegionBuilder* rb, Addr a )
+{
+   return a >= rb->vta->guest_bytes_addr
+          && a - rb->vta->guest_bytes_addr < rb->code_szB;
+}
+
+static Addr block_end ( const VexRegionBlock* blk )
+{
+   return blk->guest_extents.base[0] + blk->guest_extents.len[0];
+}
+
+static void region_push ( RegionBuilder* rb, Addr a )
+{
+   if (rb->n_work == rb->work_size)
+      rb->work = grow_array(rb->work, &rb->work_size, sizeof(Addr));
+   rb->work[rb->n_work++] = a;
+}
+
+/* Deal with one successor of block b: queue it while the blocks are
+   being found, or record the edge once they all have been. */
+static void region_succ ( RegionBuilder* rb, UInt b, Bool edges,
+                          VexEdgeKind kind, Addr a )
+{
+   VexRegion*     rg = rb->rg;
+   VexRegionEdge* e;
+   Int            to;
+
+   if (!edges) {
+      if (kind != VexEdgeCall || rb->follow_calls)
+         region_push(rb, a);
+      return;
+   }
+
+   to = rm_get(&rb->map, a);
+   if (to >= 0 && rg->blocks[to].addr != a)
+      to = -1;
+   if (rg->n_edges == rb->edges_size)
+      rg->edges = grow_array(rg->edges, &rb->edges_size,
+                             sizeof(VexRegionEdge));
+   e = &rg->edges[rg->n_edges++];
+   e->kind = kind;
+   e->from = b;
+   e->to   = to;
+   e->addr = a;
+}
+
+/* Where the block goes if it runs to the end, if known.  The front
+   end usually leaves that in the guest IP, for irsb->next to read. */
+static Bool region_next ( const RegionBuilder* rb, const IRSB* irsb,
+                          /*OUT*/Addr* a )
+{
+   const IRExpr* next = irsb->next;
+   Int           i;
+
+   if (next->tag == Iex_Get
+       && next->Iex.Get.offset == rb->ls->offB_GUEST_IP) {
+      next = NULL;
+      for (i = irsb->stmts_used - 1; i >= 0; i--) {
+         const IRStmt* st = irsb->stmts[i];
+         if (st->tag == Ist_Put
+             && st->Ist.Put.offset == rb->ls->offB_GUEST_IP) {
+            next = st->Ist.Put.data;
+            break;
+         }
+      }
+   }
+   if (next == NULL || next->tag != Iex_Const)
+      return False;
+   *a = const_to_Addr(next->Iex.Const.con);
+   return True;
+}
+
+static void region_succs ( RegionBuilder* rb, UInt b, Bool edges )
+{
+   const VexRegionBlock* blk  = &rb->rg->blocks[b];
+   const IRSB*           irsb = blk->irsb;
+   Int                   i;
+   Addr                  next;
+
+   for (i = 0; i < irsb->stmts_used; i++) {
+      const IRStmt* st = irsb->stmts[i];
+      if (st->tag == Ist_Exit && st->Ist.Exit.jk == Ijk_Boring)
+         region_succ(rb, b, edges, VexEdgeJump,
+                     const_to_Addr(st->Ist.Exit.dst));
+   }
+
+   switch (irsb->jumpkind) {
+      case Ijk_Call:
+         if (region_next(rb, irsb, &next))
+            region_succ(rb, b, edges, VexEdgeCall, next);
+         region_succ(rb, b, edges, VexEdgeCallReturn, block_end(blk));
+         break;
+      case Ijk_Boring:
+      case Ijk_Sys_syscall: case Ijk_Sys_int32: case Ijk_Sys_int128:
+      case Ijk_Sys_int129:  case Ijk_Sys_int130: case Ijk_Sys_int145:
+      case Ijk_Sys_int210:
+         if (region_next(rb, irsb, &next))
+            region_succ(rb, b, edges, VexEdgeJump, next);
+         break;
+      default:
+         break;
+   }
+}
+
+/* Cut block b short just before its insn at 'at', which is not its
+   first, so that it falls through to there.  Nothing iropt has done
+   needs undoing, since it has not been near the block yet.  The insns
+   cut off that were in b are left in no block. */
+static void region_cut ( RegionBuilder* rb, UInt b, Addr at )
+{
+   VexRegionBlock* blk  = &rb->rg->blocks[b];
+   IRSB*           irsb = blk->irsb;
+   Int             i, cut = -1;
+   UInt            n = 0;
+
+   for (i = 0; i < irsb->stmts_used; i++) {
+      const IRStmt* st = irsb->stmts[i];
+      if (st->tag != Ist_IMark)
+         continue;
+      if (imark_addr(st) == at)
+         cut = i;
+      if (cut < 0)
+         n++;
+      else if (rm_get(&rb->map, imark_addr(st)) == (Int)b)
+         rm_set(&rb->map, imark_addr(st), RM_NONE);
+   }
+   vassert(cut >= 0 && n > 0);
+
+   irsb->stmts_used = cut;
+   irsb->next       = IRExpr_Const(rb->ls->guest_word_type == Ity_I32
+                                      ? IRConst_U32((UInt)at)
+                                      : IRConst_U64(at));
+   irsb->jumpkind   = Ijk_Boring;
+   blk->n_guest_instrs         = n;
+   blk->guest_extents.len[0]   = (UShort)(at - blk->addr);
+}
+
+/* Front ends read up to a whole insn beyond the last one they
+   decode, and ARM Thumb up to 18 bytes before the first.  This much
+   slack around a block is enough for any of them. */
+#define REGION_PAD 32
+
+/* Run the front end from a, as far as the first insn already in some
+   block or the end of the code, whichever comes first. */
+static void region_lift ( RegionBuilder* rb, Addr a )
+{
+   VexRegion*         rg = rb->rg;
+   VexRegionBlock*    blk;
+   VexTranslateArgs   one;
+   VexTranslateResult res;
+   UInt               b = rg->n_blocks;
+   Int                i;
+   Addr               end    = rb->vta->guest_bytes_addr + rb->code_szB;
+   UInt               before = a - rb->vta->guest_bytes_addr;
+   UInt               avail  = end - a;
+   const UChar*       bytes  = rb->vta->guest_bytes + before;
+
+   if (rg->n_blocks == rb->blocks_size)
+      rg->blocks = grow_array(rg->blocks, &rb->blocks_size,
+                              sizeof(VexRegionBlock));
+   blk = &rg->blocks[b];
+   vex_bzero(blk, sizeof(*blk));
+
+   /* Near either end of the code, lift from a copy with zeroes
+      around it, so that the front end stays inside the caller's
+      buffer.  Near the end, also stop it going more than REGION_PAD
+      past the end; insns running past the end are cut off below. */
+   if (before < REGION_PAD
+       || avail < (UInt)rb->max_bytes + 2 * REGION_PAD) {
+      UInt   n   = avail < (UInt)rb->max_bytes + REGION_PAD
+                      ? avail : (UInt)rb->max_bytes + REGION_PAD;
+      UChar* win = LibVEX_Alloc_inline(n + 3 * REGION_PAD);
+      if (before > REGION_PAD)
+         before = REGION_PAD;
+      vex_bzero(win, n + 3 * REGION_PAD);
+      vex_memcpy(win + REGION_PAD - before, bytes - before, before + n);
+      bytes = win + REGION_PAD;
+      if (avail + REGION_PAD < (UInt)rb->max_bytes)
+         vex_control.guest_max_bytes = avail + REGION_PAD;
+   }
+
+   one = *rb->vta;
+   one.guest_bytes      = bytes;
+   one.guest_bytes_addr = a;
+   one.guest_extents    = &blk->guest_extents;
+   one.chase_into_ok    = chase_into_nothing;
+
+   blk->irsb = lift_front(&one, rb->ls, &res, &blk->pxControl);
+   vex_control.guest_max_bytes = rb->max_bytes;
+   if (blk->irsb == NULL)
+      return;
+   vassert(blk->guest_extents.n_used == 1);
+
+   /* A first insn that does not fit in the code means no block. */
+   for (i = 0; i < blk->irsb->stmts_used; i++) {
+      const IRStmt* st = blk->irsb->stmts[i];
+      if (st->tag == Ist_IMark) {
+         if (st->Ist.IMark.len > avail)
+            return;
+         break;
+      }
+   }
+
+   blk->addr           = a;
+   blk->n_guest_instrs = res.n_guest_instrs;
+   rg->n_blocks++;
+
+   rm_set(&rb->map, a, b);
+   for (i = 0; i < blk->irsb->stmts_used; i++) {
+      const IRStmt* st = blk->irsb->stmts[i];
+      Addr          ia;
+      if (st->tag != Ist_IMark)
+         continue;
+      ia = imark_addr(st);
+      if (ia == a)
+         continue;
+      if (rm_get(&rb->map, ia) >= 0 || ia >= end
+          || st->Ist.IMark.len > end - ia) {
+         region_cut(rb, b, ia);
+         break;
+      }
+      rm_set(&rb->map, ia, b);
+   }
+
+   region_succs(rb, b, False);
+}
+
+static VexRegion* lift_region ( VexTranslateArgs* vta, const LiftSetup* ls,
+                                UInt code_szB, Int max_bytes,
+                                const Addr* entries, UInt n_entries,
+                                UInt max_blocks, Bool follow_calls,
+                                /*OUT*/VexTranslateResult* res )
+{
+   RegionBuilder      rb;
+   VexRegion*         rg;
+   VexTranslateArgs   one;
+   VexTranslateResult bres;
+   IRTypeEnv*         env;
+   UInt               i, n_temps;
+   Int                b;
+
+   rg = LibVEX_Alloc_inline(sizeof(VexRegion));
+   vex_bzero(rg, sizeof(*rg));
+   vex_bzero(&rb, sizeof(rb));
+   rb.vta          = vta;
+   rb.ls           = ls;
+   rb.code_szB     = code_szB;
+   rb.max_bytes    = max_bytes;
+   rb.follow_calls = follow_calls;
+   rb.rg           = rg;
+   rb.blocks_size  = 16;
+   rb.edges_size   = 32;
+   rb.work_size    = n_entries + 16;
+   rg->blocks      = LibVEX_Alloc_inline(rb.blocks_size
+                                         * sizeof(VexRegionBlock));
+   rg->edges       = LibVEX_Alloc_inline(rb.edges_size
+                                         * sizeof(VexRegionEdge));
+   rb.work         = LibVEX_Alloc_inline(rb.work_size * sizeof(Addr));
+   rm_init(&rb.map, 256);
+
+   /* Find the blocks.  A jump into the middle of a block cuts it in
+      two: the first part keeps the IR it has, the second is lifted
+      afresh. */
+   for (i = n_entries; i > 0; i--)
+      region_push(&rb, entries[i-1]);
+   while (rb.n_work > 0) {
+      Addr a = rb.work[--rb.n_work];
+      if (!in_code(&rb, a))
+         continue;
+      b = rm_get(&rb.map, a);
+      if (b >= 0 && rg->blocks[b].addr == a)
+         continue;
+      if (rg->n_blocks == max_blocks) {
+         rg->truncated = True;
+         continue;
+      }
+      if (b >= 0)
+         region_cut(&rb, b, a);
+      region_lift(&rb, a);
+   }
+
+   /* Then link them up and finish them off. */
+   one     = *vta;
+   n_temps = 0;
+   res->n_guest_instrs = 0;
+   for (i = 0; i < rg->n_blocks; i++) {
+      VexRegionBlock* blk = &rg->blocks[i];
+      blk->first_edge = rg->n_edges;
+      region_succs(&rb, i, True);
+      blk->n_edges = rg->n_edges - blk->first_edge;
+
+      one.guest_bytes      = vta->guest_bytes
+                             + (blk->addr - vta->guest_bytes_addr);
+      one.guest_bytes_addr = blk->addr;
+      one.guest_extents    = &blk->guest_extents;
+      bres.n_guest_instrs  = blk->n_guest_instrs;
+      blk->irsb = lift_finish(&one, ls, blk->irsb, &bres, blk->pxControl);
+      n_temps += blk->irsb->tyenv->types_used;
+      res->n_guest_instrs += blk->n_guest_instrs;
+   }
+
+   /* Give all the blocks one type environment.  Each block's temps
+      are moved up past those of the blocks before it. */
+   env             = LibVEX_Alloc_inline(sizeof(IRTypeEnv));
+   env->types_size = n_temps > 0 ? n_temps : 8;
+   env->types_used = 0;
+   env->types      = LibVEX_Alloc_inline(env->types_size * sizeof(IRType));
+   for (i = 0; i < rg->n_blocks; i++) {
+      IRSB*            irsb = rg->blocks[i].irsb;
+      const IRTypeEnv* own  = irsb->tyenv;
+      if (env->types_used > 0) {
+         irsb = deepCopyIRSB(irsb);
+         renumberIRTemps(irsb, env->types_used);
+      }
+      vex_memcpy(&env->types[env->types_used], own->types,
+                 own->types_used * sizeof(IRType));
+      env->types_used += own->types_used;
+      irsb->tyenv = env;
+      rg->blocks[i].irsb = irsb;
+   }
+   rg->tyenv = env;
+
+   rg->entries = LibVEX_Alloc_inline((n_entries > 0 ? n_entries : 1)
+                                     * sizeof(Int));
+   for (i = 0; i < n_entries; i++) {
+      b = rm_get(&rb.map, entries[i]);
+      rg->entries[i] = b >= 0 && rg->blocks[b].addr == entries[i] ? b : -1;
+   }
+   return rg;
+}
+
+#undef REGION_PAD
+#undef RM_EMPTY
+#undef RM_NONE
+
+
+VexRegion* LibVEX_LiftRegion ( VexTranslateArgs* vta, UInt guest_bytes_szB,
+                               const Addr* entries, UInt n_entries,
+                               UInt max_blocks, Bool follow_calls,
+                               /*OUT*/VexTranslateResult* res )
+{
+   LiftSetup       ls;
+   VexRegion*      rg;
+   VexRecoverPoint rp;
+   Int             unroll, max_bytes;
+
+   vexLoadControl();
+
+   vexSetAllocModeTEMP_and_clear();
+   vexAllocSanityCheck();
+
+   vex_traceflags = vta->traceflags;
+
+   /* iropt unrolls blocks that jump back to their own start, which
+      would put their insns in the region more than once. */
+   unroll = vex_control.iropt_unroll_thresh;
+   vex_control.iropt_unroll_thresh = 0;
+   /* region_lift lowers this for blocks near the end of the code */
+   max_bytes = vex_control.guest_max_bytes;
+
+   vex_recover = NULL;
+   if (vta->recover_errors) {
+      if (vexRecoverSet(&rp)) {
+         vex_control.iropt_unroll_thresh = unroll;
+         vex_control.guest_max_bytes     = max_bytes;
+         recovered(&rp, res, True);
+         return NULL;
+      }
+      vex_recover = &rp;
+   }
+
+   lift_setup(vta, &ls);
+   res->status       = VexTransOK;
+   res->error_code   = VexTransErrNone;
+   res->error_msg    = NULL;
+   res->n_sc_extents = 0;
+   res->offs_profInc = -1;
+   rg = lift_region(vta, &ls, guest_bytes_szB, max_bytes,
+                    entries, n_entries, max_blocks, follow_calls, res);
+   vex_recover = NULL;
+   vex_control.iropt_unroll_thresh = unroll;
+   return rg;
+}
+
+
+static void codegen_block ( VexTranslateArgs *vta,
+                            VexTranslateResult *res,
+                            IRSB *irsb,
+                            VexRegisterUpdates pxControl )
 {
    /* This the bundle of functions we need to do the back-end stuff
       (insn selection, reg-alloc, assembly) whilst being insulated
@@ -741,6 +1921,7 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
    void         (*genSpill)     ( HInstr**, HInstr**, HReg, Int, Bool );
    void         (*genReload)    ( HInstr**, HInstr**, HReg, Int, Bool );
    HInstr*      (*directReload) ( HInstr*, HReg, Short );
+   void         (*peephole)     ( HInstrArray*, Bool );
    void         (*ppInstr)      ( const HInstr*, Bool );
    void         (*ppReg)        ( HReg );
    HInstrArray* (*iselSB)       ( const IRSB*, VexArch, const VexArchInfo*,
@@ -761,8 +1942,11 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
    Int offB_HOST_EvC_FAILADDR;
    Addr            max_ga;
    UChar           insn_bytes[128];
+   Bool            all_fit;
+   Int             peep_bytes;
    HInstrArray*    vcode;
    HInstrArray*    rcode;
+   VexStageMark    m;
 
    isMove                  = NULL;
    getRegUsage             = NULL;
@@ -770,6 +1954,7 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
    genSpill                = NULL;
    genReload               = NULL;
    directReload            = NULL;
+   peephole                = NULL;
    ppInstr                 = NULL;
    ppReg                   = NULL;
    iselSB                  = NULL;
@@ -784,6 +1969,11 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
 
    vassert(vex_initdone);
    vassert(vta->disp_cp_xassisted != NULL);
+   /* Raw IR can't be code generated. */
+   vassert(vta->lift_mode != VexLiftRaw);
+
+   vexLoadControl();
+   vexStatsSelect(vta->arch_guest, vta->arch_host);
 
    vex_traceflags = vta->traceflags;
 
@@ -912,6 +2102,7 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
          mapRegs      = CAST_AS(mapRegs) AMD64FN(mapRegs_AMD64Instr);
          genSpill     = CAST_AS(genSpill) AMD64FN(genSpill_AMD64);
          genReload    = CAST_AS(genReload) AMD64FN(genReload_AMD64);
+         peephole     = AMD64FN(peephole_AMD64Instrs);
          ppInstr      = CAST_AS(ppInstr) AMD64FN(ppAMD64Instr);
          ppReg        = CAST_AS(ppReg) AMD64FN(ppHRegAMD64);
          iselSB       = AMD64FN(iselSB_AMD64);
@@ -996,6 +2187,7 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
          mapRegs      = CAST_AS(mapRegs) ARM64FN(mapRegs_ARM64Instr);
          genSpill     = CAST_AS(genSpill) ARM64FN(genSpill_ARM64);
          genReload    = CAST_AS(genReload) ARM64FN(genReload_ARM64);
+         peephole     = ARM64FN(peephole_ARM64Instrs);
          ppInstr      = CAST_AS(ppInstr) ARM64FN(ppARM64Instr);
          ppReg        = CAST_AS(ppReg) ARM64FN(ppHRegARM64);
          iselSB       = ARM64FN(iselSB_ARM64);
@@ -1064,11 +2256,13 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
 
    /* Turn it into virtual-registerised code.  Build trees -- this
       also throws away any dead bindings. */
+   vexStatsBegin(&m);
    max_ga = ado_treebuild_BB( irsb, preciseMemExnsFn, pxControl );
 
    if (vta->finaltidy) {
       irsb = vta->finaltidy(irsb);
    }
+   vexStatsEnd(VexStageTreeBuild, &m);
 
    vexAllocSanityCheck();
 
@@ -1097,6 +2291,7 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
       irsb->offsIP properly. */
    vassert(irsb->offsIP >= 16);
 
+   vexStatsBegin(&m);
    vcode = iselSB ( irsb, vta->arch_host,
                     &vta->archinfo_host, 
                     &vta->abiinfo_both,
@@ -1105,6 +2300,7 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
                     chainingAllowed,
                     vta->addProfInc,
                     max_ga );
+   vexStatsEnd(VexStageIsel, &m);
 
    vexAllocSanityCheck();
 
@@ -1121,14 +2317,47 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
    }
 
    /* Register allocate. */
-   rcode = doRegisterAllocation ( vcode, rRegUniv,
-                                  isMove, getRegUsage, mapRegs, 
-                                  genSpill, genReload, directReload, 
-                                  guest_sizeB,
-                                  ppInstr, ppReg, mode64 );
+   vexStatsBegin(&m);
+   if (vex_control.regalloc_version == 3)
+      rcode = doRegisterAllocation_v3 ( vcode, rRegUniv,
+                                        isMove, getRegUsage, mapRegs,
+                                        genSpill, genReload, directReload,
+                                        guest_sizeB,
+                                        ppInstr, ppReg, mode64 );
+   else
+      rcode = doRegisterAllocation ( vcode, rRegUniv,
+                                     isMove, getRegUsage, mapRegs, 
+                                     genSpill, genReload, directReload, 
+                                     guest_sizeB,
+                                     ppInstr, ppReg, mode64 );
+   vexStatsEnd(VexStageRegAlloc, &m);
 
    vexAllocSanityCheck();
 
+   /* Tidy up the allocated code, if the host has a way to. */
+   peep_bytes = 0;
+   if (vex_control.host_peephole && peephole != NULL) {
+      if (vex_stats != NULL) {
+         /* Size the code as allocated, so that what the pass saves
+            can be charged once the result has been assembled.  This
+            costs a second emit of the block, so it is done only when
+            someone is collecting the numbers. */
+         for (i = 0; i < rcode->arr_used; i++) {
+            Bool isProfInc = False;
+            peep_bytes += emit( &isProfInc,
+                                insn_bytes, sizeof insn_bytes, rcode->arr[i],
+                                mode64, vta->archinfo_host.endness,
+                                vta->disp_cp_chain_me_to_slowEP,
+                                vta->disp_cp_chain_me_to_fastEP,
+                                vta->disp_cp_xindir,
+                                vta->disp_cp_xassisted );
+         }
+      }
+      vexStatsBegin(&m);
+      peephole(rcode, mode64);
+      vexStatsEnd(VexStagePeephole, &m);
+   }
+
    if (vex_traceflags & VEX_TRACE_RCODE) {
       vex_printf("\n------------------------" 
                    " Register-allocated code "
@@ -1155,16 +2384,29 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
                    "------------------------\n\n");
    }
 
+   /* Instructions are emitted straight into host_bytes.  No single
+      instruction is longer than insn_bytes, so if the whole block is
+      certain to fit at that worst-case size, no further checks are
+      needed.  Otherwise instructions are emitted directly until the
+      remaining space drops below insn_bytes, after which each one is
+      staged in insn_bytes and copied only if it fits. */
+   vexStatsBegin(&m);
+   all_fit  = (Long)rcode->arr_used * (Long)sizeof insn_bytes
+                 <= (Long)vta->host_bytes_size;
    out_used = 0; /* tracks along the host_bytes array */
    for (i = 0; i < rcode->arr_used; i++) {
       HInstr* hi           = rcode->arr[i];
       Bool    hi_isProfInc = False;
+      UChar*  dst          = &vta->host_bytes[out_used];
+      Bool    staged;
       if (UNLIKELY(vex_traceflags & VEX_TRACE_ASM)) {
          ppInstr(hi, mode64);
          vex_printf("\n");
       }
+      staged = !all_fit && vta->host_bytes_size - out_used
+                              < (Int)sizeof insn_bytes;
       j = emit( &hi_isProfInc,
-                insn_bytes, sizeof insn_bytes, hi,
+                staged ? insn_bytes : dst, sizeof insn_bytes, hi,
                 mode64, vta->archinfo_host.endness,
                 vta->disp_cp_chain_me_to_slowEP,
                 vta->disp_cp_chain_me_to_fastEP,
@@ -1172,14 +2414,18 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
                 vta->disp_cp_xassisted );
       if (UNLIKELY(vex_traceflags & VEX_TRACE_ASM)) {
          for (k = 0; k < j; k++)
-            vex_printf("%02x ", (UInt)insn_bytes[k]);
+            vex_printf("%02x ", (UInt)(staged ? insn_bytes : dst)[k]);
          vex_printf("\n\n");
       }
-      if (UNLIKELY(out_used + j > vta->host_bytes_size)) {
-         vexSetAllocModeTEMP_and_clear();
-         vex_traceflags = 0;
-         res->status = VexTransOutputFull;
-         return;
+      if (UNLIKELY(staged)) {
+         if (out_used + j > vta->host_bytes_size) {
+            vexSetAllocModeTEMP_and_clear();
+            vex_traceflags = 0;
+            res->status = VexTransOutputFull;
+            return;
+         }
+         for (k = 0; k < j; k++)
+            dst[k] = insn_bytes[k];
       }
       if (UNLIKELY(hi_isProfInc)) {
          vassert(vta->addProfInc); /* else where did it come from? */
@@ -1187,14 +2433,19 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
          vassert(out_used >= 0);
          res->offs_profInc = out_used;
       }
-      { UChar* dst = &vta->host_bytes[out_used];
-        for (k = 0; k < j; k++) {
-           dst[k] = insn_bytes[k];
-        }
-        out_used += j;
-      }
+      out_used += j;
    }
    *(vta->host_bytes_used) = out_used;
+   vexStatsEnd(VexStageEmit, &m);
+
+   if (vex_stats != NULL) {
+      vex_stats->n_blocks_emitted++;
+      vex_stats->n_host_bytes += out_used;
+      /* Only blocks the pass made shorter count; anything else would
+         wrap the unsigned total. */
+      if (peep_bytes > out_used)
+         vex_stats->n_peephole_bytes += peep_bytes - out_used;
+   }
 
    vexAllocSanityCheck();
 
@@ -1215,6 +2466,166 @@ void LibVEX_Codegen (   VexTranslateArgs *vta,
    return;
 }
 
+void LibVEX_Codegen (   VexTranslateArgs *vta,
+                        VexTranslateResult *res,
+                        IRSB *irsb,
+                        VexRegisterUpdates pxControl)
+{
+   VexRecoverPoint rp;
+
+   vex_recover = NULL;
+   if (vta->recover_errors) {
+      if (vexRecoverSet(&rp)) {
+         recovered(&rp, res, True);
+         return;
+      }
+      vex_recover = &rp;
+   }
+
+   codegen_block(vta, res, irsb, pxControl);
+   vex_recover = NULL;
+}
+
+
+/* --------- Translation contexts. --------- */
+
+#define VEX_CONTEXT_MAGIC 0x56435458 /* "VCTX" */
+
+/* While a thread is working in a context, the context's arena field
+   holds the thread's own TEMP area, and vice versa. */
+
+static void leave_context ( VexContext* ctx )
+{
+   vassert(curr_context == ctx);
+   vexSwapTempArea(&ctx->arena);
+   curr_context = NULL;
+}
+
+static void enter_context ( VexContext* ctx )
+{
+   vassert(vex_initdone);
+   vassert(ctx->magic == VEX_CONTEXT_MAGIC);
+
+   /* If failure_exit longjmp'd out of a translation in some context,
+      this thread is still in it.  Put things straight first. */
+   if (UNLIKELY(curr_context != NULL))
+      leave_context(curr_context);
+
+   vexSwapTempArea(&ctx->arena);
+   vex_control  = ctx->control;
+   curr_context = ctx;
+}
+
+
+/* Exported to library client. */
+
+void LibVEX_InitContext ( /*OUT*/VexContext* ctx,
+                          void* arena, SizeT arena_szB,
+                          const VexControl* vcon )
+{
+   vassert(vex_initdone);
+   vassert(arena != NULL);
+   vassert(0 == (((HWord)arena) & (REQ_ALIGN-1)));
+   arena_szB &= ~(SizeT)(REQ_ALIGN-1);
+   /* Anything smaller will not survive even a modest block. */
+   vassert(arena_szB >= 65536);
+
+   vex_bzero(ctx, sizeof(*ctx));
+   ctx->magic       = VEX_CONTEXT_MAGIC;
+   ctx->arena.first      = (HChar*)arena;
+   ctx->arena.curr       = (HChar*)arena;
+   ctx->arena.last       = (HChar*)arena + arena_szB - 1;
+   ctx->arena.base_first = ctx->arena.first;
+   ctx->arena.base_last  = ctx->arena.last;
+   ctx->arena.slabs      = NULL;
+   if (vcon) {
+      check_control(vcon);
+      ctx->control = *vcon;
+   } else {
+      ctx->control = vex_control_default;
+   }
+}
+
+void LibVEX_Update_Control_ctx ( VexContext* ctx, const VexControl* vcon )
+{
+   vassert(ctx->magic == VEX_CONTEXT_MAGIC);
+   check_control(vcon);
+   ctx->control = *vcon;
+}
+
+VexTranslateResult LibVEX_Translate_ctx ( VexContext* ctx,
+                                          VexTranslateArgs* vta )
+{
+   VexTranslateResult res;
+   enter_context(ctx);
+   res = LibVEX_Translate(vta);
+   leave_context(ctx);
+   return res;
+}
+
+IRSB* LibVEX_Lift_ctx ( VexContext* ctx,
+                        VexTranslateArgs* vta,
+                        /*OUT*/ VexTranslateResult* res,
+                        /*OUT*/ VexRegisterUpdates* pxControl )
+{
+   IRSB* irsb;
+   enter_context(ctx);
+   irsb = LibVEX_Lift(vta, res, pxControl);
+   leave_context(ctx);
+   return irsb;
+}
+
+void LibVEX_Codegen_ctx ( VexContext* ctx,
+                          VexTranslateArgs* vta,
+                          VexTranslateResult* res,
+                          IRSB* irsb,
+                          VexRegisterUpdates pxControl )
+{
+   enter_context(ctx);
+   LibVEX_Codegen(vta, res, irsb, pxControl);
+   leave_context(ctx);
+}
+
+IRSB* LibVEX_Lift_cached_ctx ( VexContext* ctx,
+                               VexLiftCache* cache,
+                               VexTranslateArgs* vta,
+                               /*OUT*/ VexTranslateResult* res,
+                               /*OUT*/ VexRegisterUpdates* pxControl )
+{
+   IRSB* irsb;
+   enter_context(ctx);
+   irsb = LibVEX_Lift_cached(cache, vta, res, pxControl);
+   leave_context(ctx);
+   return irsb;
+}
+
+UInt LibVEX_LiftBatch_ctx ( VexContext* ctx,
+                            VexTranslateArgs* vta,
+                            /*MOD*/VexLiftRequest* reqs, UInt n_reqs,
+                            void (*deliver)( void*, VexLiftRequest* ) )
+{
+   UInt n_ok;
+   enter_context(ctx);
+   n_ok = LibVEX_LiftBatch(vta, reqs, n_reqs, deliver);
+   leave_context(ctx);
+   return n_ok;
+}
+
+VexRegion* LibVEX_LiftRegion_ctx ( VexContext* ctx,
+                                   VexTranslateArgs* vta,
+                                   UInt guest_bytes_szB,
+                                   const Addr* entries, UInt n_entries,
+                                   UInt max_blocks, Bool follow_calls,
+                                   /*OUT*/VexTranslateResult* res )
+{
+   VexRegion* rg;
+   enter_context(ctx);
+   rg = LibVEX_LiftRegion(vta, guest_bytes_szB, entries, n_entries,
+                          max_blocks, follow_calls, res);
+   leave_context(ctx);
+   return rg;
+}
+
 
 /* --------- Chain/Unchain XDirects. --------- */
 
@@ -1347,34 +2758,32 @@ VexInvalRange LibVEX_UnChain ( VexArch     arch_host,
 
 Int LibVEX_evCheckSzB ( VexArch    arch_host )
 {
-   static Int cached = 0; /* DO NOT MAKE NON-STATIC */
-   if (UNLIKELY(cached == 0)) {
-      switch (arch_host) {
-         case VexArchX86:
-            X86ST(cached = evCheckSzB_X86()); break;
-         case VexArchAMD64:
-            AMD64ST(cached = evCheckSzB_AMD64()); break;
-         case VexArchARM:
-            ARMST(cached = evCheckSzB_ARM()); break;
-         case VexArchARM64:
-            ARM64ST(cached = evCheckSzB_ARM64()); break;
-         case VexArchS390X:
-            S390ST(cached = evCheckSzB_S390()); break;
-         case VexArchPPC32:
-            PPC32ST(cached = evCheckSzB_PPC()); break;
-         case VexArchPPC64:
-            PPC64ST(cached = evCheckSzB_PPC()); break;
-         case VexArchMIPS32:
-            MIPS32ST(cached = evCheckSzB_MIPS()); break;
-         case VexArchMIPS64:
-            MIPS64ST(cached = evCheckSzB_MIPS()); break;
-         case VexArchTILEGX:
-            TILEGXST(cached = evCheckSzB_TILEGX()); break;
-         default:
-            vassert(0);
-      }
+   /* Each of these returns a constant, so there is nothing to cache;
+      a cache would be shared between threads and between hosts. */
+   switch (arch_host) {
+      case VexArchX86:
+         X86ST(return evCheckSzB_X86());
+      case VexArchAMD64:
+         AMD64ST(return evCheckSzB_AMD64());
+      case VexArchARM:
+         ARMST(return evCheckSzB_ARM());
+      case VexArchARM64:
+         ARM64ST(return evCheckSzB_ARM64());
+      case VexArchS390X:
+         S390ST(return evCheckSzB_S390());
+      case VexArchPPC32:
+         PPC32ST(return evCheckSzB_PPC());
+      case VexArchPPC64:
+         PPC64ST(return evCheckSzB_PPC());
+      case VexArchMIPS32:
+         MIPS32ST(return evCheckSzB_MIPS());
+      case VexArchMIPS64:
+         MIPS64ST(return evCheckSzB_MIPS());
+      case VexArchTILEGX:
+         TILEGXST(return evCheckSzB_TILEGX());
+      default:
+         vassert(0);
    }
-   return cached;
 }
 
 VexInvalRange LibVEX_PatchProfInc ( VexArch    arch_host,
@@ -1574,7 +2983,9 @@ static IRType arch_word_size (VexArch arch) {
 #define NUM_HWCAPS (sizeof hwcaps_list / sizeof hwcaps_list[0])
 
 /* Return a string showing the hwcaps in a nice way.  The string will
-   be NULL for unrecognised hardware capabilities. */
+   be NULL for unrecognised hardware capabilities.  Those that are
+   built up are built afresh on each call, in a buffer private to the
+   calling thread, and stay valid until its next call. */
 
 static const HChar* show_hwcaps_x86 ( UInt hwcaps ) 
 {
@@ -1590,9 +3001,9 @@ static const HChar* show_hwcaps_x86 ( UInt hwcaps )
       { VEX_HWCAPS_X86_LZCNT,  "lzcnt"  },
    };
    /* Allocate a large enough buffer */
-   static HChar buf[sizeof prefix + 
-                    NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1) + 1]; // '\0'
-   if (buf[0] != '\0') return buf;  /* already constructed */
+   static VEX_TLS HChar buf[sizeof prefix + 
+                            NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1)
+                            + 1]; // '\0'
 
    HChar *p = buf + vex_sprintf(buf, "%s", prefix);
 
@@ -1624,9 +3035,9 @@ static const HChar* show_hwcaps_amd64 ( UInt hwcaps )
       { VEX_HWCAPS_AMD64_BMI,    "bmi"    },
    };
    /* Allocate a large enough buffer */
-   static HChar buf[sizeof prefix + 
-                    NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1) + 1]; // '\0'
-   if (buf[0] != '\0') return buf;  /* already constructed */
+   static VEX_TLS HChar buf[sizeof prefix + 
+                            NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1)
+                            + 1]; // '\0'
 
    HChar *p = buf + vex_sprintf(buf, "%s", prefix);
 
@@ -1659,9 +3070,9 @@ static const HChar* show_hwcaps_ppc32 ( UInt hwcaps )
       { VEX_HWCAPS_PPC32_ISA3_0,  "ISA3_0"  },
    };
    /* Allocate a large enough buffer */
-   static HChar buf[sizeof prefix + 
-                    NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1) + 1]; // '\0'
-   if (buf[0] != '\0') return buf;  /* already constructed */
+   static VEX_TLS HChar buf[sizeof prefix + 
+                            NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1)
+                            + 1]; // '\0'
 
    HChar *p = buf + vex_sprintf(buf, "%s", prefix);
 
@@ -1690,9 +3101,9 @@ static const HChar* show_hwcaps_ppc64 ( UInt hwcaps )
       { VEX_HWCAPS_PPC64_ISA3_0,  "ISA3_0"  },
    };
    /* Allocate a large enough buffer */
-   static HChar buf[sizeof prefix + 
-                    NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1) + 1]; // '\0'
-   if (buf[0] != '\0') return buf;  /* already constructed */
+   static VEX_TLS HChar buf[sizeof prefix + 
+                            NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1)
+                            + 1]; // '\0'
 
    HChar *p = buf + vex_sprintf(buf, "%s", prefix);
 
@@ -1717,9 +3128,9 @@ static const HChar* show_hwcaps_arm ( UInt hwcaps )
       { VEX_HWCAPS_ARM_VFP | VEX_HWCAPS_ARM_VFP2 | VEX_HWCAPS_ARM_VFP3, "vfp" },
    };
    /* Allocate a large enough buffer */
-   static HChar buf[sizeof prefix + 12 +    // level
-                    NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1) + 1]; // '\0'
-   if (buf[0] != '\0') return buf;  /* already constructed */
+   static VEX_TLS HChar buf[sizeof prefix + 12 +    // level
+                            NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1)
+                            + 1]; // '\0'
 
    HChar *p;
    UInt i, level;
@@ -1764,10 +3175,9 @@ static const HChar* show_hwcaps_s390x ( UInt hwcaps )
       { VEX_HWCAPS_S390X_PFPO,  "pfpo" },
    };
    /* Allocate a large enough buffer */
-   static HChar buf[sizeof prefix + 
-                    NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1) + 1]; // '\0'
-
-   if (buf[0] != '\0') return buf;  /* already constructed */
+   static VEX_TLS HChar buf[sizeof prefix + 
+                            NUM_HWCAPS * (sizeof hwcaps_list[0].name + 1)
+                            + 1]; // '\0'
 
    HChar *p;
    UInt i;
@@ -0,0 +1,131 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*---------------------------------------------------------------*/
+/*--- begin                                      main_stats.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* The pipeline statistics described in pub/libvex.h. */
+
+#include "libvex_basictypes.h"
+#include "libvex.h"
+
+#include "main_util.h"
+#include "main_stats.h"
+
+
+/* The clock, shared by all threads.  NULL means statistics are off. */
+static ULong (*volatile stats_clock)( void ) = NULL;
+
+/* This thread's records, and the clock the current translation
+   started with, so that a concurrent LibVEX_EnablePipelineStats(NULL)
+   cannot pull it out from under a stage. */
+static VEX_TLS VexPipelineStats stats[VEX_PIPESTATS_MAX_PAIRS];
+static VEX_TLS UInt             stats_used = 0;
+static VEX_TLS ULong            (*stats_clock_curr)( void ) = NULL;
+
+VEX_TLS VexPipelineStats* vex_stats = NULL;
+
+
+void vexStatsSelect ( VexArch arch_guest, VexArch arch_host )
+{
+   VexPipelineStats* s;
+   UInt              i;
+
+   stats_clock_curr = stats_clock;
+   if (LIKELY(stats_clock_curr == NULL)) {
+      vex_stats = NULL;
+      return;
+   }
+
+   if (vex_stats != NULL && vex_stats->arch_guest == arch_guest
+       && vex_stats->arch_host == arch_host)
+      return;
+
+   for (i = 0; i < stats_used; i++) {
+      s = &stats[i];
+      if (s->arch_guest == arch_guest && s->arch_host == arch_host) {
+         vex_stats = s;
+         return;
+      }
+   }
+
+   if (stats_used < VEX_PIPESTATS_MAX_PAIRS) {
+      s = &stats[stats_used++];
+      vex_bzero(s, sizeof(*s));
+      s->arch_guest = arch_guest;
+      s->arch_host  = arch_host;
+   } else {
+      /* Out of records.  Lump this pair in with the last one. */
+      s = &stats[VEX_PIPESTATS_MAX_PAIRS-1];
+      s->arch_guest = VexArch_INVALID;
+      s->arch_host  = VexArch_INVALID;
+   }
+   vex_stats = s;
+}
+
+void vexStatsMark ( /*OUT*/VexStageMark* m )
+{
+   vassert(stats_clock_curr != NULL);
+   m->time  = stats_clock_curr();
+   m->bytes = vexTempBytesAllocd();
+}
+
+void vexStatsCharge ( VexStage stage, const VexStageMark* m )
+{
+   VexStageStats* st;
+   vassert(stage >= 0 && stage < VexStage_LAST);
+   st = &vex_stats->stage[stage];
+   st->n_runs++;
+   st->time  += stats_clock_curr() - m->time;
+   st->bytes += vexTempBytesAllocd() - m->bytes;
+}
+
+
+/* Exported to library client. */
+
+void LibVEX_EnablePipelineStats ( ULong (*clock)( void ) )
+{
+   stats_clock = clock;
+}
+
+void LibVEX_ResetPipelineStats ( void )
+{
+   stats_used = 0;
+   vex_stats  = NULL;
+}
+
+UInt LibVEX_GetPipelineStats ( /*OUT*/VexPipelineStats* out,
+                               UInt max_pairs )
+{
+   UInt i;
+   for (i = 0; i < stats_used && i < max_pairs; i++)
+      out[i] = stats[i];
+   return stats_used;
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- end                                        main_stats.c ---*/
+/*---------------------------------------------------------------*/
@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------*/
+/*--- begin                                      main_stats.h ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __VEX_MAIN_STATS_H
+#define __VEX_MAIN_STATS_H
+
+#include "libvex_basictypes.h"
+#include "libvex.h"
+#include "main_util.h"
+
+/* Hooks for LibVEX_GetPipelineStats.  vex_stats is the record that
+   the current translation is charged to, or NULL when statistics are
+   off, in which case the hooks below cost a test and a branch. */
+
+extern VEX_TLS VexPipelineStats* vex_stats;
+
+/* Point vex_stats at the record for this arch pair.  Called at the
+   start of each lift and each codegen. */
+extern void vexStatsSelect ( VexArch arch_guest, VexArch arch_host );
+
+typedef
+   struct {
+      ULong time;
+      ULong bytes;
+   }
+   VexStageMark;
+
+extern void vexStatsMark ( /*OUT*/VexStageMark* m );
+extern void vexStatsCharge ( VexStage stage, const VexStageMark* m );
+
+/* Bracket a stage:
+      VexStageMark m;
+      vexStatsBegin(&m);
+      .. do the work ..
+      vexStatsEnd(VexStageIsel, &m);
+*/
+static inline void vexStatsBegin ( /*OUT*/VexStageMark* m )
+{
+   if (UNLIKELY(vex_stats != NULL))
+      vexStatsMark(m);
+}
+
+static inline void vexStatsEnd ( VexStage stage, const VexStageMark* m )
+{
+   if (UNLIKELY(vex_stats != NULL))
+      vexStatsCharge(stage, m);
+}
+
+#endif /* ndef __VEX_MAIN_STATS_H */
+
+/*---------------------------------------------------------------*/
+/*--- end                                        main_stats.h ---*/
+/*---------------------------------------------------------------*/
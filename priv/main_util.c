@@ -55,11 +55,53 @@
 #define N_TEMPORARY_BYTES 5000000
 
 static HChar  temporary[N_TEMPORARY_BYTES] __attribute__((aligned(REQ_ALIGN)));
-static HChar* temporary_first = &temporary[0];
-static HChar* temporary_curr  = &temporary[0];
-static HChar* temporary_last  = &temporary[N_TEMPORARY_BYTES-1];
 
-static ULong  temporary_bytes_allocd_TOT = 0;
+/* This thread's TEMP area.  Normally its base is the static one
+   above, but a thread working in a VexContext uses the context's area
+   instead; see vexSwapTempArea.
+
+   If the client has supplied a slab allocator, a translation that
+   fills the base area carries on in extra slabs obtained from it.
+   temporary_{first,curr,last} always describe the area currently
+   being allocated from -- the base or the newest slab -- and
+   vexSetAllocModeTEMP_and_clear hands all the slabs back and returns
+   to the base. */
+static VEX_TLS HChar* temporary_first = &temporary[0];
+static VEX_TLS HChar* temporary_curr  = &temporary[0];
+static VEX_TLS HChar* temporary_last  = &temporary[N_TEMPORARY_BYTES-1];
+
+static VEX_TLS HChar* temporary_base_first = &temporary[0];
+static VEX_TLS HChar* temporary_base_last  = &temporary[N_TEMPORARY_BYTES-1];
+
+/* Slabs in use, most recent first, linked through their headers. */
+static VEX_TLS void*  temporary_slabs = NULL;
+
+/* Bumped whenever this thread's TEMP area is cleared or swapped. */
+static VEX_TLS ULong  temporary_generation = 1;
+
+static VEX_TLS ULong  temporary_bytes_allocd_TOT = 0;
+static VEX_TLS ULong  temporary_slabs_allocd_TOT = 0;
+
+/* Minimum size of an extra slab, including its header. */
+#define N_TEMPORARY_SLAB_BYTES 1000000
+
+/* The start of each slab.  A slab remembers the function that is to
+   free it, so the client can change or remove the allocator while
+   slabs are still in use (they are holding the last translation's IR,
+   say) without those slabs going to the wrong function, or NULL. */
+typedef
+   struct {
+      void* next;
+      void  (*free_slab) ( void* );
+   }
+   TempSlabHdr;
+
+/* Rounded up so that the payload stays REQ_ALIGN-aligned. */
+#define TEMPORARY_SLAB_HDR_BYTES \
+   ((sizeof(TempSlabHdr) + REQ_ALIGN - 1) & ~(SizeT)(REQ_ALIGN - 1))
+
+static void* (*slab_alloc) ( SizeT ) = NULL;
+static void  (*slab_free)  ( void* ) = NULL;
 
 #define N_PERMANENT_BYTES 10000
 
@@ -68,21 +110,26 @@ static HChar* permanent_first = &permanent[0];
 static HChar* permanent_curr  = &permanent[0];
 static HChar* permanent_last  = &permanent[N_PERMANENT_BYTES-1];
 
-HChar* private_LibVEX_alloc_first = &temporary[0];
-HChar* private_LibVEX_alloc_curr  = &temporary[0];
-HChar* private_LibVEX_alloc_last  = &temporary[N_TEMPORARY_BYTES-1];
+VEX_TLS_HOT HChar* private_LibVEX_alloc_first = &temporary[0];
+VEX_TLS_HOT HChar* private_LibVEX_alloc_curr  = &temporary[0];
+VEX_TLS_HOT HChar* private_LibVEX_alloc_last  = &temporary[N_TEMPORARY_BYTES-1];
 
+VEX_TLS_HOT ULong  vex_temp_generation = 1;
 
-static VexAllocMode mode = VexAllocModeTEMP;
+
+static VEX_TLS VexAllocMode mode = VexAllocModeTEMP;
 
 void vexAllocSanityCheck ( void )
 {
-   vassert(temporary_first == &temporary[0]);
-   vassert(temporary_last  == &temporary[N_TEMPORARY_BYTES-1]);
    vassert(permanent_first == &permanent[0]);
    vassert(permanent_last  == &permanent[N_PERMANENT_BYTES-1]);
    vassert(temporary_first <= temporary_curr);
    vassert(temporary_curr  <= temporary_last);
+   vassert(temporary_base_first < temporary_base_last);
+   if (temporary_slabs == NULL) {
+      vassert(temporary_first == temporary_base_first);
+      vassert(temporary_last  == temporary_base_last);
+   }
    vassert(permanent_first <= permanent_curr);
    vassert(permanent_curr  <= permanent_last);
    vassert(private_LibVEX_alloc_first <= private_LibVEX_alloc_curr);
@@ -148,6 +195,7 @@ void vexSetAllocMode ( VexAllocMode m )
       vassert(0);
 
    mode = m;
+   vex_temp_generation = m == VexAllocModeTEMP ? temporary_generation : 0;
 }
 
 VexAllocMode vexGetAllocMode ( void )
@@ -156,11 +204,20 @@ VexAllocMode vexGetAllocMode ( void )
 }
 
 __attribute__((noreturn))
-void private_LibVEX_alloc_OOM(void)
+static void recover_with ( VexTransErrorCode code,
+                           const HChar* format, ... );
+
+__attribute__((noreturn))
+static void alloc_OOM ( void )
 {
    const HChar* pool = "???";
-   if (private_LibVEX_alloc_first == &temporary[0]) pool = "TEMP";
-   if (private_LibVEX_alloc_first == &permanent[0]) pool = "PERM";
+   if (private_LibVEX_alloc_first == temporary_first) pool = "TEMP";
+   if (private_LibVEX_alloc_first == permanent_first) pool = "PERM";
+   if (vex_recover != NULL)
+      recover_with(VexTransErrOOM,
+                   "VEX %s storage exhausted (%lld bytes).", pool,
+                   (Long)(private_LibVEX_alloc_last + 1
+                          - private_LibVEX_alloc_first));
    vex_printf("VEX temporary storage exhausted.\n");
    vex_printf("Pool = %s,  start %p curr %p end %p (size %lld)\n",
               pool, 
@@ -169,7 +226,61 @@ void private_LibVEX_alloc_OOM(void)
               private_LibVEX_alloc_last,
               (Long)(private_LibVEX_alloc_last + 1 - private_LibVEX_alloc_first));
    vpanic("VEX temporary storage exhausted.\n"
-          "Increase N_{TEMPORARY,PERMANENT}_BYTES and recompile.");
+          "Supply a slab allocator with LibVEX_SetSlabAllocator, or\n"
+          "increase N_{TEMPORARY,PERMANENT}_BYTES and recompile.");
+}
+
+/* Slow path of LibVEX_Alloc_inline: the current area cannot satisfy
+   a request for nbytes (already rounded up to the alignment).  Move
+   on to a fresh slab if we can. */
+void* private_LibVEX_alloc_slow ( SizeT nbytes )
+{
+   SizeT  szB;
+   HChar* slab;
+   HChar* curr;
+
+   if (mode != VexAllocModeTEMP || slab_alloc == NULL)
+      alloc_OOM();
+
+   szB = TEMPORARY_SLAB_HDR_BYTES + nbytes + REQ_ALIGN;
+   if (szB < N_TEMPORARY_SLAB_BYTES)
+      szB = N_TEMPORARY_SLAB_BYTES;
+   szB = (szB + REQ_ALIGN - 1) & ~(SizeT)(REQ_ALIGN - 1);
+
+   slab = slab_alloc(szB);
+   if (slab == NULL)
+      alloc_OOM();
+   vassert(0 == (((HWord)slab) & (REQ_ALIGN-1)));
+
+   temporary_bytes_allocd_TOT
+      += (ULong)(private_LibVEX_alloc_curr - private_LibVEX_alloc_first);
+   temporary_slabs_allocd_TOT++;
+
+   ((TempSlabHdr*)slab)->next      = temporary_slabs;
+   ((TempSlabHdr*)slab)->free_slab = slab_free;
+   temporary_slabs = slab;
+
+   temporary_first = slab + TEMPORARY_SLAB_HDR_BYTES;
+   temporary_last  = slab + szB - 1;
+   curr            = temporary_first;
+   temporary_curr  = curr + nbytes;
+
+   private_LibVEX_alloc_first = temporary_first;
+   private_LibVEX_alloc_curr  = temporary_curr;
+   private_LibVEX_alloc_last  = temporary_last;
+   return curr;
+}
+
+/* Free the slabs newer than stop, which must be in use or NULL. */
+static void free_slabs_to ( void* stop )
+{
+   while (temporary_slabs != stop) {
+      TempSlabHdr* hdr;
+      vassert(temporary_slabs != NULL);
+      hdr             = temporary_slabs;
+      temporary_slabs = hdr->next;
+      hdr->free_slab(hdr);
+   }
 }
 
 void vexSetAllocModeTEMP_and_clear ( void )
@@ -179,21 +290,105 @@ void vexSetAllocModeTEMP_and_clear ( void )
       += (ULong)(private_LibVEX_alloc_curr - private_LibVEX_alloc_first);
 
    mode = VexAllocModeTEMP;
-   temporary_curr            = &temporary[0];
-   private_LibVEX_alloc_curr = &temporary[0];
+   vex_temp_generation = ++temporary_generation;
+
+   free_slabs_to(NULL);
+
+   temporary_first            = temporary_base_first;
+   temporary_curr             = temporary_base_first;
+   temporary_last             = temporary_base_last;
+   private_LibVEX_alloc_first = temporary_first;
+   private_LibVEX_alloc_curr  = temporary_first;
+   private_LibVEX_alloc_last  = temporary_last;
 
    /* Set to (1) and change the fill byte to 0x00 or 0xFF to test for
       any potential bugs due to using uninitialised memory in the main
       VEX storage area. */
    if (0) {
-      Int i;
-      for (i = 0; i < N_TEMPORARY_BYTES; i++)
-         temporary[i] = 0x00;
+      HChar* p;
+      for (p = temporary_first; p <= temporary_last; p++)
+         *p = 0x00;
    }
 
    vexAllocSanityCheck();
 }
 
+void vexSwapTempArea ( /*MOD*/VexArena* area )
+{
+   VexArena mine;
+
+   /* Switching while allocating permanently would leave the PERM
+      cursor pointing into the wrong area. */
+   vassert(mode == VexAllocModeTEMP);
+   vassert(area->first <= area->curr && area->curr <= area->last);
+   vassert(area->base_first < area->base_last);
+   vexAllocSanityCheck();
+
+   mine.first      = temporary_first;
+   mine.curr       = private_LibVEX_alloc_curr;
+   mine.last       = temporary_last;
+   mine.base_first = temporary_base_first;
+   mine.base_last  = temporary_base_last;
+   mine.slabs      = temporary_slabs;
+
+   temporary_first            = area->first;
+   temporary_curr             = area->curr;
+   temporary_last             = area->last;
+   temporary_base_first       = area->base_first;
+   temporary_base_last        = area->base_last;
+   temporary_slabs            = area->slabs;
+   private_LibVEX_alloc_first = area->first;
+   private_LibVEX_alloc_curr  = area->curr;
+   private_LibVEX_alloc_last  = area->last;
+   vex_temp_generation        = ++temporary_generation;
+
+   *area = mine;
+
+   vexAllocSanityCheck();
+}
+
+
+void vexGetTempMark ( /*OUT*/VexTempMark* mark )
+{
+   vassert(mode == VexAllocModeTEMP);
+   mark->first = temporary_first;
+   mark->curr  = private_LibVEX_alloc_curr;
+   mark->last  = temporary_last;
+   mark->slabs = temporary_slabs;
+}
+
+void vexReleaseTempToMark ( const VexTempMark* mark )
+{
+   vassert(mode == VexAllocModeTEMP);
+
+   /* Count the current area's use as vexSetAllocModeTEMP_and_clear
+      would, less what will be counted again for the mark's area. */
+   temporary_bytes_allocd_TOT
+      += (ULong)(private_LibVEX_alloc_curr - private_LibVEX_alloc_first);
+   temporary_bytes_allocd_TOT -= (ULong)(mark->curr - mark->first);
+
+   free_slabs_to(mark->slabs);
+
+   temporary_first            = mark->first;
+   temporary_curr             = mark->curr;
+   temporary_last             = mark->last;
+   private_LibVEX_alloc_first = temporary_first;
+   private_LibVEX_alloc_curr  = temporary_curr;
+   private_LibVEX_alloc_last  = temporary_last;
+   vex_temp_generation        = ++temporary_generation;
+
+   vexAllocSanityCheck();
+}
+
+
+/* Total bytes allocated in TEMP areas by this thread so far. */
+ULong vexTempBytesAllocd ( void )
+{
+   HChar* curr = mode == VexAllocModeTEMP ? private_LibVEX_alloc_curr
+                                          : temporary_curr;
+   return temporary_bytes_allocd_TOT + (ULong)(curr - temporary_first);
+}
+
 
 /* Exported to library client. */
 
@@ -201,6 +396,8 @@ void LibVEX_ShowAllocStats ( void )
 {
    vex_printf("vex storage: T total %lld bytes allocated\n",
               (Long)temporary_bytes_allocd_TOT );
+   vex_printf("vex storage: T total %lld extra slabs allocated\n",
+              (Long)temporary_slabs_allocd_TOT );
    vex_printf("vex storage: P total %lld bytes allocated\n",
               (Long)(permanent_curr - permanent_first) );
 }
@@ -210,6 +407,14 @@ void *LibVEX_Alloc ( SizeT nbytes )
    return LibVEX_Alloc_inline(nbytes);
 }
 
+void LibVEX_SetSlabAllocator ( void* (*alloc_slab) ( SizeT ),
+                               void  (*free_slab)  ( void* ) )
+{
+   vassert((alloc_slab == NULL) == (free_slab == NULL));
+   slab_alloc = alloc_slab;
+   slab_free  = free_slab;
+}
+
 /*---------------------------------------------------------*/
 /*--- Bombing out                                       ---*/
 /*---------------------------------------------------------*/
@@ -218,6 +423,9 @@ __attribute__ ((noreturn))
 void vex_assert_fail ( const HChar* expr,
                        const HChar* file, Int line, const HChar* fn )
 {
+   if (vex_recover != NULL)
+      recover_with(VexTransErrAssert, "%s:%d (%s): Assertion `%s' failed.",
+                   file, line, fn, expr);
    vex_printf( "\nvex: %s:%d (%s): Assertion `%s' failed.\n",
                file, line, fn, expr );
    (*vex_failure_exit)();
@@ -227,6 +435,8 @@ void vex_assert_fail ( const HChar* expr,
 __attribute__ ((noreturn))
 void vpanic ( const HChar* str )
 {
+   if (vex_recover != NULL)
+      recover_with(VexTransErrPanic, "the `impossible' happened: %s", str);
    vex_printf("\nvex: the `impossible' happened:\n   %s\n", str);
    (*vex_failure_exit)();
 }
@@ -268,6 +478,14 @@ void vex_bzero ( void* sV, SizeT n )
    for (i = 0; i < n; i++) s[i] = 0;
 }
 
+void vex_memcpy ( void* dstV, const void* srcV, SizeT n )
+{
+   SizeT i;
+   UChar*       dst = (UChar*)dstV;
+   const UChar* src = (const UChar*)srcV;
+   for (i = 0; i < n; i++) dst[i] = src[i];
+}
+
 
 /* Convert N0 into ascii in BUF, which is assumed to be big enough (at
    least 67 bytes long).  Observe BASE, SYNED and HEXCAPS. */
@@ -497,8 +715,8 @@ UInt vprintf_wrk ( void(*sink)(HChar),
    debugging info should be sent via here.  The official route is to
    to use vg_message().  This interface is deprecated.
 */
-static HChar myprintf_buf[1000];
-static Int   n_myprintf_buf;
+static VEX_TLS HChar myprintf_buf[1000];
+static VEX_TLS Int   n_myprintf_buf;
 
 static void add_to_myprintf_buf ( HChar c )
 {
@@ -538,12 +756,79 @@ UInt vex_printf ( const HChar* format, ... )
    return ret;
 }
 
+/* Recovering from failures; see comments in main_util.h. */
+
+VEX_TLS VexRecoverPoint* vex_recover = NULL;
+
+static VEX_TLS HChar error_msg[256];
+static VEX_TLS UInt  n_error_msg;
+
+static void add_to_error_msg ( HChar c )
+{
+   /* Keep it on one line, and drop anything that does not fit. */
+   if (n_error_msg >= sizeof(error_msg) - 1)
+      return;
+   if (c == '\n') {
+      if (n_error_msg == 0 || error_msg[n_error_msg-1] == ' ')
+         return;
+      c = ' ';
+   }
+   error_msg[n_error_msg++] = c;
+   error_msg[n_error_msg] = 0;
+}
+
+static void set_error_msg ( const HChar* format, va_list vargs )
+{
+   n_error_msg  = 0;
+   error_msg[0] = 0;
+   vprintf_wrk ( add_to_error_msg, format, vargs );
+   while (n_error_msg > 0 && error_msg[n_error_msg-1] == ' ')
+      error_msg[--n_error_msg] = 0;
+}
+
+__attribute__ ((noreturn))
+static void recover_now ( VexTransErrorCode code )
+{
+   VexRecoverPoint* rp = vex_recover;
+   /* Whatever goes wrong while the entry point cleans up is fatal. */
+   vex_recover = NULL;
+   rp->code = code;
+#  if VEX_CAN_RECOVER
+   __builtin_longjmp(rp->jb, 1);
+#  else
+   vex_printf("\nvex: %s\n", error_msg);
+   (*vex_failure_exit)();
+#  endif
+}
+
+__attribute__ ((noreturn))
+static void recover_with ( VexTransErrorCode code,
+                           const HChar* format, ... )
+{
+   va_list vargs;
+   va_start(vargs, format);
+   set_error_msg(format, vargs);
+   va_end(vargs);
+   recover_now(code);
+}
+
+const HChar* vexErrorMsg ( void )
+{
+   return error_msg;
+}
+
 /* Use this function to communicate to users that a (legitimate) situation
    occured that we cannot handle (yet). */
 __attribute__ ((noreturn))
 void vfatal ( const HChar* format, ... )
 {
    va_list vargs;
+   if (vex_recover != NULL) {
+      va_start(vargs, format);
+      set_error_msg(format, vargs);
+      va_end(vargs);
+      recover_now(VexTransErrFatal);
+   }
    va_start(vargs, format);
    vex_vprintf( format, vargs );
    va_end(vargs);
@@ -554,7 +839,7 @@ void vfatal ( const HChar* format, ... )
 
 /* A general replacement for sprintf(). */
 
-static HChar *vg_sprintf_ptr;
+static VEX_TLS HChar *vg_sprintf_ptr;
 
 static void add_to_vg_sprintf_buf ( HChar c )
 {
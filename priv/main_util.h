@@ -37,6 +37,7 @@
 #define __VEX_MAIN_UTIL_H
 
 #include "libvex_basictypes.h"
+#include "libvex.h"
 
 
 /* Misc. */
@@ -51,6 +52,20 @@
 #define STATIC_ASSERT(x)  extern int vex__unused_array[(x) ? 1 : -1] \
                                      __attribute__((unused))
 
+/* Thread-local storage.  Any library state that a translation
+   mutates is marked VEX_TLS, so that translations running on
+   different threads (each in its own VexContext) do not interfere.
+   VEX_TLS_HOT is for the handful of variables on the allocation fast
+   path; they are few and small enough to use the cheaper
+   initial-exec model even when libvex is dlopen'd. */
+#ifndef _MSC_VER
+#  define VEX_TLS      __thread
+#  define VEX_TLS_HOT  __thread __attribute__((tls_model("initial-exec")))
+#else
+#  define VEX_TLS      __declspec(thread)
+#  define VEX_TLS_HOT  __declspec(thread)
+#endif
+
 /* Stuff for panicking and assertion. */
 
 #define vassert(expr)                                           \
@@ -71,6 +86,36 @@ __attribute__ ((format (printf, 1, 2)))
 #endif
 extern void vfatal ( const HChar* format, ... );
 
+/* Recovering from the above.  An entry point asked to recover
+   (VexTranslateArgs::recover_errors) points vex_recover at a
+   VexRecoverPoint in its own frame, set with vexRecoverSet.  The
+   bombing-out functions, and running out of TEMP storage, then jump
+   back to it with ->code and vexErrorMsg() saying what went wrong,
+   rather than printing and calling failure_exit.  The entry point
+   must clear the TEMP area before returning.  This relies on
+   __builtin_setjmp, so without GCC or clang VEX_CAN_RECOVER is 0 and
+   failures are fatal as before. */
+
+typedef
+   struct {
+      void*             jb[5];
+      VexTransErrorCode code;
+   }
+   VexRecoverPoint;
+
+extern VEX_TLS VexRecoverPoint* vex_recover;
+
+#if defined(__GNUC__)
+#  define VEX_CAN_RECOVER 1
+#  define vexRecoverSet(_rp)  __builtin_setjmp((_rp)->jb)
+#else
+#  define VEX_CAN_RECOVER 0
+#  define vexRecoverSet(_rp)  0
+#endif
+
+/* The message for the most recent recovered failure on this thread. */
+extern const HChar* vexErrorMsg ( void );
+
 
 /* Printing */
 
@@ -90,6 +135,7 @@ extern UInt vex_sprintf ( HChar* buf, const HChar *format, ... );
 extern Bool vex_streq ( const HChar* s1, const HChar* s2 );
 extern SizeT vex_strlen ( const HChar* str );
 extern void vex_bzero ( void* s, SizeT n );
+extern void vex_memcpy ( void* dst, const void* src, SizeT n );
 
 
 /* Storage management: clear the area, and allocate from it. */
@@ -111,16 +157,47 @@ extern void         vexAllocSanityCheck ( void );
 
 extern void vexSetAllocModeTEMP_and_clear ( void );
 
+/* Exchange this thread's TEMP area with *area.  A second call with
+   the same *area undoes the first.  Used to give each VexContext its
+   own storage. */
+extern void vexSwapTempArea ( /*MOD*/VexArena* area );
+
+/* A point in this thread's TEMP area.  vexReleaseTempToMark frees
+   everything allocated in TEMP since the matching vexGetTempMark, and
+   keeps everything before it, so that scratch work done on the
+   client's behalf need not clear out IR the client is still
+   holding. */
+typedef
+   struct {
+      HChar* first;
+      HChar* curr;
+      HChar* last;
+      void*  slabs;
+   }
+   VexTempMark;
+
+extern void vexGetTempMark ( /*OUT*/VexTempMark* mark );
+extern void vexReleaseTempToMark ( const VexTempMark* mark );
+
+/* Total bytes allocated in TEMP areas by this thread so far. */
+extern ULong vexTempBytesAllocd ( void );
+
 /* Allocate in Vex's temporary allocation area.  Be careful with this.
    You can only call it inside an instrumentation or optimisation
    callback that you have previously specified in a call to
    LibVEX_Translate.  The storage allocated will only stay alive until
    translation of the current basic block is complete.
  */
-extern HChar* private_LibVEX_alloc_first;
-extern HChar* private_LibVEX_alloc_curr;
-extern HChar* private_LibVEX_alloc_last;
-extern void   private_LibVEX_alloc_OOM(void) __attribute__((noreturn));
+extern VEX_TLS_HOT HChar* private_LibVEX_alloc_first;
+extern VEX_TLS_HOT HChar* private_LibVEX_alloc_curr;
+extern VEX_TLS_HOT HChar* private_LibVEX_alloc_last;
+extern void*  private_LibVEX_alloc_slow ( SizeT nbytes );
+
+/* Identifies the TEMP area currently being allocated from, or is 0
+   when allocating in PERM mode.  It changes whenever the TEMP area is
+   cleared, swapped or released to a mark, so anything that caches pointers to TEMP
+   storage can tell when they have gone stale. */
+extern VEX_TLS_HOT ULong vex_temp_generation;
 
 /* Allocated memory as returned by LibVEX_Alloc will be aligned on this
    boundary. */
@@ -160,13 +237,18 @@ static inline void* LibVEX_Alloc_inline ( SizeT nbytes )
    nbytes = (nbytes + ALIGN) & ~ALIGN;
    curr   = private_LibVEX_alloc_curr;
    next   = curr + nbytes;
-   if (next >= private_LibVEX_alloc_last)
-      private_LibVEX_alloc_OOM();
+   if (UNLIKELY(next >= private_LibVEX_alloc_last))
+      return private_LibVEX_alloc_slow(nbytes);
    private_LibVEX_alloc_curr = next;
    return curr;
 #endif
 }
 
+/* Build the table that typeOfPrimop reads (ir_defs.c).  Called once,
+   by LibVEX_Init; until then typeOfPrimop works without it. */
+
+extern void vexInitPrimopTypes ( void );
+
 /* Misaligned memory access support. */
 
 extern UInt  read_misaligned_UInt_LE  ( void* addr );
@@ -44,7 +44,7 @@ mnemonic(const HChar *mnm)
 {
    vassert(vex_strlen(mnm) <= S390_MAX_MNEMONIC_LEN);
 
-   static HChar buf[S390_MAX_MNEMONIC_LEN + 1];
+   static VEX_TLS HChar buf[S390_MAX_MNEMONIC_LEN + 1];
 
    vex_sprintf(buf, "%-*s", S390_MAX_MNEMONIC_LEN, mnm);
 
@@ -112,7 +112,7 @@ cab_operand(const HChar *base, UInt mask)
    HChar *to;
    const HChar *from;
 
-   static HChar buf[S390_MAX_MNEMONIC_LEN + 1];
+   static VEX_TLS HChar buf[S390_MAX_MNEMONIC_LEN + 1];
 
    static const HChar suffix[8][3] = {
       "", "h", "l", "ne", "e", "nl", "nh", ""
@@ -143,7 +143,7 @@ construct_mnemonic(const HChar *prefix, const HChar *suffix, UInt mask)
    HChar *to;
    const HChar *from;
 
-   static HChar buf[S390_MAX_MNEMONIC_LEN + 1];
+   static VEX_TLS HChar buf[S390_MAX_MNEMONIC_LEN + 1];
 
    static HChar mask_id[16][4] = {
       "", /* 0 -> unused */
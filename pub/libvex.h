@@ -456,6 +456,28 @@ typedef
    }
    VexRegisterUpdates;
 
+/* How much of the IR that LibVEX_Lift produces is checked with
+   sanityCheckIRSB, which it runs over the front end's output and
+   again after the cleanup that follows instrumentation.  The check
+   costs about as much as the front end itself, and once the front
+   ends and instrumenters in use have been exercised it almost never
+   finds anything. */
+typedef
+   enum {
+      VexSanityAlways=0, /* check every block */
+      VexSanitySampled,  /* check one block in every
+                            VexControl.sanity_sample_interval, at each
+                            of the two points */
+      VexSanityNewOps,   /* check only blocks that use an IROp, or a
+                            kind of expression or statement, that no
+                            block which passed the check on this
+                            thread has used, so that the output of
+                            each new decoder path is checked at least
+                            once */
+      VexSanityNever     /* don't check */
+   }
+   VexSanityLevel;
+
 /* Control of Vex's optimiser. */
 
 typedef
@@ -503,6 +525,34 @@ typedef
       /* Whether we should lift the x86 code `call $+5; pop xxx` as
          one instruction (True) or two (False). Default: True */
       Bool x86_optimize_callpop_idiom;
+      /* Should the IR constructors share one node between all uses of
+         the same integer constant, temp read or guest state Get within
+         a translation?  This saves memory and lets iropt compare
+         atoms by pointer, but means that such nodes must never be
+         modified in place; deep copies are always unshared.  It does
+         not change the IR produced.  Default: NO */
+      Bool ir_intern_atoms;
+      /* Which register allocator to use.  2 is the long-standing
+         one.  3 splits live ranges at uses, hands out spill slots
+         only to vregs that are spilled, and coalesces moves to and
+         from real registers as well as between vregs; it usually
+         generates fewer spills and reloads where register pressure is
+         high.  Either must produce correct code.  Default: 2 */
+      Int regalloc_version;
+      /* Should register-allocated host code be given a peephole
+         pass before assembly?  It removes moves to self, reloads of
+         values just spilled, move chains and redundant tests before
+         conditional exits.  Only the amd64 and arm64 back ends have
+         one; elsewhere this is ignored.  Default: NO */
+      Bool host_peephole;
+      /* How much of the lifted IR should be sanity checked?  See
+         VexSanityLevel.  A translation's skip_initial_sanity still
+         skips the check of the front end's output.  Default:
+         VexSanityAlways */
+      VexSanityLevel sanity_level;
+      /* For VexSanitySampled, check one block in how many?  Default:
+         64 */
+      Int sanity_sample_interval;
    }
    VexControl;
 
@@ -527,6 +577,20 @@ extern void* LibVEX_Alloc ( SizeT nbytes );
 /* Show Vex allocation statistics. */
 extern void LibVEX_ShowAllocStats ( void );
 
+/* Optionally, give Vex a way to obtain more storage when a
+   translation outgrows its temporary allocation area, instead of
+   panicking.  alloc_slab must return 8-aligned memory of at least the
+   requested size, or NULL if there is none.  Extra slabs are handed
+   back to free_slab as soon as the translation that needed them is
+   complete, so the area stays at its base size in the steady state.
+   When translating concurrently (see VexContext), both functions must
+   be thread-safe.  Pass NULL for both to revert to panicking.  Slabs
+   already handed out are still given back to the free_slab they came
+   from, so the allocator may be changed or removed between
+   translations even while IR from the last one is still held. */
+extern void LibVEX_SetSlabAllocator ( void* (*alloc_slab) ( SizeT nbytes ),
+                                      void  (*free_slab)  ( void* slab ) );
+
 
 /*-------------------------------------------------------*/
 /*--- Describing guest state layout                   ---*/
@@ -619,12 +683,24 @@ extern void LibVEX_Update_Control (const VexControl * );
 /*--- Make a translation                              ---*/
 /*-------------------------------------------------------*/
 
+/* Why a translation ended with VexTransError. */
+typedef
+   enum {
+      VexTransErrNone=0,
+      VexTransErrAssert,  /* an internal assertion failed */
+      VexTransErrPanic,   /* VEX got into an 'impossible' state */
+      VexTransErrFatal,   /* a legitimate situation VEX can't handle */
+      VexTransErrOOM      /* ran out of TEMP storage */
+   }
+   VexTransErrorCode;
+
 /* Describes the outcome of a translation attempt. */
 typedef
    struct {
       /* overall status */
       enum { VexTransOK=0x800,
-             VexTransAccessFail, VexTransOutputFull } status;
+             VexTransAccessFail, VexTransOutputFull,
+             VexTransError } status;
       /* The number of extents that have a self-check (0 to 3) */
       UInt n_sc_extents;
       /* Offset in generated code of the profile inc, or -1 if
@@ -633,6 +709,11 @@ typedef
       /* Stats only: the number of guest insns included in the
          translation.  It may be zero (!). */
       UInt n_guest_instrs;
+      /* For VexTransError, what went wrong.  error_msg is valid
+         until the next failure on this thread.  (These come last so
+         that the fields above keep their offsets.) */
+      VexTransErrorCode error_code;
+      const HChar*      error_msg;
    }
    VexTranslateResult;
 
@@ -655,6 +736,23 @@ typedef
    VexGuestExtents;
 
 
+/* How much of the IR optimiser LibVEX_Lift runs.  Clients that only
+   want to look at the IR can save most of the cost of lifting by
+   asking for less than the full pipeline.  LibVEX_Codegen needs flat
+   IR, so VexLiftRaw is for lifting only, and since instrumentation
+   functions expect flat IR they may not be used with it either. */
+typedef
+   enum {
+      VexLiftFull=0, /* everything vex_control.iropt_level asks for */
+      VexLiftRaw,    /* the front end's output, not even flattened */
+      VexLiftFlat,   /* flattened only, as for iropt_level 0 */
+      VexLiftCheap   /* flattened and the cheap transformations only,
+                        as for iropt_level 1 (or 0, if that is what
+                        vex_control asks for) */
+   }
+   VexLiftMode;
+
+
 /* A structure to carry arguments for LibVEX_Translate.  There are so
    many of them, it seems better to have a structure. */
 typedef
@@ -790,6 +888,27 @@ typedef
       const void* disp_cp_chain_me_to_fastEP;
       const void* disp_cp_xindir;
       const void* disp_cp_xassisted;
+
+      /* New fields go below here, so that the ones above keep their
+         offsets. */
+
+      /* IN: how much IR optimisation to do; see VexLiftMode. */
+      VexLiftMode lift_mode;
+
+      /* IN: don't sanity check the front end's output.  The check
+         costs about as much as the front end itself, and a front end
+         that has been run over the client's code before is unlikely
+         to start producing bad IR. */
+      Bool    skip_initial_sanity;
+
+      /* IN: if VEX fails -- an assertion, a panic, running out of
+         storage -- return VexTransError instead of calling
+         failure_exit.  The TEMP area is cleared, so nothing lifted
+         by the failed call survives (but see LibVEX_LiftBatch).
+         Translation state is otherwise rebuilt on every call, so the
+         next call proceeds normally.
+         Needs a GCC-compatible compiler; ignored otherwise. */
+      Bool    recover_errors;
    }
    VexTranslateArgs;
 
@@ -807,6 +926,487 @@ void LibVEX_Codegen ( VexTranslateArgs*,
                       VexRegisterUpdates );
 
 
+/*-------------------------------------------------------*/
+/*--- Batch lifting                                   ---*/
+/*-------------------------------------------------------*/
+
+/* Lift many blocks for the same guest in one call.  The guest
+   architecture setup and hwcaps checks that LibVEX_Lift does for
+   every block are done once per batch instead.
+
+   All the fields of the VexTranslateArgs are used as for LibVEX_Lift,
+   except guest_bytes, guest_bytes_addr and guest_extents, which are
+   taken from (respectively written to) each VexLiftRequest in turn.
+   The VexTranslateArgs itself is not modified. */
+
+typedef
+   struct {
+      /* IN: the block to lift */
+      const UChar*       guest_bytes;
+      Addr               guest_bytes_addr;
+      /* OUT: as for LibVEX_Lift.  irsb is NULL on access failure,
+         and on a failure caught by vta->recover_errors. */
+      IRSB*              irsb;
+      VexTranslateResult res;
+      VexRegisterUpdates pxControl;
+      VexGuestExtents    guest_extents;
+   }
+   VexLiftRequest;
+
+/* Lift reqs[0 .. n_reqs-1] in order, returning the number of blocks
+   lifted without an access failure.
+
+   If deliver is NULL, the storage area is cleared once at the start
+   of the batch and every resulting IRSB stays valid until the next
+   call into the library.  The area must then be big enough for the
+   whole batch, or a slab allocator must have been supplied with
+   LibVEX_SetSlabAllocator.
+
+   If deliver is non-NULL, it is called with vta->callback_opaque
+   after each block is lifted, and the storage area is cleared as soon
+   as it returns.  The IRSB is valid only for the duration of that
+   call; req->irsb is set to NULL afterwards.  This keeps memory use
+   bounded whatever the size of the batch.
+
+   With vta->recover_errors, a failure costs only the block that
+   caused it: its res.status is VexTransError and the batch carries
+   on.  If deliver is NULL, the area is not cleared, so the blocks
+   already lifted survive.  A failure before any block is lifted (a
+   bad arch, say) fails every request. */
+extern
+UInt LibVEX_LiftBatch ( VexTranslateArgs* vta,
+                        /*MOD*/VexLiftRequest* reqs, UInt n_reqs,
+                        void (*deliver)( void* callback_opaque,
+                                         VexLiftRequest* req ) );
+
+
+/*-------------------------------------------------------*/
+/*--- Region lifting                                  ---*/
+/*-------------------------------------------------------*/
+
+/* Lift a whole function, or any other region of code, in one call.
+   Starting from some entry points, the basic blocks reachable by
+   direct jumps and calls are found, lifted once each and returned
+   with the edges between them.  Unlike superblocks, no two blocks
+   cover the same insn: a jump into the middle of a block splits it,
+   the first half falling through to the second.  (Code reachable by
+   two differently-aligned decodings is the exception.)
+
+   The blocks' IRSBs share one type environment, with each temp
+   numbered differently, so temps can be told apart across the
+   region.  Each IRSB is otherwise as LibVEX_Lift would make it, and
+   the block's guest_extents and pxControl are as LibVEX_Lift would
+   set them.
+
+   vta is used as for LibVEX_Lift, except that guest_bytes and
+   guest_bytes_addr describe the code the region may come from,
+   guest_bytes_szB bytes of it, and that guest_extents and
+   chase_into_ok are ignored.  Nothing outside those bytes is read.
+   Blocks end at the first control transfer, at
+   vex_control.guest_max_insns insns, or at the last insn that fits
+   entirely within the code; an entry point with no such insn gets no
+   block.
+
+   Calls are assumed to return: a block that ends in a direct call
+   has an edge to the callee and another to the insn after the call.
+   The callee is lifted into the region only if follow_calls.  At
+   most max_blocks are lifted; jumps to code beyond that, or outside
+   the code, or that is not reached directly, lead nowhere (to==-1).
+
+   Everything lives in the TEMP area until the next call into the
+   library, so a big region needs a big area or a slab allocator.
+   Returns NULL on failure, when recover_errors is set, with *res
+   saying why; otherwise res->n_guest_instrs is the region's total. */
+
+typedef
+   enum {
+      VexEdgeJump=0xA00, /* a jump or side exit, or falling through
+                            into the next block */
+      VexEdgeCall,       /* a call, to addr */
+      VexEdgeCallReturn  /* to the insn after a call */
+   }
+   VexEdgeKind;
+
+typedef
+   struct {
+      VexEdgeKind kind;
+      UInt        from;  /* index in VexRegion::blocks */
+      Int         to;    /* ditto, or -1 if not in the region */
+      Addr        addr;  /* the target */
+   }
+   VexRegionEdge;
+
+typedef
+   struct {
+      Addr               addr;
+      UInt               n_guest_instrs;
+      IRSB*              irsb;
+      VexGuestExtents    guest_extents;
+      VexRegisterUpdates pxControl;
+      /* the block's edges are edges[first_edge .. first_edge+n_edges-1] */
+      UInt               first_edge;
+      UInt               n_edges;
+   }
+   VexRegionBlock;
+
+typedef
+   struct {
+      IRTypeEnv*      tyenv;     /* shared by all the IRSBs */
+      VexRegionBlock* blocks;    /* in no particular order */
+      UInt            n_blocks;
+      VexRegionEdge*  edges;
+      UInt            n_edges;
+      Int*            entries;   /* the block for each entry point, or
+                                    -1 if it could not be lifted */
+      Bool            truncated; /* max_blocks was reached */
+   }
+   VexRegion;
+
+extern
+VexRegion* LibVEX_LiftRegion ( VexTranslateArgs* vta, UInt guest_bytes_szB,
+                               const Addr* entries, UInt n_entries,
+                               UInt max_blocks, Bool follow_calls,
+                               /*OUT*/VexTranslateResult* res );
+
+
+/*-------------------------------------------------------*/
+/*--- Decoding without lifting                        ---*/
+/*-------------------------------------------------------*/
+
+/* For disassemblers and CFG recovery, which need instruction
+   boundaries and control flow far more often than they need IR.
+
+   On x86, amd64 and arm64 this is done by a decoder that builds no IR,
+   and reports the architectural length and kind of any well-formed
+   insn, whether or not the front end implements it.  On the other
+   guests (ppc32, ppc64, s390x, arm, mips32, mips64), which take a
+   much slower path, the front end is run over the insn and its IR
+   inspected, so an insn the front end can't handle, or panics on, is
+   VexInsnInvalid.  That IR is freed again before returning; anything
+   the client has in the TEMP area, such as IR from LibVEX_Lift, is
+   left alone. */
+
+typedef
+   enum {
+      VexInsnInvalid=0x900, /* can't be decoded, or runs off the end */
+      VexInsnNormal,        /* carries on at fall_through */
+      VexInsnJump,          /* goes to target */
+      VexInsnCondJump,      /* goes to target or fall_through */
+      VexInsnCall,          /* calls target, returning to fall_through */
+      VexInsnIndJump,       /* goes to a computed address */
+      VexInsnIndCall,       /* calls a computed address */
+      VexInsnRet,           /* returns */
+      VexInsnSys            /* system call, trap, halt etc: hands
+                               control to the environment */
+   }
+   VexInsnKind;
+
+typedef
+   struct {
+      VexInsnKind kind;
+      UInt        len;          /* 0 for VexInsnInvalid */
+      Addr        target;       /* Jump, CondJump and Call only */
+      Addr        fall_through; /* address of the next insn */
+   }
+   VexDecodedInsn;
+
+/* Decode the insn at bytes[0 .. n_bytes-1], whose guest address is
+   addr, into *insn.  Returns False, and sets insn->kind to
+   VexInsnInvalid, if it can't be decoded or is longer than n_bytes.
+   For an ARM Thumb insn, addr has its bottom bit set, as for
+   LibVEX_Lift. */
+extern
+Bool LibVEX_DecodeInsn ( VexArch arch,
+                         const VexArchInfo* archinfo,
+                         const VexAbiInfo*  abiinfo,
+                         const UChar* bytes, UInt n_bytes, Addr addr,
+                         /*OUT*/VexDecodedInsn* insn );
+
+/* Decode consecutive insns from bytes[0 .. n_bytes-1] into
+   insns[0 .. max_insns-1], stopping early at an insn that can't be
+   decoded, or, if stop_at_branch, after the first insn that isn't
+   VexInsnNormal.  Returns the number of insns decoded. */
+extern
+UInt LibVEX_DecodeRange ( VexArch arch,
+                          const VexArchInfo* archinfo,
+                          const VexAbiInfo*  abiinfo,
+                          const UChar* bytes, UInt n_bytes, Addr addr,
+                          /*OUT*/VexDecodedInsn* insns, UInt max_insns,
+                          Bool stop_at_branch );
+
+
+/*-------------------------------------------------------*/
+/*--- Flat IRSBs                                      ---*/
+/*-------------------------------------------------------*/
+
+/* LibVEX_SerializeIRSB writes an IRSB into a single pointer-free
+   buffer, which can be copied or mapped wholesale and decoded lazily
+   by a consumer, without walking the IR tree through the C API.
+
+   The buffer is a sequence of 32-bit little-endian words.  Enumerated
+   values (IRType, IROp, IRExprTag, IRStmtTag, IRJumpKind, etc) are
+   stored as their values in libvex_ir.h; VEX_IRSER_VERSION is bumped
+   whenever those or the layout below change.  A "ref" is the index of
+   a record's first word within the expression pool, or VEX_IRSER_NONE
+   for a NULL pointer.  A record's children always come after it.
+
+   Header (word offsets):
+      0 VEX_IRSER_MAGIC      1 VEX_IRSER_VERSION   2 total size, bytes
+      3 number of temps      4 byte offset of the tyenv
+      5 number of stmts      6 byte offset of the stmt table
+      7 stmt pool words      8 byte offset of the stmt pool
+      9 expr pool words     10 byte offset of the expr pool
+     11 number of consts    12 byte offset of the const pool
+     13 string pool bytes   14 byte offset of the string pool
+     15 ref of IRSB.next    16 IRSB.jumpkind      17 IRSB.offsIP
+
+   tyenv:       one IRType per temp.
+   stmt table:  for each stmt, the index of its record in the stmt pool.
+   const pool:  VEX_IRSER_CONST_WORDS words per constant: tag, then
+                the value's bit pattern as a 64-bit low/high pair.
+   string pool: NUL-terminated helper names.
+
+   A callee is 5 words: regparms, mcx_mask, addr low, addr high, and
+   the byte offset of the name in the string pool.  A register array
+   is 3 words: base, elemTy, nElems.
+
+   Expression records, each starting with its IRExprTag:
+      Binder  binder               Get    offset ty
+      GetI    regarray ix bias     RdTmp  tmp
+      Qop     op arg1 arg2 arg3 arg4
+      Triop   op arg1 arg2 arg3    Binop  op arg1 arg2
+      Unop    op arg               Load   end ty addr
+      Const   const-index          ITE    cond iftrue iffalse
+      CCall   callee retty nargs args...
+      VECRET  (nothing)            GSPTR  (nothing)
+
+   Statement records, each starting with its IRStmtTag:
+      NoOp    (nothing)            IMark  addr-low addr-high len delta
+      AbiHint base len nia         Put    offset data
+      PutI    regarray ix bias data
+      WrTmp   tmp data             Store  end addr data
+      StoreG  end addr data guard
+      LoadG   end cvt dst addr alt guard
+      CAS     oldHi oldLo end addr expdHi expdLo dataHi dataLo
+      LLSC    end result addr storedata
+      Dirty   callee guard tmp mFx mAddr mSize nFxState
+              { fx, offset|size<<16, nRepeats|repeatLen<<8 } x nFxState
+              nargs args...
+      MBE     event
+      Exit    guard const-index jk offsIP
+*/
+
+#define VEX_IRSER_MAGIC        0x52495856  /* "VXIR" */
+#define VEX_IRSER_VERSION      1
+#define VEX_IRSER_HDR_WORDS    18
+#define VEX_IRSER_CONST_WORDS  3
+#define VEX_IRSER_NONE         0xFFFFFFFF
+
+/* Write bb into buf and return its size in bytes.  If buf is NULL
+   or buf_szB is too small, nothing is written, and the return value
+   is the size needed. */
+extern
+UInt LibVEX_SerializeIRSB ( const IRSB* bb, /*OUT*/UChar* buf, UInt buf_szB );
+
+/* The reverse.  The IRSB is built in the storage area, as for
+   LibVEX_Lift.  Returns NULL if the buffer is truncated, of another
+   version, or structurally malformed.  IROps and the like are not
+   checked; run sanityCheckIRSB over the result if its origin is in
+   doubt. */
+extern
+IRSB* LibVEX_DeserializeIRSB ( const UChar* buf, UInt buf_szB );
+
+
+/*-------------------------------------------------------*/
+/*--- Lift cache                                      ---*/
+/*-------------------------------------------------------*/
+
+/* An optional cache in front of LibVEX_Lift, for clients that lift
+   the same code again and again.
+
+   Entries are looked up by the guest address together with a hash of
+   everything else that determines the lifted IR: the guest and host
+   archs and VexArchInfos, the VexAbiInfo, the VexControl in force and
+   a client-supplied salt.  An entry is only used if the guest bytes
+   covered by its VexGuestExtents still hash to the same value, and
+   the needs_self_check callback still gives the same answer for
+   them.  A hit then rebuilds the IRSB from its flat image (see
+   LibVEX_SerializeIRSB) without running the front end or iropt.
+
+   The cache keeps a bounded number of entries in memory, dropping the
+   least recently used ones, and can optionally be backed by a
+   persistent store supplied by the client.  Lifts with nonzero
+   traceflags bypass the cache.
+
+   A VexLiftCache is not thread-safe; use one per thread, or lock
+   around the calls. */
+
+typedef
+   struct {
+      /* Memory for the cache and its entries.  Mandatory. */
+      void* (*alloc) ( SizeT nbytes );
+      void  (*free)  ( void* p );
+
+      /* Bounds on the in-memory entries, which must both be nonzero.
+         max_bytes counts the entries' flat images. */
+      SizeT max_bytes;
+      UInt  max_entries;
+
+      /* Optional persistent store, keyed by a 64-bit value.  load
+         returns the bytes last stored under key and sets *szB, or
+         returns NULL; they need only stay valid until the next call
+         to load or store.  store may keep or ignore what it is
+         given.  Either both or neither must be supplied.  Loaded
+         entries are not trusted: one whose extents the front end
+         could not have made from the VexTranslateArgs, as judged by
+         guest_bytes_addr, guest_max_bytes and chase_into_ok, is
+         discarded before any guest bytes are read for it.  Helper
+         addresses in stored entries are adjusted if the library is
+         loaded at a different address next time, which is correct as
+         long as all helpers live in the same module as libvex. */
+      void*        store_opaque;
+      const UChar* (*load)  ( void* store_opaque, ULong key,
+                              /*OUT*/UInt* szB );
+      void         (*store) ( void* store_opaque, ULong key,
+                              const UChar* bytes, UInt szB );
+
+      /* Mixed into every key.  The results of chase_into_ok,
+         preamble_function, instrument1 and instrument2 are assumed to
+         depend only on the guest code and the salt, so a client must
+         change the salt whenever they would change.  It is also wise
+         to change it when upgrading the library, or else to empty the
+         persistent store. */
+      ULong salt;
+   }
+   VexLiftCacheConfig;
+
+typedef
+   struct {
+      ULong hits;        /* of which disk_hits came from the store */
+      ULong disk_hits;
+      ULong misses;
+      ULong bypassed;    /* tracing was on */
+      ULong evictions;
+      UInt  n_entries;   /* currently in memory */
+      SizeT n_bytes;
+   }
+   VexLiftCacheStats;
+
+typedef  struct _VexLiftCache  VexLiftCache;
+
+extern
+VexLiftCache* LibVEX_NewLiftCache ( const VexLiftCacheConfig* config );
+
+extern
+void LibVEX_DeleteLiftCache ( VexLiftCache* cache );
+
+/* As LibVEX_Lift, but consult the cache first, and add the result to
+   it on a miss. */
+extern
+IRSB* LibVEX_Lift_cached ( VexLiftCache* cache,
+                           VexTranslateArgs* vta,
+                           /*OUT*/ VexTranslateResult* res,
+                           /*OUT*/ VexRegisterUpdates* pxControl );
+
+/* The flat image of the IRSB most recently returned by
+   LibVEX_Lift_cached, as written by LibVEX_SerializeIRSB, or NULL if
+   it is not in the cache.  Valid until the next call on the cache. */
+extern
+const UChar* LibVEX_LiftCacheImage ( const VexLiftCache* cache,
+                                     /*OUT*/UInt* szB );
+
+extern
+void LibVEX_GetLiftCacheStats ( const VexLiftCache* cache,
+                                /*OUT*/VexLiftCacheStats* stats );
+
+
+/*-------------------------------------------------------*/
+/*--- Translation contexts                            ---*/
+/*-------------------------------------------------------*/
+
+/* By default all translations share the library's static storage
+   area, so LibVEX_Translate, LibVEX_Lift and LibVEX_Codegen must not
+   be in progress on more than one thread at once.
+
+   A VexContext carries a private storage area and a private
+   VexControl.  The _ctx variants below may run concurrently on
+   different threads, provided no two of them use the same context at
+   the same time.  The IRSB returned by LibVEX_Lift_ctx lives in the
+   context's storage, and stays valid until the next lift or
+   translation in that context.  Instrumentation callbacks run inside
+   the context, so LibVEX_Alloc in them allocates there too.
+
+   LibVEX_Init must have been called (once, on one thread) before any
+   context is set up; it builds the tables the threads then share
+   read-only.  Calls that change library-wide settings, such as
+   LibVEX_Update_Control and LibVEX_SetSlabAllocator, must not overlap
+   with any translation.  All fields are private to VEX. */
+
+typedef
+   struct {
+      HChar* first;
+      HChar* curr;
+      HChar* last;
+      HChar* base_first;
+      HChar* base_last;
+      void*  slabs;
+   }
+   VexArena;
+
+typedef
+   struct {
+      UInt       magic;
+      VexArena   arena;
+      VexControl control;
+   }
+   VexContext;
+
+/* Set up *ctx to allocate from the arena_szB bytes at arena.  The
+   area must be 8-aligned, at least 64KB, and outlive the context; a
+   few MB is a sensible size, or less if a slab allocator has been
+   supplied with LibVEX_SetSlabAllocator.  vcon may be NULL, meaning the control
+   currently in force for the plain entry points. */
+extern
+void LibVEX_InitContext ( /*OUT*/VexContext* ctx,
+                          void* arena, SizeT arena_szB,
+                          const VexControl* vcon );
+
+/* Update the VexControl of a context. */
+extern
+void LibVEX_Update_Control_ctx ( VexContext* ctx, const VexControl* vcon );
+
+extern
+VexTranslateResult LibVEX_Translate_ctx ( VexContext*, VexTranslateArgs* );
+extern
+IRSB *LibVEX_Lift_ctx ( VexContext*,
+                        VexTranslateArgs*,
+                        VexTranslateResult*,
+                        VexRegisterUpdates* );
+extern
+void LibVEX_Codegen_ctx ( VexContext*,
+                          VexTranslateArgs*,
+                          VexTranslateResult*,
+                          IRSB*,
+                          VexRegisterUpdates );
+extern
+IRSB* LibVEX_Lift_cached_ctx ( VexContext*,
+                               VexLiftCache*,
+                               VexTranslateArgs*,
+                               VexTranslateResult*,
+                               VexRegisterUpdates* );
+extern
+UInt LibVEX_LiftBatch_ctx ( VexContext*,
+                            VexTranslateArgs*,
+                            /*MOD*/VexLiftRequest*, UInt,
+                            void (*)( void*, VexLiftRequest* ) );
+extern
+VexRegion* LibVEX_LiftRegion_ctx ( VexContext*,
+                                   VexTranslateArgs*, UInt,
+                                   const Addr*, UInt,
+                                   UInt, Bool,
+                                   VexTranslateResult* );
+
+
 /* A subtlety re interaction between self-checking translations and
    bb-chasing.  The supplied chase_into_ok function should say NO
    (False) when presented with any address for which you might want to
@@ -880,6 +1480,79 @@ VexInvalRange LibVEX_PatchProfInc ( VexArch      arch_host,
 
 extern void LibVEX_ShowStats ( void );
 
+
+/* Optional accounting of where translation time and storage go.
+   Off by default.  LibVEX_EnablePipelineStats turns it on for all
+   threads, using |clock| to time each stage; clock may count cycles,
+   nanoseconds or anything else that increases monotonically, and the
+   times reported are in its units.  Passing NULL turns it off again.
+
+   The figures accumulate per thread, separately for each guest/host
+   arch pair that thread has translated for.  A thread keeps records
+   for up to VEX_PIPESTATS_MAX_PAIRS pairs; any further pairs are
+   lumped together into the last record, whose archs then read
+   VexArch_INVALID. */
+
+typedef
+   enum {
+      VexStageFrontEnd,       /* bb_to_IR */
+      VexStageSanity,         /* sanityCheckIRSB on the lifted IR */
+      VexStageIROptFlatten,   /* iropt: flattening */
+      VexStageIROptCheap,     /* iropt: cheap transformations */
+      VexStageIROptExpensive, /* iropt: expensive transformations */
+      VexStageIROptCSE,       /* iropt: standalone CSE + dead code */
+      VexStageIROptUnroll,    /* iropt: loop unrolling attempts */
+      VexStageInstrument,     /* instrument1/2 and their cleanup */
+      VexStageTreeBuild,      /* ado_treebuild_BB and finaltidy */
+      VexStageIsel,           /* instruction selection */
+      VexStageRegAlloc,       /* doRegisterAllocation */
+      VexStagePeephole,       /* peephole pass on allocated code */
+      VexStageEmit,           /* assembly into host_bytes */
+      VexStage_LAST           /* must be the last enumerator */
+   }
+   VexStage;
+
+typedef
+   struct {
+      ULong n_runs;
+      ULong time;    /* in units of the client's clock */
+      ULong bytes;   /* TEMP storage allocated */
+   }
+   VexStageStats;
+
+#define VEX_PIPESTATS_MAX_PAIRS 4
+
+typedef
+   struct {
+      VexArch arch_guest;
+      VexArch arch_host;
+      ULong   n_blocks_lifted;
+      ULong   n_guest_instrs;
+      ULong   n_ir_stmts;       /* in the IRSBs LibVEX_Lift returned */
+      ULong   n_blocks_emitted;
+      ULong   n_host_bytes;
+      ULong   n_spills;          /* spill stores regalloc added */
+      ULong   n_reloads;         /* .. and reloads */
+      ULong   n_moves_coalesced; /* reg-reg moves regalloc removed */
+      ULong   n_peephole_bytes;  /* host code bytes the peephole
+                                    pass saved */
+      VexStageStats stage[VexStage_LAST];
+      ULong   n_cse_hits;        /* CSE lookups that found an
+                                    available expression */
+      ULong   n_cse_misses;      /* .. and that added one */
+   }
+   VexPipelineStats;
+
+extern void LibVEX_EnablePipelineStats ( ULong (*clock)( void ) );
+
+/* Discard the calling thread's records. */
+extern void LibVEX_ResetPipelineStats ( void );
+
+/* Copy up to max_pairs of the calling thread's records to stats, and
+   return how many records there are. */
+extern UInt LibVEX_GetPipelineStats ( /*OUT*/VexPipelineStats* stats,
+                                      UInt max_pairs );
+
 /*-------------------------------------------------------*/
 /*-- IR injection                                      --*/
 /*-------------------------------------------------------*/
@@ -3057,6 +3057,12 @@ extern void ppIRSB ( const IRSB* );
 /* Append an IRStmt to an IRSB */
 extern void addStmtToIRSB ( IRSB*, IRStmt* );
 
+/* Add delta to every IRTemp mentioned in an IRSB, leaving its type
+   environment alone.  The IRSB must not share any IR nodes, neither
+   internally nor with any other IRSB; one made by deepCopyIRSB
+   doesn't. */
+extern void renumberIRTemps ( IRSB*, IRTemp delta );
+
 
 /*---------------------------------------------------------------*/
 /*--- Helper functions for the IR                             ---*/
@@ -0,0 +1,477 @@
+
+/*---------------------------------------------------------------*/
+/*--- begin                                      bench_lift.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* Lifting throughput benchmark.
+
+   usage: bench_lift [-r reps] arch=file [arch=file ...]
+
+   where arch is one of x86 amd64 arm thumb arm64 ppc32 ppc64 mips32
+   mips64 s390x.  If file is an ELF object its .text section is used,
+   and the ELF header decides the endianness; otherwise the whole file
+   is taken as raw code, in the arch's usual endianness, at address
+   0x10000.
+
+   Each corpus is swept linearly: a block is lifted at the start of
+   .text, the next one starts where it ended, and so on, stepping over
+   anything that does not decode.  This is done at iropt levels 0, 1
+   and 2, |reps| times each (default 3), keeping the fastest run.  A
+   further, untimed, sweep with LibVEX_EnablePipelineStats on gives
+   the TEMP storage used per block.
+
+   Output is one line per corpus and level, of space-separated
+   key=value pairs, eg
+
+      bench arch=amd64 level=2 file=/bin/ls text_bytes=... blocks=...
+        insns=... stmts=... failures=... secs=... blocks_per_sec=...
+        insns_per_sec=... stmts_per_sec=... mean_temp_bytes=...
+        peak_temp_bytes=...
+
+   (all on one line), so results are easy to diff and graph.  A
+   block that does not lift (LibVEX calling failure_exit) is counted
+   in failures and skipped; if any sweep has failures, bench_lift
+   says so on stderr and exits with 1, since the timings then leave
+   out work that should have been done.  Build with
+   "make -f Makefile-vex bench_lift" in this directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "libvex_basictypes.h"
+#include "libvex.h"
+
+
+/*---------------------------------------------------------------*/
+/*--- Loading a corpus                                        ---*/
+/*---------------------------------------------------------------*/
+
+typedef
+   struct {
+      const HChar* name;
+      VexArch      arch;
+      UInt         hwcaps;
+      VexEndness   endness;   /* for raw files */
+      Int          align;     /* insn alignment, for stepping */
+      Bool         thumb;
+   }
+   ArchDesc;
+
+static const ArchDesc archs[] = {
+   { "x86",    VexArchX86,
+     VEX_HWCAPS_X86_MMXEXT | VEX_HWCAPS_X86_SSE1 | VEX_HWCAPS_X86_SSE2
+     | VEX_HWCAPS_X86_SSE3 | VEX_HWCAPS_X86_LZCNT,
+     VexEndnessLE, 1, False },
+   { "amd64",  VexArchAMD64,
+     VEX_HWCAPS_AMD64_SSE3 | VEX_HWCAPS_AMD64_CX16 | VEX_HWCAPS_AMD64_LZCNT
+     | VEX_HWCAPS_AMD64_AVX | VEX_HWCAPS_AMD64_RDTSCP
+     | VEX_HWCAPS_AMD64_BMI | VEX_HWCAPS_AMD64_AVX2,
+     VexEndnessLE, 1, False },
+   { "arm",    VexArchARM,
+     7 | VEX_HWCAPS_ARM_VFP3 | VEX_HWCAPS_ARM_NEON,
+     VexEndnessLE, 4, False },
+   { "thumb",  VexArchARM,
+     7 | VEX_HWCAPS_ARM_VFP3 | VEX_HWCAPS_ARM_NEON,
+     VexEndnessLE, 2, True },
+   { "arm64",  VexArchARM64,  0, VexEndnessLE, 4, False },
+   { "ppc32",  VexArchPPC32,
+     VEX_HWCAPS_PPC32_F | VEX_HWCAPS_PPC32_V | VEX_HWCAPS_PPC32_FX
+     | VEX_HWCAPS_PPC32_GX,
+     VexEndnessBE, 4, False },
+   { "ppc64",  VexArchPPC64,
+     VEX_HWCAPS_PPC64_V | VEX_HWCAPS_PPC64_FX | VEX_HWCAPS_PPC64_GX
+     | VEX_HWCAPS_PPC64_VX | VEX_HWCAPS_PPC64_DFP | VEX_HWCAPS_PPC64_ISA2_07,
+     VexEndnessBE, 4, False },
+   { "mips32", VexArchMIPS32, VEX_PRID_COMP_MIPS, VexEndnessLE, 4, False },
+   { "mips64", VexArchMIPS64, VEX_PRID_COMP_MIPS, VexEndnessLE, 4, False },
+   { "s390x",  VexArchS390X,
+     VEX_S390X_MODEL_Z196 | VEX_HWCAPS_S390X_LDISP | VEX_HWCAPS_S390X_EIMM
+     | VEX_HWCAPS_S390X_GIE | VEX_HWCAPS_S390X_DFP | VEX_HWCAPS_S390X_FGX
+     | VEX_HWCAPS_S390X_ETF2 | VEX_HWCAPS_S390X_STFLE
+     | VEX_HWCAPS_S390X_ETF3 | VEX_HWCAPS_S390X_STCKF
+     | VEX_HWCAPS_S390X_FPEXT | VEX_HWCAPS_S390X_LSC,
+     VexEndnessBE, 2, False },
+};
+
+typedef
+   struct {
+      const ArchDesc* desc;
+      const HChar*    file;
+      VexEndness      endness;
+      UChar*          image;     /* the whole file */
+      ULong           image_szB;
+      ULong           text_off;  /* .text, within image */
+      ULong           text_szB;
+      Addr            text_addr;
+   }
+   Corpus;
+
+/* Read a 16/32/64 bit field of an ELF header in the file's byte
+   order. */
+static ULong elf_get ( const UChar* p, Int szB, Bool be )
+{
+   ULong v = 0;
+   Int   i;
+   for (i = 0; i < szB; i++)
+      v |= (ULong)p[be ? szB - 1 - i : i] << (8 * i);
+   return v;
+}
+
+/* Find .text in an ELF image.  Returns False if it is not a usable
+   ELF file, in which case the caller treats it as raw code. */
+static Bool find_elf_text ( Corpus* c )
+{
+   const UChar* im = c->image;
+   Bool  is64, be;
+   ULong shoff, shentsize, shnum, shstrndx, stroff, i;
+
+   if (c->image_szB < 64 || memcmp(im, "\177ELF", 4) != 0)
+      return False;
+   is64 = im[4] == 2;
+   be   = im[5] == 2;
+
+   shoff     = elf_get(im + (is64 ? 0x28 : 0x20), is64 ? 8 : 4, be);
+   shentsize = elf_get(im + (is64 ? 0x3A : 0x2E), 2, be);
+   shnum     = elf_get(im + (is64 ? 0x3C : 0x30), 2, be);
+   shstrndx  = elf_get(im + (is64 ? 0x3E : 0x32), 2, be);
+   if (shoff == 0 || shstrndx >= shnum
+       || shoff + shnum * shentsize > c->image_szB)
+      return False;
+
+#  define SH_FIELD(_n, _off32, _off64, _sz32, _sz64)               \
+      elf_get(im + shoff + (_n) * shentsize + (is64 ? _off64 : _off32), \
+              is64 ? _sz64 : _sz32, be)
+   stroff = SH_FIELD(shstrndx, 0x10, 0x18, 4, 8);
+   for (i = 0; i < shnum; i++) {
+      ULong name = SH_FIELD(i, 0x00, 0x00, 4, 4);
+      if (stroff + name + 6 > c->image_szB
+          || memcmp(im + stroff + name, ".text", 6) != 0)
+         continue;
+      c->text_addr = SH_FIELD(i, 0x0C, 0x10, 4, 8);
+      c->text_off  = SH_FIELD(i, 0x10, 0x18, 4, 8);
+      c->text_szB  = SH_FIELD(i, 0x14, 0x20, 4, 8);
+      c->endness   = be ? VexEndnessBE : VexEndnessLE;
+      return c->text_off + c->text_szB <= c->image_szB;
+   }
+#  undef SH_FIELD
+   return False;
+}
+
+/* Thumb decoding looks at up to 18 bytes before a block, and the
+   front ends may read a little past the end, so raw images are
+   padded at both ends. */
+#define N_PAD_BYTES 64
+
+static void load_corpus ( /*OUT*/Corpus* c, const HChar* spec )
+{
+   const HChar* eq = strchr(spec, '=');
+   FILE*        f;
+   long         szB;
+   UInt         i;
+
+   memset(c, 0, sizeof(*c));
+   for (i = 0; eq && i < sizeof(archs) / sizeof(archs[0]); i++) {
+      if (strlen(archs[i].name) == (size_t)(eq - spec)
+          && 0 == strncmp(archs[i].name, spec, eq - spec))
+         c->desc = &archs[i];
+   }
+   if (c->desc == NULL) {
+      fprintf(stderr, "bench_lift: bad corpus `%s'\n", spec);
+      exit(1);
+   }
+   c->file = eq + 1;
+
+   f = fopen(c->file, "rb");
+   if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (szB = ftell(f)) <= 0) {
+      fprintf(stderr, "bench_lift: can't read `%s'\n", c->file);
+      exit(1);
+   }
+   rewind(f);
+   c->image = calloc(1, szB + 2 * N_PAD_BYTES);
+   if (c->image == NULL
+       || fread(c->image + N_PAD_BYTES, 1, szB, f) != (size_t)szB) {
+      fprintf(stderr, "bench_lift: can't read `%s'\n", c->file);
+      exit(1);
+   }
+   fclose(f);
+   c->image     += N_PAD_BYTES;
+   c->image_szB  = szB;
+
+   if (!find_elf_text(c)) {
+      c->text_off  = 0;
+      c->text_szB  = szB;
+      c->text_addr = 0x10000;
+      c->endness   = c->desc->endness;
+   }
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Lifting                                                 ---*/
+/*---------------------------------------------------------------*/
+
+static jmp_buf failure_env;
+
+__attribute__ ((noreturn))
+static void failure_exit ( void )
+{
+   longjmp(failure_env, 1);
+}
+
+static void log_bytes ( const HChar* bytes, SizeT nbytes )
+{
+   fwrite(bytes, 1, nbytes, stderr);
+}
+
+static Bool chase_into_not_ok ( void* opaque, Addr dst )
+{
+   return False;
+}
+
+static UInt needs_self_check ( void* opaque, VexRegisterUpdates* pxControl,
+                               const VexGuestExtents* vge )
+{
+   return 0;
+}
+
+static ULong now_ns ( void )
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (ULong)ts.tv_sec * 1000000000ULL + (ULong)ts.tv_nsec;
+}
+
+static VexArch host_arch ( void )
+{
+#  if defined(__x86_64__)
+   return VexArchAMD64;
+#  elif defined(__i386__)
+   return VexArchX86;
+#  elif defined(__aarch64__)
+   return VexArchARM64;
+#  elif defined(__arm__)
+   return VexArchARM;
+#  elif defined(__powerpc64__)
+   return VexArchPPC64;
+#  elif defined(__powerpc__)
+   return VexArchPPC32;
+#  elif defined(__s390x__)
+   return VexArchS390X;
+#  elif defined(__mips__) && defined(__mips64)
+   return VexArchMIPS64;
+#  elif defined(__mips__)
+   return VexArchMIPS32;
+#  else
+   return VexArchAMD64;
+#  endif
+}
+
+typedef
+   struct {
+      ULong blocks, insns, stmts, failures;
+      ULong ns;
+      ULong temp_bytes, peak_temp_bytes;
+   }
+   SweepResult;
+
+static ULong temp_bytes_so_far ( void )
+{
+   VexPipelineStats st;
+   ULong            sum = 0;
+   Int              i;
+   if (LibVEX_GetPipelineStats(&st, 1) == 0)
+      return 0;
+   for (i = 0; i < VexStage_LAST; i++)
+      sum += st.stage[i].bytes;
+   return sum;
+}
+
+/* Lift every block in c's .text once.  If with_stats, also record
+   the TEMP storage each block uses. */
+static void sweep ( const Corpus* c, Bool with_stats, /*OUT*/SweepResult* r )
+{
+   VexTranslateArgs   vta;
+   VexTranslateResult res;
+   VexRegisterUpdates pxControl;
+   VexGuestExtents    vge;
+   ULong              off, step, before;
+   ULong              t0;
+   IRSB*              irsb;
+
+   memset(&vta, 0, sizeof(vta));
+   vta.arch_guest = c->desc->arch;
+   LibVEX_default_VexArchInfo(&vta.archinfo_guest);
+   vta.archinfo_guest.hwcaps                 = c->desc->hwcaps;
+   vta.archinfo_guest.endness                = c->endness;
+   vta.archinfo_guest.ppc_icache_line_szB    = 128;
+   vta.archinfo_guest.ppc_dcbz_szB           = 128;
+   vta.archinfo_guest.ppc_dcbzl_szB          = 128;
+   vta.archinfo_guest.arm64_dMinLine_lg2_szB = 6;
+   vta.archinfo_guest.arm64_iMinLine_lg2_szB = 6;
+   vta.arch_host = host_arch();
+   LibVEX_default_VexArchInfo(&vta.archinfo_host);
+   vta.archinfo_host.endness = VexEndnessLE;
+   if (vta.arch_host == VexArchAMD64)
+      vta.archinfo_host.hwcaps = VEX_HWCAPS_AMD64_SSE3
+                                 | VEX_HWCAPS_AMD64_CX16;
+   LibVEX_default_VexAbiInfo(&vta.abiinfo_both);
+   vta.abiinfo_both.guest_stack_redzone_size = 128;
+   vta.guest_extents    = &vge;
+   vta.chase_into_ok    = chase_into_not_ok;
+   vta.needs_self_check = needs_self_check;
+
+   memset(r, 0, sizeof(*r));
+   t0 = now_ns();
+
+   for (off = 0; off < c->text_szB; off += step) {
+      step = c->desc->align;
+      /* Thumb addresses carry the T bit, and guest_bytes is offset
+         to match, as in Valgrind proper. */
+      vta.guest_bytes      = c->image + c->text_off + off + c->desc->thumb;
+      vta.guest_bytes_addr = c->text_addr + off + c->desc->thumb;
+      before = with_stats ? temp_bytes_so_far() : 0;
+
+      if (setjmp(failure_env)) {
+         r->failures++;
+         continue;
+      }
+      irsb = LibVEX_Lift(&vta, &res, &pxControl);
+      if (irsb == NULL) {
+         r->failures++;
+         continue;
+      }
+
+      r->blocks++;
+      r->insns += res.n_guest_instrs;
+      r->stmts += irsb->stmts_used;
+      if (vge.n_used >= 1 && vge.len[0] > step)
+         step = vge.len[0];
+      if (with_stats) {
+         ULong used = temp_bytes_so_far() - before;
+         r->temp_bytes += used;
+         if (used > r->peak_temp_bytes)
+            r->peak_temp_bytes = used;
+      }
+   }
+
+   r->ns = now_ns() - t0;
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Main                                                    ---*/
+/*---------------------------------------------------------------*/
+
+static double per_sec ( ULong n, ULong ns )
+{
+   return ns == 0 ? 0.0 : (double)n * 1e9 / (double)ns;
+}
+
+int main ( int argc, char** argv )
+{
+   VexControl  vcon;
+   Corpus*     corpora;
+   Int         n_corpora, reps, i, j, level, n_failed = 0;
+   SweepResult best, r;
+
+   reps = 3;
+   i    = 1;
+   if (argc > 2 && 0 == strcmp(argv[1], "-r")) {
+      reps = atoi(argv[2]);
+      i    = 3;
+   }
+   if (i >= argc || reps < 1) {
+      fprintf(stderr, "usage: bench_lift [-r reps] arch=file ...\n");
+      return 1;
+   }
+
+   n_corpora = argc - i;
+   corpora   = calloc(n_corpora, sizeof(Corpus));
+   for (j = 0; j < n_corpora; j++)
+      load_corpus(&corpora[j], argv[i + j]);
+
+   /* No chasing, so that blocks never leave the corpus. */
+   LibVEX_default_VexControl(&vcon);
+   vcon.guest_chase_thresh = 0;
+   LibVEX_Init(failure_exit, log_bytes, 0, &vcon);
+
+   for (j = 0; j < n_corpora; j++) {
+      const Corpus* c = &corpora[j];
+      /* The s390x front end relies on facts about the host that
+         are only set up when the host is an s390x too. */
+      if (c->desc->arch == VexArchS390X && host_arch() != VexArchS390X) {
+         printf("bench arch=%s file=%s skipped=host_not_s390x\n",
+                c->desc->name, c->file);
+         continue;
+      }
+      for (level = 0; level <= 2; level++) {
+         vcon.iropt_level = level;
+         LibVEX_Update_Control(&vcon);
+
+         LibVEX_EnablePipelineStats(NULL);
+         for (i = 0; i < reps; i++) {
+            sweep(c, False, &r);
+            if (i == 0 || r.ns < best.ns)
+               best = r;
+         }
+
+         LibVEX_ResetPipelineStats();
+         LibVEX_EnablePipelineStats(now_ns);
+         sweep(c, True, &r);
+         LibVEX_EnablePipelineStats(NULL);
+
+         printf("bench arch=%s level=%d file=%s text_bytes=%llu "
+                "blocks=%llu insns=%llu stmts=%llu failures=%llu "
+                "secs=%.6f blocks_per_sec=%.0f insns_per_sec=%.0f "
+                "stmts_per_sec=%.0f mean_temp_bytes=%llu "
+                "peak_temp_bytes=%llu\n",
+                c->desc->name, level, c->file, c->text_szB,
+                best.blocks, best.insns, best.stmts, best.failures,
+                (double)best.ns / 1e9,
+                per_sec(best.blocks, best.ns),
+                per_sec(best.insns, best.ns),
+                per_sec(best.stmts, best.ns),
+                r.blocks == 0 ? 0ULL : r.temp_bytes / r.blocks,
+                r.peak_temp_bytes);
+         fflush(stdout);
+         if (best.failures > 0 || r.failures > 0)
+            n_failed++;
+      }
+   }
+   if (n_failed > 0) {
+      fprintf(stderr, "bench_lift: FAILED: %d sweep(s) had blocks that "
+                      "did not lift; the numbers above are not valid\n",
+                      n_failed);
+      return 1;
+   }
+   return 0;
+}
+
+/*---------------------------------------------------------------*/
+/*--- end                                        bench_lift.c ---*/
+/*---------------------------------------------------------------*/
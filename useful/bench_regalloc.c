@@ -0,0 +1,503 @@
+/*---------------------------------------------------------------*/
+/*--- begin                                  bench_regalloc.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* Register allocator benchmark.
+
+   usage: bench_regalloc [-r reps] arch=file [arch=file ...]
+
+   with corpora given as for bench_lift.  Each corpus is swept
+   linearly, as bench_lift does, and every block that lifts is
+   translated for this host at iropt level 2 with each register
+   allocator (VexControl.regalloc_version 2 and 3), |reps| times each
+   (default 3), keeping the fastest allocation time per block.
+
+   A block counts as SIMD-heavy if at least a quarter of its IR temps,
+   and at least 8, are V128 or V256; those are the blocks where
+   register pressure, and so spilling, is worst.  Output is one line
+   per corpus, allocator and set of blocks (all, or the SIMD-heavy
+   ones), of space-separated key=value pairs, eg
+
+      regalloc arch=amd64 file=/bin/ls set=simd version=3 blocks=...
+        secs=... ns_per_block=... spills=... reloads=...
+        moves_coalesced=... host_bytes=...
+
+   (all on one line), where secs is the time spent in the allocator,
+   spills and reloads count the spill stores and reloads it added, and
+   moves_coalesced the reg-reg moves it removed.  Build with
+   "make -f Makefile-vex bench_regalloc" in this directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "libvex_basictypes.h"
+#include "libvex.h"
+
+
+/*---------------------------------------------------------------*/
+/*--- Loading a corpus                                        ---*/
+/*---------------------------------------------------------------*/
+
+typedef
+   struct {
+      const HChar* name;
+      VexArch      arch;
+      UInt         hwcaps;
+      VexEndness   endness;   /* for raw files */
+      Int          align;     /* insn alignment, for stepping */
+      Bool         thumb;
+   }
+   ArchDesc;
+
+static const ArchDesc archs[] = {
+   { "x86",    VexArchX86,
+     VEX_HWCAPS_X86_MMXEXT | VEX_HWCAPS_X86_SSE1 | VEX_HWCAPS_X86_SSE2
+     | VEX_HWCAPS_X86_SSE3 | VEX_HWCAPS_X86_LZCNT,
+     VexEndnessLE, 1, False },
+   { "amd64",  VexArchAMD64,
+     VEX_HWCAPS_AMD64_SSE3 | VEX_HWCAPS_AMD64_CX16 | VEX_HWCAPS_AMD64_LZCNT
+     | VEX_HWCAPS_AMD64_AVX | VEX_HWCAPS_AMD64_RDTSCP
+     | VEX_HWCAPS_AMD64_BMI | VEX_HWCAPS_AMD64_AVX2,
+     VexEndnessLE, 1, False },
+   { "arm",    VexArchARM,
+     7 | VEX_HWCAPS_ARM_VFP3 | VEX_HWCAPS_ARM_NEON,
+     VexEndnessLE, 4, False },
+   { "thumb",  VexArchARM,
+     7 | VEX_HWCAPS_ARM_VFP3 | VEX_HWCAPS_ARM_NEON,
+     VexEndnessLE, 2, True },
+   { "arm64",  VexArchARM64,  0, VexEndnessLE, 4, False },
+   { "ppc32",  VexArchPPC32,
+     VEX_HWCAPS_PPC32_F | VEX_HWCAPS_PPC32_V | VEX_HWCAPS_PPC32_FX
+     | VEX_HWCAPS_PPC32_GX,
+     VexEndnessBE, 4, False },
+   { "ppc64",  VexArchPPC64,
+     VEX_HWCAPS_PPC64_V | VEX_HWCAPS_PPC64_FX | VEX_HWCAPS_PPC64_GX
+     | VEX_HWCAPS_PPC64_VX | VEX_HWCAPS_PPC64_DFP | VEX_HWCAPS_PPC64_ISA2_07,
+     VexEndnessBE, 4, False },
+   { "mips32", VexArchMIPS32, VEX_PRID_COMP_MIPS, VexEndnessLE, 4, False },
+   { "mips64", VexArchMIPS64, VEX_PRID_COMP_MIPS, VexEndnessLE, 4, False },
+   { "s390x",  VexArchS390X,
+     VEX_S390X_MODEL_Z196 | VEX_HWCAPS_S390X_LDISP | VEX_HWCAPS_S390X_EIMM
+     | VEX_HWCAPS_S390X_GIE | VEX_HWCAPS_S390X_DFP | VEX_HWCAPS_S390X_FGX
+     | VEX_HWCAPS_S390X_ETF2 | VEX_HWCAPS_S390X_STFLE
+     | VEX_HWCAPS_S390X_ETF3 | VEX_HWCAPS_S390X_STCKF
+     | VEX_HWCAPS_S390X_FPEXT | VEX_HWCAPS_S390X_LSC,
+     VexEndnessBE, 2, False },
+};
+
+typedef
+   struct {
+      const ArchDesc* desc;
+      const HChar*    file;
+      VexEndness      endness;
+      UChar*          image;     /* the whole file */
+      ULong           image_szB;
+      ULong           text_off;  /* .text, within image */
+      ULong           text_szB;
+      Addr            text_addr;
+   }
+   Corpus;
+
+/* Read a 16/32/64 bit field of an ELF header in the file's byte
+   order. */
+static ULong elf_get ( const UChar* p, Int szB, Bool be )
+{
+   ULong v = 0;
+   Int   i;
+   for (i = 0; i < szB; i++)
+      v |= (ULong)p[be ? szB - 1 - i : i] << (8 * i);
+   return v;
+}
+
+/* Find .text in an ELF image.  Returns False if it is not a usable
+   ELF file, in which case the caller treats it as raw code. */
+static Bool find_elf_text ( Corpus* c )
+{
+   const UChar* im = c->image;
+   Bool  is64, be;
+   ULong shoff, shentsize, shnum, shstrndx, stroff, i;
+
+   if (c->image_szB < 64 || memcmp(im, "\177ELF", 4) != 0)
+      return False;
+   is64 = im[4] == 2;
+   be   = im[5] == 2;
+
+   shoff     = elf_get(im + (is64 ? 0x28 : 0x20), is64 ? 8 : 4, be);
+   shentsize = elf_get(im + (is64 ? 0x3A : 0x2E), 2, be);
+   shnum     = elf_get(im + (is64 ? 0x3C : 0x30), 2, be);
+   shstrndx  = elf_get(im + (is64 ? 0x3E : 0x32), 2, be);
+   if (shoff == 0 || shstrndx >= shnum
+       || shoff + shnum * shentsize > c->image_szB)
+      return False;
+
+#  define SH_FIELD(_n, _off32, _off64, _sz32, _sz64)               \
+      elf_get(im + shoff + (_n) * shentsize + (is64 ? _off64 : _off32), \
+              is64 ? _sz64 : _sz32, be)
+   stroff = SH_FIELD(shstrndx, 0x10, 0x18, 4, 8);
+   for (i = 0; i < shnum; i++) {
+      ULong name = SH_FIELD(i, 0x00, 0x00, 4, 4);
+      if (stroff + name + 6 > c->image_szB
+          || memcmp(im + stroff + name, ".text", 6) != 0)
+         continue;
+      c->text_addr = SH_FIELD(i, 0x0C, 0x10, 4, 8);
+      c->text_off  = SH_FIELD(i, 0x10, 0x18, 4, 8);
+      c->text_szB  = SH_FIELD(i, 0x14, 0x20, 4, 8);
+      c->endness   = be ? VexEndnessBE : VexEndnessLE;
+      return c->text_off + c->text_szB <= c->image_szB;
+   }
+#  undef SH_FIELD
+   return False;
+}
+
+/* Thumb decoding looks at up to 18 bytes before a block, and the
+   front ends may read a little past the end, so raw images are
+   padded at both ends. */
+#define N_PAD_BYTES 64
+
+static void load_corpus ( /*OUT*/Corpus* c, const HChar* spec )
+{
+   const HChar* eq = strchr(spec, '=');
+   FILE*        f;
+   long         szB;
+   UInt         i;
+
+   memset(c, 0, sizeof(*c));
+   for (i = 0; eq && i < sizeof(archs) / sizeof(archs[0]); i++) {
+      if (strlen(archs[i].name) == (size_t)(eq - spec)
+          && 0 == strncmp(archs[i].name, spec, eq - spec))
+         c->desc = &archs[i];
+   }
+   if (c->desc == NULL) {
+      fprintf(stderr, "bench_regalloc: bad corpus `%s'\n", spec);
+      exit(1);
+   }
+   c->file = eq + 1;
+
+   f = fopen(c->file, "rb");
+   if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (szB = ftell(f)) <= 0) {
+      fprintf(stderr, "bench_regalloc: can't read `%s'\n", c->file);
+      exit(1);
+   }
+   rewind(f);
+   c->image = calloc(1, szB + 2 * N_PAD_BYTES);
+   if (c->image == NULL
+       || fread(c->image + N_PAD_BYTES, 1, szB, f) != (size_t)szB) {
+      fprintf(stderr, "bench_regalloc: can't read `%s'\n", c->file);
+      exit(1);
+   }
+   fclose(f);
+   c->image     += N_PAD_BYTES;
+   c->image_szB  = szB;
+
+   if (!find_elf_text(c)) {
+      c->text_off  = 0;
+      c->text_szB  = szB;
+      c->text_addr = 0x10000;
+      c->endness   = c->desc->endness;
+   }
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Translating                                             ---*/
+/*---------------------------------------------------------------*/
+
+static jmp_buf failure_env;
+
+__attribute__ ((noreturn))
+static void failure_exit ( void )
+{
+   longjmp(failure_env, 1);
+}
+
+static void log_bytes ( const HChar* bytes, SizeT nbytes )
+{
+   fwrite(bytes, 1, nbytes, stderr);
+}
+
+static Bool chase_into_not_ok ( void* opaque, Addr dst )
+{
+   return False;
+}
+
+static UInt needs_self_check ( void* opaque, VexRegisterUpdates* pxControl,
+                               const VexGuestExtents* vge )
+{
+   return 0;
+}
+
+static ULong now_ns ( void )
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (ULong)ts.tv_sec * 1000000000ULL + (ULong)ts.tv_nsec;
+}
+
+static VexArch host_arch ( void )
+{
+#  if defined(__x86_64__)
+   return VexArchAMD64;
+#  elif defined(__i386__)
+   return VexArchX86;
+#  elif defined(__aarch64__)
+   return VexArchARM64;
+#  elif defined(__arm__)
+   return VexArchARM;
+#  elif defined(__powerpc64__)
+   return VexArchPPC64;
+#  elif defined(__powerpc__)
+   return VexArchPPC32;
+#  elif defined(__s390x__)
+   return VexArchS390X;
+#  elif defined(__mips__) && defined(__mips64)
+   return VexArchMIPS64;
+#  elif defined(__mips__)
+   return VexArchMIPS32;
+#  else
+   return VexArchAMD64;
+#  endif
+}
+
+/* Totals for one allocator over one set of blocks. */
+typedef
+   struct {
+      ULong blocks;
+      ULong ns;
+      ULong spills, reloads, moves_coalesced;
+      ULong host_bytes;
+   }
+   Totals;
+
+enum { SET_ALL, SET_SIMD, N_SETS };
+static const HChar* set_names[N_SETS] = { "all", "simd" };
+
+static const Int versions[] = { 2, 3 };
+#define N_VERSIONS ((Int)(sizeof(versions) / sizeof(versions[0])))
+
+static UChar host_bytes[65536];
+
+static void setup_vta ( const Corpus* c, /*OUT*/VexTranslateArgs* vta,
+                        VexGuestExtents* vge, Int* host_bytes_used )
+{
+   memset(vta, 0, sizeof(*vta));
+   vta->arch_guest = c->desc->arch;
+   LibVEX_default_VexArchInfo(&vta->archinfo_guest);
+   vta->archinfo_guest.hwcaps                 = c->desc->hwcaps;
+   vta->archinfo_guest.endness                = c->endness;
+   vta->archinfo_guest.ppc_icache_line_szB    = 128;
+   vta->archinfo_guest.ppc_dcbz_szB           = 128;
+   vta->archinfo_guest.ppc_dcbzl_szB          = 128;
+   vta->archinfo_guest.arm64_dMinLine_lg2_szB = 6;
+   vta->archinfo_guest.arm64_iMinLine_lg2_szB = 6;
+   vta->arch_host = host_arch();
+   LibVEX_default_VexArchInfo(&vta->archinfo_host);
+   vta->archinfo_host.endness = VexEndnessLE;
+   if (vta->arch_host == VexArchAMD64)
+      vta->archinfo_host.hwcaps = VEX_HWCAPS_AMD64_SSE3
+                                  | VEX_HWCAPS_AMD64_CX16;
+   LibVEX_default_VexAbiInfo(&vta->abiinfo_both);
+   vta->abiinfo_both.guest_stack_redzone_size = 128;
+   vta->guest_extents    = vge;
+   vta->chase_into_ok    = chase_into_not_ok;
+   vta->needs_self_check = needs_self_check;
+   vta->host_bytes       = host_bytes;
+   vta->host_bytes_size  = sizeof(host_bytes);
+   vta->host_bytes_used  = host_bytes_used;
+   /* Never jumped to; the translations are only measured. */
+   vta->disp_cp_chain_me_to_slowEP = (const void*)0x1000;
+   vta->disp_cp_chain_me_to_fastEP = (const void*)0x2000;
+   vta->disp_cp_xindir             = (const void*)0x3000;
+   vta->disp_cp_xassisted          = (const void*)0x4000;
+}
+
+static Bool is_simd_heavy ( const IRSB* irsb )
+{
+   Int i, n_vec = 0;
+   for (i = 0; i < irsb->tyenv->types_used; i++) {
+      if (irsb->tyenv->types[i] == Ity_V128
+          || irsb->tyenv->types[i] == Ity_V256)
+         n_vec++;
+   }
+   return n_vec >= 8 && 4 * n_vec >= irsb->tyenv->types_used;
+}
+
+/* Lift and translate the block vta points at.  Returns False if
+   either fails.  *simd says whether the block is SIMD-heavy. */
+static Bool translate ( VexTranslateArgs* vta, /*OUT*/Bool* simd )
+{
+   VexTranslateResult res;
+   VexRegisterUpdates pxControl;
+   IRSB*              irsb;
+
+   if (setjmp(failure_env))
+      return False;
+   irsb = LibVEX_Lift(vta, &res, &pxControl);
+   if (irsb == NULL)
+      return False;
+   *simd = is_simd_heavy(irsb);
+   LibVEX_Codegen(vta, &res, irsb, pxControl);
+   return res.status == VexTransOK;
+}
+
+static void get_stats ( /*OUT*/VexPipelineStats* st )
+{
+   if (LibVEX_GetPipelineStats(st, 1) == 0)
+      memset(st, 0, sizeof(*st));
+}
+
+/* Translate every block in c's .text with each allocator, adding to
+   totals[set][version]. */
+static void sweep ( const Corpus* c, VexControl* vcon, Int reps,
+                    /*OUT*/Totals totals[N_SETS][N_VERSIONS] )
+{
+   VexTranslateArgs vta;
+   VexGuestExtents  vge;
+   VexPipelineStats before, after;
+   Totals           block[N_VERSIONS];
+   Int              used, v, i, set;
+   ULong            off, step;
+   Bool             simd, ok;
+
+   setup_vta(c, &vta, &vge, &used);
+   memset(totals, 0, N_SETS * N_VERSIONS * sizeof(Totals));
+
+   for (off = 0; off < c->text_szB; off += step) {
+      step = c->desc->align;
+      vta.guest_bytes      = c->image + c->text_off + off + c->desc->thumb;
+      vta.guest_bytes_addr = c->text_addr + off + c->desc->thumb;
+
+      /* Only blocks that every allocator translates are counted, so
+         that the totals compare like with like. */
+      ok = True;
+      for (v = 0; v < N_VERSIONS && ok; v++) {
+         vcon->regalloc_version = versions[v];
+         LibVEX_Update_Control(vcon);
+         for (i = 0; i < reps && ok; i++) {
+            get_stats(&before);
+            ok = translate(&vta, &simd);
+            get_stats(&after);
+            ULong ns = after.stage[VexStageRegAlloc].time
+                       - before.stage[VexStageRegAlloc].time;
+            if (i == 0 || ns < block[v].ns)
+               block[v].ns = ns;
+         }
+         /* The counts are the same on every rep; take the last. */
+         block[v].blocks          = 1;
+         block[v].spills          = after.n_spills - before.n_spills;
+         block[v].reloads         = after.n_reloads - before.n_reloads;
+         block[v].moves_coalesced = after.n_moves_coalesced
+                                    - before.n_moves_coalesced;
+         block[v].host_bytes      = used;
+      }
+      for (set = 0; ok && set < N_SETS; set++) {
+         if (set == SET_SIMD && !simd)
+            continue;
+         for (v = 0; v < N_VERSIONS; v++) {
+            Totals* t = &totals[set][v];
+            t->blocks          += block[v].blocks;
+            t->ns              += block[v].ns;
+            t->spills          += block[v].spills;
+            t->reloads         += block[v].reloads;
+            t->moves_coalesced += block[v].moves_coalesced;
+            t->host_bytes      += block[v].host_bytes;
+         }
+      }
+      if (ok && vge.n_used >= 1 && vge.len[0] > step)
+         step = vge.len[0];
+   }
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Main                                                    ---*/
+/*---------------------------------------------------------------*/
+
+int main ( int argc, char** argv )
+{
+   VexControl vcon;
+   Corpus*    corpora;
+   Int        n_corpora, reps, i, j, set, v;
+   Totals     totals[N_SETS][N_VERSIONS];
+
+   reps = 3;
+   i    = 1;
+   if (argc > 2 && 0 == strcmp(argv[1], "-r")) {
+      reps = atoi(argv[2]);
+      i    = 3;
+   }
+   if (i >= argc || reps < 1) {
+      fprintf(stderr, "usage: bench_regalloc [-r reps] arch=file ...\n");
+      return 1;
+   }
+
+   n_corpora = argc - i;
+   corpora   = calloc(n_corpora, sizeof(Corpus));
+   for (j = 0; j < n_corpora; j++)
+      load_corpus(&corpora[j], argv[i + j]);
+
+   /* No chasing, so that blocks never leave the corpus.  Statistics
+      on throughout, since they give the allocator's time and
+      counts. */
+   LibVEX_default_VexControl(&vcon);
+   vcon.guest_chase_thresh = 0;
+   LibVEX_Init(failure_exit, log_bytes, 0, &vcon);
+   LibVEX_EnablePipelineStats(now_ns);
+
+   for (j = 0; j < n_corpora; j++) {
+      const Corpus* c = &corpora[j];
+      if (c->desc->arch == VexArchS390X && host_arch() != VexArchS390X) {
+         printf("regalloc arch=%s file=%s skipped=host_not_s390x\n",
+                c->desc->name, c->file);
+         continue;
+      }
+      LibVEX_ResetPipelineStats();
+      sweep(c, &vcon, reps, totals);
+
+      for (set = 0; set < N_SETS; set++) {
+         for (v = 0; v < N_VERSIONS; v++) {
+            const Totals* t = &totals[set][v];
+            printf("regalloc arch=%s file=%s set=%s version=%d "
+                   "blocks=%llu secs=%.6f ns_per_block=%.0f "
+                   "spills=%llu reloads=%llu moves_coalesced=%llu "
+                   "host_bytes=%llu\n",
+                   c->desc->name, c->file, set_names[set], versions[v],
+                   t->blocks, (double)t->ns / 1e9,
+                   t->blocks == 0 ? 0.0
+                                  : (double)t->ns / (double)t->blocks,
+                   t->spills, t->reloads, t->moves_coalesced,
+                   t->host_bytes);
+         }
+      }
+      fflush(stdout);
+   }
+   return 0;
+}
+
+/*---------------------------------------------------------------*/
+/*--- end                                    bench_regalloc.c ---*/
+/*---------------------------------------------------------------*/
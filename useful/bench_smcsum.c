@@ -0,0 +1,270 @@
+/*---------------------------------------------------------------*/
+/*--- begin                                    bench_smcsum.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* Self-check checksum benchmark.
+
+   usage: bench_smcsum [-r reps]
+
+   Times the generic checksum helpers which self-checking translations
+   call, as found in guest_generic_bb_to_IR.c: the scalar versions,
+   and the SSE2 and AVX2 versions where this machine has them.  This
+   program is linked with its own copy of guest_generic_bb_to_IR.c,
+   compiled with VEX_BENCH_SMCSUM defined, which makes the helpers
+   available through genericg_checksum_for_bench.
+
+   First, each vector version is checked to give the same results as
+   the scalar one, for both the 32- and 64-bit versions, over all
+   lengths up to 600 words and a range of buffer offsets, and each
+   version is checked to notice a change to any one word.  Then each
+   is timed at a selection of lengths, |reps| times (default 5),
+   keeping the fastest run; the versions take turns.  Lengths are
+   those which bb_to_IR can ask for -- under 1004 bytes -- and which
+   the specialised 1 to 12 word helpers don't cover.
+
+   Output is one line per word size and length, eg
+
+      bench bits=64 words=125 scalar_ns=... avx2_ns=... (x...)
+
+   where (x...) is the speedup over scalar.  There is an SSE2 version
+   only for 32-bit words and an AVX2 one only for 64-bit words.  Build
+   with "make -f Makefile-vex bench_smcsum" in this directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libvex_basictypes.h"
+#include "libvex_ir.h"
+#include "libvex.h"
+#include "guest_generic_bb_to_IR.h"
+
+typedef HWord VEX_REGPARM(2) (*ChecksumFn)(HWord, HWord);
+
+#define N_IMPLS 3
+static const char* impl_names[N_IMPLS] = { "scalar", "sse2", "avx2" };
+
+/* The helpers, by word size (0 for 32 bits, 1 for 64) and version.
+   NULL where there is no such version, or this machine can't run
+   it. */
+static ChecksumFn helpers[2][N_IMPLS];
+
+static void get_helpers ( void )
+{
+   Int sz, impl;
+   for (sz = 0; sz < 2; sz++) {
+      for (impl = 0; impl < N_IMPLS; impl++) {
+         helpers[sz][impl]
+            = (ChecksumFn)genericg_checksum_for_bench(sz ? 8 : 4, impl);
+      }
+   }
+#  if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+   __builtin_cpu_init();
+   if (!__builtin_cpu_supports("sse2")) {
+      helpers[0][1] = helpers[1][1] = NULL;
+   }
+   if (!__builtin_cpu_supports("avx2")) {
+      helpers[0][2] = helpers[1][2] = NULL;
+   }
+#  endif
+}
+
+
+/*---------------------------------------------------------------*/
+/*--- Checking and timing                                     ---*/
+/*---------------------------------------------------------------*/
+
+#define MAX_WORDS 600
+#define N_OFFSETS 8
+
+/* Room for MAX_WORDS 64-bit words at each of N_OFFSETS offsets. */
+static ULong buf[MAX_WORDS + N_OFFSETS];
+
+static ULong now_ns ( void )
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (ULong)ts.tv_sec * 1000000000ULL + (ULong)ts.tv_nsec;
+}
+
+static void fill ( ULong seed )
+{
+   Int i;
+   for (i = 0; i < MAX_WORDS + N_OFFSETS; i++) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      buf[i] = seed ^ (seed >> 29);
+   }
+}
+
+/* Call a helper.  The 32-bit ones return a UInt, so on a 64-bit
+   host only the low half of the result means anything. */
+static HWord call ( Int sz, Int impl, HWord a, HWord n )
+{
+   HWord r = helpers[sz][impl](a, n);
+   return sz ? r : (HWord)(UInt)r;
+}
+
+/* Returns the number of problems found. */
+static Int check ( void )
+{
+   Int   bad = 0, seed, off, n, sz, impl, i;
+   for (seed = 1; seed <= 20; seed++) {
+      fill(seed);
+      for (off = 0; off < N_OFFSETS; off++) {
+         for (sz = 0; sz < 2; sz++) {
+            HWord a = sz ? (HWord)&buf[off] : (HWord)((UInt*)buf + off);
+            for (n = 0; n <= MAX_WORDS; n++) {
+               HWord want = call(sz, 0, a, n);
+               for (impl = 1; impl < N_IMPLS; impl++) {
+                  if (helpers[sz][impl]
+                      && call(sz, impl, a, n) != want) {
+                     printf("mismatch: bits=%d words=%d offset=%d "
+                            "%s\n", sz ? 64 : 32, n, off,
+                            impl_names[impl]);
+                     bad++;
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   /* Flip one bit in each word of a 250-word area in turn. */
+   fill(0);
+   for (sz = 0; sz < 2; sz++) {
+      for (impl = 0; impl < N_IMPLS; impl++) {
+         HWord want;
+         if (!helpers[sz][impl])
+            continue;
+         want = call(sz, impl, (HWord)buf, 250);
+         for (i = 0; i < 250; i++) {
+            UInt* w = sz ? (UInt*)&buf[i] : (UInt*)buf + i;
+            *w ^= 1U << (i % 32);
+            if (call(sz, impl, (HWord)buf, 250) == want) {
+               printf("insensitive: bits=%d word=%d %s\n",
+                      sz ? 64 : 32, i, impl_names[impl]);
+               bad++;
+            }
+            *w ^= 1U << (i % 32);
+         }
+      }
+   }
+   return bad;
+}
+
+/* The time of one run of |calls| calls of fn, in ns.  The results
+   are summed into |sink|, and the empty asm tells the compiler the
+   buffer may have changed, so the calls can be neither removed nor
+   hoisted. */
+static ULong time_run ( ChecksumFn fn, HWord n, Int calls,
+                        volatile HWord* sink )
+{
+   HWord acc = 0;
+   ULong t0  = now_ns();
+   Int   i;
+   for (i = 0; i < calls; i++) {
+      __asm__ __volatile__("" ::: "memory");
+      acc += fn((HWord)buf, n);
+   }
+   *sink += acc;
+   return now_ns() - t0;
+}
+
+/* The fastest of |reps| runs of each version, in ns per call, for
+   n-word checks of sz-sized words.  The versions take turns, so
+   that they all see much the same clock speed. */
+static void time_all ( Int sz, HWord n, Int reps, /*OUT*/double* ns,
+                       volatile HWord* sink )
+{
+   const Int calls = 200000;
+   ULong best[N_IMPLS];
+   Int   r, impl;
+   for (impl = 0; impl < N_IMPLS; impl++)
+      best[impl] = ~0ULL;
+   for (r = 0; r < reps; r++) {
+      for (impl = 0; impl < N_IMPLS; impl++) {
+         ULong t;
+         if (!helpers[sz][impl])
+            continue;
+         t = time_run(helpers[sz][impl], n, calls, sink);
+         if (t < best[impl]) best[impl] = t;
+      }
+   }
+   for (impl = 0; impl < N_IMPLS; impl++)
+      ns[impl] = (double)best[impl] / (double)calls;
+}
+
+int main ( int argc, char** argv )
+{
+   static const Int lengths[]
+      = { 13, 16, 24, 31, 32, 48, 64, 96, 125, 160, 200, 250 };
+   volatile HWord sink = 0;
+   Int reps = 5, sz, impl, i;
+
+   if (argc == 3 && argv[1][0] == '-' && argv[1][1] == 'r'
+       && argv[1][2] == 0) {
+      reps = atoi(argv[2]);
+   } else if (argc != 1) {
+      fprintf(stderr, "usage: bench_smcsum [-r reps]\n");
+      return 1;
+   }
+   if (reps < 1) reps = 1;
+
+   get_helpers();
+   if (check() != 0) {
+      printf("FAILED: checksum helpers disagree or miss changes\n");
+      return 1;
+   }
+   printf("check ok:");
+   for (impl = 0; impl < N_IMPLS; impl++) {
+      if (helpers[0][impl] || helpers[1][impl])
+         printf(" %s", impl_names[impl]);
+   }
+   printf("\n");
+
+   fill(0);
+   for (sz = 0; sz < 2; sz++) {
+      for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+         double ns[N_IMPLS];
+         if (lengths[i] * (sz ? 8 : 4) >= 1004)
+            continue;
+         time_all(sz, lengths[i], reps, ns, &sink);
+         printf("bench bits=%d words=%d scalar_ns=%.2f",
+                sz ? 64 : 32, lengths[i], ns[0]);
+         for (impl = 1; impl < N_IMPLS; impl++) {
+            if (!helpers[sz][impl])
+               continue;
+            printf(" %s_ns=%.2f (x%.2f)", impl_names[impl], ns[impl],
+                   ns[0] / ns[impl]);
+         }
+         printf("\n");
+      }
+   }
+   return 0;
+}
+
+/*---------------------------------------------------------------*/
+/*--- end                                      bench_smcsum.c ---*/
+/*---------------------------------------------------------------*/
@@ -0,0 +1,190 @@
+/*---------------------------------------------------------------*/
+/*--- begin                                 test_liftregion.c ---*/
+/*---------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* LibVEX_LiftRegion test: entry points near the edges of the code.
+
+   usage: test_liftregion
+
+   A page of amd64 code is put directly before an inaccessible page,
+   so that any read past the end of the code faults.  The page is all
+   NOPs, except that the last three bytes are the start of a five
+   byte "movl $imm32, %eax" followed by a NOP.  A region is lifted
+   with entry points at the start of the page and 16, 3 and 1 bytes
+   from its end, and then:
+
+   - the entry 3 bytes from the end, whose insn runs off the end,
+     must have no block;
+   - the entry 16 bytes from the end must stop short of that insn,
+     after 13 bytes;
+   - the entry 1 byte from the end must be a block of just that NOP;
+   - every block must lie within the page and pass sanityCheckIRSB.
+
+   Prints "ok" and exits with 0 on success.  amd64 hosts only.  Build
+   with "make -f Makefile-vex test_liftregion" in this directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "libvex_basictypes.h"
+#include "libvex.h"
+#include "libvex_ir.h"
+
+__attribute__ ((noreturn))
+static void failure_exit ( void )
+{
+   printf("FAILED: LibVEX failure exit\n");
+   exit(1);
+}
+
+static void log_bytes ( const HChar* bytes, SizeT nbytes )
+{
+   fwrite(bytes, 1, nbytes, stderr);
+}
+
+static Bool chase_into_not_ok ( void* opaque, Addr dst )
+{
+   return False;
+}
+
+static UInt needs_self_check ( void* opaque, VexRegisterUpdates* pxControl,
+                               const VexGuestExtents* vge )
+{
+   return 0;
+}
+
+static Int n_failures = 0;
+
+static void check ( Bool ok, const HChar* what )
+{
+   if (!ok) {
+      printf("FAILED: %s\n", what);
+      n_failures++;
+   }
+}
+
+int main ( void )
+{
+   static UChar       host_bytes[65536];
+   VexControl         vcon;
+   VexTranslateArgs   vta;
+   VexTranslateResult res;
+   VexRegion*         rg;
+   Addr               entries[4];
+   UChar*             page;
+   Long               szB = sysconf(_SC_PAGESIZE);
+   Addr               base, end;
+   UInt               i;
+
+#  if !defined(__x86_64__)
+   printf("ok (skipped: not an amd64 host)\n");
+   return 0;
+#  endif
+
+   page = mmap(NULL, 2 * szB, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (page == MAP_FAILED || mprotect(page + szB, szB, PROT_NONE) != 0) {
+      perror("mmap");
+      return 1;
+   }
+   memset(page, 0x90, szB);
+   page[szB - 3] = 0xB8;  /* movl $imm32, %eax, cut short */
+   page[szB - 2] = 0x01;
+   page[szB - 1] = 0x90;
+   base = (Addr)page;
+   end  = base + szB;
+
+   LibVEX_default_VexControl(&vcon);
+   vcon.guest_max_insns = 50;
+   LibVEX_Init(failure_exit, log_bytes, 0, &vcon);
+
+   memset(&vta, 0, sizeof(vta));
+   vta.arch_guest = VexArchAMD64;
+   LibVEX_default_VexArchInfo(&vta.archinfo_guest);
+   vta.archinfo_guest.hwcaps  = VEX_HWCAPS_AMD64_SSE3 | VEX_HWCAPS_AMD64_CX16;
+   vta.archinfo_guest.endness = VexEndnessLE;
+   vta.arch_host = VexArchAMD64;
+   LibVEX_default_VexArchInfo(&vta.archinfo_host);
+   vta.archinfo_host.hwcaps  = VEX_HWCAPS_AMD64_SSE3 | VEX_HWCAPS_AMD64_CX16;
+   vta.archinfo_host.endness = VexEndnessLE;
+   LibVEX_default_VexAbiInfo(&vta.abiinfo_both);
+   vta.abiinfo_both.guest_stack_redzone_size = 128;
+   vta.guest_bytes      = page;
+   vta.guest_bytes_addr = base;
+   vta.chase_into_ok    = chase_into_not_ok;
+   vta.needs_self_check = needs_self_check;
+   vta.host_bytes       = host_bytes;
+   vta.host_bytes_size  = sizeof(host_bytes);
+   vta.recover_errors   = True;
+
+   entries[0] = base;
+   entries[1] = end - 16;
+   entries[2] = end - 3;
+   entries[3] = end - 1;
+   rg = LibVEX_LiftRegion(&vta, szB, entries, 4, 1000, False, &res);
+   if (rg == NULL) {
+      printf("FAILED: LibVEX_LiftRegion: %s\n",
+             res.error_msg ? res.error_msg : "(no message)");
+      return 1;
+   }
+
+   check(rg->entries[0] >= 0, "no block at the start");
+   check(rg->entries[1] >= 0, "no block 16 bytes from the end");
+   check(rg->entries[2] == -1, "block for an insn running off the end");
+   check(rg->entries[3] >= 0, "no block 1 byte from the end");
+   if (rg->entries[1] >= 0) {
+      const VexRegionBlock* blk = &rg->blocks[rg->entries[1]];
+      check(blk->guest_extents.len[0] == 13
+            && blk->n_guest_instrs == 13,
+            "block 16 bytes from the end is not 13 NOPs");
+   }
+   if (rg->entries[3] >= 0) {
+      const VexRegionBlock* blk = &rg->blocks[rg->entries[3]];
+      check(blk->guest_extents.len[0] == 1 && blk->n_guest_instrs == 1,
+            "block 1 byte from the end is not 1 NOP");
+   }
+
+   for (i = 0; i < rg->n_blocks; i++) {
+      const VexRegionBlock* blk = &rg->blocks[i];
+      check(blk->guest_extents.n_used == 1
+            && blk->guest_extents.base[0] >= base
+            && blk->guest_extents.base[0]
+               + blk->guest_extents.len[0] <= end,
+            "block outside the code");
+      sanityCheckIRSB(blk->irsb, "test_liftregion", False, Ity_I64);
+   }
+
+   if (n_failures > 0)
+      return 1;
+   printf("ok\n");
+   return 0;
+}
+
+/*---------------------------------------------------------------*/
+/*--- end                                   test_liftregion.c ---*/
+/*---------------------------------------------------------------*/
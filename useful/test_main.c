@@ -265,6 +265,9 @@ int main ( int argc, char** argv )
       vta.traceflags      = TEST_FLAGS;
       vta.addProfInc      = False;
       vta.sigill_diag     = True;
+      vta.lift_mode       = VexLiftFull;
+      vta.skip_initial_sanity = False;
+      vta.recover_errors  = False;
 
       vta.disp_cp_chain_me_to_slowEP = (void*)0x12345678;
       vta.disp_cp_chain_me_to_fastEP = (void*)0x12345679;